@@ -2,4 +2,5 @@
 SELECT mediaids.mediaid, mediaids.mediauniqueid, medianame.name, mediamap.mediatype
 FROM mediamap
 INNER JOIN medianame ON mediamap.medianameid = medianame.id
-INNER JOIN mediaids ON mediamap.mediaid = mediaids.id;
\ No newline at end of file
+INNER JOIN mediaids ON mediamap.mediaid = mediaids.id
+ORDER BY mediamap.mediaid, mediamap.id;
\ No newline at end of file
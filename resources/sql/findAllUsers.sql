@@ -0,0 +1 @@
+SELECT userid, info FROM usermap
\ No newline at end of file
@@ -0,0 +1,8 @@
+-- Media with an alias starting with the query, for queries too short to
+-- have trigrams
+SELECT medianame.name, mediaids.mediaid, mediaids.mediauniqueid, mediamap.mediatype
+FROM medianame
+INNER JOIN mediamap ON mediamap.medianameid = medianame.id
+INNER JOIN mediaids ON mediamap.mediaid = mediaids.id
+WHERE medianame.name LIKE ? ESCAPE '\'
+LIMIT ?;
\ No newline at end of file
@@ -0,0 +1,9 @@
+-- Media with an alias sharing a trigram with the query, best BM25 rank first
+SELECT medianame.name, mediaids.mediaid, mediaids.mediauniqueid, mediamap.mediatype
+FROM medianame_fts
+INNER JOIN medianame ON medianame.id = medianame_fts.rowid
+INNER JOIN mediamap ON mediamap.medianameid = medianame.id
+INNER JOIN mediaids ON mediamap.mediaid = mediaids.id
+WHERE medianame_fts MATCH ?
+ORDER BY medianame_fts.rank
+LIMIT ?;
\ No newline at end of file
@@ -266,10 +266,27 @@ void TgBotApiImpl::removeAnyMessageCallbacksForCommand(
 }
 
 void TgBotApiImpl::onCallbackQuery(
-    std::string command,
-    TgBot::EventBroadcaster::CallbackQueryListener listener) {
+    std::string command, std::string dataPrefix,
+    TgBot::EventBroadcaster::CallbackQueryListener listener, CallbackAck ack) {
     onCallbackQueryImpl->onCallbackQuery(std::move(command),
-                                         std::move(listener));
+                                         std::move(dataPrefix),
+                                         std::move(listener), ack);
+}
+
+std::shared_ptr<void> TgBotApiImpl::holdCallbackAnswer(
+    const std::string_view callbackQueryId) {
+    if (!onCallbackQueryImpl) {
+        return nullptr;
+    }
+    return onCallbackQueryImpl->holdAnswer(callbackQueryId);
+}
+
+std::vector<TgBotApi::CallbackQueryStats> TgBotApiImpl::callbackQueryStats()
+    const {
+    if (!onCallbackQueryImpl) {
+        return {};
+    }
+    return onCallbackQueryImpl->stats();
 }
 
 void TgBotApiImpl::onEditedMessage(
@@ -646,6 +663,19 @@ bool TgBotApiImpl::setMessageReaction_impl(
 bool TgBotApiImpl::answerCallbackQuery_impl(
     const std::string_view callbackQueryId, const std::string_view text,
     bool showAlert) const {
+    if (onCallbackQueryImpl &&
+        !onCallbackQueryImpl->claimAnswer(callbackQueryId)) {
+        // Not posted to the chat instead: alerts and refusals are meant for
+        // the one who pressed the button only.
+        if (!text.empty()) {
+            LOG(INFO) << "Dropping late answer to callback query "
+                      << callbackQueryId << ": " << text;
+        } else {
+            DLOG(INFO) << "Callback query was already acknowledged: "
+                       << callbackQueryId;
+        }
+        return false;
+    }
     return getApi().answerCallbackQuery(callbackQueryId, text, showAlert);
 }
 
@@ -724,7 +754,9 @@ TgBotApiImpl::TgBotApiImpl(const std::string_view token, AuthContext* auth,
     // Restart command
     restartCommand = std::make_unique<RestartCommand>(this);
     // Reactions provider
-    reactionsProvider = std::make_unique<ReactionsProvider>(this);
+    reactionsProvider = std::make_unique<ReactionsProvider>(
+        this, providers->cmdline->getPath(FS::PathType::RESOURCES) /
+                  "reactions.json");
 
     // Log bot info
     LOG(INFO) << "TgBotApiImpl::Ctor BOT username: "
@@ -105,6 +105,10 @@ class ROMBuildQueryHandler {
     }
 
    public:
+    // Starts the callback data of every button of this handler, which is
+    // all it is routed.
+    constexpr static std::string_view kCallbackQueryPrefix = "rombuild_";
+
     ROMBuildQueryHandler(TgBotApi::Ptr api, Message::Ptr userMessage,
                          CommandLine* line, AuthContext* uath,
                          ConfigManager* mgr);
@@ -117,6 +121,12 @@ class ROMBuildQueryHandler {
 
    private:
     using Query = TgBot::CallbackQuery::Ptr;
+
+    // The callback data of a button: `data` behind kCallbackQueryPrefix.
+    static std::string callbackData(const std::string_view data) {
+        return fmt::format("{}{}", kCallbackQueryPrefix, data);
+    }
+
     struct ButtonHandler {
         std::string text;
         std::string data;
@@ -141,7 +151,7 @@ class ROMBuildQueryHandler {
         }
 
         [[nodiscard]] KeyboardBuilder::Button toButton() const {
-            return {text, data};
+            return {text, callbackData(data)};
         }
     };
 
@@ -891,9 +901,11 @@ class RomTgObserver : public tgbot::builder::IBuildObserver {
 
 void ROMBuildQueryHandler::handle_confirm(const Query& query) {
     auto backKeyboard2 = KeyboardBuilder()
-                             .addKeyboard({{"Back", "back"},
-                                           {"Retry", "confirm"},
-                                           {"Tick RepoSync", "repo_sync_only"}})
+                             .addKeyboard(
+                                 {{"Back", callbackData("back")},
+                                  {"Retry", callbackData("confirm")},
+                                  {"Tick RepoSync",
+                                   callbackData("repo_sync_only")}})
                              .get();
     _api->answerCallbackQuery(query->id, "Starting build...");
     _api->editMessage(sentMessage, "Starting build...");
@@ -957,7 +969,7 @@ void ROMBuildQueryHandler::handle_confirm(const Query& query) {
     }
 
     KeyboardBuilder cancelKb;
-    cancelKb.addKeyboard({{"Cancel build", "cancel"}});
+    cancelKb.addKeyboard({{"Cancel build", callbackData("cancel")}});
 
     const auto start = std::chrono::system_clock::now();
     RomTgObserver observer(_api, sentMessage, stats_.get(), cancelKb.get(),
@@ -1096,7 +1108,8 @@ void ROMBuildQueryHandler::handle_build(const Query& query) {
     }
     buttons.reserve(localManifest.size());
     for (const auto& [name, manifest] : localManifest) {
-        buttons.emplace_back(name, fmt::format("local_manifest_{}", name));
+        buttons.emplace_back(
+            name, callbackData(fmt::format("local_manifest_{}", name)));
     }
     builder.addKeyboard(buttons);
     builder.addKeyboard(getButtonOf<Buttons::back>());
@@ -1133,7 +1146,8 @@ void ROMBuildQueryHandler::handle_local_manifest(const Query& query) {
 
     for (const auto& device : devices) {
         builder.addKeyboard(
-            {device->toString(), fmt::format("device_{}", device->codename)});
+            {device->toString(),
+             callbackData(fmt::format("device_{}", device->codename))});
     }
     builder.addKeyboard(getButtonOf<Buttons::back>());
     _api->editMessage(sentMessage, "Select device...", builder.get());
@@ -1174,7 +1188,8 @@ void ROMBuildQueryHandler::handle_device(const Query& query) {
     KeyboardBuilder builder;
     for (const auto& roms : uniqueRoms) {
         builder.addKeyboard(
-            {roms->romInfo->name, fmt::format("rom_{}", roms->romInfo->name)});
+            {roms->romInfo->name,
+             callbackData(fmt::format("rom_{}", roms->romInfo->name))});
     }
     builder.addKeyboard(getButtonOf<Buttons::back>());
     _api->editMessage(sentMessage, "Select ROM...", builder.get());
@@ -1208,8 +1223,9 @@ void ROMBuildQueryHandler::handle_rom(const Query& query) {
 
     KeyboardBuilder builder;
     for (const auto& version : androidVersions) {
-        builder.addKeyboard({version->name, fmt::format("android_version_{}",
-                                                        version->version)});
+        builder.addKeyboard(
+            {version->name, callbackData(fmt::format("android_version_{}",
+                                                     version->version))});
     }
     builder.addKeyboard(getButtonOf<Buttons::back>());
     _api->editMessage(sentMessage, "Select Android version...", builder.get());
@@ -1247,9 +1263,9 @@ void ROMBuildQueryHandler::handle_android_version(const Query& query) {
     lookup._localManifest.clear();
 
     KeyboardBuilder builder;
-    builder.addKeyboard({{"User build", "type_user"},
-                         {"Userdebug build", "type_userdebug"},
-                         {"Eng build", "type_eng"}});
+    builder.addKeyboard({{"User build", callbackData("type_user")},
+                         {"Userdebug build", callbackData("type_userdebug")},
+                         {"Eng build", callbackData("type_eng")}});
     builder.addKeyboard(getButtonOf<Buttons::back>());
     _api->editMessage(sentMessage, "Select build variant...", builder.get());
 }
@@ -1383,9 +1399,10 @@ void ROMBuildQueryHandler::handle_clean_directories(const Query& query) {
             }
             return;
         }
-        builder.addKeyboard({"Clean ROM directory", "clean_rom"});
+        builder.addKeyboard({"Clean ROM directory", callbackData("clean_rom")});
         if (boolValue.exists()) {
-            builder.addKeyboard({"Clean ROM build directory", "clean_build"});
+            builder.addKeyboard({"Clean ROM build directory",
+                                 callbackData("clean_build")});
         }
     }
     builder.addKeyboard(getButtonOf<Buttons::back>());
@@ -1425,6 +1442,13 @@ void ROMBuildQueryHandler::onCallbackQuery(
             "Sorry son, you are not allowed to touch this keyboard.");
         return;
     }
+    // The buttons match on their data without the prefix.
+    std::string_view data = query->data;
+    if (!absl::ConsumePrefix(&data, kCallbackQueryPrefix)) {
+        LOG(ERROR) << "Unknown callback query: " << query->data;
+        return;
+    }
+    query->data = std::string(data);
     for (const auto& handler : buttonHandlers) {
         if (handler.matcher(query)) {
             try {
@@ -1451,16 +1475,18 @@ DECLARE_COMMAND_HANDLER(rombuild) {
                 api, message->message(), provider->cmdline.get(),
                 provider->auth.get(), provider->config.get());
 
-            api->onCallbackQuery("rombuild", [](TgBot::CallbackQuery::Ptr
-                                                    query) {
-                std::lock_guard<std::mutex> lock(handler_mutex);
-                if (handler) {
-                    handler->onCallbackQuery(std::move(query));
-                } else {
-                    LOG(WARNING)
-                        << "No ROMBuildQueryHandler to handle callback query";
-                }
-            });
+            api->onCallbackQuery(
+                "rombuild",
+                std::string(ROMBuildQueryHandler::kCallbackQueryPrefix),
+                [](TgBot::CallbackQuery::Ptr query) {
+                    std::lock_guard<std::mutex> lock(handler_mutex);
+                    if (handler) {
+                        handler->onCallbackQuery(std::move(query));
+                    } else {
+                        LOG(WARNING) << "No ROMBuildQueryHandler to handle "
+                                        "callback query";
+                    }
+                });
         } catch (const std::exception& e) {
             LOG(ERROR) << "Failed to create ROMBuildQueryHandler: " << e.what();
             init_failed = true;
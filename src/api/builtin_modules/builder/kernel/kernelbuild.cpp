@@ -717,6 +717,7 @@ DECLARE_COMMAND_HANDLER(kernelbuild) {
 
             api->onCallbackQuery(
                 "kernelbuild",
+                std::string(KernelBuildHandler::kCallbackQueryPrefix),
                 [api, provider](const TgBot::CallbackQuery::Ptr& ptr) {
                     std::string_view data = ptr->data;
 
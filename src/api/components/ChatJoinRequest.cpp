@@ -72,7 +72,6 @@ void TgBotApiImpl::ChatJoinRequestImpl::onCallbackQueryFunction(
                                      request->chat);
             _api->getApi().approveChatJoinRequest(request->chat->id,
                                                   request->from->id);
-            _api->getApi().answerCallbackQuery(query->id, "Approved user");
             result = fmt::format("Approved user {} by {}", request->from,
                                  query->from);
         } else if (queryData == "disapprove") {
@@ -80,8 +79,6 @@ void TgBotApiImpl::ChatJoinRequestImpl::onCallbackQueryFunction(
                                      request->chat);
             _api->getApi().declineChatJoinRequest(request->chat->id,
                                                   request->from->id);
-            _api->getApi().answerCallbackQuery(query->id, "Declined user");
-
             result = fmt::format("Declined user {} by {}", request->from,
                                  query->from);
         } else if (queryData == "ban") {
@@ -91,14 +88,13 @@ void TgBotApiImpl::ChatJoinRequestImpl::onCallbackQueryFunction(
             _api->getApi().declineChatJoinRequest(request->chat->id,
                                                   request->from->id);
             _api->getApi().banChatMember(request->chat->id, request->from->id);
-            _api->getApi().answerCallbackQuery(query->id, "Banned user");
             result = fmt::format("Declined and banned user {} by {}",
                                  request->from, query->from);
         } else {
             LOG(ERROR) << "Invalid payload: " << query->data
                        << ". Parsed item: " << queryData;
-            _api->getApi().answerCallbackQuery(query->id,
-                                               "Error occurred while parsing");
+            _api->answerCallbackQuery(query->id,
+                                      "Error occurred while parsing");
             return;
         }
         _api->editMessage(reqIt->first, result);
@@ -153,10 +149,14 @@ TgBotApiImpl::ChatJoinRequestImpl::ChatJoinRequestImpl(TgBotApiImpl::Ptr api)
                 LOG(ERROR) << "Error in onChatJoinRequest: " << ex.what();
             }
         });
-    _api->onCallbackQuery("[builtin::ChatJoinRequest]",
-                          [this](const TgBot::CallbackQuery::Ptr& query) {
-                              onCallbackQueryFunction(query);
-                          });
+    // The outcome is edited into the request message, and deciding it takes
+    // several API calls, so don't keep the button spinning meanwhile.
+    _api->onCallbackQuery(
+        "[builtin::ChatJoinRequest]", "chatjoin_",
+        [this](const TgBot::CallbackQuery::Ptr& query) {
+            onCallbackQueryFunction(query);
+        },
+        TgBotApi::CallbackAck::Immediate);
     _api->getEvents().onChatMember(
         [this](const TgBot::ChatMemberUpdated::Ptr& update) {
             try {
@@ -1,6 +1,11 @@
 #include <api/components/ModuleExecutionContext.hpp>
 #include <api/components/ModuleManagement.hpp>
 #include <api/components/OnCallbackQuery.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace {
 struct CallbackInvocation {
@@ -24,51 +29,305 @@ struct CallbackInvocation {
 };
 }  // namespace
 
+struct TgBotApiImpl::OnCallbackQueryImpl::HandlerTicket {
+    HandlerTicket(OnCallbackQueryImpl* owner, std::string queryId)
+        : owner(owner), queryId(std::move(queryId)) {}
+    ~HandlerTicket() { owner->finishHandler(queryId); }
+    NO_COPY_CTOR(HandlerTicket);
+
+    OnCallbackQueryImpl* owner;
+    std::string queryId;
+};
+
+void TgBotApiImpl::OnCallbackQueryImpl::HandlerStats::record(
+    const std::chrono::microseconds elapsed) {
+    const auto micros = static_cast<std::uint64_t>(elapsed.count());
+    calls.fetch_add(1, std::memory_order_relaxed);
+    totalMicros.fetch_add(micros, std::memory_order_relaxed);
+    auto seen = maxMicros.load(std::memory_order_relaxed);
+    while (seen < micros && !maxMicros.compare_exchange_weak(
+                                seen, micros, std::memory_order_relaxed)) {
+    }
+}
+
+TgBotApiImpl::OnCallbackQueryImpl::RoutesSnapshot::RoutesSnapshot(
+    OnCallbackQueryImpl* owner)
+    : owner_(owner) {
+    const std::lock_guard<std::mutex> lock(owner_->mutex);
+    routes_ = owner_->routes;
+    id_ = owner_->nextSnapshot++;
+    owner_->snapshotsInUse.emplace(id_);
+}
+
+TgBotApiImpl::OnCallbackQueryImpl::RoutesSnapshot::~RoutesSnapshot() {
+    {
+        const std::lock_guard<std::mutex> lock(owner_->mutex);
+        // Under the lock, so the listeners of replaced routes are destroyed
+        // before onUnload() sees this snapshot gone.
+        routes_.reset();
+        owner_->snapshotsInUse.erase(id_);
+    }
+    owner_->snapshotReleased.notify_all();
+}
+
+void TgBotApiImpl::OnCallbackQueryImpl::Routes::addLengthOf(
+    const std::string& prefix) {
+    const auto it = std::ranges::lower_bound(prefixLengths, prefix.size());
+    if (it == prefixLengths.end() || *it != prefix.size()) {
+        prefixLengths.insert(it, prefix.size());
+    }
+}
+
+void TgBotApiImpl::OnCallbackQueryImpl::dispatch(
+    const Listener& listener, const TgBot::CallbackQuery::Ptr& query,
+    std::shared_ptr<RefLock::SharedLease> lease) {
+    auto ticket = std::make_shared<HandlerTicket>(this, query->id);
+    auto invocation = std::make_shared<CallbackInvocation>();
+    invocation->owner = listener.command;
+    invocation->moduleLease = std::move(lease);
+    invocation->callback = listener.callback;
+    invocation->query = query;
+    auto task = [invocation, stats = listener.stats,
+                 ticket = std::move(ticket)] {
+        const auto start = std::chrono::steady_clock::now();
+        (*invocation)();
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+        stats->record(elapsed);
+        if (elapsed > kSlowHandlerThreshold) {
+            LOG(WARNING) << "Slow callback-query handler " << invocation->owner
+                         << ": " << elapsed.count() / 1000 << "ms for "
+                         << invocation->query->data;
+        }
+    };
+    if (!queryAsync.emplaceTask(listener.command, std::move(task))) {
+        LOG(WARNING) << "Callback-query queue is full; rejecting "
+                     << listener.command;
+    }
+}
+
 void TgBotApiImpl::OnCallbackQueryImpl::onCallbackQueryFunction(
     TgBot::CallbackQuery::Ptr query) {
-    const std::lock_guard<std::mutex> lock(mutex);
-    if (listeners.empty()) {
-        return;
+    const RoutesSnapshot snapshot(this);
+    std::vector<const Listener*> matched;
+    const std::string_view data = query->data;
+    for (const auto length : snapshot->prefixLengths) {
+        if (length > data.size()) {
+            break;
+        }
+        const auto it =
+            snapshot->byPrefix.find(std::string(data.substr(0, length)));
+        if (it == snapshot->byPrefix.end()) {
+            continue;
+        }
+        for (const auto& listener : it->second) {
+            matched.emplace_back(&listener);
+        }
+    }
+    for (const auto& listener : snapshot->catchAll) {
+        matched.emplace_back(&listener);
+    }
+
+    // Handlers of a module being unloaded don't run.
+    std::vector<
+        std::pair<const Listener*, std::shared_ptr<RefLock::SharedLease>>>
+        runnable;
+    if (_api->kModuleLoader) {
+        for (const auto* listener : matched) {
+            if (auto lease = _api->kModuleLoader->acquireExecutionLease(
+                    listener->command)) {
+                runnable.emplace_back(listener, std::move(lease));
+            }
+        }
+    }
+
+    // Nobody will answer a query without handlers, and any Immediate handler
+    // means the query is answered up front; otherwise give handlers a grace
+    // period. The handlers are counted in the same critical section that
+    // schedules the ack, so the ack can't complete the query under them.
+    const bool deferred =
+        !runnable.empty() && std::ranges::all_of(runnable, [](const auto& r) {
+            return r.first->ack == TgBotApi::CallbackAck::Deferred;
+        });
+    {
+        const std::lock_guard lock(ackMutex);
+        pendingAcks[query->id].running += runnable.size();
+        const std::chrono::steady_clock::duration delay =
+            deferred ? kAckGrace : std::chrono::milliseconds::zero();
+        scheduleAckLocked(query->id, delay);
     }
-    for (const auto& [command, callback] : listeners) {
-        if (!_api->kModuleLoader) {
+    ackCondition.notify_one();
+
+    for (auto& [listener, lease] : runnable) {
+        dispatch(*listener, query, std::move(lease));
+    }
+}
+
+void TgBotApiImpl::OnCallbackQueryImpl::scheduleAckLocked(
+    std::string queryId, const std::chrono::steady_clock::duration delay) {
+    ackQueue.emplace(std::chrono::steady_clock::now() + delay,
+                     std::move(queryId));
+}
+
+void TgBotApiImpl::OnCallbackQueryImpl::finishHandler(
+    const std::string& queryId) {
+    {
+        const std::lock_guard lock(ackMutex);
+        const auto it = pendingAcks.find(queryId);
+        if (it == pendingAcks.end() || --it->second.running != 0) {
+            return;
+        }
+        if (it->second.answered) {
+            pendingAcks.erase(it);
+            return;
+        }
+        // The last handler returned without answering; don't wait out the
+        // grace period.
+        scheduleAckLocked(queryId, std::chrono::steady_clock::duration::zero());
+    }
+    ackCondition.notify_one();
+}
+
+bool TgBotApiImpl::OnCallbackQueryImpl::claimAnswer(
+    const std::string_view queryId) {
+    const std::lock_guard lock(ackMutex);
+    const auto it = pendingAcks.find(std::string(queryId));
+    if (it == pendingAcks.end()) {
+        // Not a query we are tracking, e.g. it already completed.
+        return true;
+    }
+    if (it->second.answered) {
+        return false;
+    }
+    it->second.answered = true;
+    if (it->second.running == 0) {
+        pendingAcks.erase(it);
+    }
+    return true;
+}
+
+std::shared_ptr<void> TgBotApiImpl::OnCallbackQueryImpl::holdAnswer(
+    const std::string_view queryId) {
+    const std::lock_guard lock(ackMutex);
+    const auto it = pendingAcks.find(std::string(queryId));
+    if (it == pendingAcks.end() || it->second.answered) {
+        return nullptr;
+    }
+    ++it->second.running;
+    return std::make_shared<HandlerTicket>(this, it->first);
+}
+
+void TgBotApiImpl::OnCallbackQueryImpl::ackThreadFunction() {
+    std::unique_lock lock(ackMutex);
+    while (!stopAcks) {
+        if (ackQueue.empty()) {
+            ackCondition.wait(lock);
             continue;
         }
-        auto leaseHolder = _api->kModuleLoader->acquireExecutionLease(command);
-        if (!leaseHolder) {
+        const auto due = ackQueue.begin()->first;
+        if (std::chrono::steady_clock::now() < due) {
+            ackCondition.wait_until(lock, due);
             continue;
         }
-        auto invocation = std::make_shared<CallbackInvocation>();
-        invocation->owner = command;
-        invocation->moduleLease = std::move(leaseHolder);
-        invocation->callback = callback;
-        invocation->query = query;
-        if (!queryAsync.emplaceTask(command,
-                                    [invocation] { (*invocation)(); })) {
-            LOG(WARNING) << "Callback-query queue is full; rejecting "
-                         << command;
+        auto queryId = std::move(ackQueue.begin()->second);
+        ackQueue.erase(ackQueue.begin());
+
+        const auto it = pendingAcks.find(queryId);
+        if (it == pendingAcks.end()) {
+            continue;
+        }
+        const bool send = !it->second.answered;
+        it->second.answered = true;
+        if (it->second.running == 0) {
+            pendingAcks.erase(it);
+        }
+        if (!send) {
+            continue;
         }
+        lock.unlock();
+        try {
+            _api->getApi().answerCallbackQuery(queryId);
+        } catch (const TgBot::TgException& e) {
+            LOG(WARNING) << "Could not acknowledge callback query: "
+                         << e.what();
+        }
+        lock.lock();
     }
 }
 
 void TgBotApiImpl::OnCallbackQueryImpl::onCallbackQuery(
-    std::string command,
-    TgBot::EventBroadcaster::CallbackQueryListener listener) {
+    std::string command, std::string dataPrefix,
+    TgBot::EventBroadcaster::CallbackQueryListener listener,
+    const TgBotApi::CallbackAck ack) {
     const std::lock_guard<std::mutex> _(mutex);
-    listeners.emplace(std::move(command), std::move(listener));
+    auto next = std::make_shared<Routes>(*routes);
+    Listener entry{.command = std::move(command),
+                   .dataPrefix = std::move(dataPrefix),
+                   .callback = std::move(listener),
+                   .ack = ack,
+                   .stats = std::make_shared<HandlerStats>()};
+    if (entry.dataPrefix.empty()) {
+        next->catchAll.emplace_back(std::move(entry));
+    } else {
+        next->addLengthOf(entry.dataPrefix);
+        auto key = entry.dataPrefix;
+        next->byPrefix[std::move(key)].emplace_back(std::move(entry));
+    }
+    routes = std::move(next);
+}
+
+std::vector<TgBotApi::CallbackQueryStats>
+TgBotApiImpl::OnCallbackQueryImpl::stats() {
+    const RoutesSnapshot snapshot(this);
+    std::vector<TgBotApi::CallbackQueryStats> result;
+    const auto append = [&result](const Listener& listener) {
+        const auto calls = listener.stats->calls.load();
+        const auto total = listener.stats->totalMicros.load();
+        const auto max = listener.stats->maxMicros.load();
+        result.push_back(
+            {.command = listener.command,
+             .dataPrefix = listener.dataPrefix,
+             .calls = calls,
+             .average = std::chrono::microseconds(calls ? total / calls : 0),
+             .max = std::chrono::microseconds(max)});
+    };
+    for (const auto& [prefix, listeners] : snapshot->byPrefix) {
+        std::ranges::for_each(listeners, append);
+    }
+    std::ranges::for_each(snapshot->catchAll, append);
+    return result;
 }
 
 void TgBotApiImpl::OnCallbackQueryImpl::onUnload(
     const std::string_view command) {
-    const std::lock_guard<std::mutex> lock(mutex);
-    for (auto it = listeners.begin(); it != listeners.end();) {
-        if (it->first == command) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto owned = [command](const Listener& listener) {
+        if (listener.command == command) {
             DLOG(INFO) << "Removing callback query handler for " << command;
-            it = listeners.erase(it);
-        } else {
-            ++it;
+            return true;
+        }
+        return false;
+    };
+    auto next = std::make_shared<Routes>();
+    next->catchAll = routes->catchAll;
+    std::erase_if(next->catchAll, owned);
+    for (const auto& [prefix, listeners] : routes->byPrefix) {
+        auto kept = listeners;
+        std::erase_if(kept, owned);
+        if (!kept.empty()) {
+            next->addLengthOf(prefix);
+            next->byPrefix.emplace(prefix, std::move(kept));
         }
     }
+    auto previous = std::exchange(routes, std::move(next));
+    // Snapshots taken from now on only see the new routes. The older ones,
+    // of these or earlier routes, may hold the module's listeners.
+    const auto swapped = nextSnapshot;
+    snapshotReleased.wait(lock, [this, swapped] {
+        return snapshotsInUse.empty() || *snapshotsInUse.begin() >= swapped;
+    });
+    previous.reset();
 }
 
 void TgBotApiImpl::OnCallbackQueryImpl::onReload(
@@ -76,8 +335,20 @@ void TgBotApiImpl::OnCallbackQueryImpl::onReload(
 
 TgBotApiImpl::OnCallbackQueryImpl::OnCallbackQueryImpl(TgBotApiImpl::Ptr api)
     : _api(api), queryAsync("callbackquery", 2) {
+    ackThread = std::thread([this] { ackThreadFunction(); });
     _api->getEvents().onCallbackQuery([this](TgBot::CallbackQuery::Ptr query) {
         onCallbackQueryFunction(std::move(query));
     });
     _api->addCommandListener(this);
 }
+
+TgBotApiImpl::OnCallbackQueryImpl::~OnCallbackQueryImpl() {
+    {
+        const std::lock_guard lock(ackMutex);
+        stopAcks = true;
+    }
+    ackCondition.notify_all();
+    if (ackThread.joinable()) {
+        ackThread.join();
+    }
+}
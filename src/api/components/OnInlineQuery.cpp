@@ -5,10 +5,13 @@
 #include <api/components/ModuleExecutionContext.hpp>
 #include <api/components/ModuleManagement.hpp>
 #include <api/components/OnInlineQuery.hpp>
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 #include <exception>
+#include <functional>
 #include <memory>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -50,43 +53,51 @@ void TgBotApiImpl::OnInlineQueryImpl::onInlineQueryFunction(
 
     // Keep module leases alive until both the Telegram request and destruction
     // of callback-produced result objects have completed. Declare the result
-    // vector after this one so it is destroyed first during stack unwinding.
+    // vector after these so it is destroyed first during stack unwinding.
     std::vector<std::shared_ptr<InlineInvocation>> invocations;
+    // Held for the static results of module-owned entries.
+    std::vector<std::shared_ptr<RefLock::SharedLease>> staticLeases;
     std::vector<TgBot::InlineQueryResult::Ptr> inlineResults;
-    std::vector<InlineQuery> advertisedQueries;
+    std::shared_ptr<const ResultList> advertisedQueries;
     {
         const std::lock_guard lock(mutex);
-        if (queryResults.empty()) {
+        if (entryCount == 0) {
             return;
         }
+        advertisedQueries = canDoPrivileged ? advertisedAll : advertisedPublic;
 
-        invocations.reserve(queryResults.size());
-        advertisedQueries.reserve(queryResults.size());
-        for (const auto& [registration, callback] : queryResults) {
+        const auto serve = [&](const Entry& entry,
+                               const absl::string_view suffix) {
+            const auto& [registration, callback, staticResults] = entry;
             if (!canDoPrivileged && registration.enforced) {
-                continue;
+                return;
             }
 
-            advertisedQueries.push_back(registration);
+            std::shared_ptr<RefLock::SharedLease> moduleLease;
+            if (!registration.command.empty()) {
+                if (!_api->kModuleLoader) {
+                    return;
+                }
+                moduleLease = _api->kModuleLoader->acquireExecutionLease(
+                    registration.command);
+                if (!moduleLease) {
+                    return;
+                }
+            }
 
-            absl::string_view suffix = query->query;
-            if (!absl::ConsumePrefix(&suffix, registration.name)) {
-                continue;
+            if (!staticResults.empty()) {
+                if (moduleLease) {
+                    staticLeases.emplace_back(std::move(moduleLease));
+                }
+                inlineResults.insert(inlineResults.end(),
+                                     staticResults.begin(),
+                                     staticResults.end());
+                return;
             }
 
             auto invocation = std::make_shared<InlineInvocation>();
             invocation->owner = registration.command;
-            if (!invocation->owner.empty()) {
-                if (!_api->kModuleLoader) {
-                    continue;
-                }
-                invocation->moduleLease =
-                    _api->kModuleLoader->acquireExecutionLease(
-                        invocation->owner);
-                if (!invocation->moduleLease) {
-                    continue;
-                }
-            }
+            invocation->moduleLease = std::move(moduleLease);
 
             try {
                 // Acquire the owner lease before copying the std::function:
@@ -111,6 +122,23 @@ void TgBotApiImpl::OnInlineQueryImpl::onInlineQueryFunction(
                               "query callback owned by "
                            << registration.command;
             }
+        };
+
+        // Every registered name that prefixes the query, shortest first.
+        const std::string_view text = query->query;
+        const Node* node = &root;
+        for (size_t length = 0;; ++length) {
+            for (const auto& entry : node->entries) {
+                serve(entry, text.substr(length));
+            }
+            if (length == text.size()) {
+                break;
+            }
+            const auto child = node->children.find(text[length]);
+            if (child == node->children.end()) {
+                break;
+            }
+            node = child->second.get();
         }
     }
 
@@ -133,24 +161,16 @@ void TgBotApiImpl::OnInlineQueryImpl::onInlineQueryFunction(
         }
     }
 
-    if (inlineResults.empty()) {
-        static std::atomic_uint64_t articleCount = 0;
-        for (const auto& registration : advertisedQueries) {
-            auto article = std::make_shared<TgBot::InlineQueryResultArticle>();
-            article->id = fmt::format(
-                "article-{}",
-                articleCount.fetch_add(1, std::memory_order_relaxed));
-            article->title = fmt::format("Query: {}", registration.name);
-            article->description = registration.description;
-            auto content = std::make_shared<TgBot::InputTextMessageContent>();
-            content->messageText = registration.description;
-            article->inputMessageContent = content;
-            inlineResults.emplace_back(std::move(article));
-        }
+    if (inlineResults.empty() && advertisedQueries) {
+        inlineResults = *advertisedQueries;
     }
 
+    // Answers depend on who asks: enforced entries are only shown to
+    // privileged users. So Telegram must not serve one user's cached answer
+    // to another.
     try {
-        _api->getApi().answerInlineQuery(query->id, inlineResults);
+        _api->getApi().answerInlineQuery(query->id, inlineResults, kCacheTime,
+                                         /*isPersonal=*/true);
     } catch (const TgBot::TgException& error) {
         LOG(ERROR) << "Could not answer inline query: " << error.what();
     } catch (const std::exception& error) {
@@ -161,15 +181,93 @@ void TgBotApiImpl::OnInlineQueryImpl::onInlineQueryFunction(
     }
 }
 
+void TgBotApiImpl::OnInlineQueryImpl::rebuildAdvertisedLocked() {
+    static std::atomic_uint64_t articleCount = 0;
+    auto all = std::make_shared<ResultList>();
+    auto pub = std::make_shared<ResultList>();
+    // In name order: a node's own entries, then its children's.
+    std::vector<const Node*> pending{&root};
+    while (!pending.empty()) {
+        const Node* node = pending.back();
+        pending.pop_back();
+        for (const auto& entry : node->entries) {
+            auto article = std::make_shared<TgBot::InlineQueryResultArticle>();
+            article->id = fmt::format(
+                "article-{}",
+                articleCount.fetch_add(1, std::memory_order_relaxed));
+            article->title =
+                fmt::format("Query: {}", entry.registration.name);
+            article->description = entry.registration.description;
+            auto content = std::make_shared<TgBot::InputTextMessageContent>();
+            content->messageText = entry.registration.description;
+            article->inputMessageContent = content;
+            all->emplace_back(article);
+            if (!entry.registration.enforced) {
+                pub->emplace_back(std::move(article));
+            }
+        }
+        for (auto it = node->children.rbegin(); it != node->children.rend();
+             ++it) {
+            pending.emplace_back(it->second.get());
+        }
+    }
+    advertisedAll = std::move(all);
+    advertisedPublic = std::move(pub);
+}
+
+void TgBotApiImpl::OnInlineQueryImpl::addLocked(Entry entry) {
+    Node* node = &root;
+    for (const char c : entry.registration.name) {
+        auto& child = node->children[c];
+        if (!child) {
+            child = std::make_unique<Node>();
+        }
+        node = child.get();
+    }
+    const auto same = std::ranges::find_if(
+        node->entries, [&entry](const Entry& other) {
+            return other.registration.command == entry.registration.command;
+        });
+    if (same != node->entries.end()) {
+        *same = std::move(entry);
+        return;
+    }
+    if (!node->entries.empty()) {
+        LOG(INFO) << "Inline query " << entry.registration.name
+                  << " is now also served by "
+                  << (entry.registration.command.empty()
+                          ? "the bot"
+                          : entry.registration.command);
+    }
+    node->entries.emplace_back(std::move(entry));
+    ++entryCount;
+}
+
+std::size_t TgBotApiImpl::OnInlineQueryImpl::eraseIfLocked(
+    const std::function<bool(const Entry&)>& remove) {
+    std::size_t removed = 0;
+    const std::function<bool(Node&)> prune = [&](Node& node) {
+        removed += std::erase_if(node.entries, remove);
+        std::erase_if(node.children,
+                      [&prune](auto& child) { return prune(*child.second); });
+        return node.entries.empty() && node.children.empty();
+    };
+    prune(root);
+    entryCount -= removed;
+    return removed;
+}
+
 void TgBotApiImpl::OnInlineQueryImpl::onUnload(const std::string_view command) {
     const std::lock_guard lock(mutex);
-    for (auto it = queryResults.begin(); it != queryResults.end();) {
-        if (it->first.command == command) {
+    const auto owned = [command](const Entry& entry) {
+        if (entry.registration.command == command) {
             DLOG(INFO) << "Removing inline query handler for " << command;
-            it = queryResults.erase(it);
-        } else {
-            ++it;
+            return true;
         }
+        return false;
+    };
+    if (eraseIfLocked(owned) != 0) {
+        rebuildAdvertisedLocked();
     }
 }
 
@@ -1,89 +1,170 @@
+#include <absl/log/log.h>
+
 #include <api/components/ReactionsProvider.hpp>
+#include <fstream>
+#include <nlohmann/json.hpp>
 #include <regex>
+#include <sstream>
 
 #include "api/TgBotApi.hpp"
 #include "api/TgBotApiImpl.hpp"
 #include "tgbot/types/ReactionTypeEmoji.h"
 
-TgBotApiImpl::ReactionsProvider::ReactionsProvider(TgBotApi* apiImpl)
-    : _apiImpl(apiImpl) {
-    anyMessageSubscription_ = _apiImpl->subscribeAnyMessage(
-        [this](TgBotApi::CPtr /*api*/, const Message::Ptr& message) {
-            return this->onAnyMessageFunction(message);
-        });
-}
+using Rules = TgBotApiImpl::ReactionsProvider::Rules;
+using Rule = TgBotApiImpl::ReactionsProvider::Rule;
 
-TgBotApiImpl::ReactionsProvider::~ReactionsProvider() {
-    anyMessageSubscription_.reset();
-}
+namespace {
+
+// The rules from before they were configurable, in the same order.
+constexpr std::string_view kDefaultRules = R"([
+  { "type": "filename", "match": "last_kmsg", "emoji": "😱" },
+  { "type": "text", "pattern": "^[a-z]lex$", "emoji": "🥰" },
+  { "type": "user", "id": 5037893234, "emoji": "👑" },
+  { "type": "text", "pattern": "^[a-z]ey$", "emoji": "🍌" }
+])";
 
-static void addReaction(std::vector<TgBot::ReactionType::Ptr>& reactions,
-                        const std::string& emoji) {
-    auto e = std::make_shared<TgBot::ReactionTypeEmoji>();
-    e->emoji = emoji;
-    reactions.emplace_back(e);
+// Text patterns joined as (?:a)|(?:b)|... for the prefilter.
+// Backreferences are renumbered by joining, so skip the prefilter then.
+std::optional<std::regex> buildPrefilter(
+    const std::vector<std::string>& patterns) {
+    static const std::regex kBackReference(R"(\\[1-9])");
+    if (patterns.empty()) {
+        return std::nullopt;
+    }
+    std::string combined;
+    for (const auto& pattern : patterns) {
+        if (std::regex_search(pattern, kBackReference)) {
+            return std::nullopt;
+        }
+        if (!combined.empty()) {
+            combined += '|';
+        }
+        combined += "(?:" + pattern + ")";
+    }
+    try {
+        return std::regex(combined, std::regex::ECMAScript |
+                                        std::regex::optimize |
+                                        std::regex::nosubs);
+    } catch (const std::regex_error& e) {
+        LOG(WARNING) << "Cannot combine reaction patterns: " << e.what();
+        return std::nullopt;
+    }
 }
 
-template <typename T>
-void apply(std::vector<TgBot::ReactionType::Ptr>& reactions,
-           const Message::Ptr& message, const T& filter) = delete;
+}  // namespace
 
-// Filter by file name
-struct FilterFilename {
-    std::string emoji;
-    std::string match;
-};
+std::optional<Rules> Rules::parse(std::istream& input) {
+    Rules rules;
+    std::vector<std::string> patterns;
+    try {
+        const auto root = nlohmann::json::parse(input);
+        for (const auto& entry : root) {
+            const auto type = entry.at("type").get<std::string>();
+            Rule rule{.emoji = entry.at("emoji").get<std::string>()};
+            if (type == "text") {
+                auto pattern = entry.at("pattern").get<std::string>();
+                rule.type = Rule::Type::Text;
+                rule.pattern = std::regex(
+                    pattern, std::regex::ECMAScript | std::regex::optimize);
+                patterns.emplace_back(std::move(pattern));
+            } else if (type == "filename") {
+                rule.type = Rule::Type::Filename;
+                rule.filename = entry.at("match").get<std::string>();
+            } else if (type == "user") {
+                rule.type = Rule::Type::User;
+                rule.userId = entry.at("id").get<UserId>();
+            } else {
+                LOG(WARNING) << "Unknown reaction rule type: " << type;
+                continue;
+            }
+            rules.rules.emplace_back(std::move(rule));
+        }
+    } catch (const nlohmann::json::exception& e) {
+        LOG(ERROR) << "Failed to parse reaction rules: " << e.what();
+        return std::nullopt;
+    } catch (const std::regex_error& e) {
+        LOG(ERROR) << "Invalid reaction pattern: " << e.what();
+        return std::nullopt;
+    }
+    rules.textPrefilter = buildPrefilter(patterns);
+    return rules;
+}
 
-template <>
-void apply<FilterFilename>(std::vector<TgBot::ReactionType::Ptr>& reactions,
-                           const Message::Ptr& message,
-                           const FilterFilename& filter) {
-    if (message->document && (*message->document)->fileName == filter.match) {
-        addReaction(reactions, filter.emoji);
+std::optional<Rules> Rules::load(const std::filesystem::path& file) {
+    std::ifstream input(file);
+    if (!input) {
+        return std::nullopt;
     }
+    return parse(input);
 }
 
-// Filter by user
-struct FilterUser {
-    std::string emoji;
-    UserId userId;
-};
+Rules Rules::defaults() {
+    std::istringstream input{std::string(kDefaultRules)};
+    return *parse(input);
+}
 
-template <>
-void apply<FilterUser>(std::vector<TgBot::ReactionType::Ptr>& reactions,
-                       const Message::Ptr& message, const FilterUser& filter) {
-    if (message->from && (*message->from)->id == filter.userId) {
-        addReaction(reactions, filter.emoji);
+std::vector<std::string> Rules::match(const Message& message) const {
+    std::vector<std::string> emojis;
+    // Whether the prefilter let the text through, checked on the first
+    // text rule.
+    std::optional<bool> textMayMatch;
+    for (const auto& rule : rules) {
+        bool matched = false;
+        switch (rule.type) {
+            case Rule::Type::Text:
+                if (!message.text) {
+                    break;
+                }
+                if (!textMayMatch) {
+                    textMayMatch = !textPrefilter ||
+                                   std::regex_search(*message.text,
+                                                     *textPrefilter);
+                }
+                matched = *textMayMatch &&
+                          std::regex_search(*message.text, rule.pattern);
+                break;
+            case Rule::Type::Filename:
+                matched = message.document &&
+                          (*message.document)->fileName == rule.filename;
+                break;
+            case Rule::Type::User:
+                matched = message.from && (*message.from)->id == rule.userId;
+                break;
+        }
+        if (matched) {
+            emojis.emplace_back(rule.emoji);
+        }
     }
+    return emojis;
 }
 
-// Filter by message text
-struct FilterText {
-    std::string emoji;
-    std::regex match;
-};
-
-template <>
-void apply<FilterText>(std::vector<TgBot::ReactionType::Ptr>& reactions,
-                       const Message::Ptr& message, const FilterText& filter) {
-    if (message->text && std::regex_search(*message->text, filter.match)) {
-        addReaction(reactions, filter.emoji);
+TgBotApiImpl::ReactionsProvider::ReactionsProvider(
+    TgBotApi* apiImpl, const std::filesystem::path& rulesFile)
+    : _apiImpl(apiImpl) {
+    if (auto rules = Rules::load(rulesFile); rules) {
+        _rules = std::move(*rules);
+        LOG(INFO) << "Loaded reaction rules from " << rulesFile;
+    } else {
+        _rules = Rules::defaults();
     }
+    anyMessageSubscription_ = _apiImpl->subscribeAnyMessage(
+        [this](TgBotApi::CPtr /*api*/, const Message::Ptr& message) {
+            return this->onAnyMessageFunction(message);
+        });
+}
+
+TgBotApiImpl::ReactionsProvider::~ReactionsProvider() {
+    anyMessageSubscription_.reset();
 }
 
 TgBotApi::AnyMessageResult
 TgBotApiImpl::ReactionsProvider::onAnyMessageFunction(Message::Ptr message) {
     std::vector<TgBot::ReactionType::Ptr> reactions;
-    apply<FilterFilename>(reactions, message,
-                          FilterFilename{.emoji = "😱", .match = "last_kmsg"});
-    apply<FilterText>(
-        reactions, message,
-        FilterText{.emoji = "🥰", .match = std::regex("^[a-z]lex$")});
-    apply<FilterUser>(reactions, message,
-                      FilterUser{.emoji = "👑", .userId = 5037893234});
-    apply<FilterText>(
-        reactions, message,
-        FilterText{.emoji = "🍌", .match = std::regex("^[a-z]ey$")});
+    for (const auto& emoji : _rules.match(*message)) {
+        auto reaction = std::make_shared<TgBot::ReactionTypeEmoji>();
+        reaction->emoji = emoji;
+        reactions.emplace_back(std::move(reaction));
+    }
     if (!reactions.empty()) {
         _apiImpl->setMessageReaction(message, reactions, false);
     }
@@ -0,0 +1,245 @@
+#include "Blake3.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace tgbot::socket::transfer {
+
+namespace {
+
+constexpr std::uint32_t kChunkStart = 1 << 0;
+constexpr std::uint32_t kChunkEnd = 1 << 1;
+constexpr std::uint32_t kParent = 1 << 2;
+constexpr std::uint32_t kRoot = 1 << 3;
+
+constexpr Blake3::ChainingValue kIv = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+constexpr std::array<std::size_t, 16> kPermutation = {
+    2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8,
+};
+
+using Words = std::array<std::uint32_t, 16>;
+
+void g(Words& state, const std::size_t a, const std::size_t b,
+       const std::size_t c, const std::size_t d, const std::uint32_t mx,
+       const std::uint32_t my) {
+    state[a] = state[a] + state[b] + mx;
+    state[d] = std::rotr(state[d] ^ state[a], 16);
+    state[c] = state[c] + state[d];
+    state[b] = std::rotr(state[b] ^ state[c], 12);
+    state[a] = state[a] + state[b] + my;
+    state[d] = std::rotr(state[d] ^ state[a], 8);
+    state[c] = state[c] + state[d];
+    state[b] = std::rotr(state[b] ^ state[c], 7);
+}
+
+Words compress(const Blake3::ChainingValue& cv, const Words& block,
+               const std::uint64_t counter, const std::uint32_t blockLen,
+               const std::uint32_t flags) {
+    Words state = {cv[0],  cv[1],  cv[2],  cv[3],  cv[4],  cv[5],
+                   cv[6],  cv[7],  kIv[0], kIv[1], kIv[2], kIv[3],
+                   static_cast<std::uint32_t>(counter),
+                   static_cast<std::uint32_t>(counter >> 32),
+                   blockLen, flags};
+    Words m = block;
+    for (int round = 0; round < 7; ++round) {
+        g(state, 0, 4, 8, 12, m[0], m[1]);
+        g(state, 1, 5, 9, 13, m[2], m[3]);
+        g(state, 2, 6, 10, 14, m[4], m[5]);
+        g(state, 3, 7, 11, 15, m[6], m[7]);
+        g(state, 0, 5, 10, 15, m[8], m[9]);
+        g(state, 1, 6, 11, 12, m[10], m[11]);
+        g(state, 2, 7, 8, 13, m[12], m[13]);
+        g(state, 3, 4, 9, 14, m[14], m[15]);
+        Words permuted{};
+        for (std::size_t i = 0; i < permuted.size(); ++i) {
+            permuted[i] = m[kPermutation[i]];
+        }
+        m = permuted;
+    }
+    for (std::size_t i = 0; i < 8; ++i) {
+        state[i] ^= state[i + 8];
+        state[i + 8] ^= cv[i];
+    }
+    return state;
+}
+
+Words loadWords(const std::uint8_t* bytes) {
+    Words words{};
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        words[i] = static_cast<std::uint32_t>(bytes[4 * i]) |
+                   static_cast<std::uint32_t>(bytes[4 * i + 1]) << 8 |
+                   static_cast<std::uint32_t>(bytes[4 * i + 2]) << 16 |
+                   static_cast<std::uint32_t>(bytes[4 * i + 3]) << 24;
+    }
+    return words;
+}
+
+Blake3::ChainingValue firstHalf(const Words& words) {
+    Blake3::ChainingValue half{};
+    std::copy_n(words.begin(), half.size(), half.begin());
+    return half;
+}
+
+}  // namespace
+
+Blake3::ChainingValue Blake3::Output::chainingValue() const {
+    return firstHalf(compress(inputCv, block, counter, blockLen, flags));
+}
+
+Blake3::Digest Blake3::Output::rootDigest() const {
+    // One compression yields 64 bytes, so the counter stays 0.
+    const auto words = compress(inputCv, block, 0, blockLen, flags | kRoot);
+    Digest digest{};
+    for (std::size_t i = 0; i < kDigestSize; ++i) {
+        digest[i] = static_cast<std::uint8_t>(words[i / 4] >> (8 * (i % 4)));
+    }
+    return digest;
+}
+
+Blake3::Blake3(const std::uint64_t firstChunk)
+    : cv_(kIv), chunkCounter_(firstChunk) {}
+
+void Blake3::compressBlock() {
+    const std::uint32_t flags = blocksCompressed_ == 0 ? kChunkStart : 0;
+    cv_ = firstHalf(compress(cv_, loadWords(block_.data()), chunkCounter_,
+                             static_cast<std::uint32_t>(block_.size()),
+                             flags));
+    ++blocksCompressed_;
+    block_.fill(0);
+    blockLen_ = 0;
+}
+
+void Blake3::finishChunk() {
+    auto cv = finalOutput().chainingValue();
+    ++chunksDone_;
+    // Merge every subtree this chunk completes.
+    for (auto total = chunksDone_; (total & 1) == 0; total >>= 1) {
+        cv = parent(stack_.back(), cv);
+        stack_.pop_back();
+    }
+    stack_.emplace_back(cv);
+    cv_ = kIv;
+    ++chunkCounter_;
+    block_.fill(0);
+    blockLen_ = 0;
+    blocksCompressed_ = 0;
+}
+
+void Blake3::update(const void* data, std::size_t size) {
+    const auto* input = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        // Keep the last block of a chunk until more input shows whether the
+        // chunk, and so the block, is the last one.
+        if (blockLen_ == block_.size()) {
+            if (blocksCompressed_ + 1 == kChunkLen / block_.size()) {
+                finishChunk();
+            } else {
+                compressBlock();
+            }
+        }
+        const auto take = std::min(size, block_.size() - blockLen_);
+        std::memcpy(block_.data() + blockLen_, input, take);
+        blockLen_ += take;
+        input += take;
+        size -= take;
+    }
+}
+
+Blake3::Output Blake3::finalOutput() const {
+    std::uint32_t flags = kChunkEnd;
+    if (blocksCompressed_ == 0) {
+        flags |= kChunkStart;
+    }
+    return {cv_, loadWords(block_.data()), chunkCounter_,
+            static_cast<std::uint32_t>(blockLen_), flags};
+}
+
+Blake3::Output Blake3::parentOutput(const ChainingValue& left,
+                                    const ChainingValue& right) {
+    Words block{};
+    std::copy(left.begin(), left.end(), block.begin());
+    std::copy(right.begin(), right.end(), block.begin() + left.size());
+    return {kIv, block, 0, 64, kParent};
+}
+
+Blake3::ChainingValue Blake3::parent(const ChainingValue& left,
+                                     const ChainingValue& right) {
+    return parentOutput(left, right).chainingValue();
+}
+
+Blake3::Digest Blake3::root(const ChainingValue& left,
+                            const ChainingValue& right) {
+    return parentOutput(left, right).rootDigest();
+}
+
+Blake3::Digest Blake3::digest() const {
+    if (stack_.empty()) {
+        return finalOutput().rootDigest();
+    }
+    auto cv = finalOutput().chainingValue();
+    for (auto it = stack_.rbegin(); std::next(it) != stack_.rend(); ++it) {
+        cv = parent(*it, cv);
+    }
+    return root(stack_.front(), cv);
+}
+
+Blake3::ChainingValue Blake3::subtree() const {
+    auto cv = finalOutput().chainingValue();
+    for (auto it = stack_.rbegin(); it != stack_.rend(); ++it) {
+        cv = parent(*it, cv);
+    }
+    return cv;
+}
+
+Blake3Tree::Blake3Tree(const std::uint64_t totalSize,
+                       const std::size_t blockSize)
+    : blockSize_(blockSize),
+      blocks_(std::max<std::uint64_t>((totalSize + blockSize - 1) / blockSize,
+                                      1)),
+      present_(blocks_.size()) {}
+
+Blake3Tree::BlockHash Blake3Tree::hashBlock(const std::uint64_t index,
+                                            const void* data,
+                                            const std::size_t size) const {
+    Blake3 hasher(index * (blockSize_ / Blake3::kChunkLen));
+    hasher.update(data, size);
+    if (blocks_.size() == 1) {
+        return {index, hasher.digest()};
+    }
+    return {index, hasher.subtree()};
+}
+
+void Blake3Tree::setBlock(const BlockHash& hash) {
+    if (const auto* digest = std::get_if<Blake3::Digest>(&hash.value)) {
+        single_ = *digest;
+    } else {
+        blocks_[hash.index] = std::get<Blake3::ChainingValue>(hash.value);
+    }
+    present_[hash.index] = true;
+}
+
+Blake3::ChainingValue Blake3Tree::merge(const std::uint64_t begin,
+                                        const std::uint64_t end) const {
+    if (end - begin == 1) {
+        return blocks_[begin];
+    }
+    // The left subtree holds the largest power of two of blocks that leaves
+    // at least one for the right.
+    const auto split = begin + std::bit_floor(end - begin - 1);
+    return Blake3::parent(merge(begin, split), merge(split, end));
+}
+
+Blake3::Digest Blake3Tree::digest() const {
+    if (blocks_.size() == 1) {
+        return single_;
+    }
+    const auto split = std::bit_floor(blocks_.size() - 1);
+    return Blake3::root(merge(0, split), merge(split, blocks_.size()));
+}
+
+}  // namespace tgbot::socket::transfer
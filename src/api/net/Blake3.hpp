@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+namespace tgbot::socket::transfer {
+
+/**
+ * BLAKE3 hashing (https://github.com/BLAKE3-team/BLAKE3-specs), portable and
+ * unkeyed, with a 32 byte output.
+ *
+ * Besides plain incremental hashing, this exposes the chaining values of
+ * subtrees, which lets aligned parts of a file be hashed independently and
+ * in any order, see Blake3Tree.
+ */
+class Blake3 {
+   public:
+    static constexpr std::size_t kDigestSize = 32;
+    // Input is split into chunks of this size, the leaves of the tree.
+    static constexpr std::size_t kChunkLen = 1024;
+
+    using Digest = std::array<std::uint8_t, kDigestSize>;
+    using ChainingValue = std::array<std::uint32_t, 8>;
+
+    // `firstChunk` is the index in the whole input of the first chunk this
+    // hasher sees, for hashing a subtree.
+    explicit Blake3(std::uint64_t firstChunk = 0);
+
+    void update(const void* data, std::size_t size);
+
+    // Hash of everything passed to update().
+    [[nodiscard]] Digest digest() const;
+
+    // The chaining value of the input as a subtree of a larger input. Only
+    // meaningful if it is a subtree there: it starts at a multiple of a power
+    // of two number of chunks, and is no longer than that power of two.
+    [[nodiscard]] ChainingValue subtree() const;
+
+    // The chaining value of the parent of two subtrees.
+    [[nodiscard]] static ChainingValue parent(const ChainingValue& left,
+                                              const ChainingValue& right);
+    // The hash of an input made of two subtrees.
+    [[nodiscard]] static Digest root(const ChainingValue& left,
+                                     const ChainingValue& right);
+
+   private:
+    struct Output {
+        ChainingValue inputCv;
+        std::array<std::uint32_t, 16> block;
+        std::uint64_t counter;
+        std::uint32_t blockLen;
+        std::uint32_t flags;
+
+        [[nodiscard]] ChainingValue chainingValue() const;
+        [[nodiscard]] Digest rootDigest() const;
+    };
+
+    static Output parentOutput(const ChainingValue& left,
+                               const ChainingValue& right);
+    // The output of the last chunk, with the subtrees before it merged in.
+    [[nodiscard]] Output finalOutput() const;
+    void compressBlock();
+    void finishChunk();
+
+    // State of the chunk being filled.
+    ChainingValue cv_;
+    std::uint64_t chunkCounter_;
+    std::array<std::uint8_t, 64> block_{};
+    std::size_t blockLen_ = 0;
+    std::size_t blocksCompressed_ = 0;
+
+    // Chunks completed before the current one.
+    std::uint64_t chunksDone_ = 0;
+    // Chaining values of completed subtrees, largest first.
+    std::vector<ChainingValue> stack_;
+};
+
+/**
+ * BLAKE3 of a file of known size, fed in blocks that may arrive in any
+ * order. Each block is hashed on its own into a subtree chaining value as it
+ * arrives, and those are merged in digest().
+ */
+class Blake3Tree {
+   public:
+    // `blockSize` must be a power of two multiple of Blake3::kChunkLen.
+    Blake3Tree(std::uint64_t totalSize, std::size_t blockSize);
+
+    [[nodiscard]] std::uint64_t blockCount() const { return blocks_.size(); }
+    [[nodiscard]] bool hasBlock(std::uint64_t index) const {
+        return present_[index];
+    }
+
+    // The hash of one block, computed without changing the tree, so blocks
+    // can be hashed in parallel and stored with setBlock().
+    struct BlockHash {
+        std::uint64_t index;
+        // The root digest if the file is this one block.
+        std::variant<Blake3::ChainingValue, Blake3::Digest> value;
+    };
+
+    // Hash block `index`, which must be whole: blockSize bytes, or what is
+    // left of the file for the last one.
+    [[nodiscard]] BlockHash hashBlock(std::uint64_t index, const void* data,
+                                      std::size_t size) const;
+    void setBlock(const BlockHash& hash);
+    void addBlock(std::uint64_t index, const void* data, std::size_t size) {
+        setBlock(hashBlock(index, data, size));
+    }
+    // Forgets block `index`, e.g. once its bytes changed. It must be added
+    // again before digest().
+    void removeBlock(std::uint64_t index) { present_[index] = false; }
+
+    // Only valid once every block was added.
+    [[nodiscard]] Blake3::Digest digest() const;
+
+   private:
+    [[nodiscard]] Blake3::ChainingValue merge(std::uint64_t begin,
+                                              std::uint64_t end) const;
+
+    std::size_t blockSize_;
+    std::vector<Blake3::ChainingValue> blocks_;
+    std::vector<bool> present_;
+    // A single block is the root itself, so its digest is kept instead.
+    Blake3::Digest single_{};
+};
+
+}  // namespace tgbot::socket::transfer
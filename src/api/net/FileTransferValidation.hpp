@@ -1,10 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
 #include <map>
+#include <utility>
+#include <vector>
 
 // Pure boundary/size helpers for the file-transfer RPCs. Extracted from
 // SocketServiceImpl so the bounds and overflow checks can be unit-tested
@@ -43,6 +46,44 @@ class UploadCoverage {
         return coveredBytes_ == totalSize_;
     }
     [[nodiscard]] std::uintmax_t coveredBytes() const { return coveredBytes_; }
+    // Whether all of [begin, end) was received.
+    [[nodiscard]] bool covers(std::uintmax_t begin, std::uintmax_t end) const {
+        if (begin >= end) return true;
+        auto it = ranges_.upper_bound(begin);
+        if (it == ranges_.begin()) return false;
+        return std::prev(it)->second >= end;
+    }
+    // Whether any of [begin, end) was received.
+    [[nodiscard]] bool overlaps(std::uintmax_t begin,
+                                std::uintmax_t end) const {
+        if (begin >= end) return false;
+        auto it = ranges_.lower_bound(end);
+        if (it == ranges_.begin()) return false;
+        return std::prev(it)->second > begin;
+    }
+    [[nodiscard]] std::uintmax_t totalSize() const { return totalSize_; }
+    // Covered [begin, end) ranges, disjoint and in order.
+    [[nodiscard]] const std::map<std::uintmax_t, std::uintmax_t>& ranges()
+        const {
+        return ranges_;
+    }
+
+    // The [begin, end) ranges of the file not covered yet, in order.
+    [[nodiscard]] std::vector<std::pair<std::uintmax_t, std::uintmax_t>>
+    missing() const {
+        std::vector<std::pair<std::uintmax_t, std::uintmax_t>> gaps;
+        std::uintmax_t next = 0;
+        for (const auto& [begin, end] : ranges_) {
+            if (begin > next) {
+                gaps.emplace_back(next, begin);
+            }
+            next = end;
+        }
+        if (next < totalSize_) {
+            gaps.emplace_back(next, totalSize_);
+        }
+        return gaps;
+    }
 
    private:
     std::uintmax_t totalSize_{};
@@ -85,4 +126,57 @@ inline std::uintmax_t chunkOffset(std::int64_t chunkIdx) {
     return static_cast<std::uintmax_t>(chunkIdx) * kChunkSize;
 }
 
+// A download stream resumes on a chunk boundary within the file, or at its
+// end, so the chunk indices it reports stay offset / kChunkSize.
+inline bool streamStartValid(std::uintmax_t offset, std::uintmax_t totalSize) {
+    return offset == totalSize ||
+           (offset < totalSize && offset % kChunkSize == 0);
+}
+
+// Largest chunk a download stream sends. Leaves room for the framing under
+// gRPC's default 4 MB receive limit.
+inline constexpr std::uintmax_t kMaxStreamChunkSize = 2 * 1024 * 1024;  // 2 MB
+// Chunks a download stream may send before the client grants more, when the
+// opening request does not say.
+inline constexpr std::uint32_t kDefaultStreamWindow = 8;
+
+// The chunk size a download stream may grow to: the client's request rounded
+// down to a multiple of kChunkSize and clamped to
+// [kChunkSize, kMaxStreamChunkSize]. 0 asks for the largest.
+inline std::uintmax_t streamChunkLimit(std::uintmax_t requested) {
+    if (requested == 0) {
+        return kMaxStreamChunkSize;
+    }
+    return std::clamp(requested / kChunkSize * kChunkSize, kChunkSize,
+                      kMaxStreamChunkSize);
+}
+
+// Chunk size of a download stream. Starts at kChunkSize, doubles up to the
+// limit while writes complete quickly and halves when one stalls on the
+// client. Sizes stay multiples of kChunkSize, so a stream that breaks off
+// can be resumed on chunk indices.
+class AdaptiveChunkSize {
+   public:
+    static constexpr std::chrono::milliseconds kFastWrite{10};
+    static constexpr std::chrono::milliseconds kSlowWrite{100};
+
+    explicit AdaptiveChunkSize(std::uintmax_t limit) : limit_(limit) {}
+
+    [[nodiscard]] std::uintmax_t size() const { return size_; }
+
+    void record(std::chrono::steady_clock::duration writeTime) {
+        if (writeTime < kFastWrite) {
+            size_ = std::min(size_ * 2, limit_);
+        } else if (writeTime > kSlowWrite) {
+            // Rounded down, as a limit like 3 * kChunkSize halves to a
+            // size between two chunk boundaries.
+            size_ = std::max(size_ / 2 / kChunkSize * kChunkSize, kChunkSize);
+        }
+    }
+
+   private:
+    std::uintmax_t limit_;
+    std::uintmax_t size_ = kChunkSize;
+};
+
 }  // namespace tgbot::socket::transfer
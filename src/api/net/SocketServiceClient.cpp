@@ -1,10 +1,15 @@
 #include <grpcpp/grpcpp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "Socket_service.grpc.pb.h"  // Generated header
@@ -18,6 +23,8 @@ using namespace tgbot::proto::socket;
 // Configuration
 const std::string SERVER_ADDRESS = "127.0.0.1:50000";  // Or "localhost:50051"
 const size_t CHUNK_SIZE = 1024 * 64;                   // 64KB
+// Chunks a download stream may have in flight.
+const uint32_t STREAM_WINDOW = 8;
 
 class BotClient {
    public:
@@ -51,6 +58,43 @@ class BotClient {
         PrintResponse(status, response);
     }
 
+    // ======================================================
+    // Command: send_messages <chat_id,chat_id,...> <text> [file_path]
+    // ======================================================
+    void SendMessages(const std::vector<int64_t>& chat_ids,
+                      const std::string& text,
+                      const std::string& file_path = "") {
+        ClientContext context;
+        SendMessagesRequest request;
+
+        auto* message = request.mutable_message();
+        if (!text.empty()) message->set_text(text);
+        if (!file_path.empty()) {
+            if (!std::filesystem::exists(file_path)) {
+                std::cerr << "Error: File not found: " << file_path
+                          << std::endl;
+                return;
+            }
+            message->set_file_path(file_path);
+            message->set_file_type(FileType::DOCUMENT);
+        }
+        for (const auto chat_id : chat_ids) {
+            request.add_targets()->set_chat_id(chat_id);
+        }
+
+        auto reader = stub_->sendMessages(&context, request);
+        SendResult result;
+        while (reader->Read(&result)) {
+            std::cout << result.chat_id() << ": ";
+            PrintResponse(Status::OK, result.response());
+        }
+        Status status = reader->Finish();
+        if (!status.ok()) {
+            std::cerr << "RPC Error " << status.error_code() << ": "
+                      << status.error_message() << std::endl;
+        }
+    }
+
     // ======================================================
     // Command: spam_config <mode_int>
     // 0=Disabled, 1=Log, 2=Purge, 3=Purge+Mute
@@ -93,16 +137,18 @@ class BotClient {
     }
 
     // ======================================================
-    // Command: upload <local_path> <remote_path>
+    // Command: upload <local_path> <remote_path> [streams] [resume_uuid]
     // ======================================================
     void UploadFile(const std::string& local_path,
-                    const std::string& remote_path) {
+                    const std::string& remote_path, unsigned streams = 1,
+                    const std::string& resume_uuid = "") {
         if (!std::filesystem::exists(local_path)) {
             std::cerr << "Local file not found." << std::endl;
             return;
         }
+        const auto file_size = std::filesystem::file_size(local_path);
 
-        // STEP 1: Handshake
+        // STEP 1: Handshake, or resume an earlier session
         ClientContext ctx1;
         FileTransferRequest req;
         FileTransferResponse resp;
@@ -110,59 +156,103 @@ class BotClient {
         req.set_file_path(remote_path);  // Where to save on server
         req.set_is_upload(true);
         req.set_overwrite_existing(true);
-        req.set_file_size(std::filesystem::file_size(local_path));
+        req.set_file_size(file_size);
+        if (!resume_uuid.empty()) {
+            req.set_uuid(resume_uuid);
+        }
 
         Status status = stub_->requestFileTransfer(&ctx1, req, &resp);
         if (!status.ok() || !resp.accepted()) {
             std::cerr << "Upload handshake failed: " << status.error_message()
-                      << std::endl;
+                      << resp.reject_message() << std::endl;
             return;
         }
         std::string uuid = resp.uuid();
         std::cout << "Handshake OK. UUID: " << uuid << std::endl;
 
-        // STEP 2: Streaming Loop
-        ClientContext ctx2;
-        std::shared_ptr<ClientReaderWriter<FileChunk, FileChunkResponse>>
-            stream(stub_->uploadFileLoop(&ctx2));
-
-        std::ifstream infile(local_path, std::ios::binary);
-        std::vector<char> buffer(CHUNK_SIZE);
-        int chunk_idx = 0;
-        size_t offset = 0;
-
-        while (infile.read(buffer.data(), buffer.size()) ||
-               infile.gcount() > 0) {
-            FileChunk chunk;
-            chunk.set_uuid(uuid);
-            chunk.set_chunk_idx(chunk_idx++);
-            chunk.set_chunk_data(buffer.data(), infile.gcount());
-            chunk.set_chunk_offset(static_cast<int64_t>(offset));
-
-            if (!stream->Write(chunk)) {
-                std::cerr << "Stream broken!" << std::endl;
-                break;
+        // STEP 2: Ask what the server is missing, all of it for a new upload
+        std::vector<std::pair<uint64_t, uint64_t>> chunks;  // offset, length
+        {
+            ClientContext ctx;
+            FileTransferRequest status_req;
+            UploadStatus upload_status;
+            status_req.set_uuid(uuid);
+            status = stub_->getUploadStatus(&ctx, status_req, &upload_status);
+            std::vector<std::pair<uint64_t, uint64_t>> missing;
+            if (status.ok() && upload_status.found()) {
+                for (const auto& range : upload_status.missing()) {
+                    missing.emplace_back(range.offset(), range.length());
+                }
+                std::cout << "Server has " << upload_status.received_bytes()
+                          << " of " << file_size << " bytes" << std::endl;
+            } else {
+                missing.emplace_back(0, file_size);
             }
-            offset += infile.gcount();
-
-            // Optional: Read ACK (if your server sends one per chunk)
-            FileChunkResponse ack;
-            stream->Read(&ack);
-            if (!ack.success()) {
-                std::cerr << "Chunk upload failed, retrying..." << std::endl;
-                // In production, implement retry logic here
+            for (const auto& [begin, length] : missing) {
+                for (uint64_t off = 0; off < length; off += CHUNK_SIZE) {
+                    chunks.emplace_back(
+                        begin + off,
+                        std::min<uint64_t>(CHUNK_SIZE, length - off));
+                }
             }
         }
 
-        stream->WritesDone();
-        Status stream_status = stream->Finish();
-        if (!stream_status.ok()) {
-            std::cerr << "Stream failed: " << stream_status.error_message()
+        // STEP 3: Send the chunks over `streams` streams in parallel
+        streams = std::max(1U, streams);
+        std::atomic_bool failed = false;
+        std::vector<std::thread> workers;
+        for (unsigned s = 0; s < streams; ++s) {
+            workers.emplace_back([&, s] {
+                ClientContext ctx;
+                std::shared_ptr<
+                    ClientReaderWriter<FileChunk, FileChunkResponse>>
+                    stream(stub_->uploadFileLoop(&ctx));
+                std::ifstream infile(local_path, std::ios::binary);
+                std::vector<char> buffer(CHUNK_SIZE);
+                for (size_t i = s; i < chunks.size() && !failed;
+                     i += streams) {
+                    const auto [offset, length] = chunks[i];
+                    infile.seekg(static_cast<std::streamoff>(offset));
+                    if (!infile.read(buffer.data(),
+                                     static_cast<std::streamsize>(length))) {
+                        std::cerr << "Read of local file failed" << std::endl;
+                        failed = true;
+                        break;
+                    }
+                    FileChunk chunk;
+                    chunk.set_uuid(uuid);
+                    chunk.set_chunk_idx(static_cast<int32_t>(i));
+                    chunk.set_chunk_data(buffer.data(), length);
+                    chunk.set_chunk_offset(static_cast<int64_t>(offset));
+
+                    FileChunkResponse ack;
+                    if (!stream->Write(chunk) || !stream->Read(&ack) ||
+                        !ack.success()) {
+                        std::cerr << "Chunk upload failed at offset "
+                                  << offset << std::endl;
+                        failed = true;
+                        break;
+                    }
+                }
+                stream->WritesDone();
+                Status stream_status = stream->Finish();
+                if (!stream_status.ok()) {
+                    std::cerr << "Stream failed: "
+                              << stream_status.error_message() << std::endl;
+                    failed = true;
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (failed) {
+            std::cerr << "Upload interrupted, resume with UUID " << uuid
                       << std::endl;
             return;
         }
 
-        // STEP 3: Finalize
+        // STEP 4: Finalize
         ClientContext ctx3;
         FileTransferRequest end_req;
         GenericResponse end_resp;
@@ -174,6 +264,22 @@ class BotClient {
         PrintResponse(Status::OK, end_resp);
     }
 
+    // ======================================================
+    // Command: abort_upload <uuid> <remote_path>
+    // ======================================================
+    void AbortUpload(const std::string& uuid, const std::string& remote_path) {
+        ClientContext context;
+        FileTransferRequest request;
+        GenericResponse response;
+        request.set_uuid(uuid);
+        request.set_file_path(remote_path);
+        request.set_is_upload(true);
+        request.set_abort_upload(true);
+
+        Status status = stub_->endFileTransfer(&context, request, &response);
+        PrintResponse(status, response);
+    }
+
     // ======================================================
     // Command: download <remote_path> <local_path>
     // ======================================================
@@ -199,42 +305,86 @@ class BotClient {
         std::cout << "Downloading " << file_size << " bytes (" << total_chunks
                   << " chunks)..." << std::endl;
 
-        // STEP 2: Streaming Loop
-        ClientContext ctx2;
-        std::shared_ptr<ClientReaderWriter<FileChunkRequest, FileChunkResponse>>
-            stream(stub_->downloadFileLoop(&ctx2));
-
         std::ofstream outfile(local_path, std::ios::binary);
 
-        // Pipelining strategy: Request all chunks (simplified)
-        // In production, maintain a 'window' of active requests.
-        for (int i = 0; i < total_chunks; ++i) {
-            FileChunkRequest chunk_req;
-            chunk_req.set_uuid(uuid);
-            chunk_req.set_chunk_idx(i);
+        // STEP 2: Stream the file in order, granting credit as chunks are
+        // written out.
+        int64_t received = 0;
+        {
+            ClientContext ctx2;
+            std::shared_ptr<
+                ClientReaderWriter<FileStreamRequest, FileChunkResponse>>
+                stream(stub_->streamFileDownload(&ctx2));
 
-            if (!stream->Write(chunk_req)) break;
+            FileStreamRequest open_req;
+            open_req.set_uuid(uuid);
+            open_req.set_window(STREAM_WINDOW);
+            stream->Write(open_req);
 
             FileChunkResponse chunk_resp;
-            if (stream->Read(&chunk_resp) && chunk_resp.success()) {
-                outfile.write(chunk_resp.chunk().chunk_data().data(),
-                              chunk_resp.chunk().chunk_data().size());
-
-                if (i % 10 == 0)
-                    std::cout << "\rChunk " << i << "/" << total_chunks
-                              << std::flush;
-            } else {
-                std::cerr << "Failed to read chunk " << i << std::endl;
-                break;
+            uint32_t consumed = 0;
+            while (received < file_size && stream->Read(&chunk_resp)) {
+                if (!chunk_resp.success() ||
+                    chunk_resp.chunk().chunk_offset() != received) {
+                    break;
+                }
+                const auto& data = chunk_resp.chunk().chunk_data();
+                outfile.write(data.data(), data.size());
+                received += static_cast<int64_t>(data.size());
+                std::cout << "\r" << received << "/" << file_size
+                          << " bytes" << std::flush;
+
+                if (++consumed == STREAM_WINDOW / 2) {
+                    FileStreamRequest credit;
+                    credit.set_window(consumed);
+                    stream->Write(credit);
+                    consumed = 0;
+                }
+            }
+            std::cout << std::endl;
+            stream->WritesDone();
+            if (received < file_size) {
+                // Do not wait for chunks the server still has credit for.
+                ctx2.TryCancel();
             }
+            stream->Finish();
         }
-        std::cout << std::endl;
 
-        stream->WritesDone();
-        stream->Finish();
+        // STEP 3: Fetch whatever the stream did not deliver chunk by chunk.
+        // Stream chunks are multiples of CHUNK_SIZE, so the resume point is
+        // on a chunk boundary.
+        if (received < file_size) {
+            std::cout << "Stream ended at " << received
+                      << " bytes, fetching the rest in chunks..." << std::endl;
+            ClientContext ctx2;
+            std::shared_ptr<
+                ClientReaderWriter<FileChunkRequest, FileChunkResponse>>
+                stream(stub_->downloadFileLoop(&ctx2));
+
+            outfile.seekp(received / CHUNK_SIZE * CHUNK_SIZE);
+            for (int i = static_cast<int>(received / CHUNK_SIZE);
+                 i < total_chunks; ++i) {
+                FileChunkRequest chunk_req;
+                chunk_req.set_uuid(uuid);
+                chunk_req.set_chunk_idx(i);
+
+                if (!stream->Write(chunk_req)) break;
+
+                FileChunkResponse chunk_resp;
+                if (stream->Read(&chunk_resp) && chunk_resp.success()) {
+                    outfile.write(chunk_resp.chunk().chunk_data().data(),
+                                  chunk_resp.chunk().chunk_data().size());
+                } else {
+                    std::cerr << "Failed to read chunk " << i << std::endl;
+                    break;
+                }
+            }
+            stream->WritesDone();
+            stream->Finish();
+        }
         outfile.close();
 
-        // STEP 3: Finalize
+        // STEP 4: Finalize
         ClientContext ctx3;
         FileTransferRequest end_req;
         GenericResponse end_resp;
@@ -264,9 +414,12 @@ int app_main(int argc, char** argv) {
         std::cerr << "Usage: ./client <dest> <command> [args...]\n"
                   << "Commands:\n"
                   << "  send_message <chat_id> <text> [file_path]\n"
+                  << "  send_messages <chat_id,...> <text> [file_path]\n"
                   << "  spam_config <0-3>\n"
                   << "  info\n"
-                  << "  upload <local_path> <remote_path>\n"
+                  << "  upload <local_path> <remote_path> [streams] "
+                     "[resume_uuid]\n"
+                  << "  abort_upload <uuid> <remote_path>\n"
                   << "  download <remote_path> <local_path>\n";
         return 1;
     }
@@ -287,6 +440,15 @@ int app_main(int argc, char** argv) {
             std::string text = argv[3];
             std::string file = (argc >= 5) ? argv[4] : "";
             client.SendMessage(chat_id, text, file);
+        } else if (command == "send_messages") {
+            if (argc < 4) throw std::runtime_error("Missing args");
+            std::vector<int64_t> chat_ids;
+            std::stringstream ids(argv[2]);
+            for (std::string id; std::getline(ids, id, ',');) {
+                chat_ids.emplace_back(std::stoll(id));
+            }
+            std::string file = (argc >= 5) ? argv[4] : "";
+            client.SendMessages(chat_ids, argv[3], file);
         } else if (command == "spam_config") {
             if (argc < 3) throw std::runtime_error("Missing mode");
             client.SetSpamConfig(std::stoi(argv[2]));
@@ -294,7 +456,12 @@ int app_main(int argc, char** argv) {
             client.GetInfo();
         } else if (command == "upload") {
             if (argc < 4) throw std::runtime_error("Missing paths");
-            client.UploadFile(argv[2], argv[3]);
+            unsigned streams = (argc >= 5) ? std::stoul(argv[4]) : 1;
+            std::string resume = (argc >= 6) ? argv[5] : "";
+            client.UploadFile(argv[2], argv[3], streams, resume);
+        } else if (command == "abort_upload") {
+            if (argc < 4) throw std::runtime_error("Missing uuid or path");
+            client.AbortUpload(argv[2], argv[3]);
         } else if (command == "download") {
             if (argc < 4) throw std::runtime_error("Missing paths");
             client.DownloadFile(argv[2], argv[3]);
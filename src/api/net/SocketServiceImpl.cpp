@@ -6,27 +6,55 @@
 #include <fmt/format.h>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/server_builder.h>
+#include <grpcpp/support/message_allocator.h>
 #include <grpcpp/support/status.h>
 #include <uuid.h>
 
 #include <GitBuildInfo.hpp>
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <climits>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
 #include <random>
+#include <semaphore>
+#include <set>
+#include <stop_token>
+#include <string>
 #include <string_view>
 #include <system_error>
+#include <thread>
+#include <trivial_helpers/_class_helper_macros.h>
+#include <variant>
 #include <vector>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Blake3.hpp"
 #include "FileTransferValidation.hpp"
 #include "Socket_service.grpc.pb.h"
 #include "Socket_service.pb.h"
 #include "api/TgBotApi.hpp"
 #include "api/Utils.hpp"
+#include "database/DatabaseMetrics.hpp"
 #include "global_handlers/SpamBlock.hpp"
 #include "tgbot/TgException.h"
 
@@ -42,7 +70,471 @@ using grpc::Status;
 using namespace tgbot::proto::socket;
 namespace transfer = tgbot::socket::transfer;
 
-class SocketServiceImpl::Service : public SocketService::Service {
+namespace {
+
+// A file read or written at explicit offsets, so streams sharing a transfer
+// share no file position. Download streams open one of their own.
+class TransferFile {
+   public:
+    enum class Mode { READ, WRITE };
+
+    // WRITE opens an existing file without truncating it, and reads it too.
+    TransferFile(const std::filesystem::path& path, const Mode mode) {
+#ifdef _WIN32
+        fd_ = _wopen(path.c_str(),
+                     (mode == Mode::READ ? _O_RDONLY : _O_RDWR) | _O_BINARY);
+#else
+        fd_ = ::open(path.c_str(),
+                     (mode == Mode::READ ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (fd_ >= 0 && mode == Mode::READ) {
+            ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+#endif
+    }
+    ~TransferFile() {
+        if (fd_ >= 0) {
+#ifdef _WIN32
+            _close(fd_);
+#else
+            ::close(fd_);
+#endif
+        }
+    }
+    NO_COPY_CTOR(TransferFile);
+
+    [[nodiscard]] bool is_open() const { return fd_ >= 0; }
+
+    // Fills `size` bytes from `offset`. False on errors and on files that
+    // end early.
+    bool readAt(char* buffer, std::size_t size, std::uintmax_t offset) {
+        while (size > 0) {
+#ifdef _WIN32
+            if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) {
+                return false;
+            }
+            const auto count = _read(
+                fd_, buffer,
+                static_cast<unsigned>(std::min<std::size_t>(size, INT_MAX)));
+#else
+            const auto count =
+                ::pread(fd_, buffer, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (count <= 0) {
+                return false;
+            }
+            buffer += count;
+            size -= static_cast<std::size_t>(count);
+            offset += static_cast<std::uintmax_t>(count);
+        }
+        return true;
+    }
+
+    // Writes `size` bytes at `offset`.
+    bool writeAt(const char* data, std::size_t size, std::uintmax_t offset) {
+        while (size > 0) {
+#ifdef _WIN32
+            if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) {
+                return false;
+            }
+            const auto count = _write(
+                fd_, data,
+                static_cast<unsigned>(std::min<std::size_t>(size, INT_MAX)));
+#else
+            const auto count =
+                ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (count <= 0) {
+                return false;
+            }
+            data += count;
+            size -= static_cast<std::size_t>(count);
+            offset += static_cast<std::uintmax_t>(count);
+        }
+        return true;
+    }
+
+   private:
+    int fd_ = -1;
+};
+
+/**
+ * Hashes an upload while it is written, so the digest is ready when the
+ * transfer ends instead of reading the whole file back.
+ *
+ * The file is hashed in kChunkSize blocks, each once all of it arrived.
+ * BLAKE3 takes them in any order, and they are hashed outside the entry's
+ * lock. The other algorithms take them in file order only, so blocks that
+ * arrive early are read back from the file (most likely from the page cache)
+ * once the blocks before them are in.
+ *
+ * A write over bytes received before may change a block that was hashed
+ * already, or is being hashed. Such blocks are read back in finish(), once
+ * no writes are in flight; for the ordered algorithms that means the whole
+ * file.
+ */
+class UploadDigest {
+   public:
+    UploadDigest(const ChecksumAlgorithm algorithm,
+                 const std::uintmax_t totalSize)
+        : totalSize_(totalSize),
+          blocks_(std::max(transfer::chunkCount(totalSize), 1)) {
+        switch (algorithm) {
+            case ChecksumAlgorithm::MD5:
+                hash_ = std::make_unique<CryptoPP::Weak::MD5>();
+                break;
+            case ChecksumAlgorithm::SHA1:
+                hash_ = std::make_unique<CryptoPP::SHA1>();
+                break;
+            case ChecksumAlgorithm::SHA256:
+                hash_ = std::make_unique<CryptoPP::SHA256>();
+                break;
+            case ChecksumAlgorithm::SHA512:
+                hash_ = std::make_unique<CryptoPP::SHA512>();
+                break;
+            case ChecksumAlgorithm::Blake2b:
+                hash_ = std::make_unique<CryptoPP::BLAKE2b>();
+                break;
+            case ChecksumAlgorithm::Blake2s:
+                hash_ = std::make_unique<CryptoPP::BLAKE2s>();
+                break;
+            case ChecksumAlgorithm::Blake3:
+                tree_.emplace(totalSize, transfer::kChunkSize);
+                states_.assign(blocks_, BlockState::Waiting);
+                break;
+            case ChecksumAlgorithm::None:
+            default:
+                break;
+        }
+    }
+
+    // A BLAKE3 block to hash outside the lock, from `data` if the request
+    // held all of it, else read back from the file.
+    struct Block {
+        std::uintmax_t index;
+        const char* data;
+    };
+
+    // Called once `data` was written at `offset`, under the entry's lock.
+    // Adds the range to `coverage` and returns the blocks it completed, for
+    // hash() and then store().
+    std::vector<Block> written(TransferFile& file,
+                               transfer::UploadCoverage& coverage,
+                               const char* data, const std::size_t size,
+                               const std::uintmax_t offset) {
+        std::vector<Block> ready;
+        const auto end = offset + size;
+        if (size == 0 || (!hash_ && !tree_)) {
+            coverage.add(offset, size);
+            return ready;
+        }
+        const auto first = offset / transfer::kChunkSize;
+        for (auto index = first; index * transfer::kChunkSize < end;
+             ++index) {
+            const auto begin =
+                std::max(index * transfer::kChunkSize, offset);
+            if (!coverage.overlaps(begin, std::min(blockEnd(index), end))) {
+                continue;
+            }
+            if (tree_) {
+                tree_->removeBlock(index);
+                states_[index] = BlockState::Stale;
+            } else {
+                stale_ = true;
+            }
+        }
+        coverage.add(offset, size);
+
+        for (auto index = first; index * transfer::kChunkSize < end;
+             ++index) {
+            const auto begin = index * transfer::kChunkSize;
+            if (!coverage.covers(begin, blockEnd(index))) {
+                continue;
+            }
+            // Hash from the request when it holds the whole block.
+            const char* block = begin >= offset && blockEnd(index) <= end
+                                    ? data + (begin - offset)
+                                    : nullptr;
+            if (tree_) {
+                if (states_[index] == BlockState::Waiting) {
+                    states_[index] = BlockState::Hashing;
+                    ready.push_back({index, block});
+                }
+            } else if (!stale_ && index == next_ &&
+                       hashBlock(file, index, block)) {
+                ++next_;
+                while (next_ < blocks_ &&
+                       coverage.covers(next_ * transfer::kChunkSize,
+                                       blockEnd(next_)) &&
+                       hashBlock(file, next_, nullptr)) {
+                    ++next_;
+                }
+            }
+        }
+        return ready;
+    }
+
+    // Hashes blocks from written(), without the entry's lock; the file must
+    // stay open meanwhile. Blocks that could not be read back are left out.
+    std::vector<transfer::Blake3Tree::BlockHash> hash(
+        TransferFile& file, const std::vector<Block>& blocks) const {
+        std::vector<transfer::Blake3Tree::BlockHash> hashes;
+        std::vector<char> buffer;
+        for (const auto& [index, data] : blocks) {
+            const auto begin = index * transfer::kChunkSize;
+            const auto length = blockEnd(index) - begin;
+            if (data == nullptr) {
+                buffer.resize(length);
+                if (!file.readAt(buffer.data(), length, begin)) {
+                    LOG(WARNING) << "Failed to read back upload block "
+                                 << index;
+                    continue;
+                }
+            }
+            hashes.emplace_back(tree_->hashBlock(
+                index, data != nullptr ? data : buffer.data(), length));
+        }
+        return hashes;
+    }
+
+    // Adds what hash() returned, under the entry's lock. Blocks written to
+    // again meanwhile are dropped, finish() reads them back.
+    void store(const std::vector<transfer::Blake3Tree::BlockHash>& hashes) {
+        for (const auto& hash : hashes) {
+            if (states_[hash.index] == BlockState::Hashing) {
+                tree_->setBlock(hash);
+            }
+        }
+    }
+
+    // The raw digest, after hashing the blocks that were not yet, such as
+    // those received before a restart. std::nullopt if reading them failed.
+    // No writes may be in flight.
+    std::optional<std::string> finish(TransferFile& file) {
+        if (tree_) {
+            for (std::uintmax_t index = 0; index < blocks_; ++index) {
+                if (!tree_->hasBlock(index) &&
+                    !hashBlock(file, index, nullptr)) {
+                    return std::nullopt;
+                }
+            }
+            const auto digest = tree_->digest();
+            return std::string(digest.begin(), digest.end());
+        }
+        if (!hash_) {
+            return std::string();
+        }
+        if (stale_) {
+            hash_->Restart();
+            next_ = 0;
+            stale_ = false;
+        }
+        for (; next_ < blocks_; ++next_) {
+            if (!hashBlock(file, next_, nullptr)) {
+                return std::nullopt;
+            }
+        }
+        std::string digest(hash_->DigestSize(), '\0');
+        hash_->Final(reinterpret_cast<CryptoPP::byte*>(digest.data()));
+        return digest;
+    }
+
+   private:
+    enum class BlockState : std::uint8_t {
+        // Not all received yet, or received before a restart.
+        Waiting,
+        // Handed out by written(), then stored.
+        Hashing,
+        // Written to again after that, so read back in finish().
+        Stale,
+    };
+
+    [[nodiscard]] std::uintmax_t blockEnd(const std::uintmax_t index) const {
+        return std::min((index + 1) * transfer::kChunkSize, totalSize_);
+    }
+
+    // Hashes block `index` from `data`, or from the file if that is null.
+    bool hashBlock(TransferFile& file, const std::uintmax_t index,
+                   const char* data) {
+        const auto begin = index * transfer::kChunkSize;
+        const auto length = blockEnd(index) - begin;
+        if (data == nullptr) {
+            scratch_.resize(length);
+            if (!file.readAt(scratch_.data(), length, begin)) {
+                LOG(WARNING) << "Failed to read back upload block " << index;
+                return false;
+            }
+            data = scratch_.data();
+        }
+        if (tree_) {
+            tree_->addBlock(index, data, length);
+        } else {
+            hash_->Update(reinterpret_cast<const CryptoPP::byte*>(data),
+                          length);
+        }
+        return true;
+    }
+
+    std::uintmax_t totalSize_;
+    std::uintmax_t blocks_;
+    std::unique_ptr<CryptoPP::HashTransformation> hash_;
+    std::optional<transfer::Blake3Tree> tree_;
+    // Per block of tree_.
+    std::vector<BlockState> states_;
+    // The next block for hash_.
+    std::uintmax_t next_ = 0;
+    // A block before next_ changed, so hash_ starts over in finish().
+    bool stale_ = false;
+    std::vector<char> scratch_;
+};
+
+// How often an upload stream saves the session while chunks keep coming.
+constexpr std::chrono::seconds kUploadStateInterval{1};
+// Uploads not written to for this long are dropped with their files.
+constexpr std::chrono::hours kUploadTtl{24};
+// How often requestFileTransfer looks for such uploads.
+constexpr std::chrono::minutes kUploadSweepInterval{10};
+constexpr std::string_view kUploadTempPrefix = "upload_";
+
+std::filesystem::path uploadTempPath(const std::string_view uuid) {
+    return std::filesystem::temp_directory_path() /
+           fmt::format("{}{}.tmp", kUploadTempPrefix, uuid);
+}
+
+// The saved UploadSessionState of the upload at `tempPath`.
+std::filesystem::path uploadStatePath(std::filesystem::path tempPath) {
+    return tempPath.replace_extension(".state");
+}
+
+// Workers and queue of the pool running sendMessage calls. Telegram takes
+// about 30 messages a second from a bot, so a few workers keep up with it.
+constexpr std::size_t kSendWorkers = 4;
+constexpr std::size_t kSendQueue = 512;
+// Threads the synchronous methods may use at most. More concurrent calls
+// fail with RESOURCE_EXHAUSTED instead of starting threads.
+constexpr int kMaxServerThreads = 64;
+// Streaming calls that may run at once. Each holds a server thread for as
+// long as the client keeps it open, so the rest of kMaxServerThreads stays
+// free for the short calls.
+constexpr std::ptrdiff_t kMaxStreamingCalls = 48;
+static_assert(kMaxStreamingCalls < kMaxServerThreads);
+// Spacing of the sends of all calls. Telegram allows a bot about 30
+// messages a second across chats.
+constexpr std::chrono::milliseconds kSendInterval(34);
+
+/**
+ * Runs handlers of callback methods that block, on a fixed number of
+ * workers with a bounded queue, so a burst of calls waits in the queue
+ * instead of holding gRPC's callback threads or growing the thread count.
+ */
+class HandlerPool {
+   public:
+    HandlerPool(const std::size_t workers, const std::size_t capacity)
+        : capacity_(capacity) {
+        for (std::size_t i = 0; i < workers; ++i) {
+            workers_.emplace_back(
+                [this](const std::stop_token& stop) { run(stop); });
+        }
+    }
+    NO_COPY_CTOR(HandlerPool);
+
+    // False if the queue is full.
+    bool submit(std::function<void()> handler) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.size() >= capacity_) {
+                return false;
+            }
+            queue_.emplace_back(std::move(handler));
+        }
+        ready_.notify_one();
+        return true;
+    }
+
+   private:
+    void run(const std::stop_token& stop) {
+        while (true) {
+            std::function<void()> handler;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                // Once stop is requested this stops waiting, but what is
+                // still queued runs before the workers exit.
+                ready_.wait(lock, stop, [this] { return !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                handler = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            handler();
+        }
+    }
+
+    std::size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable_any ready_;
+    std::deque<std::function<void()>> queue_;
+    // Last, so the workers stop before the queue goes away.
+    std::vector<std::jthread> workers_;
+};
+
+// Paces the sends of every call to what Telegram allows a bot, and holds
+// them all off while Telegram asks the bot to wait.
+class SendPacer {
+   public:
+    // Takes the next free slot and returns when it starts.
+    std::chrono::steady_clock::time_point reserve() {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        const auto start = std::max(next_, std::chrono::steady_clock::now());
+        next_ = start + kSendInterval;
+        return start;
+    }
+
+    // No slot starts before `until`.
+    void holdOff(const std::chrono::steady_clock::time_point until) {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        next_ = std::max(next_, until);
+    }
+
+   private:
+    std::mutex mutex_;
+    std::chrono::steady_clock::time_point next_;
+};
+
+// A slot of a bounded number of calls, released when it goes out of scope.
+// Empty if every slot was taken.
+class CallSlot {
+   public:
+    explicit CallSlot(std::counting_semaphore<kMaxStreamingCalls>& slots)
+        : slots_(slots.try_acquire() ? &slots : nullptr) {}
+    ~CallSlot() {
+        if (slots_ != nullptr) {
+            slots_->release();
+        }
+    }
+    NO_COPY_CTOR(CallSlot);
+
+    explicit operator bool() const { return slots_ != nullptr; }
+
+   private:
+    std::counting_semaphore<kMaxStreamingCalls>* slots_;
+};
+
+}  // namespace
+
+// sendMessage waits on the Bot API, so it is a callback method whose work
+// runs on sendPool_. The others stay synchronous, with the streaming ones
+// limited to streamSlots_.
+class SocketServiceImpl::Service
+    : public SocketService::WithCallbackMethod_sendMessage<
+          SocketService::Service> {
    public:
     explicit Service(TgBotApi* api, SpamBlockBase* spamBlock,
                      DatabaseBase* database)
@@ -51,9 +543,13 @@ class SocketServiceImpl::Service : public SocketService::Service {
     std::chrono::system_clock::time_point startTime_ =
         std::chrono::system_clock::now();
 
-    Status sendMessage(ServerContext* context,
-                       const SendMessageRequest* request,
-                       GenericResponse* response) override;
+    grpc::ServerUnaryReactor* sendMessage(
+        grpc::CallbackServerContext* context,
+        const SendMessageRequest* request,
+        GenericResponse* response) override;
+    Status sendMessages(ServerContext* context,
+                        const SendMessagesRequest* request,
+                        ::grpc::ServerWriter<SendResult>* writer) override;
     Status setSpamBlockingConfig(ServerContext* context,
                                  const SpamBlockingConfig* request,
                                  GenericResponse* response) override;
@@ -71,9 +567,16 @@ class SocketServiceImpl::Service : public SocketService::Service {
         ServerContext* context,
         ::grpc::ServerReaderWriter<FileChunkResponse, FileChunk>* stream)
         override;
+    Status streamFileDownload(
+        ServerContext* context,
+        ::grpc::ServerReaderWriter<FileChunkResponse, FileStreamRequest>*
+            stream) override;
     Status endFileTransfer(ServerContext* context,
                            const FileTransferRequest* request,
                            GenericResponse* response) override;
+    Status getUploadStatus(ServerContext* context,
+                           const FileTransferRequest* request,
+                           UploadStatus* response) override;
     Status ping(ServerContext* context,
                 const ::google::protobuf::Empty* request,
                 ::google::protobuf::Empty* response) override;
@@ -107,26 +610,161 @@ class SocketServiceImpl::Service : public SocketService::Service {
     TgBotApi* api_;
     SpamBlockBase* spamBlock_;
     DatabaseBase* database_;
+    HandlerPool sendPool_{kSendWorkers, kSendQueue};
+    SendPacer sendPacer_;
+    // Taken by each running streaming call, see kMaxStreamingCalls.
+    std::counting_semaphore<kMaxStreamingCalls> streamSlots_{
+        kMaxStreamingCalls};
+
+    // The body of sendMessage, run on sendPool_. Moves the file data out of
+    // `request`.
+    void sendMessageNow(SendMessageRequest* request,
+                        GenericResponse* response);
+    // Checks `request` and reads its file into `media`. False, with
+    // `response` set, if it cannot be sent.
+    static bool prepareMessage(SendMessageRequest* request,
+                               GenericResponse* response,
+                               TgBotApi::FileOrMedia* media);
+    // Sends a prepared message to `chatId`, ignoring request->chat_id().
+    // Throws TgBot::TgException. Returns nullptr, with `response` set, for
+    // an unsupported file type.
+    Message::Ptr deliverMessage(ChatId chatId,
+                                const SendMessageRequest& request,
+                                const TgBotApi::FileOrMedia& media,
+                                std::string_view text,
+                                GenericResponse* response);
+    struct SendBatch;
+    // Holds off every send if `ex` is a flood limit. Returns whether it
+    // was.
+    bool holdOffSends(const TgBot::TgException& ex);
+    // Sends one target of a sendMessages batch into `result`, once. Sets
+    // `flooded` if it hit a flood limit, to be sent again after the wait.
+    // Any failure ends up in `result`; it doesn't throw.
+    Message::Ptr sendToTarget(const SendMessageRequest& message,
+                              const TgBotApi::FileOrMedia& media,
+                              const SendTarget& target, SendResult* result,
+                              bool* flooded);
 
     struct TranferEntry {
-        std::fstream fileStream;
+        // Guards the rest of the entry. A transfer's file I/O happens under
+        // it, so transfers only contend with each other on the map, except
+        // upload chunks, which are written and hashed without it.
+        std::mutex mutex;
+        // Reset once the transfer ended, for streams still holding it.
+        std::unique_ptr<TransferFile> file;
         std::filesystem::path filePath;
         std::filesystem::path destinationPath;
         std::uintmax_t totalSize = 0;
         int chunk_count{};
+        bool isUpload = false;
         ChecksumAlgorithm checksumAlgorithm = ChecksumAlgorithm::None;
         std::string checksum;
         bool overwriteExisting = false;
         transfer::UploadCoverage coverage;
+        std::unique_ptr<UploadDigest> digest;
+        // When the upload session was last saved.
+        std::chrono::steady_clock::time_point savedAt;
+        // Upload chunks being written without `mutex`. The file stays open
+        // until they are done, see writesDone.
+        std::size_t writes = 0;
+        std::condition_variable writesDone;
+        // Orders saves of the session, which may run without `mutex`.
+        std::mutex saveMutex;
     };
-
-    std::map<std::string, TranferEntry> activeTransfers_;
-    std::mutex activeTransfersMutex_;
+    // Active transfers by uuid, split in shards by the hash of the uuid so
+    // lookups of different transfers rarely wait on each other either.
+    struct TransferShard {
+        std::mutex mutex;
+        std::map<std::string, std::shared_ptr<TranferEntry>> transfers;
+    };
+    static constexpr std::size_t kTransferShards = 16;
+    class UploadWrite;
+
+    // Saves an upload session next to its temporary file, so it can be
+    // resumed after a restart. Caller holds entry.mutex.
+    static void saveUploadState(TranferEntry& entry);
+    // The session saveUploadState() saves, to write without the lock.
+    // Caller holds entry.mutex.
+    static UploadSessionState uploadState(TranferEntry& entry);
+    static void saveUploadState(TranferEntry& entry,
+                                const UploadSessionState& state);
+    // Removes the temporary file and saved state of an upload.
+    static void removeUploadFiles(const TranferEntry& entry);
+    // Reopens an upload session saved by an earlier run.
+    static std::shared_ptr<TranferEntry> restoreUpload(const std::string& uuid);
+
+    TransferShard& shardOf(const std::string& uuid);
+    // The active transfer with `uuid`, or nullptr.
+    std::shared_ptr<TranferEntry> findTransfer(const std::string& uuid);
+    // The active upload with `uuid`, restored from disk if needed, or
+    // nullptr.
+    std::shared_ptr<TranferEntry> findUpload(const std::string& uuid);
+    // False if `uuid` is taken.
+    bool insertTransfer(const std::string& uuid,
+                        std::shared_ptr<TranferEntry> entry);
+    void eraseTransfer(const std::string& uuid);
+    // Drops uploads idle for longer than kUploadTtl, active ones and those
+    // saved by earlier runs. Does nothing if it ran within
+    // kUploadSweepInterval.
+    void sweepStaleUploads();
+
+    std::array<TransferShard, kTransferShards> activeTransfers_;
+    std::mutex uploadSweepMutex_;
+    std::chrono::steady_clock::time_point nextUploadSweep_;
 };
 
 namespace {
+// Reads `path` into an InputFile. Unlike InputFile::fromFile, this sizes the
+// buffer up front and reads into it directly, so the file is held once
+// rather than also in a growing stream buffer and its copy. Returns nullptr,
+// with `response` set, if `path` is not a regular file or can't be read.
+InputFile::Ptr readInputFile(const std::filesystem::path& path,
+                             std::string mimeType, GenericResponse* response) {
+    // Sized from the file system: tellg() of a directory, which opens fine,
+    // is garbage.
+    std::error_code ec;
+    std::uintmax_t size = 0;
+    if (std::filesystem::is_regular_file(path, ec)) {
+        size = std::filesystem::file_size(path, ec);
+    } else if (!ec) {
+        response->set_code(GenericResponseCode::ErrorCommandIgnored);
+        response->set_message(
+            fmt::format("Not a regular file: {}", path.string()));
+        return nullptr;
+    }
+    if (ec) {
+        response->set_code(GenericResponseCode::ErrorCommandIgnored);
+        response->set_message(fmt::format("Cannot send {}: {}", path.string(),
+                                          ec.message()));
+        return nullptr;
+    }
+
+    auto inputFile = std::make_shared<InputFile>();
+    try {
+        std::ifstream input;
+        input.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        input.open(path, std::ios::binary);
+        inputFile->data.resize(static_cast<std::size_t>(size));
+        input.read(inputFile->data.data(),
+                   static_cast<std::streamsize>(size));
+    } catch (const std::ifstream::failure& e) {
+        response->set_code(GenericResponseCode::ErrorCommandIgnored);
+        response->set_message(fmt::format("Failed to read file: {}", e.what()));
+        return nullptr;
+    } catch (const std::bad_alloc&) {
+        response->set_code(GenericResponseCode::ErrorCommandIgnored);
+        response->set_message(
+            fmt::format("File too large to send: {} bytes", size));
+        return nullptr;
+    }
+    inputFile->mimeType = std::move(mimeType);
+    inputFile->fileName = path.filename().string();
+    return inputFile;
+}
+
+// `request` is modified: file_data is moved out of it.
 std::optional<TgBotApi::FileOrMedia> makeFileOrMedia(
-    const SendMessageRequest* request, GenericResponse* response) {
+    SendMessageRequest* request, GenericResponse* response) {
     TgBotApi::FileOrMedia fileOrMedia;
 
     // Guess the MIME type based on file type
@@ -160,18 +798,17 @@ std::optional<TgBotApi::FileOrMedia> makeFileOrMedia(
 
     if (request->has_file_path()) {
         // 1. If it has file path.
-        try {
-            fileOrMedia = InputFile::fromFile(request->file_path(), fileType);
-        } catch (const std::ifstream::failure& e) {
-            response->set_code(GenericResponseCode::ErrorCommandIgnored);
-            response->set_message(
-                fmt::format("Failed to read file: {}", e.what()));
+        auto inputFile =
+            readInputFile(request->file_path(), fileType, response);
+        if (inputFile == nullptr) {
             return std::nullopt;
         }
+        fileOrMedia = std::move(inputFile);
     } else if (request->has_file_data()) {
-        // 2. If it has file data.
+        // 2. If it has file data. Take the request's buffer rather than
+        // copying what may be megabytes.
         auto inputFile = std::make_shared<InputFile>();
-        inputFile->data = request->file_data();
+        inputFile->data = std::move(*request->mutable_file_data());
         inputFile->mimeType = fileType;
         inputFile->fileName = "upload_file";  // Default file name
         fileOrMedia = inputFile;
@@ -186,7 +823,8 @@ std::optional<TgBotApi::FileOrMedia> makeFileOrMedia(
     return fileOrMedia;
 }
 
-void LogWhoCalledMe(ServerContext* context, const std::string& methodName) {
+void LogWhoCalledMe(grpc::ServerContextBase* context,
+                    const std::string& methodName) {
     auto peer = context->peer();
     std::string_view unused = peer;
     if (absl::ConsumePrefix(&unused, "ipv4:127.0.0.1")) {
@@ -199,78 +837,345 @@ void LogWhoCalledMe(ServerContext* context, const std::string& methodName) {
 
 }  // namespace
 
-Status SocketServiceImpl::Service::sendMessage(
-    ServerContext* context, const SendMessageRequest* request,
-    GenericResponse* response) {
+grpc::ServerUnaryReactor* SocketServiceImpl::Service::sendMessage(
+    grpc::CallbackServerContext* context,
+    const SendMessageRequest* /*request*/, GenericResponse* response) {
     LogWhoCalledMe(context, "sendMessage");
+    auto* reactor = context->DefaultReactor();
+    // The request and response stay valid until Finish(). The request is
+    // handed out const, but it is the call's own copy in the arena of the
+    // allocator's holder, so it may be taken apart through the holder.
+    auto* messages =
+        static_cast<grpc::MessageHolder<SendMessageRequest, GenericResponse>*>(
+            context->GetRpcAllocatorState());
+    const bool queued = sendPool_.submit([this, reactor, messages] {
+        try {
+            sendMessageNow(messages->request(), messages->response());
+        } catch (const std::exception& ex) {
+            // Nothing else would finish the call.
+            LOG(ERROR) << "sendMessage failed: " << ex.what();
+            messages->response()->set_code(
+                GenericResponseCode::ErrorRuntimeError);
+            messages->response()->set_message(
+                fmt::format("Failed to send message: {}", ex.what()));
+        }
+        reactor->Finish(Status::OK);
+    });
+    if (!queued) {
+        response->set_code(GenericResponseCode::ErrorRuntimeError);
+        response->set_message("Too many messages queued, try again later");
+        LOG(WARNING) << "sendMessage queue is full, rejecting a call";
+        reactor->Finish(Status::OK);
+    }
+    return reactor;
+}
 
-    // 1. Check if file_type,text is present
-    bool hasFileType = request->has_file_type();
-    bool hasText = request->has_text();
+void SocketServiceImpl::Service::sendMessageNow(SendMessageRequest* request,
+                                                GenericResponse* response) {
+    TgBotApi::FileOrMedia fileOrMedia;
+    if (!prepareMessage(request, response, &fileOrMedia)) {
+        return;
+    }
+    // Takes a slot so batches leave room for this send, but doesn't wait
+    // for it: the worker would be held for nothing.
+    sendPacer_.reserve();
+    try {
+        if (deliverMessage(request->chat_id(), *request, fileOrMedia,
+                           request->text(), response) == nullptr) {
+            return;
+        }
+    } catch (const TgBot::TgException& ex) {
+        holdOffSends(ex);
+        response->set_code(GenericResponseCode::TelegramApiException);
+        response->set_message(
+            fmt::format("Failed to send message: {}", ex.what()));
+        return;
+    }
+
+    response->set_code(GenericResponseCode::Success);
+    response->set_message("Message sent successfully");
+}
 
-    // 2. Check if file_type or text is provided
-    if (!hasFileType && !hasText) {
+bool SocketServiceImpl::Service::prepareMessage(SendMessageRequest* request,
+                                                GenericResponse* response,
+                                                TgBotApi::FileOrMedia* media) {
+    // 1. Check if file_type or text is provided
+    if (!request->has_file_type() && !request->has_text()) {
         response->set_code(GenericResponseCode::ErrorCommandIgnored);
         response->set_message("Either file_type or text must be provided");
-        return Status::OK;
+        return false;
     }
 
-    // 3. Store file if needed
-    TgBotApi::FileOrMedia fileOrMedia;
-    if (hasFileType) {
+    // 2. Store file if needed
+    if (request->has_file_type()) {
         auto fileOrMediaOpt = makeFileOrMedia(request, response);
         if (!fileOrMediaOpt.has_value()) {
-            return Status::OK;
+            return false;
         }
-        fileOrMedia = *fileOrMediaOpt;
+        *media = std::move(*fileOrMediaOpt);
     }
+    return true;
+}
 
-    // 4. store text if needed
-    constexpr std::string_view emptyStringView;
-    std::string_view textOpt = hasText ? request->text() : emptyStringView;
+Message::Ptr SocketServiceImpl::Service::deliverMessage(
+    const ChatId chatId, const SendMessageRequest& request,
+    const TgBotApi::FileOrMedia& media, const std::string_view text,
+    GenericResponse* response) {
+    if (!request.has_file_type()) {
+        return api_->sendMessage(chatId, text);
+    }
+    switch (request.file_type()) {
+        case FileType::PHOTO:
+            return api_->sendPhoto(chatId, media, text);
+        case FileType::VIDEO:
+            return api_->sendVideo(chatId, media, text);
+        case FileType::DOCUMENT:
+            return api_->sendDocument(chatId, media, text);
+        case FileType::GIF:
+            return api_->sendAnimation(chatId, media, text);
+        case FileType::STICKER:
+            return api_->sendSticker(chatId, media);
+        case FileType::DICE:
+            return api_->sendDice(chatId);
+        default:
+            response->set_code(GenericResponseCode::ErrorCommandIgnored);
+            response->set_message("Unsupported file type");
+            return nullptr;
+    }
+}
+
+namespace {
+
+// How long Telegram asks to wait, if `ex` is a flood limit error, "Too Many
+// Requests: retry after N".
+std::optional<std::chrono::seconds> floodWait(const TgBot::TgException& ex) {
+    constexpr int kTooManyRequests = 429;
+    if (static_cast<int>(ex.errorCode) != kTooManyRequests) {
+        return std::nullopt;
+    }
+    constexpr std::string_view kRetryAfter = "retry after ";
+    const std::string_view what = ex.what();
+    int seconds = 1;
+    if (const auto at = what.find(kRetryAfter); at != std::string_view::npos) {
+        const auto* begin = what.data() + at + kRetryAfter.size();
+        std::from_chars(begin, what.data() + what.size(), seconds);
+    }
+    return std::chrono::seconds(std::max(seconds, 1));
+}
+
+// The file ID of the media in a sent message, to send it again without
+// uploading it.
+std::optional<MediaIds> sentMedia(const Message::Ptr& message) {
+    if (!message->photo.empty()) {
+        return MediaIds(message->photo.back());
+    }
+    if (message->video) {
+        return MediaIds(message->video);
+    }
+    if (message->animation) {
+        return MediaIds(message->animation);
+    }
+    if (message->sticker) {
+        return MediaIds(message->sticker);
+    }
+    if (message->document) {
+        return MediaIds(message->document->fileId,
+                        message->document->fileUniqueId);
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+// A sendMessages batch. Sends on sendPool_ hand their results back to the
+// RPC's thread, which alone writes the stream and waits on the pacing.
+struct SocketServiceImpl::Service::SendBatch {
+    SendBatch() = default;
+    // Sends still queued use the batch, so it waits for them, also when the
+    // RPC unwinds before it flushed.
+    ~SendBatch() {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return pending == 0; });
+    }
+    NO_COPY_CTOR(SendBatch);
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<SendResult> results;
+    // Sends on sendPool_ that hit a flood limit, for the RPC's thread to
+    // queue once more.
+    std::vector<SendResult> retries;
+    // Sends queued on sendPool_ and not done.
+    std::size_t pending = 0;
+};
+
+bool SocketServiceImpl::Service::holdOffSends(const TgBot::TgException& ex) {
+    const auto wait = floodWait(ex);
+    if (!wait) {
+        return false;
+    }
+    // The limit is the bot's, so every send waits it out.
+    sendPacer_.holdOff(std::chrono::steady_clock::now() + *wait);
+    LOG(WARNING) << "Flood limit hit, holding off sends for "
+                 << wait->count() << "s";
+    return true;
+}
 
-    // 5. Process the request based on file_type presence
+Message::Ptr SocketServiceImpl::Service::sendToTarget(
+    const SendMessageRequest& message, const TgBotApi::FileOrMedia& media,
+    const SendTarget& target, SendResult* result, bool* flooded) {
+    auto* response = result->mutable_response();
+    const std::string_view text =
+        target.has_text() ? target.text() : message.text();
     try {
-        if (hasFileType) {
-            switch (request->file_type()) {
-                case FileType::PHOTO:
-                    api_->sendPhoto(request->chat_id(), fileOrMedia, textOpt);
-                    break;
-                case FileType::VIDEO:
-                    api_->sendVideo(request->chat_id(), fileOrMedia, textOpt);
-                    break;
-                case FileType::DOCUMENT:
-                    api_->sendDocument(request->chat_id(), fileOrMedia,
-                                       textOpt);
-                    break;
-                case FileType::GIF:
-                    api_->sendAnimation(request->chat_id(), fileOrMedia,
-                                        textOpt);
-                    break;
-                case FileType::STICKER:
-                    api_->sendSticker(request->chat_id(), fileOrMedia);
-                    break;
-                case FileType::DICE:
-                    api_->sendDice(request->chat_id());
-                    break;
-                default:
-                    response->set_code(
-                        GenericResponseCode::ErrorCommandIgnored);
-                    response->set_message("Unsupported file type");
-                    return Status::OK;
-            }
-        } else if (hasText) {
-            api_->sendMessage(request->chat_id(), textOpt);
+        auto sent =
+            deliverMessage(target.chat_id(), message, media, text, response);
+        if (sent != nullptr) {
+            response->set_code(GenericResponseCode::Success);
+            response->set_message("Message sent successfully");
         }
+        return sent;
     } catch (const TgBot::TgException& ex) {
+        *flooded = holdOffSends(ex);
         response->set_code(GenericResponseCode::TelegramApiException);
         response->set_message(
             fmt::format("Failed to send message: {}", ex.what()));
-        return Status::OK;
+        return nullptr;
+    } catch (const std::exception& ex) {
+        // Reported as this target's result, so the batch goes on.
+        LOG(ERROR) << "Failed to send to " << target.chat_id() << ": "
+                   << ex.what();
+        response->set_code(GenericResponseCode::ErrorRuntimeError);
+        response->set_message(
+            fmt::format("Failed to send message: {}", ex.what()));
+        return nullptr;
     }
+}
 
-    response->set_code(GenericResponseCode::Success);
-    response->set_message("Message sent successfully");
+Status SocketServiceImpl::Service::sendMessages(
+    ServerContext* context, const SendMessagesRequest* request,
+    ::grpc::ServerWriter<SendResult>* writer) {
+    const CallSlot slot(streamSlots_);
+    if (!slot) {
+        return {grpc::StatusCode::RESOURCE_EXHAUSTED,
+                "Too many streaming calls, try again later"};
+    }
+    LogWhoCalledMe(context, "sendMessages");
+
+    // A copy, once for the batch, as preparing moves the file data out.
+    SendMessageRequest message = request->message();
+    GenericResponse prepared;
+    TgBotApi::FileOrMedia media;
+    const bool ready = prepareMessage(&message, &prepared, &media);
+    // Whether sends may run in parallel: there is no file to upload, or it
+    // went up once and is sent by its file ID since.
+    bool uploaded = !message.has_file_type() ||
+                    !std::holds_alternative<InputFile::Ptr>(media);
+
+    SendBatch batch;
+    bool writable = true;
+    // Queues the send of `result`'s target on sendPool_ once its slot
+    // starts. The first attempt hands a flood limit back in batch.retries,
+    // the retry reports it.
+    const auto dispatch = [&](SendResult result, const bool retried) {
+        std::this_thread::sleep_until(sendPacer_.reserve());
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            ++batch.pending;
+        }
+        // Each send copies `media`, which is a file ID or nothing by now.
+        auto send = [this, &message, media, &targets = request->targets(),
+                     &batch, result = std::move(result), retried]() mutable {
+            bool flooded = false;
+            sendToTarget(message, media, targets[result.index()], &result,
+                         &flooded);
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            --batch.pending;
+            if (flooded && !retried) {
+                batch.retries.emplace_back(std::move(result));
+            } else {
+                batch.results.emplace_back(std::move(result));
+            }
+            // Under the lock: the batch may be gone right after it.
+            batch.changed.notify_one();
+        };
+        if (!sendPool_.submit(send)) {
+            send();
+        }
+    };
+    // Writes what sends finished and queues the flooded ones again. With
+    // `all`, waits for the ones queued.
+    const auto flush = [&](const bool all) {
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        while (true) {
+            while (!batch.results.empty()) {
+                auto result = std::move(batch.results.front());
+                batch.results.pop_front();
+                lock.unlock();
+                writable = writable && writer->Write(result);
+                lock.lock();
+            }
+            if (!batch.retries.empty()) {
+                auto retries = std::move(batch.retries);
+                batch.retries.clear();
+                lock.unlock();
+                for (auto& result : retries) {
+                    dispatch(std::move(result), true);
+                }
+                lock.lock();
+                continue;
+            }
+            if (!all || batch.pending == 0) {
+                return;
+            }
+            batch.changed.wait(lock, [&batch] {
+                return !batch.results.empty() || !batch.retries.empty() ||
+                       batch.pending == 0;
+            });
+        }
+    };
+
+    const auto& targets = request->targets();
+    for (int index = 0; index < targets.size(); ++index) {
+        if (context->IsCancelled() || !writable) {
+            break;
+        }
+        SendResult result;
+        result.set_index(index);
+        result.set_chat_id(targets[index].chat_id());
+        if (!ready) {
+            *result.mutable_response() = prepared;
+            writable = writer->Write(result);
+            continue;
+        }
+
+        if (uploaded) {
+            dispatch(std::move(result), false);
+        } else {
+            // Until the media is on Telegram, sends upload it and so go one at
+            // a time here, where waiting out a flood limit holds no worker.
+            bool flooded = false;
+            std::this_thread::sleep_until(sendPacer_.reserve());
+            auto sent = sendToTarget(message, media, targets[index], &result,
+                                     &flooded);
+            if (flooded) {
+                std::this_thread::sleep_until(sendPacer_.reserve());
+                sent = sendToTarget(message, media, targets[index], &result,
+                                    &flooded);
+            }
+            if (sent != nullptr) {
+                if (auto ids = sentMedia(sent)) {
+                    media = std::move(*ids);
+                    uploaded = true;
+                }
+            }
+            writable = writable && writer->Write(result);
+        }
+        flush(false);
+    }
+    // Writes what the queued sends report. Should the loop throw instead,
+    // ~SendBatch() still waits for them.
+    flush(true);
     return Status::OK;
 }
 
@@ -307,80 +1212,254 @@ std::string hex_encode(std::string_view data) {
     return encoded;
 }
 
-template <typename T>
-std::optional<std::string> calc_file_hash(const std::filesystem::path& path) {
-    std::ifstream input(path, std::ios::binary);
-    if (!input.is_open()) {
-        return std::nullopt;
+// `provided` is either the raw digest or its hex encoding in any case.
+bool checksum_matches(const std::string& digest, const std::string& provided) {
+    if (provided.size() == digest.size()) {
+        return provided == digest;
+    }
+    return absl::AsciiStrToUpper(provided) == hex_encode(digest);
+}
+
+}  // namespace
+
+void SocketServiceImpl::Service::saveUploadState(TranferEntry& entry) {
+    saveUploadState(entry, uploadState(entry));
+}
+
+UploadSessionState SocketServiceImpl::Service::uploadState(
+    TranferEntry& entry) {
+    UploadSessionState state;
+    state.set_destination_path(entry.destinationPath.string());
+    state.set_file_size(entry.totalSize);
+    state.set_checksum_algorithm(entry.checksumAlgorithm);
+    state.set_checksum(entry.checksum);
+    state.set_overwrite_existing(entry.overwriteExisting);
+    for (const auto& [begin, end] : entry.coverage.ranges()) {
+        auto* range = state.add_received();
+        range->set_offset(begin);
+        range->set_length(end - begin);
     }
+    entry.savedAt = std::chrono::steady_clock::now();
+    return state;
+}
 
-    T hash_obj;
-    std::array<char, 64 * 1024> buffer{};
-    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0) {
-        hash_obj.Update(reinterpret_cast<const CryptoPP::byte*>(buffer.data()),
-                        static_cast<size_t>(input.gcount()));
+void SocketServiceImpl::Service::saveUploadState(
+    TranferEntry& entry, const UploadSessionState& state) {
+    // Replace the state by renaming, so a crash leaves the old or the new
+    // one. Ranges are only recorded after their chunks were written.
+    const std::lock_guard<std::mutex> lock(entry.saveMutex);
+    const auto statePath = uploadStatePath(entry.filePath);
+    auto newPath = statePath;
+    newPath += ".new";
+    {
+        std::ofstream output(newPath, std::ios::binary | std::ios::trunc);
+        if (!output.is_open() || !state.SerializeToOstream(&output)) {
+            LOG(WARNING) << "Failed to save upload state: "
+                         << newPath.string();
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(newPath, statePath, ec);
+    if (ec) {
+        LOG(WARNING) << "Failed to save upload state " << statePath.string()
+                     << ": " << ec.message();
     }
+}
 
-    std::string digest(hash_obj.DigestSize(), '\0');
-    hash_obj.Final(reinterpret_cast<CryptoPP::byte*>(digest.data()));
-    return hex_encode(digest);
+void SocketServiceImpl::Service::removeUploadFiles(const TranferEntry& entry) {
+    std::error_code ec;
+    std::filesystem::remove(entry.filePath, ec);
+    std::filesystem::remove(uploadStatePath(entry.filePath), ec);
 }
 
-template <typename T>
-bool file_checksum_matches(const std::filesystem::path& path,
-                           std::string providedChecksum) {
-    auto calculatedChecksum = calc_file_hash<T>(path);
-    if (!calculatedChecksum.has_value()) {
-        return false;
+std::shared_ptr<SocketServiceImpl::Service::TranferEntry>
+SocketServiceImpl::Service::restoreUpload(const std::string& uuid) {
+    // The uuid names files on disk, so only accept it in canonical form.
+    const auto parsed = uuids::uuid::from_string(uuid);
+    if (!parsed || uuids::to_string(*parsed) != uuid) {
+        return nullptr;
+    }
+    auto restored = std::make_shared<TranferEntry>();
+    TranferEntry& entry = *restored;
+    entry.filePath = uploadTempPath(uuid);
+    UploadSessionState state;
+    {
+        std::ifstream input(uploadStatePath(entry.filePath), std::ios::binary);
+        if (!input.is_open() || !state.ParseFromIstream(&input)) {
+            return nullptr;
+        }
+    }
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(entry.filePath, ec);
+    if (ec || size != state.file_size()) {
+        LOG(WARNING) << "Dropping saved upload " << uuid
+                     << ": temporary file is missing or has the wrong size";
+        return nullptr;
     }
+    entry.file = std::make_unique<TransferFile>(entry.filePath,
+                                                TransferFile::Mode::WRITE);
+    if (!entry.file->is_open()) {
+        return nullptr;
+    }
+    entry.isUpload = true;
+    entry.destinationPath = state.destination_path();
+    entry.totalSize = state.file_size();
+    entry.checksumAlgorithm = state.checksum_algorithm();
+    entry.checksum = state.checksum();
+    entry.overwriteExisting = state.overwrite_existing();
+    entry.coverage = transfer::UploadCoverage(entry.totalSize);
+    // Blocks received before the restart are hashed from the file when the
+    // upload ends.
+    entry.digest = std::make_unique<UploadDigest>(entry.checksumAlgorithm,
+                                                  entry.totalSize);
+    for (const auto& range : state.received()) {
+        if (transfer::uploadChunkInRange(
+                static_cast<std::int64_t>(range.offset()), range.length(),
+                entry.totalSize)) {
+            entry.coverage.add(range.offset(), range.length());
+        }
+    }
+    entry.savedAt = std::chrono::steady_clock::now();
+    LOG(INFO) << "Restored upload " << uuid << " with "
+              << entry.coverage.coveredBytes() << " of " << entry.totalSize
+              << " bytes";
+    return restored;
+}
 
-    T hash_obj;
-    if (providedChecksum.size() == hash_obj.DigestSize()) {
-        providedChecksum = hex_encode(providedChecksum);
-    } else {
-        providedChecksum = absl::AsciiStrToUpper(providedChecksum);
-    }
-    return providedChecksum == *calculatedChecksum;
-}
-
-bool verify_file_checksum(const std::filesystem::path& path,
-                          ChecksumAlgorithm algorithm,
-                          const std::string& providedChecksum) {
-    switch (algorithm) {
-        case ChecksumAlgorithm::MD5:
-            return file_checksum_matches<CryptoPP::Weak::MD5>(
-                path, providedChecksum);
-        case ChecksumAlgorithm::SHA1:
-            return file_checksum_matches<CryptoPP::SHA1>(path,
-                                                         providedChecksum);
-        case ChecksumAlgorithm::SHA256:
-            return file_checksum_matches<CryptoPP::SHA256>(path,
-                                                           providedChecksum);
-        case ChecksumAlgorithm::SHA512:
-            return file_checksum_matches<CryptoPP::SHA512>(path,
-                                                           providedChecksum);
-        case ChecksumAlgorithm::Blake2b:
-            return file_checksum_matches<CryptoPP::BLAKE2b>(path,
-                                                            providedChecksum);
-        case ChecksumAlgorithm::Blake2s:
-            return file_checksum_matches<CryptoPP::BLAKE2s>(path,
-                                                            providedChecksum);
-        case ChecksumAlgorithm::None:
-            return true;
-    }
-    return false;
+SocketServiceImpl::Service::TransferShard&
+SocketServiceImpl::Service::shardOf(const std::string& uuid) {
+    return activeTransfers_[std::hash<std::string>{}(uuid) % kTransferShards];
+}
+
+std::shared_ptr<SocketServiceImpl::Service::TranferEntry>
+SocketServiceImpl::Service::findTransfer(const std::string& uuid) {
+    auto& shard = shardOf(uuid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.transfers.find(uuid);
+    return it != shard.transfers.end() ? it->second : nullptr;
+}
+
+std::shared_ptr<SocketServiceImpl::Service::TranferEntry>
+SocketServiceImpl::Service::findUpload(const std::string& uuid) {
+    auto& shard = shardOf(uuid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.transfers.find(uuid);
+    if (it == shard.transfers.end()) {
+        auto restored = restoreUpload(uuid);
+        if (!restored) {
+            return nullptr;
+        }
+        it = shard.transfers.emplace(uuid, std::move(restored)).first;
+    }
+    return it->second->isUpload ? it->second : nullptr;
+}
+
+bool SocketServiceImpl::Service::insertTransfer(
+    const std::string& uuid, std::shared_ptr<TranferEntry> entry) {
+    auto& shard = shardOf(uuid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.transfers.try_emplace(uuid, std::move(entry)).second;
+}
+
+void SocketServiceImpl::Service::eraseTransfer(const std::string& uuid) {
+    auto& shard = shardOf(uuid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.transfers.erase(uuid);
+}
+
+void SocketServiceImpl::Service::sweepStaleUploads() {
+    {
+        std::unique_lock<std::mutex> lock(uploadSweepMutex_, std::try_to_lock);
+        const auto now = std::chrono::steady_clock::now();
+        if (!lock.owns_lock() || now < nextUploadSweep_) {
+            return;
+        }
+        nextUploadSweep_ = now + kUploadSweepInterval;
+    }
+
+    std::vector<std::pair<std::string, std::shared_ptr<TranferEntry>>> active;
+    for (auto& shard : activeTransfers_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& [uuid, entry] : shard.transfers) {
+            active.emplace_back(uuid, entry);
+        }
+    }
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& [uuid, entry] : active) {
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        if (!entry->isUpload || !entry->file || entry->writes != 0 ||
+            now - entry->savedAt < kUploadTtl) {
+            continue;
+        }
+        LOG(INFO) << "Dropping upload " << uuid << ", idle for over "
+                  << kUploadTtl.count() << " hours";
+        entry->file.reset();
+        removeUploadFiles(*entry);
+        eraseTransfer(uuid);
+    }
+
+    // Sessions saved by an earlier run that nobody resumed.
+    const auto fileNow = std::filesystem::file_time_type::clock::now();
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(
+             std::filesystem::temp_directory_path(ec), ec),
+         end;
+         !ec && it != end; it.increment(ec)) {
+        const auto& path = it->path();
+        const auto stem = path.stem().string();
+        if (path.extension() != ".state" ||
+            !stem.starts_with(kUploadTempPrefix)) {
+            continue;
+        }
+        const auto uuid = stem.substr(kUploadTempPrefix.size());
+        std::error_code timeEc;
+        const auto written = std::filesystem::last_write_time(path, timeEc);
+        if (timeEc || fileNow - written < kUploadTtl || findTransfer(uuid)) {
+            continue;
+        }
+        LOG(INFO) << "Dropping saved upload " << uuid << ", idle for over "
+                  << kUploadTtl.count() << " hours";
+        std::error_code removeEc;
+        std::filesystem::remove(uploadTempPath(uuid), removeEc);
+        std::filesystem::remove(path, removeEc);
+    }
 }
 
-}  // namespace
 Status SocketServiceImpl::Service::requestFileTransfer(
     ServerContext* context, const FileTransferRequest* request,
     FileTransferResponse* response) {
     LogWhoCalledMe(context, "requestFileTransfer");
+    if (request->is_upload()) {
+        sweepStaleUploads();
+    }
 
     LOG(INFO) << "Received file transfer request for path: "
               << request->file_path()
               << (request->is_upload() ? " (upload)" : " (download)");
 
+    if (request->is_upload() && request->has_uuid()) {
+        // Resume an upload session, possibly one of an earlier run.
+        auto entry = findUpload(request->uuid());
+        std::unique_lock<std::mutex> lock;
+        if (entry) {
+            lock = std::unique_lock(entry->mutex);
+        }
+        if (!entry || !entry->file ||
+            entry->destinationPath != request->file_path() ||
+            entry->totalSize != request->file_size()) {
+            response->set_accepted(false);
+            response->set_reject_message("No matching upload to resume");
+            LOG(ERROR) << "No matching upload to resume: "
+                       << std::quoted(request->uuid());
+            return Status::OK;
+        }
+        response->set_uuid(request->uuid());
+        response->set_file_size(static_cast<std::int64_t>(entry->totalSize));
+        response->set_accepted(true);
+        return Status::OK;
+    }
+
     // 1. Create UUID for the transfer. Transfers are looked up solely by this
     // id, so draw it straight from the OS CSPRNG rather than a single-seeded
     // mt19937 (whose stream a client could otherwise predict from observed
@@ -393,7 +1472,8 @@ Status SocketServiceImpl::Service::requestFileTransfer(
     uuids::uuid uuid(uuid_bytes.begin(), uuid_bytes.end());
     response->set_uuid(uuids::to_string(uuid));
     // 2. Create file stream and store in activeTransfers_
-    TranferEntry entry;
+    auto newEntry = std::make_shared<TranferEntry>();
+    TranferEntry& entry = *newEntry;
 
     std::error_code ec;
     if (request->is_upload()) {
@@ -418,12 +1498,12 @@ Status SocketServiceImpl::Service::requestFileTransfer(
             entry.checksumAlgorithm = request->file_checksum_algorithm();
             entry.checksum = request->file_checksum();
         }
+        entry.isUpload = true;
         entry.overwriteExisting = request->overwrite_existing();
         entry.destinationPath = request->file_path();
 
         // For upload, we create a temporary file to store incoming data
-        entry.filePath = std::filesystem::temp_directory_path() /
-                         fmt::format("upload_{}.tmp", uuids::to_string(uuid));
+        entry.filePath = uploadTempPath(uuids::to_string(uuid));
 
         // Reject absurd sizes before pre-allocating: file_size is
         // client-supplied and resize_file would otherwise let a single request
@@ -439,9 +1519,10 @@ Status SocketServiceImpl::Service::requestFileTransfer(
         }
         entry.totalSize = request->file_size();
         entry.coverage = transfer::UploadCoverage(entry.totalSize);
+        entry.digest = std::make_unique<UploadDigest>(entry.checksumAlgorithm,
+                                                      entry.totalSize);
         // Create the file first, then resize
-        entry.fileStream.open(entry.filePath, std::ios::binary | std::ios::out);
-        entry.fileStream.close();
+        std::ofstream{entry.filePath, std::ios::binary | std::ios::out};
         std::filesystem::resize_file(entry.filePath, entry.totalSize, ec);
         if (ec) {
             response->set_accepted(false);
@@ -454,18 +1535,21 @@ Status SocketServiceImpl::Service::requestFileTransfer(
 
         LOG(INFO) << "Resized file: " << entry.filePath.string() << " to size "
                   << entry.totalSize << " bytes";
-        entry.fileStream.open(entry.filePath, std::ios::binary | std::ios::out);
-        if (!entry.fileStream.is_open()) {
+        entry.file = std::make_unique<TransferFile>(entry.filePath,
+                                                    TransferFile::Mode::WRITE);
+        if (!entry.file->is_open()) {
             response->set_accepted(false);
             response->set_reject_message("Failed to create temporary file");
             LOG(ERROR) << "Failed to create temporary file for upload";
             return Status::OK;
         }
+        saveUploadState(entry);
     } else {
         // For download, we open the requested file
         entry.filePath = request->file_path();
-        entry.fileStream.open(entry.filePath, std::ios::binary | std::ios::in);
-        if (!entry.fileStream.is_open()) {
+        entry.file = std::make_unique<TransferFile>(entry.filePath,
+                                                    TransferFile::Mode::READ);
+        if (!entry.file->is_open()) {
             response->set_accepted(false);
             response->set_reject_message("Failed to open file for download");
             LOG(ERROR) << "Failed to open file for download: "
@@ -477,17 +1561,12 @@ Status SocketServiceImpl::Service::requestFileTransfer(
         response->set_file_size(entry.totalSize);
         response->set_chunk_count(entry.chunk_count);
     }
-    {
-        std::lock_guard<std::mutex> lock(activeTransfersMutex_);
-        auto [it, inserted] = activeTransfers_.try_emplace(
-            uuids::to_string(uuid), std::move(entry));
-        if (!inserted) {
-            response->set_accepted(false);
-            response->set_reject_message("UUID collision detected");
-            LOG(ERROR) << "File transfer with UUID already exists: "
-                       << uuids::to_string(uuid);
-            return Status::OK;
-        }
+    if (!insertTransfer(uuids::to_string(uuid), std::move(newEntry))) {
+        response->set_accepted(false);
+        response->set_reject_message("UUID collision detected");
+        LOG(ERROR) << "File transfer with UUID already exists: "
+                   << uuids::to_string(uuid);
+        return Status::OK;
     }
     response->set_accepted(true);
     return Status::OK;
@@ -496,60 +1575,63 @@ Status SocketServiceImpl::Service::requestFileTransfer(
 Status SocketServiceImpl::Service::downloadFileLoop(
     ServerContext* context,
     ::grpc::ServerReaderWriter<FileChunkResponse, FileChunkRequest>* stream) {
+    const CallSlot slot(streamSlots_);
+    if (!slot) {
+        return {grpc::StatusCode::RESOURCE_EXHAUSTED,
+                "Too many streaming calls, try again later"};
+    }
     FileChunkRequest msg;
 
     LogWhoCalledMe(context, "downloadFileLoop");
 
+    std::vector<char> buffer(transfer::kChunkSize);
+    // Looked up again only when the stream switches transfers.
+    std::shared_ptr<TranferEntry> entry;
+    std::string entryUuid;
     while (stream->Read(&msg)) {
-        std::vector<char> buffer(transfer::kChunkSize);
-        std::streamsize bytesRead = 0;
-        {
-            std::lock_guard<std::mutex> lock(activeTransfersMutex_);
-            auto it = activeTransfers_.find(msg.uuid());
-            if (it == activeTransfers_.end()) {
-                // Invalid UUID
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(false);
-                LOG(ERROR) << "Invalid UUID for file download: "
-                           << std::quoted(msg.uuid());
-                stream->Write(response);
-                return Status::OK;
-            }
-
-            // Reject out-of-range chunk indices instead of computing a bogus
-            // (possibly overflowing) seek offset.
-            if (!transfer::downloadChunkValid(msg.chunk_idx(),
-                                              it->second.chunk_count)) {
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(false);
-                LOG(ERROR) << "Out-of-range chunk index " << msg.chunk_idx()
-                           << " for download UUID " << msg.uuid();
-                stream->Write(response);
-                return Status::OK;
-            }
+        if (!entry || msg.uuid() != entryUuid) {
+            entry = findTransfer(msg.uuid());
+            entryUuid = msg.uuid();
+        }
+        if (!entry) {
+            // Invalid UUID
+            FileChunkResponse response;
+            response.set_success(false);
+            response.set_retry(false);
+            LOG(ERROR) << "Invalid UUID for file download: "
+                       << std::quoted(msg.uuid());
+            stream->Write(response);
+            return Status::OK;
+        }
 
-            it->second.fileStream.seekg(
-                static_cast<std::streamoff>(transfer::chunkOffset(
-                    msg.chunk_idx())),
-                std::ios::beg);
-            if (!it->second.fileStream.good()) {
-                // Seek failed
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(true);
-                LOG(ERROR) << "Seek failed during file download: "
-                           << msg.uuid();
-                stream->Write(response);
-                return Status::OK;
+        // Reject out-of-range chunk indices instead of computing a bogus
+        // (possibly overflowing) seek offset.
+        bool chunkValid = false;
+        std::size_t bytesRead = 0;
+        {
+            std::lock_guard<std::mutex> lock(entry->mutex);
+            chunkValid = transfer::downloadChunkValid(msg.chunk_idx(),
+                                                      entry->chunk_count);
+            const auto offset = transfer::chunkOffset(msg.chunk_idx());
+            if (chunkValid && entry->file) {
+                const auto length =
+                    std::min(transfer::kChunkSize, entry->totalSize - offset);
+                if (entry->file->readAt(buffer.data(), length, offset)) {
+                    bytesRead = length;
+                }
             }
-
-            it->second.fileStream.read(buffer.data(), buffer.size());
-            bytesRead = it->second.fileStream.gcount();
+        }
+        if (!chunkValid) {
+            FileChunkResponse response;
+            response.set_success(false);
+            response.set_retry(false);
+            LOG(ERROR) << "Out-of-range chunk index " << msg.chunk_idx()
+                       << " for download UUID " << msg.uuid();
+            stream->Write(response);
+            return Status::OK;
         }
 
-        if (bytesRead <= 0) {
+        if (bytesRead == 0) {
             // Read failed
             FileChunkResponse response;
             response.set_success(false);
@@ -575,74 +1657,217 @@ Status SocketServiceImpl::Service::downloadFileLoop(
     return Status::OK;
 }
 
+Status SocketServiceImpl::Service::streamFileDownload(
+    ServerContext* context,
+    ::grpc::ServerReaderWriter<FileChunkResponse, FileStreamRequest>* stream) {
+    const CallSlot slot(streamSlots_);
+    if (!slot) {
+        return {grpc::StatusCode::RESOURCE_EXHAUSTED,
+                "Too many streaming calls, try again later"};
+    }
+    FileStreamRequest msg;
+
+    LogWhoCalledMe(context, "streamFileDownload");
+    if (!stream->Read(&msg)) {
+        return Status::OK;
+    }
+    // Later messages only carry credit.
+    const std::string uuid = msg.uuid();
+    const auto fail = [stream](const bool retry) {
+        FileChunkResponse response;
+        response.set_success(false);
+        response.set_retry(retry);
+        stream->Write(response);
+        return Status::OK;
+    };
+
+    std::filesystem::path filePath;
+    std::uintmax_t totalSize = 0;
+    {
+        auto entry = findTransfer(uuid);
+        if (!entry || entry->isUpload) {
+            LOG(ERROR) << "Invalid UUID for file download stream: "
+                       << std::quoted(uuid);
+            return fail(false);
+        }
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        filePath = entry->filePath;
+        totalSize = entry->totalSize;
+    }
+    if (!transfer::streamStartValid(msg.start_offset(), totalSize)) {
+        LOG(ERROR) << "Start offset " << msg.start_offset()
+                   << " is out of range or not on a chunk boundary for "
+                      "download UUID "
+                   << uuid;
+        return fail(false);
+    }
+    TransferFile reader(filePath, TransferFile::Mode::READ);
+    if (!reader.is_open()) {
+        LOG(ERROR) << "Failed to open file for download stream: "
+                   << filePath.string();
+        return fail(true);
+    }
+
+    const auto limit = transfer::streamChunkLimit(msg.chunk_size());
+    transfer::AdaptiveChunkSize chunkSize(limit);
+    std::uint64_t credit =
+        msg.window() != 0 ? msg.window() : transfer::kDefaultStreamWindow;
+    std::uintmax_t offset = msg.start_offset();
+
+    // One response, and so one buffer, for the whole stream.
+    FileChunkResponse response;
+    response.set_success(true);
+    response.set_retry(false);
+    auto* chunk = response.mutable_chunk();
+    auto* buffer = chunk->mutable_chunk_data();
+    buffer->reserve(limit);
+
+    while (offset < totalSize) {
+        while (credit == 0) {
+            // Client finished or went away.
+            if (!stream->Read(&msg)) {
+                return Status::OK;
+            }
+            credit += msg.window();
+        }
+        const auto length = std::min(chunkSize.size(), totalSize - offset);
+        buffer->resize(length);
+        if (!reader.readAt(buffer->data(), length, offset)) {
+            LOG(ERROR) << "Read failed during file download stream: "
+                       << filePath.string();
+            return fail(true);
+        }
+        chunk->set_chunk_offset(static_cast<std::int64_t>(offset));
+        chunk->set_chunk_idx(
+            static_cast<std::int32_t>(offset / transfer::kChunkSize));
+
+        // Write() blocks while the client is behind on the transport's flow
+        // control, which is what the chunk size adapts to.
+        const auto start = std::chrono::steady_clock::now();
+        if (!stream->Write(response)) {
+            return Status::OK;
+        }
+        chunkSize.record(std::chrono::steady_clock::now() - start);
+        offset += length;
+        --credit;
+        LOG_EVERY_N_SEC(INFO, 10)
+            << "Streamed " << offset << "/" << totalSize
+            << " bytes for download UUID " << std::quoted(uuid);
+    }
+    return Status::OK;
+}
+
+// Counts an upload chunk in entry.writes while its stream works on it
+// without the lock, and relocks to release it, also when that work throws.
+class SocketServiceImpl::Service::UploadWrite {
+   public:
+    UploadWrite(TranferEntry& entry, std::unique_lock<std::mutex>& lock)
+        : entry_(entry), lock_(lock) {
+        ++entry_.writes;
+    }
+    ~UploadWrite() {
+        if (!lock_.owns_lock()) {
+            lock_.lock();
+        }
+        if (--entry_.writes == 0) {
+            entry_.writesDone.notify_all();
+        }
+    }
+    NO_COPY_CTOR(UploadWrite);
+
+   private:
+    TranferEntry& entry_;
+    std::unique_lock<std::mutex>& lock_;
+};
+
 Status SocketServiceImpl::Service::uploadFileLoop(
     ServerContext* context,
     ::grpc::ServerReaderWriter<FileChunkResponse, FileChunk>* stream) {
+    const CallSlot slot(streamSlots_);
+    if (!slot) {
+        return {grpc::StatusCode::RESOURCE_EXHAUSTED,
+                "Too many streaming calls, try again later"};
+    }
     FileChunk msg;
+    // Uploads this stream wrote to, saved once more when it ends.
+    std::map<std::string, std::shared_ptr<TranferEntry>> written;
 
     LogWhoCalledMe(context, "uploadFileLoop");
     while (stream->Read(&msg)) {
-        {
-            std::lock_guard<std::mutex> lock(activeTransfersMutex_);
-            auto it = activeTransfers_.find(msg.uuid());
-            if (it == activeTransfers_.end()) {
-                // Invalid UUID
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(false);
-                LOG(ERROR) << "Invalid UUID for file upload: "
+        FileChunkResponse response;
+        response.set_success(false);
+        response.set_retry(false);
+        auto cached = written.find(msg.uuid());
+        auto entry =
+            cached != written.end() ? cached->second : findUpload(msg.uuid());
+        if (!entry) {
+            LOG(ERROR) << "Invalid UUID for file upload: "
+                       << std::quoted(msg.uuid());
+        } else {
+            const auto offset =
+                static_cast<std::uintmax_t>(msg.chunk_offset());
+            const auto& data = msg.chunk_data();
+            std::unique_lock<std::mutex> lock(entry->mutex);
+            if (!entry->file) {
+                LOG(ERROR) << "Upload already ended: "
                            << std::quoted(msg.uuid());
-                stream->Write(response);
-                return Status::OK;
-            }
-            if (!transfer::uploadChunkInRange(msg.chunk_offset(),
-                                              msg.chunk_data().size(),
-                                              it->second.totalSize)) {
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(false);
+            } else if (!transfer::uploadChunkInRange(msg.chunk_offset(),
+                                                     data.size(),
+                                                     entry->totalSize)) {
                 LOG(ERROR) << "Invalid chunk range for upload UUID "
                            << std::quoted(msg.uuid());
-                stream->Write(response);
-                return Status::OK;
-            }
-
-            it->second.fileStream.seekp(msg.chunk_offset(), std::ios::beg);
-            if (!it->second.fileStream.good()) {
-                // Seek failed
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(true);
-                LOG(ERROR) << "Seek failed during file upload: "
-                           << msg.uuid();
-                stream->Write(response);
-                return Status::OK;
+            } else {
+                const UploadWrite pending(*entry, lock);
+                TransferFile& file = *entry->file;
+                // Written and hashed without the lock, so streams of one
+                // upload write in parallel and getUploadStatus doesn't wait.
+                lock.unlock();
+                const bool wrote =
+                    file.writeAt(data.data(), data.size(), offset);
+                lock.lock();
+                std::vector<UploadDigest::Block> blocks;
+                std::optional<UploadSessionState> state;
+                if (!wrote) {
+                    response.set_retry(true);
+                    LOG(ERROR) << "Write failed during file upload: "
+                               << msg.uuid();
+                } else {
+                    blocks = entry->digest->written(
+                        file, entry->coverage, data.data(), data.size(),
+                        offset);
+                    if (std::chrono::steady_clock::now() - entry->savedAt >=
+                        kUploadStateInterval) {
+                        state = uploadState(*entry);
+                    }
+                    written.try_emplace(msg.uuid(), entry);
+                    response.set_success(true);
+                }
+                if (!blocks.empty() || state) {
+                    lock.unlock();
+                    const auto hashes = entry->digest->hash(file, blocks);
+                    if (state) {
+                        saveUploadState(*entry, *state);
+                    }
+                    lock.lock();
+                    entry->digest->store(hashes);
+                }
             }
-            it->second.fileStream.write(msg.chunk_data().data(),
-                                        msg.chunk_data().size());
-            if (!it->second.fileStream.good()) {
-                // Write failed
-                FileChunkResponse response;
-                response.set_success(false);
-                response.set_retry(true);
-                LOG(ERROR) << "Write failed during file upload: "
-                           << msg.uuid();
-                stream->Write(response);
-                return Status::OK;
-            }
-            it->second.coverage.add(
-                static_cast<std::uintmax_t>(msg.chunk_offset()),
-                msg.chunk_data().size());
         }
-        // Send success response
-        FileChunkResponse response;
-        response.set_success(true);
-        response.set_retry(false);
         stream->Write(response);
+        if (!response.success()) {
+            break;
+        }
         LOG_EVERY_N_SEC(INFO, 10)
             << "Received chunk " << msg.chunk_idx() << " for upload UUID "
             << std::quoted(msg.uuid());
     }
+
+    for (const auto& [uuid, entry] : written) {
+        std::lock_guard<std::mutex> lock(entry->mutex);
+        if (entry->file) {
+            saveUploadState(*entry);
+        }
+    }
     return Status::OK;
 }
 
@@ -650,17 +1875,36 @@ Status SocketServiceImpl::Service::endFileTransfer(
     ServerContext* context, const FileTransferRequest* request,
     GenericResponse* response) {
     LogWhoCalledMe(context, "endFileTransfer");
-    std::lock_guard<std::mutex> lock(activeTransfersMutex_);
-    auto it = activeTransfers_.find(request->uuid());
-    if (it == activeTransfers_.end()) {
+    auto found = request->is_upload() ? findUpload(request->uuid())
+                                      : findTransfer(request->uuid());
+    std::unique_lock<std::mutex> lock;
+    if (found) {
+        lock = std::unique_lock(found->mutex);
+        // Chunks written meanwhile still use the file, and may complete the
+        // upload.
+        found->writesDone.wait(lock, [&found] { return found->writes == 0; });
+    }
+    if (!found || !found->file) {
         response->set_code(GenericResponseCode::ErrorCommandIgnored);
         response->set_message("Invalid UUID for ending file transfer");
         LOG(ERROR) << "Invalid UUID for ending file transfer: "
                    << request->uuid();
         return Status::OK;
     }
-    TranferEntry& entry = it->second;
-    entry.fileStream.close();
+    TranferEntry& entry = *found;
+    // Ends an upload for good, also for streams still holding it.
+    const auto dropUpload = [this, &entry, request] {
+        entry.file.reset();
+        removeUploadFiles(entry);
+        eraseTransfer(request->uuid());
+    };
+    if (request->is_upload() && request->abort_upload()) {
+        dropUpload();
+        response->set_code(GenericResponseCode::Success);
+        response->set_message("Upload aborted");
+        LOG(INFO) << "Upload aborted: " << request->uuid();
+        return Status::OK;
+    }
     if (request->is_upload()) {
         if (request->file_path() != entry.destinationPath) {
             response->set_code(GenericResponseCode::ErrorInvalidArgument);
@@ -670,28 +1914,27 @@ Status SocketServiceImpl::Service::endFileTransfer(
                        << request->uuid() << ": expected "
                        << entry.destinationPath.string() << ", got "
                        << request->file_path();
-            std::filesystem::remove(entry.filePath);
-            activeTransfers_.erase(it);
+            dropUpload();
             return Status::OK;
         }
         if (!entry.coverage.complete()) {
+            // Keep the session, so the client can send what is missing.
             response->set_code(GenericResponseCode::ErrorInvalidArgument);
-            response->set_message("Upload is incomplete");
+            response->set_message(
+                "Upload is incomplete, see getUploadStatus for missing ranges");
             LOG(ERROR) << "Incomplete upload for UUID " << request->uuid()
                        << ": received " << entry.coverage.coveredBytes()
                        << " of " << entry.totalSize << " bytes";
-            std::filesystem::remove(entry.filePath);
-            activeTransfers_.erase(it);
             return Status::OK;
         }
+        const auto digest = entry.digest->finish(*entry.file);
+        entry.file.reset();
         if (entry.checksumAlgorithm != ChecksumAlgorithm::None &&
-            !verify_file_checksum(entry.filePath, entry.checksumAlgorithm,
-                                  entry.checksum)) {
+            (!digest || !checksum_matches(*digest, entry.checksum))) {
             response->set_code(GenericResponseCode::ErrorInvalidArgument);
             response->set_message("Checksum mismatch");
             LOG(ERROR) << "Checksum mismatch for upload: " << request->uuid();
-            std::filesystem::remove(entry.filePath);
-            activeTransfers_.erase(it);
+            dropUpload();
             return Status::OK;
         }
         // Enforce no-overwrite at finalize time as well: the existence check in
@@ -706,8 +1949,7 @@ Status SocketServiceImpl::Service::endFileTransfer(
                 response->set_message("Destination already exists");
                 LOG(ERROR) << "Destination already exists for upload: "
                            << entry.destinationPath.string();
-                std::filesystem::remove(entry.filePath, existsEc);
-                activeTransfers_.erase(it);
+                dropUpload();
                 return Status::OK;
             }
         }
@@ -734,6 +1976,7 @@ Status SocketServiceImpl::Service::endFileTransfer(
                     "Failed to move uploaded file", entry.filePath,
                     entry.destinationPath, moveEc);
             }
+            removeUploadFiles(entry);
             LOG(INFO) << "File uploaded successfully to: "
                       << entry.destinationPath.string();
         } catch (const std::filesystem::filesystem_error& e) {
@@ -742,19 +1985,45 @@ Status SocketServiceImpl::Service::endFileTransfer(
                 fmt::format("Failed to move uploaded file: {}", e.what()));
             LOG(ERROR) << "Failed to move uploaded file: " << e.what();
             // Clean up temporary file
-            std::filesystem::remove(entry.filePath);
-            activeTransfers_.erase(it);
+            dropUpload();
             return Status::OK;
         }
     }
     // Remove from active transfers
-    activeTransfers_.erase(it);
+    entry.file.reset();
+    eraseTransfer(request->uuid());
     response->set_code(GenericResponseCode::Success);
     response->set_message("File transfer ended successfully");
     LOG(INFO) << "File transfer ended successfully: " << request->uuid();
     return Status::OK;
 }
 
+Status SocketServiceImpl::Service::getUploadStatus(
+    ServerContext* context, const FileTransferRequest* request,
+    UploadStatus* response) {
+    LogWhoCalledMe(context, "getUploadStatus");
+    auto entry = findUpload(request->uuid());
+    if (!entry) {
+        response->set_found(false);
+        return Status::OK;
+    }
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (!entry->file) {
+        response->set_found(false);
+        return Status::OK;
+    }
+    const auto& coverage = entry->coverage;
+    response->set_found(true);
+    response->set_file_size(coverage.totalSize());
+    response->set_received_bytes(coverage.coveredBytes());
+    for (const auto& [begin, end] : coverage.missing()) {
+        auto* range = response->add_missing();
+        range->set_offset(begin);
+        range->set_length(end - begin);
+    }
+    return Status::OK;
+}
+
 Status SocketServiceImpl::Service::ping(
     ServerContext* context, const ::google::protobuf::Empty* /*request*/,
     ::google::protobuf::Empty* /*response*/) {
@@ -787,6 +2056,36 @@ Status SocketServiceImpl::Service::info(
     uptime->set_hours(static_cast<int32_t>(hms.hours().count()));
     uptime->set_days(static_cast<int32_t>(
         std::chrono::duration_cast<std::chrono::days>(uptimeDuration).count()));
+
+    if (const auto* metrics = database_->metrics(); metrics != nullptr) {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        for (const auto& stats : metrics->snapshot()) {
+            auto* entry = response->add_database_operations();
+            entry->set_operation(
+                std::string(DatabaseMetrics::name(stats.operation)));
+            entry->set_calls(stats.calls);
+            entry->set_slow_calls(stats.slowCalls);
+            entry->set_total_latency_us(
+                duration_cast<microseconds>(stats.latency).count());
+            entry->set_total_lock_wait_us(
+                duration_cast<microseconds>(stats.lockWait).count());
+            entry->set_rows_scanned(stats.rowsScanned);
+            entry->mutable_latency_buckets()->Add(stats.latencyBuckets.begin(),
+                                                  stats.latencyBuckets.end());
+            entry->mutable_lock_wait_buckets()->Add(
+                stats.lockWaitBuckets.begin(), stats.lockWaitBuckets.end());
+        }
+    }
+
+    for (const auto& stats : api_->callbackQueryStats()) {
+        auto* entry = response->add_callback_handlers();
+        entry->set_command(stats.command);
+        entry->set_data_prefix(stats.dataPrefix);
+        entry->set_calls(stats.calls);
+        entry->set_average_latency_us(stats.average.count());
+        entry->set_max_latency_us(stats.max.count());
+    }
     return Status::OK;
 }
 
@@ -948,6 +2247,9 @@ struct SocketServiceImpl::Impl {
 
 void SocketServiceImpl::runFunction(const std::stop_token& token) {
     grpc::ServerBuilder builder;
+    grpc::ResourceQuota quota("SocketService");
+    quota.SetMaxThreads(kMaxServerThreads);
+    builder.SetResourceQuota(quota);
     builder.AddListeningPort(url_->url, grpc::InsecureServerCredentials());
     builder.RegisterService(service_.get());
     impl_->server = builder.BuildAndStart();
@@ -0,0 +1,208 @@
+#include <absl/log/log.h>
+#include <fmt/format.h>
+#include <grpcpp/grpcpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "Socket_service.grpc.pb.h"
+
+// Measures the aggregate throughput of 1, 2, 4, ... transfers running at
+// once against a SocketService, each its own session and stream, the way
+// separate clients would. Downloads fetch one file on the server chunk by
+// chunk through downloadFileLoop. Uploads send generated data through
+// uploadFileLoop to transfer_bench_<n> files in a directory on the server,
+// which are left behind.
+//
+// Usage: SocketTransferBench <dest> download <remote_file> [max_transfers]
+//        SocketTransferBench <dest> upload <remote_dir> [size_mb]
+//                                          [max_transfers]
+
+namespace {
+
+using namespace tgbot::proto::socket;
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned int kDefaultMaxTransfers = 8;
+constexpr std::uint64_t kDefaultUploadMb = 64;
+constexpr std::size_t kChunkSize = 64 * 1024;
+
+bool parse(const char* text, auto* value) {
+    const std::string_view view(text);
+    const auto [end, ec] =
+        std::from_chars(view.data(), view.data() + view.size(), *value);
+    return ec == std::errc() && end == view.data() + view.size() &&
+           *value > 0;
+}
+
+// Bytes moved by one download of `path`, or 0 if it failed.
+std::uint64_t download(SocketService::Stub& stub, const std::string& path) {
+    FileTransferResponse accepted;
+    {
+        grpc::ClientContext context;
+        FileTransferRequest request;
+        request.set_file_path(path);
+        request.set_is_upload(false);
+        if (!stub.requestFileTransfer(&context, request, &accepted).ok() ||
+            !accepted.accepted()) {
+            return 0;
+        }
+    }
+    std::uint64_t bytes = 0;
+    {
+        grpc::ClientContext context;
+        auto stream = stub.downloadFileLoop(&context);
+        FileChunkRequest request;
+        request.set_uuid(accepted.uuid());
+        FileChunkResponse response;
+        for (int i = 0; i < accepted.chunk_count(); ++i) {
+            request.set_chunk_idx(i);
+            if (!stream->Write(request) || !stream->Read(&response) ||
+                !response.success()) {
+                bytes = 0;
+                break;
+            }
+            bytes += response.chunk().chunk_data().size();
+        }
+        stream->WritesDone();
+        (void)stream->Finish();
+    }
+    grpc::ClientContext context;
+    FileTransferRequest request;
+    GenericResponse response;
+    request.set_uuid(accepted.uuid());
+    (void)stub.endFileTransfer(&context, request, &response);
+    return bytes;
+}
+
+// Bytes moved by one upload of `data` to `path`, or 0 if it failed.
+std::uint64_t upload(SocketService::Stub& stub, const std::string& path,
+                     const std::string& data) {
+    FileTransferResponse accepted;
+    {
+        grpc::ClientContext context;
+        FileTransferRequest request;
+        request.set_file_path(path);
+        request.set_is_upload(true);
+        request.set_overwrite_existing(true);
+        request.set_file_size(data.size());
+        if (!stub.requestFileTransfer(&context, request, &accepted).ok() ||
+            !accepted.accepted()) {
+            return 0;
+        }
+    }
+    bool sent = true;
+    {
+        grpc::ClientContext context;
+        auto stream = stub.uploadFileLoop(&context);
+        FileChunk chunk;
+        chunk.set_uuid(accepted.uuid());
+        FileChunkResponse response;
+        for (std::size_t offset = 0; offset < data.size() && sent;
+             offset += kChunkSize) {
+            chunk.set_chunk_idx(static_cast<std::int32_t>(offset / kChunkSize));
+            chunk.set_chunk_offset(static_cast<std::int64_t>(offset));
+            chunk.set_chunk_data(data.substr(offset, kChunkSize));
+            sent = stream->Write(chunk) && stream->Read(&response) &&
+                   response.success();
+        }
+        stream->WritesDone();
+        (void)stream->Finish();
+    }
+    grpc::ClientContext context;
+    FileTransferRequest request;
+    GenericResponse response;
+    request.set_uuid(accepted.uuid());
+    request.set_file_path(path);
+    request.set_is_upload(true);
+    if (!stub.endFileTransfer(&context, request, &response).ok() ||
+        response.code() != GenericResponseCode::Success) {
+        sent = false;
+    }
+    return sent ? data.size() : 0;
+}
+
+// Runs `transfer(n)` on `count` threads at once and prints the aggregate
+// throughput.
+template <typename Transfer>
+void measure(const std::string_view name, const unsigned int count,
+             Transfer&& transfer) {
+    std::atomic<std::uint64_t> bytes = 0;
+    std::atomic<unsigned int> failed = 0;
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    const auto start = Clock::now();
+    for (unsigned int n = 0; n < count; ++n) {
+        threads.emplace_back([&, n] {
+            const auto moved = transfer(n);
+            bytes += moved;
+            if (moved == 0) {
+                ++failed;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    fmt::print("{:<8} {:>2} transfers {:>10.1f} MB/s ({} failed)\n", name,
+               count, static_cast<double>(bytes) / elapsed.count() / 1e6,
+               failed.load());
+}
+
+}  // namespace
+
+int app_main(int argc, char** argv) {
+    const std::string_view mode = argc > 2 ? argv[2] : "";
+    const bool isUpload = mode == "upload";
+    const int maxArg = isUpload ? 5 : 4;
+    unsigned int maxTransfers = kDefaultMaxTransfers;
+    std::uint64_t sizeMb = kDefaultUploadMb;
+    if (argc < 4 || (mode != "download" && !isUpload) ||
+        (isUpload && argc > 4 && !parse(argv[4], &sizeMb)) ||
+        (argc > maxArg && !parse(argv[maxArg], &maxTransfers))) {
+        LOG(ERROR) << "Usage: " << argv[0]
+                   << " <dest> download <remote_file> [max_transfers]\n"
+                   << "       " << argv[0]
+                   << " <dest> upload <remote_dir> [size_mb] [max_transfers]";
+        return EXIT_FAILURE;
+    }
+
+    auto stub = SocketService::NewStub(
+        grpc::CreateChannel(argv[1], grpc::InsecureChannelCredentials()));
+    const std::string target = argv[3];
+
+    std::string data;
+    if (isUpload) {
+        data.resize(sizeMb * 1024 * 1024);
+        std::mt19937 random(std::random_device{}());
+        std::ranges::generate(data, [&random] {
+            return static_cast<char>(random());
+        });
+    }
+    for (unsigned int count = 1; count <= maxTransfers; count *= 2) {
+        if (isUpload) {
+            measure("upload", count, [&](const unsigned int n) {
+                return upload(*stub,
+                              fmt::format("{}/transfer_bench_{}", target, n),
+                              data);
+            });
+        } else {
+            measure("download", count, [&](const unsigned int /*n*/) {
+                return download(*stub, target);
+            });
+        }
+    }
+    return EXIT_SUCCESS;
+}
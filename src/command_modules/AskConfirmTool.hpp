@@ -52,9 +52,13 @@ struct PendingConfirmation {
 
 inline void queueCallbackAnswer(TgBotApi::Ptr api, std::string callbackId,
                                 std::string text = {}, bool alert = false) {
+    // Held until the answer ran, or the framework answers first as soon as
+    // the handler returns.
+    auto hold = api->holdCallbackAnswer(callbackId);
     if (!llm::outbound::post(
             api, [api, callbackId = std::move(callbackId),
-                  text = std::move(text), alert](std::stop_token stop) {
+                  text = std::move(text), alert,
+                  hold = std::move(hold)](std::stop_token stop) {
                 if (!stop.stop_requested()) {
                     api->answerCallbackQuery(callbackId, text, alert);
                 }
@@ -156,9 +160,10 @@ inline void handleCallback(TgBotApi::Ptr api,
 inline void ensureListenerRegistered(TgBotApi::Ptr api) {
     static std::once_flag flag;
     std::call_once(flag, [api] {
-        api->onCallbackQuery("ask", [api](TgBot::CallbackQuery::Ptr query) {
-            handleCallback(api, query);
-        });
+        api->onCallbackQuery("ask", std::string(kAskConfirmPrefix),
+                             [api](TgBot::CallbackQuery::Ptr query) {
+                                 handleCallback(api, query);
+                             });
     });
 }
 
@@ -111,9 +111,12 @@ inline TgBot::Message::Ptr resolveQueryMessage(
 inline void queueModelCallbackAnswer(TgBotApi::Ptr api, std::string callbackId,
                                      std::string text = {},
                                      bool alert = false) {
+    // Held until the answer ran, see queueCallbackAnswer().
+    auto hold = api->holdCallbackAnswer(callbackId);
     if (!llm::outbound::post(
             api, [api, callbackId = std::move(callbackId),
-                  text = std::move(text), alert](std::stop_token stop) {
+                  text = std::move(text), alert,
+                  hold = std::move(hold)](std::stop_token stop) {
                 if (!stop.stop_requested()) {
                     api->answerCallbackQuery(callbackId, text, alert);
                 }
@@ -145,96 +148,104 @@ inline void queueModelPickerEdit(
 inline void ensureListenerRegistered(TgBotApi::Ptr api) {
     static std::once_flag flag;
     std::call_once(flag, [api] {
-        api->onCallbackQuery("ask", [api](TgBot::CallbackQuery::Ptr query) {
-            std::string_view data = query->data;
-            if (!absl::ConsumePrefix(&data, kCallbackPrefix)) {
-                return;  // Not one of ours.
-            }
-            auto msg = resolveQueryMessage(query);
-            if (!msg) {
-                LOG(WARNING) << "Model picker callback on an inaccessible "
-                                "message; ignoring.";
-                return;
-            }
-            const ChatId chatId = msg->chat->id;
-
-            const auto generationEnd = data.find(':');
-            if (generationEnd == std::string_view::npos) {
-                queueModelCallbackAnswer(api, query->id,
-                                         "Invalid model picker.", true);
-                return;
-            }
-            const std::string generation(data.substr(0, generationEnd));
-            data.remove_prefix(generationEnd + 1);
-
-            ModelPickerState state;
-            {
-                auto [mtx, map] = modelPickerStore();
-                const std::lock_guard lock(mtx);
-                auto it = map.find(chatId);
-                if (it == map.end() || it->second.generation != generation ||
-                    std::chrono::steady_clock::now() >= it->second.expiresAt) {
-                    if (it != map.end() && std::chrono::steady_clock::now() >=
-                                               it->second.expiresAt) {
-                        map.erase(it);
-                    }
-                    queueModelCallbackAnswer(
-                        api, query->id, "This model picker has expired.", true);
+        api->onCallbackQuery(
+            "ask", std::string(kCallbackPrefix),
+            [api](TgBot::CallbackQuery::Ptr query) {
+                std::string_view data = query->data;
+                if (!absl::ConsumePrefix(&data, kCallbackPrefix)) {
+                    return;  // Not one of ours.
+                }
+                auto msg = resolveQueryMessage(query);
+                if (!msg) {
+                    LOG(WARNING) << "Model picker callback on an inaccessible "
+                                    "message; ignoring.";
                     return;
                 }
-                state = it->second;
-            }
-            if (!query->from || query->from->id != state.initiatingUserId) {
-                queueModelCallbackAnswer(
-                    api, query->id,
-                    "Only the user who opened this picker can use it.", true);
-                return;
-            }
+                const ChatId chatId = msg->chat->id;
 
-            if (absl::ConsumePrefix(&data, "s:")) {
-                std::size_t index = 0;
-                if (!absl::SimpleAtoi(data, &index) ||
-                    index >= state.modelIds.size()) {
+                const auto generationEnd = data.find(':');
+                if (generationEnd == std::string_view::npos) {
                     queueModelCallbackAnswer(api, query->id,
-                                             "Invalid selection.", true);
+                                             "Invalid model picker.", true);
                     return;
                 }
-                setSelectedModel(chatId, state.modelIds[index]);
-                queueModelPickerEdit(
-                    api, msg,
-                    fmt::format("Selected model: {}", state.modelIds[index]));
+                const std::string generation(data.substr(0, generationEnd));
+                data.remove_prefix(generationEnd + 1);
+
+                ModelPickerState state;
                 {
                     auto [mtx, map] = modelPickerStore();
                     const std::lock_guard lock(mtx);
-                    if (auto it = map.find(chatId);
-                        it != map.end() &&
-                        it->second.generation == generation) {
-                        map.erase(it);
+                    auto it = map.find(chatId);
+                    if (it == map.end() ||
+                        it->second.generation != generation ||
+                        std::chrono::steady_clock::now() >=
+                            it->second.expiresAt) {
+                        if (it != map.end() &&
+                            std::chrono::steady_clock::now() >=
+                                it->second.expiresAt) {
+                            map.erase(it);
+                        }
+                        queueModelCallbackAnswer(
+                            api, query->id, "This model picker has expired.",
+                            true);
+                        return;
                     }
+                    state = it->second;
                 }
-                queueModelCallbackAnswer(api, query->id, "Model selected.");
-            } else if (absl::ConsumePrefix(&data, "p:")) {
-                std::size_t page = 0;
-                if (!absl::SimpleAtoi(data, &page)) {
-                    queueModelCallbackAnswer(api, query->id, "Invalid page.",
-                                             true);
+                if (!query->from || query->from->id != state.initiatingUserId) {
+                    queueModelCallbackAnswer(
+                        api, query->id,
+                        "Only the user who opened this picker can use it.",
+                        true);
                     return;
                 }
-                {
-                    auto [mtx, map] = modelPickerStore();
-                    const std::lock_guard lock(mtx);
-                    if (auto it = map.find(chatId);
-                        it != map.end() &&
-                        it->second.generation == generation) {
-                        it->second.page = page;
+
+                if (absl::ConsumePrefix(&data, "s:")) {
+                    std::size_t index = 0;
+                    if (!absl::SimpleAtoi(data, &index) ||
+                        index >= state.modelIds.size()) {
+                        queueModelCallbackAnswer(api, query->id,
+                                                 "Invalid selection.", true);
+                        return;
+                    }
+                    setSelectedModel(chatId, state.modelIds[index]);
+                    queueModelPickerEdit(
+                        api, msg,
+                        fmt::format("Selected model: {}",
+                                    state.modelIds[index]));
+                    {
+                        auto [mtx, map] = modelPickerStore();
+                        const std::lock_guard lock(mtx);
+                        if (auto it = map.find(chatId);
+                            it != map.end() &&
+                            it->second.generation == generation) {
+                            map.erase(it);
+                        }
+                    }
+                    queueModelCallbackAnswer(api, query->id, "Model selected.");
+                } else if (absl::ConsumePrefix(&data, "p:")) {
+                    std::size_t page = 0;
+                    if (!absl::SimpleAtoi(data, &page)) {
+                        queueModelCallbackAnswer(api, query->id,
+                                                 "Invalid page.", true);
+                        return;
+                    }
+                    {
+                        auto [mtx, map] = modelPickerStore();
+                        const std::lock_guard lock(mtx);
+                        if (auto it = map.find(chatId);
+                            it != map.end() &&
+                            it->second.generation == generation) {
+                            it->second.page = page;
+                        }
                     }
+                    queueModelPickerEdit(
+                        api, msg, msg->text.value_or(""),
+                        buildModelPage(state.modelIds, page, generation));
+                    queueModelCallbackAnswer(api, query->id);
                 }
-                queueModelPickerEdit(
-                    api, msg, msg->text.value_or(""),
-                    buildModelPage(state.modelIds, page, generation));
-                queueModelCallbackAnswer(api, query->id);
-            }
-        });
+            });
     });
 }
 
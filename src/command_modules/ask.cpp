@@ -13,9 +13,12 @@
 #include <api/StringResLoader.hpp>
 #include <api/TgBotApi.hpp>
 #include <chrono>
+#include <database/AsyncDatabase.hpp>
 #include <database/DatabaseBase.hpp>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stop_token>
 #include <string>
 #include <string_view>
@@ -261,14 +264,43 @@ bool isBuilderDomain(llm::tool_router::Domain domain) {
            domain == Domain::Build || domain == Domain::All;
 }
 
-llm::ToolExecutor makeSaveChatInfoExecutor(const Providers* provider) {
-    return [provider](const std::string& /*name*/, const nlohmann::json& input,
-                      bool& isError) -> std::string {
+// Waits for a queued database write, giving up when the request is cancelled.
+std::optional<DatabaseBase::AddResult> awaitWrite(
+    std::future<DatabaseBase::AddResult> result,
+    const std::stop_token& cancellation) {
+    while (result.wait_for(std::chrono::milliseconds(50)) !=
+           std::future_status::ready) {
+        if (cancellation.stop_requested()) {
+            return std::nullopt;
+        }
+    }
+    return result.get();
+}
+
+llm::ToolExecutor makeSaveChatInfoExecutor(const Providers* provider,
+                                           std::stop_token cancellation) {
+    return [provider, cancellation](const std::string& /*name*/,
+                                    const nlohmann::json& input,
+                                    bool& isError) -> std::string {
         isError = false;
         try {
             const auto chatId = input.at("chat_id").get<ChatId>();
             const auto chatName = input.at("name").get<std::string>();
-            switch (provider->database->addChatInfo(chatId, chatName)) {
+            const auto* database = provider->database.get();
+            std::optional<DatabaseBase::AddResult> added;
+            if (auto* const queue = database->async()) {
+                // Through the queue, so a cancelled request stops waiting on
+                // the commit; the write itself still lands.
+                added = awaitWrite(queue->addChatInfo(chatId, chatName),
+                                   cancellation);
+            } else {
+                added = database->addChatInfo(chatId, chatName);
+            }
+            if (!added) {
+                isError = true;
+                return "Cancelled before the save was confirmed.";
+            }
+            switch (*added) {
                 case DatabaseBase::AddResult::OK:
                     return fmt::format("Saved: {} -> \"{}\".", chatId,
                                        chatName);
@@ -308,7 +340,7 @@ llm::ToolExecutor makeCombinedExecutor(
         cancellation);
     auto getChatId = makeGetChatIdExecutor(provider);
     auto getChatName = makeGetChatNameExecutor(provider);
-    auto saveChatInfo = makeSaveChatInfoExecutor(provider);
+    auto saveChatInfo = makeSaveChatInfoExecutor(provider, cancellation);
     auto launchBuilder =
         llm::builder_launch::makeExecutor(api, std::move(sourceMessage));
     llm::ToolExecutor dispatch =
@@ -12,7 +12,9 @@
 #include <api/StringResLoader.hpp>
 #include <api/TgBotApi.hpp>
 #include <chrono>
+#include <database/AsyncDatabase.hpp>
 #include <database/bot/TgBotDatabaseImpl.hpp>
+#include <future>
 #include <memory>
 #include <optional>
 #include <string>
@@ -225,23 +227,47 @@ DECLARE_COMMAND_HANDLER(saveid) {
     info.names = message->get<MessageAttrs::ParsedArgumentsList>();
     info.mediaType = type;
 
-    switch (provider->database->addMediaInfo(info)) {
-        case DatabaseBase::AddResult::OK: {
-            const auto content =
-                fmt::format(fmt::runtime(res->get(Strings::DB_MEDIA_ADDED)),
-                            fmt::join(info.names, "\n"));
-            api->sendReplyMessage(message->message(), content);
-            break;
-        }
-        case DatabaseBase::AddResult::ALREADY_EXISTS:
-
-            api->sendReplyMessage(message->message(),
-                                  res->get(Strings::MEDIA_ALREADY_IN_DB));
-            break;
-        case DatabaseBase::AddResult::BACKEND_ERROR:
-            api->sendReplyMessage(message->message(),
-                                  res->get(Strings::BACKEND_ERROR));
-            break;
+    // Don't hold the command worker while the write commits; the reply
+    // waits for it on the outbound lane instead.
+    const auto* database = provider->database.get();
+    std::shared_future<DatabaseBase::AddResult> result;
+    if (auto* const queue = database->async()) {
+        result = queue->addMediaInfo(info).share();
+    } else {
+        result = std::async(std::launch::deferred, [database, info] {
+                     return database->addMediaInfo(info);
+                 }).share();
+    }
+    const auto source = message->message();
+    if (!api->submitCommandWork(
+            "saveid", TgBotApi::WorkClass::Outbound,
+            [api, res, source, result, names = std::move(info.names)](
+                std::stop_token stop) {
+                const auto added = result.get();
+                if (stop.stop_requested()) {
+                    return;
+                }
+                switch (added) {
+                    case DatabaseBase::AddResult::OK:
+                        api->sendReplyMessage(
+                            source,
+                            fmt::format(fmt::runtime(
+                                            res->get(Strings::DB_MEDIA_ADDED)),
+                                        fmt::join(names, "\n")));
+                        break;
+                    case DatabaseBase::AddResult::ALREADY_EXISTS:
+                        api->sendReplyMessage(
+                            source, res->get(Strings::MEDIA_ALREADY_IN_DB));
+                        break;
+                    case DatabaseBase::AddResult::BACKEND_ERROR:
+                        api->sendReplyMessage(source,
+                                              res->get(Strings::BACKEND_ERROR));
+                        break;
+                }
+            })) {
+        LOG(WARNING) << "saveid reply queue is full";
+        // No reply then, but the media is still saved.
+        result.wait();
     }
 }
 
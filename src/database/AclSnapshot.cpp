@@ -0,0 +1,64 @@
+#include "AclSnapshot.hpp"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+// std::atomic<std::shared_ptr> is not available on every standard library we
+// build with, so go through the shared_ptr atomic access functions.
+std::shared_ptr<const AclSnapshot::Data> AclSnapshot::load() const {
+    return std::atomic_load_explicit(&current_, std::memory_order_acquire);
+}
+
+void AclSnapshot::store(std::shared_ptr<const Data> data) {
+    std::atomic_store_explicit(&current_, std::move(data),
+                               std::memory_order_release);
+}
+
+void AclSnapshot::publish(std::vector<Entry> entries,
+                          std::optional<UserId> owner) {
+    std::ranges::sort(entries, {}, &Entry::user);
+    const auto duplicate =
+        std::ranges::adjacent_find(entries, {}, &Entry::user);
+    if (duplicate != entries.end()) {
+        LOG(WARNING) << "User " << duplicate->user
+                     << " is recorded in more than one list";
+    }
+    auto data = std::make_shared<Data>();
+    data->entries = std::move(entries);
+    data->owner = owner;
+    store(std::move(data));
+}
+
+void AclSnapshot::clear() { store(nullptr); }
+
+bool AclSnapshot::available() const { return load() != nullptr; }
+
+std::optional<DatabaseBase::ListResult> AclSnapshot::check(
+    const DatabaseBase::ListType type, const UserId user) const {
+    const auto data = load();
+    if (!data) {
+        return std::nullopt;
+    }
+    const auto it =
+        std::ranges::lower_bound(data->entries, user, {}, &Entry::user);
+    if (it == data->entries.end() || it->user != user) {
+        return DatabaseBase::ListResult::NOT_IN_LIST;
+    }
+    const auto wanted = type == DatabaseBase::ListType::WHITELIST
+                            ? Membership::WHITELIST
+                            : Membership::BLACKLIST;
+    return it->membership == wanted
+               ? DatabaseBase::ListResult::OK
+               : DatabaseBase::ListResult::ALREADY_IN_OTHER_LIST;
+}
+
+std::optional<UserId> AclSnapshot::owner() const {
+    const auto data = load();
+    if (!data) {
+        return std::nullopt;
+    }
+    return data->owner;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <DBImplExports.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "DatabaseBase.hpp"
+
+/**
+ * Immutable copy of a database's access lists, published by the backend
+ * after every load and list/owner mutation. Readers take a reference to
+ * the current snapshot and search it without touching the backend or its
+ * lock, which keeps AuthContext off the database on every command.
+ */
+class DBIMPL_EXPORT AclSnapshot {
+   public:
+    // What a user is recorded as. Backends that store the owner as a list
+    // member (SQLite) publish an OWNER entry so checks report it as being
+    // in another list, exactly like the backend query did.
+    enum class Membership : uint8_t { WHITELIST, BLACKLIST, OWNER };
+
+    struct Entry {
+        UserId user;
+        Membership membership;
+    };
+
+    /**
+     * @brief Replace the published snapshot.
+     *
+     * @param entries list members, in any order. A user must appear once.
+     * @param owner the owner user id, if one is set.
+     */
+    void publish(std::vector<Entry> entries, std::optional<UserId> owner);
+
+    // Drop the snapshot, e.g. when the database is unloaded.
+    void clear();
+
+    // Whether a snapshot is currently published.
+    [[nodiscard]] bool available() const;
+
+    /**
+     * @brief Look up a user the way DatabaseBase::checkUserInList does.
+     *
+     * @return OK, NOT_IN_LIST or ALREADY_IN_OTHER_LIST, or std::nullopt if
+     * nothing is published.
+     */
+    [[nodiscard]] std::optional<DatabaseBase::ListResult> check(
+        DatabaseBase::ListType type, UserId user) const;
+
+    // The published owner, or std::nullopt if unset or nothing is published.
+    [[nodiscard]] std::optional<UserId> owner() const;
+
+   private:
+    struct Data {
+        // Sorted by user for binary search.
+        std::vector<Entry> entries;
+        std::optional<UserId> owner;
+    };
+
+    [[nodiscard]] std::shared_ptr<const Data> load() const;
+    void store(std::shared_ptr<const Data> data);
+
+    std::shared_ptr<const Data> current_;
+};
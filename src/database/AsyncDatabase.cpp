@@ -0,0 +1,201 @@
+#include "AsyncDatabase.hpp"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <exception>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A callback that fulfils the returned future.
+template <typename R>
+std::pair<std::future<R>, std::function<void(R)>> completion() {
+    auto promise = std::make_shared<std::promise<R>>();
+    auto future = promise->get_future();
+    return {std::move(future),
+            [promise](const R result) { promise->set_value(result); }};
+}
+
+}  // namespace
+
+AsyncDatabase::AsyncDatabase(const DatabaseBase* backend,
+                             const std::size_t maxGroupCommit)
+    : backend_(backend),
+      maxGroupCommit_(std::max<std::size_t>(maxGroupCommit, 1)),
+      worker_([this](std::stop_token stop) { run(std::move(stop)); }) {}
+
+AsyncDatabase::~AsyncDatabase() = default;
+
+std::future<AsyncDatabase::AddResult> AsyncDatabase::addChatInfo(
+    const ChatId chatId, std::string name) {
+    auto [future, done] = completion<AddResult>();
+    addChatInfo(chatId, std::move(name), std::move(done));
+    return std::move(future);
+}
+
+void AsyncDatabase::addChatInfo(const ChatId chatId, std::string name,
+                                std::function<void(AddResult)> done) {
+    enqueue(ChatWrite{{chatId, std::move(name)}, std::move(done)});
+}
+
+std::future<AsyncDatabase::AddResult> AsyncDatabase::addMediaInfo(
+    DatabaseBase::MediaInfo info) {
+    auto [future, done] = completion<AddResult>();
+    addMediaInfo(std::move(info), std::move(done));
+    return std::move(future);
+}
+
+void AsyncDatabase::addMediaInfo(DatabaseBase::MediaInfo info,
+                                 std::function<void(AddResult)> done) {
+    enqueue(MediaWrite{std::move(info), std::move(done)});
+}
+
+std::future<AsyncDatabase::ListResult> AsyncDatabase::addUserToList(
+    const ListType type, const UserId user) {
+    auto [future, done] = completion<ListResult>();
+    addUserToList(type, user, std::move(done));
+    return std::move(future);
+}
+
+void AsyncDatabase::addUserToList(const ListType type, const UserId user,
+                                  std::function<void(ListResult)> done) {
+    enqueue(UserWrite{type, user, std::move(done)});
+}
+
+void AsyncDatabase::drain() {
+    submit([](const DatabaseBase& /*backend*/) {}).wait();
+}
+
+AsyncDatabase::Stats AsyncDatabase::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void AsyncDatabase::enqueue(Operation operation) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.emplace_back(std::move(operation));
+    }
+    pending_.notify_one();
+}
+
+void AsyncDatabase::run(std::stop_token stop) {
+    std::deque<Operation> operations;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // Once stop is requested this stops waiting, but whatever is
+            // still queued is applied before the thread exits.
+            pending_.wait(lock, stop, [this] { return !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            operations.swap(queue_);
+        }
+        // Everything queued while the previous batch was committing is
+        // picked up here at once, which is what makes the group commit.
+        for (std::size_t next = 0; next < operations.size();) {
+            next = applyFrom(operations, next);
+        }
+        operations.clear();
+    }
+}
+
+std::size_t AsyncDatabase::applyFrom(std::deque<Operation>& operations,
+                                     const std::size_t begin) {
+    return std::visit(
+        [&]<typename T>(T& first) -> std::size_t {
+            if constexpr (std::is_same_v<T, Task>) {
+                first.run();
+                return begin + 1;
+            } else {
+                using Result = std::conditional_t<std::is_same_v<T, UserWrite>,
+                                                  ListResult, AddResult>;
+                std::size_t end = begin + 1;
+                while (end < operations.size() &&
+                       end - begin < maxGroupCommit_) {
+                    const auto* next = std::get_if<T>(&operations[end]);
+                    if (next == nullptr) {
+                        break;
+                    }
+                    if constexpr (std::is_same_v<T, UserWrite>) {
+                        if (next->type != first.type) {
+                            break;
+                        }
+                    }
+                    ++end;
+                }
+                const auto count = end - begin;
+
+                const auto valueOf = [](T& write) -> auto& {
+                    if constexpr (std::is_same_v<T, UserWrite>) {
+                        return write.user;
+                    } else {
+                        return write.value;
+                    }
+                };
+                using Value = std::remove_reference_t<decltype(valueOf(first))>;
+                std::vector<Value> values;
+                values.reserve(count);
+                for (auto i = begin; i < end; ++i) {
+                    values.emplace_back(
+                        std::move(valueOf(std::get<T>(operations[i]))));
+                }
+                // One result per value, all BACKEND_ERROR if the batch
+                // failed.
+                const auto commit = [&](const std::span<const Value> batch) {
+                    std::vector<Result> results;
+                    try {
+                        if constexpr (std::is_same_v<T, UserWrite>) {
+                            results =
+                                backend_->addUsersToList(first.type, batch);
+                        } else if constexpr (std::is_same_v<T, ChatWrite>) {
+                            results = backend_->addChatInfos(batch);
+                        } else {
+                            results = backend_->addMediaInfos(batch);
+                        }
+                    } catch (const std::exception& ex) {
+                        LOG(ERROR) << "Queued database write failed: "
+                                   << ex.what();
+                        results.clear();
+                    }
+                    if (results.size() != batch.size()) {
+                        results.assign(batch.size(), Result::BACKEND_ERROR);
+                    }
+                    return results;
+                };
+
+                auto results = commit(values);
+                std::size_t commits = 1;
+                if (count > 1 &&
+                    std::ranges::find(results, Result::BACKEND_ERROR) !=
+                        results.end()) {
+                    // A failed batch applies nothing, so one bad write would
+                    // fail the callers grouped with it. Alone, each gets its
+                    // own result.
+                    LOG(WARNING) << "Grouped database write of " << count
+                                 << " failed, retrying one by one";
+                    for (std::size_t i = 0; i < count; ++i) {
+                        results[i] = commit({&values[i], 1}).front();
+                    }
+                    commits += count;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.writes += count;
+                    stats_.commits += commits;
+                }
+                for (auto i = begin; i < end; ++i) {
+                    auto& done = std::get<T>(operations[i]).done;
+                    if (done) {
+                        done(results[i - begin]);
+                    }
+                }
+                return end;
+            }
+        },
+        operations[begin]);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <DBImplExports.h>
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <variant>
+
+#include "DatabaseBase.hpp"
+
+/**
+ * Runs database operations on a dedicated thread so callers only wait when
+ * they ask for the result.
+ *
+ * Operations run in submission order. Adds that are queued back to back are
+ * applied with one addChatInfos()/addMediaInfos()/addUsersToList() call, so
+ * a burst of writers shares one transaction (SQLite) or one journal fsync
+ * (ProtoDatabase) instead of paying for one each.
+ *
+ * Completion callbacks run on the database thread. They must not block on
+ * another future from the same AsyncDatabase.
+ */
+class DBIMPL_EXPORT AsyncDatabase {
+   public:
+    using AddResult = DatabaseBase::AddResult;
+    using ListResult = DatabaseBase::ListResult;
+    using ListType = DatabaseBase::ListType;
+
+    // Upper bound on how many queued adds go into one batch call.
+    static constexpr std::size_t kMaxGroupCommit = 256;
+
+    struct Stats {
+        // Adds completed, and the batch calls that applied them.
+        std::uint64_t writes;
+        std::uint64_t commits;
+    };
+
+    /**
+     * @param backend a loaded database. It must outlive this object.
+     * @param maxGroupCommit most adds applied by one batch call.
+     */
+    explicit AsyncDatabase(const DatabaseBase* backend,
+                           std::size_t maxGroupCommit = kMaxGroupCommit);
+
+    // Finishes everything already queued, then stops the thread.
+    ~AsyncDatabase();
+
+    NO_COPY_CTOR(AsyncDatabase);
+
+    std::future<AddResult> addChatInfo(ChatId chatId, std::string name);
+    void addChatInfo(ChatId chatId, std::string name,
+                     std::function<void(AddResult)> done);
+
+    std::future<AddResult> addMediaInfo(DatabaseBase::MediaInfo info);
+    void addMediaInfo(DatabaseBase::MediaInfo info,
+                      std::function<void(AddResult)> done);
+
+    std::future<ListResult> addUserToList(ListType type, UserId user);
+    void addUserToList(ListType type, UserId user,
+                       std::function<void(ListResult)> done);
+
+    /**
+     * @brief Run any other call on the database thread, in order with the
+     * queued writes.
+     *
+     * @param fn called with the backend. Exceptions it throws are stored in
+     * the returned future.
+     */
+    template <typename Fn>
+    auto submit(Fn fn)
+        -> std::future<std::invoke_result_t<Fn&, const DatabaseBase&>> {
+        using Result = std::invoke_result_t<Fn&, const DatabaseBase&>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(
+            [fn = std::move(fn), backend = backend_]() mutable {
+                return fn(*backend);
+            });
+        auto future = task->get_future();
+        enqueue(Task{[task] { (*task)(); }});
+        return future;
+    }
+
+    // Wait until everything queued before this call has completed.
+    void drain();
+
+    [[nodiscard]] Stats stats() const;
+
+   private:
+    template <typename T, typename R>
+    struct Write {
+        T value;
+        std::function<void(R)> done;
+    };
+    using ChatWrite = Write<DatabaseBase::ChatInfo, AddResult>;
+    using MediaWrite = Write<DatabaseBase::MediaInfo, AddResult>;
+    struct UserWrite {
+        ListType type;
+        UserId user;
+        std::function<void(ListResult)> done;
+    };
+    struct Task {
+        std::function<void()> run;
+    };
+    using Operation = std::variant<ChatWrite, MediaWrite, UserWrite, Task>;
+
+    void enqueue(Operation operation);
+    void run(std::stop_token stop);
+    // Applies the run of adds starting at begin and returns where it ended.
+    std::size_t applyFrom(std::deque<Operation>& operations, std::size_t begin);
+
+    const DatabaseBase* backend_;
+    const std::size_t maxGroupCommit_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any pending_;
+    std::deque<Operation> queue_;
+    Stats stats_{};
+    // Declared last so the queue outlives the thread draining it.
+    std::jthread worker_;
+};
@@ -2,14 +2,23 @@
 
 #include <DBImplExports.h>
 
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <ostream>
+#include <span>
+#include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 #include "api/typedefs.h"
 
+class AsyncDatabase;
+class DatabaseMetrics;
+
 struct DBIMPL_EXPORT DatabaseBase {
     virtual ~DatabaseBase() = default;
 
@@ -81,6 +90,16 @@ struct DBIMPL_EXPORT DatabaseBase {
     [[nodiscard]] virtual ListResult checkUserInList(ListType type,
                                                      UserId user) const = 0;
 
+    /**
+     * @brief Get every user in a list
+     *
+     * @param type type of the list
+     * @return the users in the list, in no particular order. Empty if the
+     * backend failed.
+     */
+    [[nodiscard]] virtual std::vector<UserId> getUsersInList(
+        ListType type) const = 0;
+
     /**
      * @brief Load the database from a file.
      *
@@ -253,6 +272,81 @@ struct DBIMPL_EXPORT DatabaseBase {
      */
     [[nodiscard]] virtual std::vector<ChatInfo> getAllChatInfos() const = 0;
 
+    /**
+     * @brief Add several media infos at once
+     *
+     * @param infos the media infos to add
+     * @return one result per info, in the same order. An info whose unique
+     * id is already stored, or appears earlier in the batch, is skipped as
+     * ALREADY_EXISTS. If any info hits a backend error, nothing is applied
+     * and every result is BACKEND_ERROR.
+     *
+     * The default adds them one by one; backends override it to apply the
+     * whole batch in one transaction.
+     */
+    [[nodiscard]] virtual std::vector<AddResult> addMediaInfos(
+        std::span<const MediaInfo> infos) const;
+
+    /**
+     * @brief Add several chat infos at once
+     *
+     * @param chats the chat infos to add
+     * @return one result per chat, as for addMediaInfos().
+     */
+    [[nodiscard]] virtual std::vector<AddResult> addChatInfos(
+        std::span<const ChatInfo> chats) const;
+
+    /**
+     * @brief Add several users to a list at once
+     *
+     * @param type type of the list
+     * @param users users to add
+     * @return one result per user, with the values addUserToList() returns.
+     * If any user hits a backend error, nothing is applied and every result
+     * is BACKEND_ERROR.
+     */
+    [[nodiscard]] virtual std::vector<ListResult> addUsersToList(
+        ListType type, std::span<const UserId> users) const;
+
+    /**
+     * @brief Visit every media info without collecting them into a vector
+     *
+     * @param visitor called once per media info. Return false to stop.
+     * It runs while the backend holds its read lock and must not call back
+     * into the database.
+     */
+    virtual void forEachMediaInfo(
+        const std::function<bool(const MediaInfo&)>& visitor) const;
+
+    // One media found by searchMedia(), with the alias it matched best by.
+    struct MediaMatch {
+        std::string alias;
+        std::string mediaId;
+        std::string mediaUniqueId;
+        MediaType mediaType;
+        // In (0, 1], where 1 is an exact match.
+        float score;
+    };
+
+    // Telegram shows at most this many inline query results.
+    static constexpr std::size_t kMediaSearchLimit = 50;
+
+    /**
+     * @brief Find media by aliases close to what the user typed
+     *
+     * Matching ignores ASCII case. Exact matches rank first, then aliases
+     * starting with the query, then aliases containing it, then aliases
+     * sharing enough trigrams with it to be a likely typo.
+     *
+     * @param query a possibly incomplete or misspelled alias.
+     * @param limit most matches to return.
+     * @return at most one match per media, best first.
+     *
+     * The default scores every alias; backends override it with an index.
+     */
+    [[nodiscard]] virtual std::vector<MediaMatch> searchMedia(
+        std::string_view query, std::size_t limit) const;
+
     /**
      * @brief Dump the database to the specified output stream.
      *
@@ -266,6 +360,68 @@ struct DBIMPL_EXPORT DatabaseBase {
      */
     virtual std::ostream& dump(std::ostream& out) const = 0;
 
+    // A user and the list it is in; std::nullopt marks the owner.
+    struct UserInfo {
+        UserId userId;
+        std::optional<ListType> list;
+    };
+
+    // One exported record. Media infos carry all of their names.
+    using DumpRow = std::variant<UserInfo, MediaInfo, ChatInfo>;
+
+    enum class DumpFormat : uint8_t {
+        // kind,id,unique_id,name,type with one line per user, media name
+        // and chat.
+        CSV,
+        // Length-delimited glider.proto.database.DumpRecord messages.
+        PROTOBUF
+    };
+
+    static constexpr std::size_t kDumpBatchRows = 512;
+
+    /**
+     * @brief Walk the owner, the user lists, media and chats in batches
+     *
+     * The sink is called with at most batchSize rows at a time and without
+     * any backend lock held, so queries keep running during a long export.
+     *
+     * @param sink receives each batch. Return false to stop.
+     * @param batchSize rows per batch. 0 is treated as 1.
+     * @return false on a backend error or if the sink stopped early.
+     *
+     * The default exports the owner, media and chats, as users cannot be
+     * enumerated through this interface.
+     */
+    [[nodiscard]] virtual bool exportRows(
+        const std::function<bool(std::span<const DumpRow>)>& sink,
+        std::size_t batchSize) const;
+
+    /**
+     * @brief Export the database in a machine-readable format
+     *
+     * Writes each batch from exportRows() as soon as it is formatted, so
+     * the whole export is never held in memory.
+     *
+     * @return false if the export failed or the format is unavailable.
+     */
+    [[nodiscard]] bool exportTo(std::ostream& out, DumpFormat format,
+                                std::size_t batchSize = kDumpBatchRows) const;
+
+    /**
+     * @brief Latency, lock wait and scan counters of the backend
+     *
+     * @return nullptr if the backend does not collect them.
+     */
+    [[nodiscard]] virtual DatabaseMetrics* metrics() const { return nullptr; }
+
+    /**
+     * @brief Queue for writes whose caller should not wait on the commit
+     *
+     * @return nullptr if the backend has none; its add methods then run
+     * inline.
+     */
+    [[nodiscard]] virtual AsyncDatabase* async() const { return nullptr; }
+
     /**
      * @brief Get the simple name of a list type
      *
@@ -282,6 +438,68 @@ struct DBIMPL_EXPORT DatabaseBase {
     }
 };
 
+inline std::vector<DatabaseBase::AddResult> DatabaseBase::addMediaInfos(
+    const std::span<const MediaInfo> infos) const {
+    std::vector<AddResult> results;
+    results.reserve(infos.size());
+    for (const auto& info : infos) {
+        results.emplace_back(addMediaInfo(info));
+    }
+    return results;
+}
+
+inline std::vector<DatabaseBase::AddResult> DatabaseBase::addChatInfos(
+    const std::span<const ChatInfo> chats) const {
+    std::vector<AddResult> results;
+    results.reserve(chats.size());
+    for (const auto& chat : chats) {
+        results.emplace_back(addChatInfo(chat.chatId, chat.name));
+    }
+    return results;
+}
+
+inline std::vector<DatabaseBase::ListResult> DatabaseBase::addUsersToList(
+    const ListType type, const std::span<const UserId> users) const {
+    std::vector<ListResult> results;
+    results.reserve(users.size());
+    for (const auto user : users) {
+        results.emplace_back(addUserToList(type, user));
+    }
+    return results;
+}
+
+inline void DatabaseBase::forEachMediaInfo(
+    const std::function<bool(const MediaInfo&)>& visitor) const {
+    for (const auto& info : getAllMediaInfos()) {
+        if (!visitor(info)) {
+            break;
+        }
+    }
+}
+
+inline bool DatabaseBase::exportRows(
+    const std::function<bool(std::span<const DumpRow>)>& sink,
+    const std::size_t batchSize) const {
+    std::vector<DumpRow> rows;
+    if (const auto owner = getOwnerUserId()) {
+        rows.emplace_back(UserInfo{*owner, std::nullopt});
+    }
+    for (auto& info : getAllMediaInfos()) {
+        rows.emplace_back(std::move(info));
+    }
+    for (auto& info : getAllChatInfos()) {
+        rows.emplace_back(std::move(info));
+    }
+    const auto limit = std::max<std::size_t>(batchSize, 1);
+    for (std::size_t offset = 0; offset < rows.size(); offset += limit) {
+        const auto count = std::min(limit, rows.size() - offset);
+        if (!sink(std::span(rows).subspan(offset, count))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 inline std::ostream& operator<<(std::ostream& os,
                                 const DatabaseBase::ListType& type) {
     switch (type) {
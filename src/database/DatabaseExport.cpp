@@ -0,0 +1,147 @@
+#include <absl/log/log.h>
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+
+#include "DatabaseBase.hpp"
+
+#ifdef DATABASE_HAVE_PROTOBUF
+#include <TgBotDB.pb.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#endif
+
+namespace {
+
+// Quotes a CSV field when it holds a separator, a quote or a line break.
+void appendCsvField(std::string& out, const std::string_view field) {
+    if (field.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (const char c : field) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+void appendCsvRow(std::string& out, const std::string_view kind,
+                  const std::string_view id, const std::string_view uniqueId,
+                  const std::string_view name, const std::string_view type) {
+    appendCsvField(out, kind);
+    for (const auto field : {id, uniqueId, name, type}) {
+        out += ',';
+        appendCsvField(out, field);
+    }
+    out += '\n';
+}
+
+void appendCsv(std::string& out, const DatabaseBase::DumpRow& row) {
+    std::visit(
+        [&out]<typename T>(const T& value) {
+            if constexpr (std::is_same_v<T, DatabaseBase::UserInfo>) {
+                appendCsvRow(out,
+                             value.list
+                                 ? DatabaseBase::getSimpleName(*value.list)
+                                 : "owner",
+                             std::to_string(value.userId), {}, {}, {});
+            } else if constexpr (std::is_same_v<T, DatabaseBase::MediaInfo>) {
+                std::ostringstream type;
+                type << value.mediaType;
+                for (const auto& name : value.names) {
+                    appendCsvRow(out, "media", value.mediaId,
+                                 value.mediaUniqueId, name, type.str());
+                }
+            } else {
+                appendCsvRow(out, "chat", std::to_string(value.chatId), {},
+                             value.name, {});
+            }
+        },
+        row);
+}
+
+#ifdef DATABASE_HAVE_PROTOBUF
+bool writeRecord(std::ostream& out, const DatabaseBase::DumpRow& row) {
+    using namespace glider::proto::database;
+    DumpRecord record;
+    std::visit(
+        [&record]<typename T>(const T& value) {
+            if constexpr (std::is_same_v<T, DatabaseBase::UserInfo>) {
+                if (!value.list) {
+                    record.set_ownerid(value.userId);
+                    return;
+                }
+                auto* const user = record.mutable_user();
+                user->set_list(*value.list == DatabaseBase::ListType::BLACKLIST
+                                   ? UserListChange::BLACKLIST
+                                   : UserListChange::WHITELIST);
+                user->set_id(value.userId);
+            } else if constexpr (std::is_same_v<T, DatabaseBase::MediaInfo>) {
+                auto* const media = record.mutable_media();
+                media->set_telegrammediaid(value.mediaId);
+                media->set_telegrammediauniqueid(value.mediaUniqueId);
+                media->set_mediatype(static_cast<MediaType>(value.mediaType));
+                for (const auto& name : value.names) {
+                    *media->add_names() = name;
+                }
+            } else {
+                auto* const chat = record.mutable_chat();
+                chat->set_telegramchatid(value.chatId);
+                chat->set_name(value.name);
+            }
+        },
+        row);
+    return google::protobuf::util::SerializeDelimitedToOstream(record, &out);
+}
+#endif
+
+}  // namespace
+
+bool DatabaseBase::exportTo(std::ostream& out, const DumpFormat format,
+                            const std::size_t batchSize) const {
+#ifndef DATABASE_HAVE_PROTOBUF
+    if (format == DumpFormat::PROTOBUF) {
+        LOG(ERROR) << "Protobuf export is unavailable in this build";
+        return false;
+    }
+#endif
+    if (format == DumpFormat::CSV) {
+        out << "kind,id,unique_id,name,type\n";
+    }
+    std::string chunk;
+    const bool exported = exportRows(
+        [&out, &chunk, format](const std::span<const DumpRow> rows) {
+            switch (format) {
+                case DumpFormat::CSV:
+                    chunk.clear();
+                    for (const auto& row : rows) {
+                        appendCsv(chunk, row);
+                    }
+                    out << chunk;
+                    break;
+                case DumpFormat::PROTOBUF:
+#ifdef DATABASE_HAVE_PROTOBUF
+                    for (const auto& row : rows) {
+                        if (!writeRecord(out, row)) {
+                            return false;
+                        }
+                    }
+#endif
+                    break;
+            }
+            return out.good();
+        },
+        batchSize);
+    out.flush();
+    if (!exported || !out.good()) {
+        LOG(ERROR) << "Database export failed";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,152 @@
+#include "DatabaseMetrics.hpp"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// The outermost Scope of the current thread.
+thread_local DatabaseMetrics::Scope* activeScope = nullptr;
+
+constexpr std::array<std::string_view, DatabaseMetrics::kOperations>
+    kOperationNames = {
+        "addUserToList",    "addUsersToList",   "removeUserFromList",
+        "checkUserInList",  "getUsersInList",   "getOwnerUserId",
+        "claimOwnerUserId", "queryMediaInfo",   "addMediaInfo",
+        "addMediaInfos",    "getAllMediaInfos", "forEachMediaInfo",
+        "deleteMediaInfo",  "getMediaIds",      "searchMedia",
+        "addChatInfo",      "addChatInfos",     "getChatId",
+        "getChatName",      "deleteChatInfo",   "getAllChatInfos",
+        "dump",             "exportRows",
+};
+
+std::size_t bucketOf(const DatabaseMetrics::Clock::duration duration) {
+    const auto micros = static_cast<std::uint64_t>(std::max<std::int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration)
+            .count(),
+        0));
+    return std::min<std::size_t>(std::bit_width(micros),
+                                 DatabaseMetrics::kBuckets - 1);
+}
+
+std::uint64_t toNanos(const DatabaseMetrics::Clock::duration duration) {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count());
+}
+
+}  // namespace
+
+DatabaseMetrics::Scope::Scope(DatabaseMetrics& metrics,
+                              const Operation operation)
+    : metrics_(activeScope == nullptr ? &metrics : nullptr),
+      operation_(operation),
+      start_(Clock::now()) {
+    if (metrics_ != nullptr) {
+        activeScope = this;
+    }
+}
+
+DatabaseMetrics::Scope::~Scope() {
+    if (metrics_ == nullptr) {
+        return;
+    }
+    activeScope = nullptr;
+    metrics_->record(operation_, Clock::now() - start_, lockWait_,
+                     rowsScanned_);
+}
+
+void DatabaseMetrics::Scope::addLockWait(const Clock::duration wait) {
+    if (activeScope != nullptr) {
+        activeScope->lockWait_ += wait;
+    }
+}
+
+void DatabaseMetrics::Scope::addRowsScanned(const std::uint64_t rows) {
+    if (activeScope != nullptr) {
+        activeScope->rowsScanned_ += rows;
+    }
+}
+
+DatabaseMetrics::DatabaseMetrics(const std::string_view backend)
+    : backend_(backend) {}
+
+std::string_view DatabaseMetrics::name(const Operation operation) {
+    return kOperationNames.at(static_cast<std::size_t>(operation));
+}
+
+std::chrono::microseconds DatabaseMetrics::bucketLimit(
+    const std::size_t bucket) {
+    return std::chrono::microseconds(std::uint64_t{1} << bucket);
+}
+
+void DatabaseMetrics::setSlowThreshold(
+    const std::chrono::microseconds threshold) {
+    slowThresholdUs_.store(threshold.count(), std::memory_order_relaxed);
+}
+
+std::chrono::microseconds DatabaseMetrics::slowThreshold() const {
+    return std::chrono::microseconds(
+        slowThresholdUs_.load(std::memory_order_relaxed));
+}
+
+void DatabaseMetrics::record(const Operation operation,
+                             const Clock::duration latency,
+                             const Clock::duration lockWait,
+                             const std::uint64_t rowsScanned) {
+    auto& counters = counters_[static_cast<std::size_t>(operation)];
+    constexpr auto kRelaxed = std::memory_order_relaxed;
+    counters.calls.fetch_add(1, kRelaxed);
+    counters.latencyNs.fetch_add(toNanos(latency), kRelaxed);
+    counters.lockWaitNs.fetch_add(toNanos(lockWait), kRelaxed);
+    counters.rowsScanned.fetch_add(rowsScanned, kRelaxed);
+    counters.latencyBuckets[bucketOf(latency)].fetch_add(1, kRelaxed);
+    counters.lockWaitBuckets[bucketOf(lockWait)].fetch_add(1, kRelaxed);
+
+    const auto threshold = slowThreshold();
+    if (threshold.count() <= 0 || latency < threshold) {
+        return;
+    }
+    counters.slowCalls.fetch_add(1, kRelaxed);
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    LOG(WARNING) << "Slow " << backend_ << " call " << name(operation) << ": "
+                 << duration_cast<microseconds>(latency).count() << "us, "
+                 << duration_cast<microseconds>(lockWait).count()
+                 << "us waiting for locks, " << rowsScanned
+                 << " rows scanned";
+}
+
+std::vector<DatabaseMetrics::OperationStats> DatabaseMetrics::snapshot()
+    const {
+    constexpr auto kRelaxed = std::memory_order_relaxed;
+    std::vector<OperationStats> result;
+    for (std::size_t i = 0; i < kOperations; ++i) {
+        const auto& counters = counters_[i];
+        const auto calls = counters.calls.load(kRelaxed);
+        if (calls == 0) {
+            continue;
+        }
+        OperationStats stats{
+            .operation = static_cast<Operation>(i),
+            .calls = calls,
+            .slowCalls = counters.slowCalls.load(kRelaxed),
+            .latency =
+                std::chrono::nanoseconds(counters.latencyNs.load(kRelaxed)),
+            .lockWait =
+                std::chrono::nanoseconds(counters.lockWaitNs.load(kRelaxed)),
+            .rowsScanned = counters.rowsScanned.load(kRelaxed),
+            .latencyBuckets = {},
+            .lockWaitBuckets = {},
+        };
+        for (std::size_t b = 0; b < kBuckets; ++b) {
+            stats.latencyBuckets[b] = counters.latencyBuckets[b].load(kRelaxed);
+            stats.lockWaitBuckets[b] =
+                counters.lockWaitBuckets[b].load(kRelaxed);
+        }
+        result.emplace_back(stats);
+    }
+    return result;
+}
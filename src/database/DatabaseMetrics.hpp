@@ -0,0 +1,157 @@
+#pragma once
+
+#include <DBImplExports.h>
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * Per-operation latency, lock wait and scan counters of one database
+ * backend, plus a log of calls slower than a configurable threshold.
+ *
+ * Backends open a Scope at the top of every public operation. Time spent
+ * blocked on the backend's lock and rows read without an index are
+ * reported to the Scope active on the calling thread, so the lock and the
+ * statement helpers need no access to the Scope itself.
+ */
+class DBIMPL_EXPORT DatabaseMetrics {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    // The DatabaseBase operations, named after the methods.
+    enum class Operation : std::uint8_t {
+        ADD_USER,
+        ADD_USERS,
+        REMOVE_USER,
+        CHECK_USER,
+        GET_LIST_USERS,
+        GET_OWNER,
+        CLAIM_OWNER,
+        QUERY_MEDIA,
+        ADD_MEDIA,
+        ADD_MEDIAS,
+        GET_ALL_MEDIA,
+        FOR_EACH_MEDIA,
+        DELETE_MEDIA,
+        GET_MEDIA_IDS,
+        SEARCH_MEDIA,
+        ADD_CHAT,
+        ADD_CHATS,
+        GET_CHAT_ID,
+        GET_CHAT_NAME,
+        DELETE_CHAT,
+        GET_ALL_CHATS,
+        DUMP,
+        EXPORT,
+        COUNT
+    };
+    static constexpr std::size_t kOperations =
+        static_cast<std::size_t>(Operation::COUNT);
+
+    // Bucket 0 counts calls under 1us, bucket i calls under 2^i us that do
+    // not fit bucket i - 1. The last bucket is unbounded.
+    static constexpr std::size_t kBuckets = 24;
+    using Buckets = std::array<std::uint64_t, kBuckets>;
+
+    struct OperationStats {
+        Operation operation;
+        std::uint64_t calls;
+        // Calls at or over the slow threshold while it was set.
+        std::uint64_t slowCalls;
+        std::chrono::nanoseconds latency;
+        std::chrono::nanoseconds lockWait;
+        // Rows visited by full scans, i.e. not found through an index.
+        std::uint64_t rowsScanned;
+        Buckets latencyBuckets;
+        Buckets lockWaitBuckets;
+    };
+
+    /**
+     * Times one operation from construction to destruction. A Scope opened
+     * while another is active on the same thread does nothing, so public
+     * operations built on other public operations are counted once.
+     */
+    class DBIMPL_EXPORT Scope {
+       public:
+        Scope(DatabaseMetrics& metrics, Operation operation);
+        ~Scope();
+        NO_COPY_CTOR(Scope);
+
+        // Charge time spent blocked on a lock or connection to the active
+        // Scope of this thread, if any.
+        static void addLockWait(Clock::duration wait);
+        // Charge rows read without an index to the active Scope.
+        static void addRowsScanned(std::uint64_t rows);
+
+       private:
+        DatabaseMetrics* metrics_;
+        Operation operation_;
+        Clock::time_point start_;
+        Clock::duration lockWait_{};
+        std::uint64_t rowsScanned_ = 0;
+    };
+
+    // `backend` names the backend in the slow call log.
+    explicit DatabaseMetrics(std::string_view backend);
+    NO_COPY_CTOR(DatabaseMetrics);
+
+    [[nodiscard]] static std::string_view name(Operation operation);
+    // The exclusive upper bound of a bucket, which the last one does not
+    // have.
+    [[nodiscard]] static std::chrono::microseconds bucketLimit(
+        std::size_t bucket);
+
+    // Log every call taking at least `threshold`. Zero turns it off.
+    void setSlowThreshold(std::chrono::microseconds threshold);
+    [[nodiscard]] std::chrono::microseconds slowThreshold() const;
+
+    // Operations called at least once, in Operation order.
+    [[nodiscard]] std::vector<OperationStats> snapshot() const;
+
+   private:
+    struct Counters {
+        std::atomic<std::uint64_t> calls;
+        std::atomic<std::uint64_t> slowCalls;
+        std::atomic<std::uint64_t> latencyNs;
+        std::atomic<std::uint64_t> lockWaitNs;
+        std::atomic<std::uint64_t> rowsScanned;
+        std::array<std::atomic<std::uint64_t>, kBuckets> latencyBuckets;
+        std::array<std::atomic<std::uint64_t>, kBuckets> lockWaitBuckets;
+    };
+
+    void record(Operation operation, Clock::duration latency,
+                Clock::duration lockWait, std::uint64_t rowsScanned);
+
+    std::string_view backend_;
+    std::atomic<std::int64_t> slowThresholdUs_ = 0;
+    std::array<Counters, kOperations> counters_{};
+};
+
+/**
+ * A mutex that reports the time callers spend blocked on it to
+ * DatabaseMetrics. Uncontended locks cost one try_lock() and no clock read.
+ */
+template <typename Mutex>
+class MeteredMutex {
+   public:
+    void lock() {
+        if (mutex_.try_lock()) {
+            return;
+        }
+        const auto start = DatabaseMetrics::Clock::now();
+        mutex_.lock();
+        DatabaseMetrics::Scope::addLockWait(DatabaseMetrics::Clock::now() -
+                                            start);
+    }
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+
+   private:
+    Mutex mutex_;
+};
@@ -0,0 +1,124 @@
+#include "MediaSearch.hpp"
+
+#include <absl/strings/ascii.h>
+
+#include <algorithm>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+namespace media_search {
+
+namespace {
+
+// Exact matches score 1. Prefix and substring matches score within
+// [kPrefixScore, 1) and [kSubstringScore, kPrefixScore), more the more of
+// the alias the query covers, and typos score below kSubstringScore.
+constexpr float kPrefixScore = 0.8F;
+constexpr float kSubstringScore = 0.6F;
+constexpr float kCoverageWeight = 0.19F;
+
+std::size_t countCommon(const std::vector<std::string>& left,
+                        const std::vector<std::string>& right) {
+    std::size_t common = 0;
+    auto l = left.begin();
+    auto r = right.begin();
+    while (l != left.end() && r != right.end()) {
+        if (*l < *r) {
+            ++l;
+        } else if (*r < *l) {
+            ++r;
+        } else {
+            ++common;
+            ++l;
+            ++r;
+        }
+    }
+    return common;
+}
+
+}  // namespace
+
+std::vector<std::string> trigrams(const std::string_view lowered) {
+    std::string padded = "  ";
+    padded += lowered;
+    padded += ' ';
+    std::vector<std::string> grams;
+    grams.reserve(padded.size() - 2);
+    for (std::size_t i = 0; i + 3 <= padded.size(); ++i) {
+        grams.emplace_back(padded.substr(i, 3));
+    }
+    std::ranges::sort(grams);
+    const auto [first, last] = std::ranges::unique(grams);
+    grams.erase(first, last);
+    return grams;
+}
+
+Query::Query(const std::string_view raw)
+    : text(absl::AsciiStrToLower(raw)), grams(trigrams(text)) {}
+
+std::optional<float> score(const Query& query, const std::string_view alias) {
+    if (query.text.empty() || alias.empty()) {
+        return std::nullopt;
+    }
+    const auto lowered = absl::AsciiStrToLower(alias);
+    if (lowered == query.text) {
+        return 1.0F;
+    }
+    const float coverage = static_cast<float>(query.text.size()) /
+                           static_cast<float>(lowered.size());
+    if (lowered.starts_with(query.text)) {
+        return kPrefixScore + kCoverageWeight * coverage;
+    }
+    if (query.text.size() >= 3 &&
+        lowered.find(query.text) != std::string::npos) {
+        return kSubstringScore + kCoverageWeight * coverage;
+    }
+    const auto grams = trigrams(lowered);
+    const auto common = countCommon(query.grams, grams);
+    const float similarity =
+        static_cast<float>(common) /
+        static_cast<float>(query.grams.size() + grams.size() - common);
+    if (similarity < kMinSimilarity) {
+        return std::nullopt;
+    }
+    return kSubstringScore * similarity;
+}
+
+std::vector<DatabaseBase::MediaMatch> rank(
+    std::vector<DatabaseBase::MediaMatch> matches, const std::size_t limit) {
+    const auto order = [](const DatabaseBase::MediaMatch& match) {
+        return std::make_tuple(-match.score, std::cref(match.alias),
+                               std::cref(match.mediaUniqueId));
+    };
+    std::ranges::sort(matches, {}, order);
+    std::unordered_set<std::string> seen;
+    std::vector<DatabaseBase::MediaMatch> ranked;
+    for (auto& match : matches) {
+        if (ranked.size() == limit) {
+            break;
+        }
+        if (seen.emplace(match.mediaUniqueId).second) {
+            ranked.emplace_back(std::move(match));
+        }
+    }
+    return ranked;
+}
+
+}  // namespace media_search
+
+std::vector<DatabaseBase::MediaMatch> DatabaseBase::searchMedia(
+    const std::string_view query, const std::size_t limit) const {
+    const media_search::Query parsed(query);
+    std::vector<MediaMatch> matches;
+    forEachMediaInfo([&parsed, &matches](const MediaInfo& info) {
+        for (const auto& name : info.names) {
+            if (const auto score = media_search::score(parsed, name)) {
+                matches.push_back({name, info.mediaId, info.mediaUniqueId,
+                                   info.mediaType, *score});
+            }
+        }
+        return true;
+    });
+    return media_search::rank(std::move(matches), limit);
+}
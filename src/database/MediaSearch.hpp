@@ -0,0 +1,51 @@
+#pragma once
+
+#include <DBImplExports.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DatabaseBase.hpp"
+
+// Scoring shared by every DatabaseBase::searchMedia() implementation, so the
+// backends only differ in how they find candidate aliases.
+namespace media_search {
+
+// Aliases sharing a smaller fraction of their trigrams with the query are
+// not considered typos of it.
+inline constexpr float kMinSimilarity = 0.3F;
+
+/**
+ * @brief Sorted, distinct trigrams of lowercased text.
+ *
+ * The text is padded with two spaces in front and one behind, so prefixes
+ * and strings shorter than three characters still have trigrams.
+ */
+DBIMPL_EXPORT std::vector<std::string> trigrams(std::string_view lowered);
+
+// A search query, lowercased and split into trigrams once.
+struct DBIMPL_EXPORT Query {
+    explicit Query(std::string_view raw);
+
+    std::string text;
+    std::vector<std::string> grams;
+};
+
+/**
+ * @brief Score an alias against a query, ignoring ASCII case.
+ *
+ * @return 1 for an exact match, then decreasing for aliases that start with
+ * the query, contain it (three characters or more) and share trigrams with
+ * it. std::nullopt if the alias does not match at all.
+ */
+DBIMPL_EXPORT std::optional<float> score(const Query& query,
+                                         std::string_view alias);
+
+// Keeps the best match per media and the `limit` best of those, best first.
+DBIMPL_EXPORT std::vector<DatabaseBase::MediaMatch> rank(
+    std::vector<DatabaseBase::MediaMatch> matches, std::size_t limit);
+
+}  // namespace media_search
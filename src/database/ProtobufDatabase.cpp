@@ -2,14 +2,21 @@
 
 #include <absl/log/check.h>
 #include <absl/log/log.h>
+#include <absl/strings/ascii.h>
 #include <absl/strings/match.h>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
 
+#include <algorithm>
 #include <atomic>
 #include <fstream>
+#include <iterator>
 #include <optional>
 #include <trivial_helpers/log_once.hpp>
+#include <unordered_set>
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -21,6 +28,7 @@
 #include <unistd.h>
 #endif
 
+#include "MediaSearch.hpp"
 #include "TgBotDB.pb.h"
 
 template <>
@@ -65,7 +73,46 @@ using namespace glider::proto::database;
 
 namespace {
 
-std::filesystem::path temporarySnapshotPath(
+using Operation = DatabaseMetrics::Operation;
+
+// The journal is folded into the snapshot once it outgrows both of these.
+constexpr std::uintmax_t kMinJournalBytes = 64 * 1024;
+
+UserListChange::List toJournalList(const DatabaseBase::ListType type) {
+    switch (type) {
+        case DatabaseBase::ListType::WHITELIST:
+            return UserListChange::WHITELIST;
+        case DatabaseBase::ListType::BLACKLIST:
+            return UserListChange::BLACKLIST;
+    }
+    CHECK(false) << "unreachable";
+}
+
+DatabaseBase::ListType fromJournalList(const UserListChange::List list) {
+    return list == UserListChange::BLACKLIST
+               ? DatabaseBase::ListType::BLACKLIST
+               : DatabaseBase::ListType::WHITELIST;
+}
+
+void toMediaToName(const DatabaseBase::MediaInfo& info, MediaToName* media) {
+    media->set_telegrammediaid(info.mediaId);
+    media->set_telegrammediauniqueid(info.mediaUniqueId);
+    media->set_mediatype(static_cast<MediaType>(info.mediaType));
+    for (const auto& name : info.names) {
+        *media->add_names() = name;
+    }
+}
+
+DatabaseBase::MediaInfo fromMediaToName(const MediaToName& media) {
+    DatabaseBase::MediaInfo info;
+    info.mediaId = media.telegrammediaid();
+    info.mediaUniqueId = media.telegrammediauniqueid();
+    info.mediaType = static_cast<DatabaseBase::MediaType>(media.mediatype());
+    info.names.assign(media.names().begin(), media.names().end());
+    return info;
+}
+
+std::filesystem::path temporaryPath(
     const std::filesystem::path& target) {
     static std::atomic_uint64_t sequence{0};
     auto temporary = target;
@@ -78,7 +125,7 @@ std::filesystem::path temporarySnapshotPath(
     return temporary;
 }
 
-bool syncSnapshotFile(const std::filesystem::path& path) {
+bool syncFile(const std::filesystem::path& path) {
 #ifdef _WIN32
     const HANDLE file =
         CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
@@ -100,8 +147,8 @@ bool syncSnapshotFile(const std::filesystem::path& path) {
 #endif
 }
 
-bool replaceSnapshotFile(const std::filesystem::path& source,
-                         const std::filesystem::path& target) {
+bool replaceFile(const std::filesystem::path& source,
+                 const std::filesystem::path& target) {
 #ifdef _WIN32
     std::error_code existsError;
     const bool targetExists = std::filesystem::exists(target, existsError);
@@ -142,55 +189,443 @@ bool replaceSnapshotFile(const std::filesystem::path& source,
 #endif
 }
 
+// Writes contents to a temporary next to target, syncs it and renames it
+// over target, so readers see either the old or the new file.
+bool writeFileAtomically(const std::filesystem::path& target,
+                         const std::string_view contents) {
+    const auto temporary = temporaryPath(target);
+    std::error_code ec;
+    std::filesystem::remove(temporary, ec);
+
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    output.write(contents.data(),
+                 static_cast<std::streamsize>(contents.size()));
+    output.close();
+    if (!output.good()) {
+        LOG(ERROR) << "Failed to write " << temporary;
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+    if (!syncFile(temporary) || !replaceFile(temporary, target)) {
+        LOG(ERROR) << "Failed to atomically replace " << target;
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+    return true;
+}
+
+// Positions in `index` after `position` move down by one.
+template <typename Index>
+void shiftAfter(Index& index, const int position) {
+    for (auto& [key, at] : index) {
+        if (at > position) {
+            --at;
+        }
+    }
+}
+
 }  // namespace
 
 ProtoDatabase::~ProtoDatabase() = default;
 
-bool ProtoDatabase::persistLocked() const {
-    if (!dbinfo) {
+std::filesystem::path ProtoDatabase::journalPathFor(
+    const std::filesystem::path& path) {
+    auto journal = path;
+    journal += ".journal";
+    return journal;
+}
+
+void ProtoDatabase::indexMediaLocked(const int position) const {
+    const auto& media = dbinfo->object.mediatonames(position);
+    auto& indices = dbinfo->indices;
+    indices.mediaByUniqueId.emplace(media.telegrammediauniqueid(), position);
+    indices.mediaById.emplace(media.telegrammediaid(), position);
+    for (const auto& name : media.names()) {
+        const auto [alias, added] = indices.mediaByAlias.try_emplace(
+            absl::AsciiStrToLower(name));
+        if (added) {
+            for (auto& gram : media_search::trigrams(alias->first)) {
+                indices.aliasesByTrigram[std::move(gram)].emplace_back(
+                    &*alias);
+            }
+        }
+        alias->second.emplace_back(position);
+    }
+}
+
+void ProtoDatabase::indexChatLocked(const int position) const {
+    const auto& chat = dbinfo->object.chattonames(position);
+    auto& indices = dbinfo->indices;
+    indices.chatByName.emplace(absl::AsciiStrToLower(chat.name()),
+                               chat.telegramchatid());
+    indices.chatById.emplace(chat.telegramchatid(), position);
+}
+
+void ProtoDatabase::unindexMediaLocked(const int position) const {
+    const auto& entries = dbinfo->object.mediatonames();
+    const auto& media = entries[position];
+    auto& indices = dbinfo->indices;
+    indices.mediaByUniqueId.erase(media.telegrammediauniqueid());
+    shiftAfter(indices.mediaByUniqueId, position);
+
+    const auto first = indices.mediaById.find(media.telegrammediaid());
+    const bool wasFirst =
+        first != indices.mediaById.end() && first->second == position;
+    if (wasFirst) {
+        indices.mediaById.erase(first);
+    }
+    shiftAfter(indices.mediaById, position);
+    if (wasFirst) {
+        // The next entry with the same id, if any, becomes the first.
+        for (int i = position + 1; i < entries.size(); ++i) {
+            if (entries[i].telegrammediaid() == media.telegrammediaid()) {
+                indices.mediaById.emplace(media.telegrammediaid(), i - 1);
+                break;
+            }
+        }
+    }
+
+    for (const auto& name : media.names()) {
+        const auto alias =
+            indices.mediaByAlias.find(absl::AsciiStrToLower(name));
+        if (alias == indices.mediaByAlias.end()) {
+            // A repeated name, already dropped.
+            continue;
+        }
+        std::erase(alias->second, position);
+        if (!alias->second.empty()) {
+            continue;
+        }
+        for (const auto& gram : media_search::trigrams(alias->first)) {
+            const auto aliases = indices.aliasesByTrigram.find(gram);
+            if (aliases == indices.aliasesByTrigram.end()) {
+                continue;
+            }
+            std::erase(aliases->second, &*alias);
+            if (aliases->second.empty()) {
+                indices.aliasesByTrigram.erase(aliases);
+            }
+        }
+        indices.mediaByAlias.erase(alias);
+    }
+    for (auto& [alias, positions] : indices.mediaByAlias) {
+        for (auto& at : positions) {
+            if (at > position) {
+                --at;
+            }
+        }
+    }
+}
+
+void ProtoDatabase::unindexChatLocked(const int position) const {
+    const auto& chats = dbinfo->object.chattonames();
+    const auto& chat = chats[position];
+    auto& indices = dbinfo->indices;
+    indices.chatById.erase(chat.telegramchatid());
+    shiftAfter(indices.chatById, position);
+
+    const auto name = absl::AsciiStrToLower(chat.name());
+    const auto named = indices.chatByName.find(name);
+    if (named == indices.chatByName.end() ||
+        named->second != chat.telegramchatid()) {
+        return;
+    }
+    indices.chatByName.erase(named);
+    // The next chat with the same name, if any, becomes the first.
+    for (int i = position + 1; i < chats.size(); ++i) {
+        if (absl::AsciiStrToLower(chats[i].name()) == name) {
+            indices.chatByName.emplace(name, chats[i].telegramchatid());
+            break;
+        }
+    }
+}
+
+void ProtoDatabase::rebuildIndicesLocked() const {
+    dbinfo->indices = {};
+    for (int i = 0; i < dbinfo->object.mediatonames_size(); ++i) {
+        indexMediaLocked(i);
+    }
+    for (int i = 0; i < dbinfo->object.chattonames_size(); ++i) {
+        indexChatLocked(i);
+    }
+}
+
+void ProtoDatabase::applyLocked(const JournalRecord& record) const {
+    auto& object = dbinfo->object;
+    switch (record.mutation_case()) {
+        case JournalRecord::kAddUser: {
+            const auto& change = record.adduser();
+            auto* const list =
+                getMutablePersonList(fromJournalList(change.list()));
+            if (!findByUid(list->id(), change.id())) {
+                list->add_id(change.id());
+            }
+            break;
+        }
+        case JournalRecord::kRemoveUser: {
+            const auto& change = record.removeuser();
+            auto* const list =
+                getMutablePersonList(fromJournalList(change.list()))
+                    ->mutable_id();
+            if (const auto loc = findByUid(*list, change.id())) {
+                list->erase(list->begin() + *loc);
+            }
+            break;
+        }
+        case JournalRecord::kSetOwnerId:
+            object.set_ownerid(record.setownerid());
+            break;
+        case JournalRecord::kAddMedia: {
+            const auto& media = record.addmedia();
+            if (!dbinfo->indices.mediaByUniqueId.contains(
+                    media.telegrammediauniqueid())) {
+                *object.add_mediatonames() = media;
+                indexMediaLocked(object.mediatonames_size() - 1);
+            }
+            break;
+        }
+        case JournalRecord::kDeleteMedia: {
+            const auto& byId = dbinfo->indices.mediaById;
+            const auto it = byId.find(record.deletemedia());
+            if (it != byId.end()) {
+                const int position = it->second;
+                unindexMediaLocked(position);
+                object.mutable_mediatonames()->DeleteSubrange(position, 1);
+            }
+            break;
+        }
+        case JournalRecord::kAddChat: {
+            const auto& chat = record.addchat();
+            if (!dbinfo->indices.chatById.contains(chat.telegramchatid())) {
+                *object.add_chattonames() = chat;
+                indexChatLocked(object.chattonames_size() - 1);
+            }
+            break;
+        }
+        case JournalRecord::kDeleteChat: {
+            const auto it = dbinfo->indices.chatById.find(record.deletechat());
+            if (it != dbinfo->indices.chatById.end()) {
+                const int position = it->second;
+                unindexChatLocked(position);
+                object.mutable_chattonames()->DeleteSubrange(position, 1);
+            }
+            break;
+        }
+        case JournalRecord::kBatch:
+            for (const auto& entry : record.batch().records()) {
+                applyLocked(entry);
+            }
+            break;
+        case JournalRecord::MUTATION_NOT_SET:
+            LOG(WARNING) << "Ignoring empty journal record";
+            break;
+    }
+}
+
+bool ProtoDatabase::commitLocked(const JournalRecord& record) const {
+    if (!appendJournalLocked(record)) {
         return false;
     }
+    applyLocked(record);
+    return true;
+}
+
+bool ProtoDatabase::appendJournalLocked(const JournalRecord& record) const {
     if (dbinfo->path == kInMemoryDatabase) {
         return true;
     }
+    const auto journalPath = journalPathFor(dbinfo->path);
+    auto& journal = dbinfo->journal;
+    if (!google::protobuf::util::SerializeDelimitedToOstream(record,
+                                                            &journal) ||
+        !journal.flush() || !syncFile(journalPath)) {
+        LOG(ERROR) << "Failed to append to protobuf journal " << journalPath;
+        // Drop whatever part of the record made it out, so the next append
+        // does not land behind a torn one.
+        journal.clear();
+        std::error_code ec;
+        std::filesystem::resize_file(journalPath, dbinfo->journalBytes, ec);
+        return false;
+    }
+    const auto size = record.ByteSizeLong();
+    dbinfo->journalBytes +=
+        google::protobuf::io::CodedOutputStream::VarintSize64(size) + size;
+    if (dbinfo->journalBytes >=
+        std::max(kMinJournalBytes, dbinfo->snapshotBytes)) {
+        compactRequested_ = true;
+        compactCondition_.notify_one();
+    }
+    return true;
+}
 
-    const auto temporary = temporarySnapshotPath(dbinfo->path);
+bool ProtoDatabase::replayJournalLocked() const {
+    const auto journalPath = journalPathFor(dbinfo->path);
+    std::uintmax_t good = 0;
+    bool torn = false;
+    {
+        std::ifstream input(journalPath, std::ios::binary);
+        if (!input.is_open()) {
+            dbinfo->journalBytes = 0;
+            return true;
+        }
+        google::protobuf::io::IstreamInputStream stream(&input);
+        JournalRecord record;
+        int replayed = 0;
+        bool cleanEof = false;
+        while (google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+            &record, &stream, &cleanEof)) {
+            applyLocked(record);
+            good = stream.ByteCount();
+            ++replayed;
+        }
+        torn = !cleanEof;
+        if (replayed != 0) {
+            LOG(INFO) << "Replayed " << replayed << " journal records from "
+                      << journalPath;
+        }
+    }
+    if (torn) {
+        // A crash mid-append leaves a partial record at the end. Everything
+        // before it was acknowledged, everything after it never was.
+        LOG(WARNING) << "Discarding torn tail of " << journalPath
+                     << " after byte " << good;
+        std::error_code ec;
+        std::filesystem::resize_file(journalPath, good, ec);
+        if (ec) {
+            LOG(ERROR) << "Failed to truncate " << journalPath << ": "
+                       << ec.message();
+            return false;
+        }
+    }
+    dbinfo->journalBytes = good;
+    return true;
+}
+
+bool ProtoDatabase::truncateJournalLocked(const std::uintmax_t covered) const {
+    const auto journalPath = journalPathFor(dbinfo->path);
     std::error_code ec;
-    std::filesystem::remove(temporary, ec);
+    if (dbinfo->journalBytes == covered) {
+        std::filesystem::resize_file(journalPath, 0, ec);
+        if (ec) {
+            LOG(ERROR) << "Failed to truncate " << journalPath << ": "
+                       << ec.message();
+            return false;
+        }
+        dbinfo->journalBytes = 0;
+        return true;
+    }
 
-    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
-    if (!output.is_open() || !dbinfo->object.SerializeToOstream(&output)) {
-        LOG(ERROR) << "Failed to serialize protobuf snapshot to " << temporary;
-        output.close();
-        std::filesystem::remove(temporary, ec);
+    // Records were appended while the snapshot was written; keep only those.
+    std::string tail;
+    {
+        std::ifstream input(journalPath, std::ios::binary);
+        input.seekg(static_cast<std::streamoff>(covered));
+        tail.assign(std::istreambuf_iterator<char>(input),
+                    std::istreambuf_iterator<char>());
+    }
+    if (tail.size() != dbinfo->journalBytes - covered) {
+        LOG(ERROR) << "Failed to read back " << journalPath;
         return false;
     }
-    output.flush();
-    if (!output.good()) {
-        LOG(ERROR) << "Failed to flush protobuf snapshot " << temporary;
-        output.close();
-        std::filesystem::remove(temporary, ec);
+    // Closed while it is replaced, as Windows can't replace an open file.
+    // Reopened either way, so later records still have somewhere to go.
+    dbinfo->journal.close();
+    const bool replaced = writeFileAtomically(journalPath, tail);
+    dbinfo->journal.clear();
+    dbinfo->journal.open(journalPath, std::ios::binary | std::ios::app);
+    if (replaced) {
+        dbinfo->journalBytes = tail.size();
+    } else {
+        LOG(ERROR) << "Failed to rewrite " << journalPath;
+    }
+    if (!dbinfo->journal.is_open()) {
+        LOG(ERROR) << "Failed to reopen " << journalPath;
         return false;
     }
-    output.close();
-    if (!output.good()) {
-        LOG(ERROR) << "Failed to close protobuf snapshot " << temporary;
-        std::filesystem::remove(temporary, ec);
+    return replaced;
+}
+
+bool ProtoDatabase::compact() const {
+    std::lock_guard<std::mutex> compaction(compaction_mutex_);
+    std::unique_lock lock(dbinfo_mutex_);
+    if (!dbinfo) {
         return false;
     }
+    if (dbinfo->path == kInMemoryDatabase) {
+        return true;
+    }
+    std::string snapshot;
+    if (!dbinfo->object.SerializeToString(&snapshot)) {
+        LOG(ERROR) << "Failed to serialize protobuf snapshot";
+        return false;
+    }
+    const auto path = dbinfo->path;
+    const auto covered = dbinfo->journalBytes;
 
-    if (!syncSnapshotFile(temporary) ||
-        !replaceSnapshotFile(temporary, dbinfo->path)) {
-        LOG(ERROR) << "Failed to atomically replace protobuf database "
-                   << dbinfo->path;
-        std::filesystem::remove(temporary, ec);
+    lock.unlock();
+    const bool written = writeFileAtomically(path, snapshot);
+    lock.lock();
+
+    // unload() stops the compactor and compacts before resetting dbinfo,
+    // and both paths hold compaction_mutex_, so dbinfo is still ours.
+    if (!written) {
         return false;
     }
-    return true;
+    dbinfo->snapshotBytes = snapshot.size();
+    return truncateJournalLocked(covered);
+}
+
+void ProtoDatabase::runCompactor(std::stop_token stop) const {
+    while (true) {
+        {
+            std::unique_lock lock(dbinfo_mutex_);
+            if (!compactCondition_.wait(lock, stop,
+                                        [this] { return compactRequested_; })) {
+                return;
+            }
+            compactRequested_ = false;
+        }
+        if (!compact()) {
+            LOG(WARNING) << "Journal compaction failed, will retry on the "
+                            "next mutation";
+        }
+    }
+}
+
+void ProtoDatabase::stopCompactor() {
+    std::jthread compactor;
+    {
+        std::lock_guard lock(dbinfo_mutex_);
+        compactor = std::move(compactor_);
+        compactRequested_ = false;
+    }
+    // Destroying the jthread requests stop and joins it.
+}
+
+void ProtoDatabase::refreshAclLocked() const {
+    if (!dbinfo) {
+        acl_.clear();
+        return;
+    }
+    const auto& object = dbinfo->object;
+    std::vector<AclSnapshot::Entry> entries;
+    entries.reserve(object.whitelist().id_size() +
+                    object.blacklist().id_size());
+    for (const auto user : object.whitelist().id()) {
+        entries.push_back({user, AclSnapshot::Membership::WHITELIST});
+    }
+    for (const auto user : object.blacklist().id()) {
+        entries.push_back({user, AclSnapshot::Membership::BLACKLIST});
+    }
+    acl_.publish(std::move(entries),
+                 object.has_ownerid() ? std::optional(object.ownerid())
+                                      : std::nullopt);
 }
 
 std::optional<int> ProtoDatabase::findByUid(const RepeatedField<UserId>& list,
                                             const UserId uid) {
+    // Membership lists have no index.
+    DatabaseMetrics::Scope::addRowsScanned(list.size());
     for (int index = 0; index < list.size(); ++index) {
         if (list.Get(index) == uid) {
             return index;
@@ -201,7 +636,8 @@ std::optional<int> ProtoDatabase::findByUid(const RepeatedField<UserId>& list,
 
 ProtoDatabase::ListResult ProtoDatabase::addUserToList(ListType type,
                                                        UserId user) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_USER);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo) {
         return ListResult::BACKEND_ERROR;
     }
@@ -217,93 +653,99 @@ ProtoDatabase::ListResult ProtoDatabase::addUserToList(ListType type,
     if (findByUid(myList->id(), user)) {
         return ListResult::ALREADY_IN_LIST;
     }
-    Database previous = dbinfo->object;
-    myList->add_id(user);
-    if (persistLocked()) {
-        return ListResult::OK;
+    JournalRecord record;
+    auto* const change = record.mutable_adduser();
+    change->set_list(toJournalList(type));
+    change->set_id(user);
+    if (!commitLocked(record)) {
+        return ListResult::BACKEND_ERROR;
     }
-    dbinfo->object = std::move(previous);
-    return ListResult::BACKEND_ERROR;
+    refreshAclLocked();
+    return ListResult::OK;
 }
 
 ProtoDatabase::ListResult ProtoDatabase::removeUserFromList(ListType type,
                                                             UserId user) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::REMOVE_USER);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo) {
         return ListResult::BACKEND_ERROR;
     }
-    auto* const myList = getMutablePersonList(type);
-    auto loc = findByUid(myList->id(), user);
-    if (loc.has_value()) {
-        Database previous = dbinfo->object;
-        auto* list = myList->mutable_id();
-        list->erase(list->begin() + loc.value());
-        if (persistLocked()) {
-            return ListResult::OK;
-        }
-        dbinfo->object = std::move(previous);
+    if (!findByUid(getPersonList(type).id(), user)) {
+        return ListResult::NOT_IN_LIST;
+    }
+    JournalRecord record;
+    auto* const change = record.mutable_removeuser();
+    change->set_list(toJournalList(type));
+    change->set_id(user);
+    if (!commitLocked(record)) {
         return ListResult::BACKEND_ERROR;
     }
-    return ListResult::NOT_IN_LIST;
+    refreshAclLocked();
+    return ListResult::OK;
 }
 
 [[nodiscard]] DatabaseBase::ListResult ProtoDatabase::checkUserInList(
     ListType type, UserId user) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    const auto& myList = getPersonList(type);
-    auto loc = findByUid(myList.id(), user);
-    if (loc.has_value()) {
-        return ListResult::OK;
+    const DatabaseMetrics::Scope scope(metrics_, Operation::CHECK_USER);
+    // The snapshot mirrors both lists and is published whenever dbinfo is.
+    if (const auto result = acl_.check(type, user)) {
+        return *result;
     }
-    const auto& otherList = getOtherPersonList(type);
-    auto otherLoc = findByUid(otherList.id(), user);
-    if (otherLoc.has_value()) {
-        return ListResult::ALREADY_IN_OTHER_LIST;
+    LOG_ONCE(WARNING) << "Database not loaded! Cannot check user lists!";
+    return ListResult::BACKEND_ERROR;
+}
+
+std::vector<UserId> ProtoDatabase::getUsersInList(const ListType type) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_LIST_USERS);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo.has_value()) {
+        LOG_ONCE(WARNING) << "Database not loaded! Cannot get list users!";
+        return {};
     }
-    return ListResult::NOT_IN_LIST;
+    const auto& users = getPersonList(type).id();
+    DatabaseMetrics::Scope::addRowsScanned(users.size());
+    return {users.begin(), users.end()};
 }
 
 std::optional<std::string> ProtoDatabase::getChatName(
     const ChatId chatId) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_CHAT_NAME);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo.has_value()) {
         LOG_ONCE(WARNING) << "Database not loaded! Cannot determine chat name!";
         return std::nullopt;
     }
-    for (const auto& chatInfo : dbinfo->object.chattonames()) {
-        if (chatInfo.telegramchatid() == chatId)
-            return chatInfo.name();
+    const auto it = dbinfo->indices.chatById.find(chatId);
+    if (it == dbinfo->indices.chatById.end()) {
+        return std::nullopt;
     }
-    return std::nullopt;
+    return dbinfo->object.chattonames(it->second).name();
 }
 
 bool ProtoDatabase::deleteChatInfo(const ChatId chatId) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DELETE_CHAT);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo.has_value()) {
         LOG_ONCE(WARNING) << "Database not loaded! Cannot delete chat info!";
         return false;
     }
-    auto* chatToNames = dbinfo->object.mutable_chattonames();
-    for (int i = 0; i < chatToNames->size(); ++i) {
-        if (chatToNames->Get(i).telegramchatid() == chatId) {
-            Database previous = dbinfo->object;
-            chatToNames->DeleteSubrange(i, 1);
-            if (persistLocked()) {
-                return true;
-            }
-            dbinfo->object = std::move(previous);
-            return false;
-        }
+    if (!dbinfo->indices.chatById.contains(chatId)) {
+        return false;
     }
-    return false;
+    JournalRecord record;
+    record.set_deletechat(chatId);
+    return commitLocked(record);
 }
 
 std::vector<ProtoDatabase::ChatInfo> ProtoDatabase::getAllChatInfos() const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_ALL_CHATS);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo.has_value()) {
         LOG_ONCE(WARNING) << "Database not loaded! Cannot get chat infos!";
         return {};
     }
+    DatabaseMetrics::Scope::addRowsScanned(dbinfo->object.chattonames_size());
     std::vector<ChatInfo> result;
     for (const auto& chatInfo : dbinfo->object.chattonames()) {
         ChatInfo info;
@@ -315,7 +757,7 @@ std::vector<ProtoDatabase::ChatInfo> ProtoDatabase::getAllChatInfos() const {
 }
 
 bool ProtoDatabase::load(std::filesystem::path filepath) {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    std::lock_guard lock(dbinfo_mutex_);
     GOOGLE_PROTOBUF_VERIFY_VERSION;
 
     if (dbinfo.has_value()) {
@@ -328,49 +770,83 @@ bool ProtoDatabase::load(std::filesystem::path filepath) {
 
     if (filepath == kInMemoryDatabase) {
         LOG(INFO) << "Loading in-memory database";
+        refreshAclLocked();
         return true;
     }
 
-    std::fstream input(filepath.string(), std::ios::in | std::ios::binary);
-    if (!input.is_open()) {
-        LOG(INFO) << "Creating new file: " << filepath;
-        // Nothing to load here...
-        return true;
+    {
+        std::fstream input(filepath.string(),
+                           std::ios::in | std::ios::binary);
+        if (!input.is_open()) {
+            LOG(INFO) << "Creating new file: " << filepath;
+        } else if (!dbinfo->object.ParseFromIstream(&input)) {
+            LOG(ERROR) << "Failed to parse input file as protobuf";
+            dbinfo.reset();
+            return false;
+        }
     }
-    if (dbinfo->object.ParseFromIstream(&input)) {
-        return true;
+    rebuildIndicesLocked();
+    std::error_code ec;
+    const auto snapshotBytes = std::filesystem::file_size(filepath, ec);
+    dbinfo->snapshotBytes = ec ? 0 : snapshotBytes;
+
+    // Mutations since the last compaction only exist in the journal.
+    if (!replayJournalLocked()) {
+        dbinfo.reset();
+        return false;
     }
-    LOG(ERROR) << "Failed to parse input file as protobuf";
-    dbinfo.reset();
-    return false;
+    dbinfo->journal.open(journalPathFor(filepath),
+                         std::ios::binary | std::ios::app);
+    if (!dbinfo->journal.is_open()) {
+        LOG(ERROR) << "Failed to open journal " << journalPathFor(filepath);
+        dbinfo.reset();
+        return false;
+    }
+    compactRequested_ = false;
+    compactor_ = std::jthread(
+        [this](std::stop_token stop) { runCompactor(std::move(stop)); });
+    refreshAclLocked();
+    return true;
 }
 
 bool ProtoDatabase::unload() {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    if (!dbinfo.has_value()) {
-        LOG(WARNING) << "Database not loaded! Cannot unload!";
+    stopCompactor();
+    // Leave a snapshot that needs no replay. Anything journaled after this
+    // is still replayed by the next load.
+    if (!compact()) {
+        std::lock_guard lock(dbinfo_mutex_);
+        if (!dbinfo.has_value()) {
+            LOG(WARNING) << "Database not loaded! Cannot unload!";
+        } else {
+            compactor_ = std::jthread([this](std::stop_token stop) {
+                runCompactor(std::move(stop));
+            });
+        }
         return false;
     }
 
-    if (!persistLocked()) {
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo.has_value()) {
+        LOG(WARNING) << "Database not loaded! Cannot unload!";
         return false;
     }
     dbinfo.reset();
+    acl_.clear();
     return true;
 }
 
 std::optional<UserId> ProtoDatabase::getOwnerUserId() const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    if (!dbinfo.has_value()) {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_OWNER);
+    if (!acl_.available()) {
         LOG_ONCE(WARNING)
             << "Database not loaded! Cannot determine owner user id!";
         return std::nullopt;
     }
-    if (!dbinfo->object.has_ownerid()) {
+    const auto owner = acl_.owner();
+    if (!owner) {
         LOG_ONCE(WARNING) << "Database does not contain owner user id!";
-        return std::nullopt;
     }
-    return dbinfo->object.ownerid();
+    return owner;
 }
 
 void ProtoDatabase::dumpList(std::ostream& os, const PersonList& list,
@@ -411,122 +887,342 @@ const PersonList& ProtoDatabase::getOtherPersonList(
     CHECK(false) << "unreachable";
 }
 
+std::vector<ProtoDatabase::MediaMatch> ProtoDatabase::searchMedia(
+    const std::string_view query, const std::size_t limit) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::SEARCH_MEDIA);
+    const media_search::Query parsed(query);
+    if (parsed.text.empty() || limit == 0) {
+        return {};
+    }
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return {};
+    }
+    // Every alias the scorer can accept shares a trigram with the query,
+    // so the candidates are the union of the query's posting lists.
+    const auto& byTrigram = dbinfo->indices.aliasesByTrigram;
+    std::unordered_set<const Indices::AliasEntry*> candidates;
+    for (const auto& gram : parsed.grams) {
+        if (const auto it = byTrigram.find(gram); it != byTrigram.end()) {
+            candidates.insert(it->second.begin(), it->second.end());
+        }
+    }
+    std::vector<MediaMatch> matches;
+    for (const auto* const candidate : candidates) {
+        const auto& [alias, positions] = *candidate;
+        const auto score = media_search::score(parsed, alias);
+        if (!score) {
+            continue;
+        }
+        for (const int position : positions) {
+            const auto& media = dbinfo->object.mediatonames(position);
+            // Report the alias as it was stored, not lowercased.
+            const auto name =
+                std::ranges::find_if(media.names(), [&](const auto& stored) {
+                    return absl::EqualsIgnoreCase(stored, alias);
+                });
+            matches.push_back(
+                {name != media.names().end() ? *name : alias,
+                 media.telegrammediaid(), media.telegrammediauniqueid(),
+                 static_cast<MediaType>(media.mediatype()), *score});
+        }
+    }
+    return media_search::rank(std::move(matches), limit);
+}
+
 std::optional<ProtoDatabase::MediaInfo> ProtoDatabase::queryMediaInfo(
     std::string str) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    std::optional<glider::proto::database::MediaToName> it;
-    const auto& obj = dbinfo->object;
-    for (const auto& mediaEntriesIt : obj.mediatonames()) {
-        for (const auto& name : mediaEntriesIt.names()) {
-            if (absl::EqualsIgnoreCase(name, str)) {
-                it = mediaEntriesIt;
-                break;
-            }
-        }
+    const DatabaseMetrics::Scope scope(metrics_, Operation::QUERY_MEDIA);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return std::nullopt;
     }
-    if (!it.has_value()) {
+    const auto& byAlias = dbinfo->indices.mediaByAlias;
+    const auto entry = byAlias.find(absl::AsciiStrToLower(str));
+    if (entry == byAlias.end()) {
         return std::nullopt;
     }
+    // The last entry carrying the alias wins, as it did for the scan.
+    const auto& it = dbinfo->object.mediatonames(entry->second.back());
     MediaInfo info;
-    info.mediaId = it->telegrammediaid();
-    info.mediaUniqueId = it->telegrammediauniqueid();
-    info.mediaType = static_cast<MediaType>(it->mediatype());
+    info.mediaId = it.telegrammediaid();
+    info.mediaUniqueId = it.telegrammediauniqueid();
+    info.mediaType = static_cast<MediaType>(it.mediatype());
     return info;
 }
 
 ProtoDatabase::AddResult ProtoDatabase::addMediaInfo(
     const MediaInfo& info) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_MEDIA);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo) {
         return AddResult::BACKEND_ERROR;
     }
-    auto* const mediaEntries = dbinfo->object.mutable_mediatonames();
-    for (const auto& elem : *mediaEntries) {
-        if (elem.telegrammediauniqueid() == info.mediaUniqueId) {
-            return AddResult::ALREADY_EXISTS;
-        }
-    }
-    Database previous = dbinfo->object;
-    auto* const mediaEntry = mediaEntries->Add();
-    mediaEntry->set_telegrammediaid(info.mediaId);
-    mediaEntry->set_telegrammediauniqueid(info.mediaUniqueId);
-    mediaEntry->set_mediatype(
-        static_cast<glider::proto::database::MediaType>(info.mediaType));
-    auto* const mediaNames = mediaEntry->mutable_names();
-    for (const auto& name : info.names) {
-        *mediaNames->Add() = name;
+    if (dbinfo->indices.mediaByUniqueId.contains(info.mediaUniqueId)) {
+        return AddResult::ALREADY_EXISTS;
     }
-    if (persistLocked()) {
-        return AddResult::OK;
+    JournalRecord record;
+    toMediaToName(info, record.mutable_addmedia());
+    if (!commitLocked(record)) {
+        return AddResult::BACKEND_ERROR;
     }
-    dbinfo->object = std::move(previous);
-    return AddResult::BACKEND_ERROR;
+    return AddResult::OK;
 }
 
 std::vector<ProtoDatabase::MediaInfo> ProtoDatabase::getAllMediaInfos() const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_ALL_MEDIA);
     std::vector<MediaInfo> result;
-    for (const auto& mediaEntriesIt : dbinfo->object.mediatonames()) {
-        MediaInfo info;
-        info.mediaId = mediaEntriesIt.telegrammediaid();
-        info.mediaUniqueId = mediaEntriesIt.telegrammediauniqueid();
-        info.mediaType = static_cast<MediaType>(mediaEntriesIt.mediatype());
-        for (const auto& name : mediaEntriesIt.names()) {
-            info.names.emplace_back(name);
-        }
+    forEachMediaInfo([&result](const MediaInfo& info) {
         result.emplace_back(info);
-    }
+        return true;
+    });
     return result;
 }
 
-bool ProtoDatabase::deleteMediaInfo(
-    const decltype(MediaInfo::mediaId) mediaId) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    auto* mediaToNames = dbinfo->object.mutable_mediatonames();
-    for (int i = 0; i < mediaToNames->size(); ++i) {
-        if (mediaToNames->Get(i).telegrammediaid() == mediaId) {
-            Database previous = dbinfo->object;
-            mediaToNames->DeleteSubrange(i, 1);
-            if (persistLocked()) {
-                return true;
+void ProtoDatabase::forEachMediaInfo(
+    const std::function<bool(const MediaInfo&)>& visitor) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::FOR_EACH_MEDIA);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return;
+    }
+    for (const auto& media : dbinfo->object.mediatonames()) {
+        DatabaseMetrics::Scope::addRowsScanned(1);
+        if (!visitor(fromMediaToName(media))) {
+            return;
+        }
+    }
+}
+
+bool ProtoDatabase::exportRows(
+    const std::function<bool(std::span<const DumpRow>)>& sink,
+    const std::size_t batchSize) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::EXPORT);
+    // Sections in export order: owner, whitelist, blacklist, media, chats.
+    constexpr int kSections = 5;
+    const auto sectionSize = [this](const int section) -> int {
+        const auto& object = dbinfo->object;
+        switch (section) {
+            case 0:
+                return object.has_ownerid() ? 1 : 0;
+            case 1:
+                return object.whitelist().id_size();
+            case 2:
+                return object.blacklist().id_size();
+            case 3:
+                return object.mediatonames_size();
+            default:
+                return object.chattonames_size();
+        }
+    };
+    const auto rowAt = [this](const int section, const int index) -> DumpRow {
+        const auto& object = dbinfo->object;
+        switch (section) {
+            case 0:
+                return UserInfo{object.ownerid(), std::nullopt};
+            case 1:
+                return UserInfo{object.whitelist().id(index),
+                                ListType::WHITELIST};
+            case 2:
+                return UserInfo{object.blacklist().id(index),
+                                ListType::BLACKLIST};
+            case 3:
+                return fromMediaToName(object.mediatonames(index));
+            default: {
+                const auto& chat = object.chattonames(index);
+                return ChatInfo{chat.telegramchatid(), chat.name()};
             }
-            dbinfo->object = std::move(previous);
+        }
+    };
+
+    // Copy one batch under the lock and hand it over after releasing it.
+    // This is not a snapshot: entries removed between batches shift the
+    // ones after them, which may then be skipped.
+    const auto limit = std::max<std::size_t>(batchSize, 1);
+    int section = 0;
+    int index = 0;
+    std::vector<DumpRow> rows;
+    rows.reserve(limit);
+    while (section < kSections) {
+        {
+            std::lock_guard lock(dbinfo_mutex_);
+            if (!dbinfo) {
+                return false;
+            }
+            while (rows.size() < limit && section < kSections) {
+                if (index < sectionSize(section)) {
+                    rows.emplace_back(rowAt(section, index++));
+                } else {
+                    ++section;
+                    index = 0;
+                }
+            }
+        }
+        DatabaseMetrics::Scope::addRowsScanned(rows.size());
+        if (!rows.empty() && !sink(rows)) {
             return false;
         }
+        rows.clear();
     }
-    return false;
+    return true;
+}
+
+std::vector<ProtoDatabase::AddResult> ProtoDatabase::addMediaInfos(
+    const std::span<const MediaInfo> infos) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_MEDIAS);
+    std::lock_guard lock(dbinfo_mutex_);
+    std::vector<AddResult> results(infos.size(), AddResult::BACKEND_ERROR);
+    if (!dbinfo) {
+        return results;
+    }
+    JournalRecord record;
+    auto* const batch = record.mutable_batch();
+    std::unordered_set<std::string_view> batched;
+    for (size_t i = 0; i < infos.size(); ++i) {
+        const auto& info = infos[i];
+        if (dbinfo->indices.mediaByUniqueId.contains(info.mediaUniqueId) ||
+            !batched.emplace(info.mediaUniqueId).second) {
+            results[i] = AddResult::ALREADY_EXISTS;
+            continue;
+        }
+        toMediaToName(info, batch->add_records()->mutable_addmedia());
+        results[i] = AddResult::OK;
+    }
+    if (batch->records_size() != 0 && !commitLocked(record)) {
+        std::ranges::fill(results, AddResult::BACKEND_ERROR);
+    }
+    return results;
+}
+
+std::vector<ProtoDatabase::AddResult> ProtoDatabase::addChatInfos(
+    const std::span<const ChatInfo> chats) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_CHATS);
+    std::lock_guard lock(dbinfo_mutex_);
+    std::vector<AddResult> results(chats.size(), AddResult::BACKEND_ERROR);
+    if (!dbinfo) {
+        return results;
+    }
+    JournalRecord record;
+    auto* const batch = record.mutable_batch();
+    std::unordered_set<ChatId> batched;
+    for (size_t i = 0; i < chats.size(); ++i) {
+        const auto& chat = chats[i];
+        if (dbinfo->indices.chatById.contains(chat.chatId) ||
+            !batched.emplace(chat.chatId).second) {
+            results[i] = AddResult::ALREADY_EXISTS;
+            continue;
+        }
+        auto* const entry = batch->add_records()->mutable_addchat();
+        entry->set_telegramchatid(chat.chatId);
+        entry->set_name(chat.name);
+        results[i] = AddResult::OK;
+    }
+    if (batch->records_size() != 0 && !commitLocked(record)) {
+        std::ranges::fill(results, AddResult::BACKEND_ERROR);
+    }
+    return results;
+}
+
+std::vector<ProtoDatabase::ListResult> ProtoDatabase::addUsersToList(
+    const ListType type, const std::span<const UserId> users) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_USERS);
+    std::lock_guard lock(dbinfo_mutex_);
+    std::vector<ListResult> results(users.size(), ListResult::BACKEND_ERROR);
+    if (!dbinfo) {
+        return results;
+    }
+    const auto& mine = getPersonList(type).id();
+    const auto& other = getOtherPersonList(type).id();
+    std::unordered_set<UserId> listed(mine.begin(), mine.end());
+    const std::unordered_set<UserId> otherListed(other.begin(), other.end());
+    const auto& object = dbinfo->object;
+
+    JournalRecord record;
+    auto* const batch = record.mutable_batch();
+    for (size_t i = 0; i < users.size(); ++i) {
+        const auto user = users[i];
+        if (otherListed.contains(user) ||
+            (type == ListType::BLACKLIST && object.has_ownerid() &&
+             object.ownerid() == user)) {
+            results[i] = ListResult::ALREADY_IN_OTHER_LIST;
+            continue;
+        }
+        if (!listed.emplace(user).second) {
+            results[i] = ListResult::ALREADY_IN_LIST;
+            continue;
+        }
+        auto* const change = batch->add_records()->mutable_adduser();
+        change->set_list(toJournalList(type));
+        change->set_id(user);
+        results[i] = ListResult::OK;
+    }
+    if (batch->records_size() == 0) {
+        return results;
+    }
+    if (!commitLocked(record)) {
+        std::ranges::fill(results, ListResult::BACKEND_ERROR);
+        return results;
+    }
+    refreshAclLocked();
+    return results;
+}
+
+bool ProtoDatabase::deleteMediaInfo(
+    const decltype(MediaInfo::mediaId) mediaId) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DELETE_MEDIA);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return false;
+    }
+    if (!dbinfo->indices.mediaById.contains(mediaId)) {
+        return false;
+    }
+    JournalRecord record;
+    record.set_deletemedia(mediaId);
+    return commitLocked(record);
 }
 
 std::optional<std::vector<decltype(ProtoDatabase::MediaInfo::mediaId)>>
 ProtoDatabase::getMediaIds(const std::string_view alias) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    std::vector<decltype(MediaInfo::mediaId)> result;
-    const auto& obj = dbinfo->object;
-    for (const auto& mediaEntriesIt : obj.mediatonames()) {
-        for (const auto& name : mediaEntriesIt.names()) {
-            if (absl::EqualsIgnoreCase(name, alias)) {
-                result.emplace_back(mediaEntriesIt.telegrammediaid());
-            }
-        }
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_MEDIA_IDS);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return std::nullopt;
     }
-    if (result.empty()) {
+    const auto& byAlias = dbinfo->indices.mediaByAlias;
+    const auto entry = byAlias.find(absl::AsciiStrToLower(alias));
+    if (entry == byAlias.end()) {
         return std::nullopt;
     }
+    std::vector<decltype(MediaInfo::mediaId)> result;
+    result.reserve(entry->second.size());
+    for (const int position : entry->second) {
+        result.emplace_back(
+            dbinfo->object.mediatonames(position).telegrammediaid());
+    }
     return result;
-    ;
 }
 
 std::ostream& ProtoDatabase::dump(std::ostream& os) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    if (!dbinfo.has_value()) {
-        os << "Database not loaded!";
-        return os;
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DUMP);
+    // Copy it under the lock and format it after releasing the lock, so
+    // writers don't wait on the stream.
+    Database db;
+    std::filesystem::path path;
+    {
+        std::lock_guard lock(dbinfo_mutex_);
+        if (!dbinfo.has_value()) {
+            os << "Database not loaded!";
+            return os;
+        }
+        db = dbinfo->object;
+        path = dbinfo->path;
     }
-    const auto& db = dbinfo->object;
+    DatabaseMetrics::Scope::addRowsScanned(db.mediatonames_size() +
+                                           db.chattonames_size());
 
     os << fmt::format("Dump of database file: {}\nOwner ID: {}\n",
-                      dbinfo->path.string(),
-                      db.has_ownerid() ? db.ownerid() : -1);
+                      path.string(), db.has_ownerid() ? db.ownerid() : -1);
 
     if (db.has_whitelist()) {
         dumpList(os, db.whitelist(), "whitelist");
@@ -537,7 +1233,7 @@ std::ostream& ProtoDatabase::dump(std::ostream& os) const {
 
     int count = 0;
     os << fmt::format("\nMediaNames Dump: (Size {})\n", db.mediatonames_size());
-    for (auto const& medias : *getMediaToName()) {
+    for (auto const& medias : db.mediatonames()) {
         os << fmt::format("- Entry {}:\n", count++);
         if (medias.has_telegrammediaid()) {
             os << fmt::format("\tMedia FileId: {}\n", medias.telegrammediaid());
@@ -552,8 +1248,7 @@ std::ostream& ProtoDatabase::dump(std::ostream& os) const {
         os << fmt::format("\tMedia Names: {}\n",
                           fmt::join(medias.names(), ", "));
     }
-    os << fmt::format("\nChatNames Dump: (Size {})\n",
-                      dbinfo->object.chattonames_size());
+    os << fmt::format("\nChatNames Dump: (Size {})\n", db.chattonames_size());
     count = 0;
     for (const auto& chat : db.chattonames()) {
         os << fmt::format("- Entry {}:\n", count++);
@@ -573,7 +1268,8 @@ void ProtoDatabase::setOwnerUserId(UserId userId) const {
 
 DatabaseBase::OwnerClaimResult ProtoDatabase::claimOwnerUserId(
     const UserId userId) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::CLAIM_OWNER);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo.has_value()) {
         LOG(WARNING) << "Database not loaded! Cannot set owner user id!";
         return OwnerClaimResult::BACKEND_ERROR;
@@ -587,45 +1283,46 @@ DatabaseBase::OwnerClaimResult ProtoDatabase::claimOwnerUserId(
                    << " as owner";
         return OwnerClaimResult::BACKEND_ERROR;
     }
-    dbinfo->object.set_ownerid(userId);
-    if (persistLocked()) {
-        return OwnerClaimResult::OK;
+    JournalRecord record;
+    record.set_setownerid(userId);
+    if (!commitLocked(record)) {
+        return OwnerClaimResult::BACKEND_ERROR;
     }
-    dbinfo->object.clear_ownerid();
-    return OwnerClaimResult::BACKEND_ERROR;
+    refreshAclLocked();
+    return OwnerClaimResult::OK;
 }
 
 [[nodiscard]] ProtoDatabase::AddResult ProtoDatabase::addChatInfo(
     const ChatId chatid, const std::string_view name) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_CHAT);
+    std::lock_guard lock(dbinfo_mutex_);
     if (!dbinfo) {
         return AddResult::BACKEND_ERROR;
     }
-    auto* const chats = dbinfo->object.mutable_chattonames();
-    for (const auto& chat : *chats) {
-        if (chat.telegramchatid() == chatid) {
-            return AddResult::ALREADY_EXISTS;
-        }
+    if (dbinfo->indices.chatById.contains(chatid)) {
+        return AddResult::ALREADY_EXISTS;
     }
-    Database previous = dbinfo->object;
-    auto* const chat = chats->Add();
+    JournalRecord record;
+    auto* const chat = record.mutable_addchat();
     chat->set_telegramchatid(chatid);
     chat->set_name(name.data(), name.size());
-    if (persistLocked()) {
-        return AddResult::OK;
+    if (!commitLocked(record)) {
+        return AddResult::BACKEND_ERROR;
     }
-    dbinfo->object = std::move(previous);
-    return AddResult::BACKEND_ERROR;
+    return AddResult::OK;
 }
 
 [[nodiscard]] std::optional<ChatId> ProtoDatabase::getChatId(
     const std::string_view name) const {
-    std::lock_guard<std::mutex> lock(dbinfo_mutex_);
-    const auto& obj = dbinfo->object;
-    for (const auto& chat : obj.chattonames()) {
-        if (absl::EqualsIgnoreCase(chat.name(), name)) {
-            return chat.telegramchatid();
-        }
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_CHAT_ID);
+    std::lock_guard lock(dbinfo_mutex_);
+    if (!dbinfo) {
+        return std::nullopt;
     }
-    return std::nullopt;
+    const auto& byName = dbinfo->indices.chatByName;
+    const auto it = byName.find(absl::AsciiStrToLower(name));
+    if (it == byName.end()) {
+        return std::nullopt;
+    }
+    return it->second;
 }
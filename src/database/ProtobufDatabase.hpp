@@ -3,13 +3,23 @@
 #include <DBImplExports.h>
 #include <TgBotDB.pb.h>
 
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
 #include <mutex>
 #include <optional>
 #include <ostream>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
 
+#include "AclSnapshot.hpp"
 #include "DatabaseBase.hpp"
+#include "DatabaseMetrics.hpp"
 
 using glider::proto::database::Database;
+using glider::proto::database::JournalRecord;
 using glider::proto::database::MediaToName;
 using glider::proto::database::PersonList;
 using google::protobuf::RepeatedField;
@@ -24,6 +34,8 @@ struct DBIMPL_EXPORT ProtoDatabase : DatabaseBase {
                                                 UserId user) const override;
     [[nodiscard]] ListResult checkUserInList(ListType type,
                                              UserId user) const override;
+    [[nodiscard]] std::vector<UserId> getUsersInList(
+        ListType type) const override;
     bool load(std::filesystem::path filepath) override;
     bool unload() override;
     [[nodiscard]] std::optional<UserId> getOwnerUserId() const override;
@@ -48,14 +60,66 @@ struct DBIMPL_EXPORT ProtoDatabase : DatabaseBase {
         const ChatId chatId) const override;
     bool deleteChatInfo(const ChatId chatId) const override;
     [[nodiscard]] std::vector<ChatInfo> getAllChatInfos() const override;
+    [[nodiscard]] std::vector<AddResult> addMediaInfos(
+        std::span<const MediaInfo> infos) const override;
+    [[nodiscard]] std::vector<AddResult> addChatInfos(
+        std::span<const ChatInfo> chats) const override;
+    [[nodiscard]] std::vector<ListResult> addUsersToList(
+        ListType type, std::span<const UserId> users) const override;
+    void forEachMediaInfo(
+        const std::function<bool(const MediaInfo&)>& visitor) const override;
+    [[nodiscard]] bool exportRows(
+        const std::function<bool(std::span<const DumpRow>)>& sink,
+        std::size_t batchSize) const override;
+    [[nodiscard]] std::vector<MediaMatch> searchMedia(
+        std::string_view query, std::size_t limit) const override;
+    [[nodiscard]] DatabaseMetrics* metrics() const override {
+        return &metrics_;
+    }
+
+    // Where the mutation journal of the database at `path` is kept.
+    static std::filesystem::path journalPathFor(
+        const std::filesystem::path& path);
 
    private:
+    // Hash indices over the repeated fields of Database, so lookups do not
+    // scan every entry. Positions refer to mediatonames() and chattonames().
+    // Names and aliases are keyed lowercased, as they are matched ignoring
+    // ASCII case.
+    struct Indices {
+        // Every occurrence of an alias, in entry order.
+        std::unordered_map<std::string, std::vector<int>> mediaByAlias;
+        using AliasEntry = decltype(mediaByAlias)::value_type;
+        // Aliases by the media_search::trigrams() they contain. Points into
+        // mediaByAlias, whose nodes stay put until they are erased.
+        std::unordered_map<std::string, std::vector<const AliasEntry*>>
+            aliasesByTrigram;
+        std::unordered_map<std::string, int> mediaByUniqueId;
+        // First entry with the given TelegramMediaId.
+        std::unordered_map<std::string, int> mediaById;
+        // First chat with the given name.
+        std::unordered_map<std::string, ChatId> chatByName;
+        std::unordered_map<ChatId, int> chatById;
+    };
     struct Info {
         mutable Database object;
         std::filesystem::path path;
+        // Append handle on the journal. Not opened for in-memory databases.
+        mutable std::ofstream journal;
+        // Sizes of the journal and of the snapshot it is replayed on.
+        mutable std::uintmax_t journalBytes = 0;
+        mutable std::uintmax_t snapshotBytes = 0;
+        mutable Indices indices;
     };
     std::optional<Info> dbinfo;
-    mutable std::mutex dbinfo_mutex_;
+    mutable MeteredMutex<std::mutex> dbinfo_mutex_;
+    // Serializes compactions, taken before dbinfo_mutex_.
+    mutable std::mutex compaction_mutex_;
+    mutable std::condition_variable_any compactCondition_;
+    mutable bool compactRequested_ = false;
+    // Served to checkUserInList() and getOwnerUserId() without the lock.
+    mutable AclSnapshot acl_;
+    mutable DatabaseMetrics metrics_{"Proto"};
 
     static void dumpList(std::ostream& os, const PersonList& list,
                          const char* name);
@@ -67,5 +131,34 @@ struct DBIMPL_EXPORT ProtoDatabase : DatabaseBase {
     const PersonList& getOtherPersonList(ListType type) const;
     static std::optional<int> findByUid(const RepeatedField<UserId>& list,
                                         const UserId uid);
-    [[nodiscard]] bool persistLocked() const;
+    // Indexes the entry at `position`, which must be the last one.
+    void indexMediaLocked(int position) const;
+    void indexChatLocked(int position) const;
+    // Drops the entry at `position` from the indices, before it is deleted,
+    // and shifts the positions after it down by one.
+    void unindexMediaLocked(int position) const;
+    void unindexChatLocked(int position) const;
+    void rebuildIndicesLocked() const;
+    // Applies one mutation to dbinfo. Records are idempotent, so replaying
+    // a journal over a snapshot that already contains it is harmless.
+    void applyLocked(const JournalRecord& record) const;
+    // Journals the record durably, then applies it. Caller holds
+    // dbinfo_mutex_.
+    [[nodiscard]] bool commitLocked(const JournalRecord& record) const;
+    [[nodiscard]] bool appendJournalLocked(const JournalRecord& record) const;
+    [[nodiscard]] bool replayJournalLocked() const;
+    // Drops the first `covered` bytes of the journal, now in the snapshot.
+    [[nodiscard]] bool truncateJournalLocked(std::uintmax_t covered) const;
+    // Folds the journal into a fresh snapshot. Writing the snapshot happens
+    // outside dbinfo_mutex_, so mutations are only blocked while it is
+    // serialized.
+    [[nodiscard]] bool compact() const;
+    void runCompactor(std::stop_token stop) const;
+    void stopCompactor();
+    // Republishes acl_ from dbinfo. Caller holds dbinfo_mutex_.
+    void refreshAclLocked() const;
+
+    // Declared last so it is stopped before the state it compacts is
+    // destroyed.
+    std::jthread compactor_;
 };
@@ -4,7 +4,10 @@
 #include <absl/log/log.h>
 #include <absl/strings/ascii.h>
 #include <fmt/core.h>
+#include <fmt/ranges.h>
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
@@ -18,10 +21,12 @@
 #include <string>
 #include <string_view>
 #include <system_error>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <variant>
 
+#include "MediaSearch.hpp"
 #include "api/typedefs.h"
 
 #ifdef TGBOTCPP_ENABLE_CPPTRACE
@@ -29,22 +34,18 @@
 #endif
 
 namespace {
-// Hash function for std::pair to use with unordered_map
-struct PairHash {
-    template <typename T1, typename T2>
-    std::size_t operator()(const std::pair<T1, T2>& p) const {
-        auto h1 = std::hash<T1>{}(p.first);
-        auto h2 = std::hash<T2>{}(p.second);
-        // Use boost::hash_combine formula for better hash distribution
-        return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2));
-    }
-};
+using Operation = DatabaseMetrics::Operation;
 
 class SQLiteTransaction {
    public:
-    explicit SQLiteTransaction(sqlite3* db) : db_(db) {
-        active_ = sqlite3_exec(db_, "BEGIN IMMEDIATE", nullptr, nullptr,
-                               nullptr) == SQLITE_OK;
+    // Writers take the write lock up front. Readers pass "BEGIN", which on
+    // a WAL connection pins one snapshot for every statement until the
+    // transaction ends.
+    explicit SQLiteTransaction(sqlite3* db,
+                               const char* begin = "BEGIN IMMEDIATE")
+        : db_(db) {
+        active_ = sqlite3_exec(db_, begin, nullptr, nullptr, nullptr) ==
+                  SQLITE_OK;
     }
     ~SQLiteTransaction() {
         if (active_) {
@@ -65,6 +66,73 @@ class SQLiteTransaction {
     sqlite3* db_{};
     bool active_{};
 };
+
+// Bounds for the read-only connection pool, sized by hardware threads.
+constexpr unsigned int kMinReaderConnections = 2;
+constexpr unsigned int kMaxReaderConnections = 8;
+// Readers can briefly wait on the writer while it checkpoints the WAL.
+constexpr int kBusyTimeoutMs = 5000;
+
+// Version 3 indexes aliases for searchMedia(). The triggers keep the
+// external-content FTS table in step with medianame.
+constexpr const char* kSearchMigration =
+    "BEGIN IMMEDIATE;"
+    "CREATE VIRTUAL TABLE IF NOT EXISTS medianame_fts USING fts5("
+    "name, content='medianame', content_rowid='id', tokenize='trigram');"
+    "CREATE TRIGGER IF NOT EXISTS medianame_fts_insert AFTER INSERT ON "
+    "medianame BEGIN INSERT INTO medianame_fts(rowid, name) VALUES "
+    "(new.id, new.name); END;"
+    "CREATE TRIGGER IF NOT EXISTS medianame_fts_delete AFTER DELETE ON "
+    "medianame BEGIN INSERT INTO medianame_fts(medianame_fts, rowid, name) "
+    "VALUES ('delete', old.id, old.name); END;"
+    "INSERT INTO medianame_fts(medianame_fts) VALUES ('rebuild');"
+    "PRAGMA user_version = 3;"
+    "COMMIT;";
+
+// Rows the index is asked for per requested match, before rescoring.
+constexpr std::size_t kSearchCandidatesPerMatch = 4;
+
+// ORs the trigrams of a lowercased query of three or more characters into
+// an FTS5 MATCH expression. Trigrams are cut at UTF-8 character boundaries
+// as the trigram tokenizer works on characters.
+std::string toMatchExpression(const std::string_view text) {
+    std::vector<std::size_t> starts;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            starts.emplace_back(i);
+        }
+    }
+    starts.emplace_back(text.size());
+    std::vector<std::string> phrases;
+    for (std::size_t i = 0; i + 3 < starts.size(); ++i) {
+        std::string phrase = "\"";
+        for (const char c : text.substr(starts[i], starts[i + 3] - starts[i])) {
+            phrase += c;
+            if (c == '"') {
+                phrase += '"';
+            }
+        }
+        phrase += '"';
+        phrases.emplace_back(std::move(phrase));
+    }
+    std::ranges::sort(phrases);
+    const auto [first, last] = std::ranges::unique(phrases);
+    phrases.erase(first, last);
+    return fmt::format("{}", fmt::join(phrases, " OR "));
+}
+
+// A LIKE pattern matching names that start with text.
+std::string toPrefixPattern(const std::string_view text) {
+    std::string pattern;
+    for (const char c : text) {
+        if (c == '%' || c == '_' || c == '\\') {
+            pattern += '\\';
+        }
+        pattern += c;
+    }
+    pattern += '%';
+    return pattern;
+}
 }  // namespace
 
 void SQLiteDatabase::Helper::logInvalidState(
@@ -126,8 +194,13 @@ bool SQLiteDatabase::Helper::prepare() {
             logInvalidState(std::source_location::current(), state);
             return false;
     };
-    auto ret =
-        sqlite3_prepare_v2(db, scriptContent.c_str(), -1, &stmt, &pztail);
+    if (cached != nullptr && cached->stmt != nullptr && !cached->inUse) {
+        cached->inUse = true;
+        stmt = cached->stmt;
+        state = State::PREPARED;
+        return true;
+    }
+    auto ret = sqlite3_prepare_v2(db, source().c_str(), -1, &stmt, &pztail);
     if (ret != SQLITE_OK) {
         LOG(ERROR) << "Failed to prepare statement: " << sqlite3_errmsg(db);
         state = State::FAILED_TO_PREPARE;
@@ -154,7 +227,7 @@ bool SQLiteDatabase::Helper::executeAsScript() {
 
     state = State::EXECUTED_AS_SCRIPT;
     LOG(INFO) << "Executing SQL script...";
-    if (sqlite3_exec(db, scriptContent.c_str(), nullptr, nullptr,
+    if (sqlite3_exec(db, source().c_str(), nullptr, nullptr,
                      &err_message) != SQLITE_OK) {
         LOG(ERROR) << "Failed to execute SQL script: " << err_message;
         sqlite3_free(err_message);
@@ -168,6 +241,9 @@ bool SQLiteDatabase::Helper::executeAsScript() {
 SQLiteDatabase::Helper::Helper(sqlite3* db, std::string content)
     : db(db), scriptContent(std::move(content)) {}
 
+SQLiteDatabase::Helper::Helper(sqlite3* db, CachedStatement& cached)
+    : db(db), cached(&cached) {}
+
 SQLiteDatabase::Helper::~Helper() {
     switch (state) {
         case State::NOTHING:
@@ -178,6 +254,15 @@ SQLiteDatabase::Helper::~Helper() {
         case State::PREPARED:
         case State::HAS_ARGUMENTS:
             if (stmt != nullptr) {
+                DatabaseMetrics::Scope::addRowsScanned(sqlite3_stmt_status(
+                    stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, /*resetFlg=*/1));
+            }
+            if (cached != nullptr && stmt == cached->stmt) {
+                // Hand the statement back to the cache in a clean state.
+                sqlite3_reset(stmt);
+                sqlite3_clear_bindings(stmt);
+                cached->inUse = false;
+            } else if (stmt != nullptr) {
                 sqlite3_finalize(stmt);
             }
             break;
@@ -320,9 +405,18 @@ SQLiteDatabase::Helper::getNextStatement() {
 SQLiteDatabase::ListResult SQLiteDatabase::addUserToList(InfoType type,
                                                          UserId user) const {
     const std::lock_guard lock(db_mutex_);
+    const auto res = insertUser(type, user);
+    if (res == ListResult::OK) {
+        refreshAcl();
+    }
+    return res;
+}
+
+SQLiteDatabase::ListResult SQLiteDatabase::insertUser(InfoType type,
+                                                      UserId user) const {
     ListResult res{};
 
-    res = checkUserInList(type, user);
+    res = checkUserInList(writer_, type, user);
     switch (res) {
         case ListResult::NOT_IN_LIST:
             break;
@@ -337,7 +431,7 @@ SQLiteDatabase::ListResult SQLiteDatabase::addUserToList(InfoType type,
         case ListResult::BACKEND_ERROR:
             return res;
     }
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kInsertUserFile);
+    auto helper = helperFor(writer_, Helper::kInsertUserFile);
     if (!helper->prepare()) {
         return ListResult::BACKEND_ERROR;
     }
@@ -350,18 +444,44 @@ SQLiteDatabase::ListResult SQLiteDatabase::addUserToList(InfoType type,
     return ListResult::BACKEND_ERROR;
 }
 
+std::vector<SQLiteDatabase::ListResult> SQLiteDatabase::addUsersToList(
+    ListType type, std::span<const UserId> users) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_USERS);
+    const std::lock_guard lock(db_mutex_);
+    std::vector<ListResult> results(users.size(), ListResult::BACKEND_ERROR);
+    SQLiteTransaction transaction(writer_.db);
+    if (!transaction.active()) {
+        return results;
+    }
+    for (size_t i = 0; i < users.size(); ++i) {
+        results[i] = insertUser(toInfoType(type), users[i]);
+        if (results[i] == ListResult::BACKEND_ERROR) {
+            std::ranges::fill(results, ListResult::BACKEND_ERROR);
+            return results;
+        }
+    }
+    if (!transaction.commit()) {
+        std::ranges::fill(results, ListResult::BACKEND_ERROR);
+        return results;
+    }
+    refreshAcl();
+    return results;
+}
+
 SQLiteDatabase::ListResult SQLiteDatabase::addUserToList(ListType type,
                                                          UserId user) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_USER);
     const std::lock_guard lock(db_mutex_);
     return addUserToList(toInfoType(type), user);
 }
 
 SQLiteDatabase::ListResult SQLiteDatabase::removeUserFromList(
     ListType type, UserId user) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::REMOVE_USER);
     const std::lock_guard lock(db_mutex_);
     ListResult res{};
 
-    res = checkUserInList(type, user);
+    res = checkUserInList(writer_, toInfoType(type), user);
     switch (res) {
         case ListResult::OK:
             break;
@@ -375,7 +495,7 @@ SQLiteDatabase::ListResult SQLiteDatabase::removeUserFromList(
             return res;
     }
 
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kRemoveUserFile);
+    auto helper = helperFor(writer_, Helper::kRemoveUserFile);
     if (!helper->prepare()) {
         return ListResult::BACKEND_ERROR;
     }
@@ -383,6 +503,7 @@ SQLiteDatabase::ListResult SQLiteDatabase::removeUserFromList(
     helper->addArgument(static_cast<int>(toInfoType(type)));
     helper->bindArguments();
     if (helper->execute()) {
+        refreshAcl();
         return ListResult::OK;
     }
     return ListResult::BACKEND_ERROR;
@@ -390,17 +511,37 @@ SQLiteDatabase::ListResult SQLiteDatabase::removeUserFromList(
 
 [[nodiscard]] DatabaseBase::ListResult SQLiteDatabase::checkUserInList(
     ListType type, UserId user) const {
-    const std::lock_guard lock(db_mutex_);
-    return checkUserInList(toInfoType(type), user);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::CHECK_USER);
+    if (const auto result = acl_.check(type, user)) {
+        return *result;
+    }
+    const ReaderLease reader(*this);
+    return checkUserInList(*reader, toInfoType(type), user);
+}
+
+std::vector<UserId> SQLiteDatabase::getUsersInList(const ListType type) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_LIST_USERS);
+    const ReaderLease reader(*this);
+    std::vector<UserId> result;
+    auto helper = helperFor(*reader, Helper::kFindAllUsersFile);
+    if (!helper->prepare()) {
+        return result;
+    }
+    const auto info = toInfoType(type);
+    while (const auto row = helper->execAndGetRow()) {
+        if (static_cast<InfoType>(row->get<int>(1)) == info) {
+            result.emplace_back(row->get<UserId>(0));
+        }
+    }
+    return result;
 }
 
 [[nodiscard]] DatabaseBase::ListResult SQLiteDatabase::checkUserInList(
-    InfoType type, UserId user) const {
-    const std::lock_guard lock(db_mutex_);
+    Connection& connection, InfoType type, UserId user) const {
     ListResult result = ListResult::BACKEND_ERROR;
     std::optional<Helper::Row> row;
 
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kFindUserFile);
+    auto helper = helperFor(connection, Helper::kFindUserFile);
     if (!helper->prepare()) {
         return result;
     }
@@ -424,10 +565,10 @@ SQLiteDatabase::ListResult SQLiteDatabase::removeUserFromList(
 
 std::optional<std::string> SQLiteDatabase::getChatName(
     const ChatId chatId) const {
-    const std::lock_guard lock(db_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_CHAT_NAME);
+    const ReaderLease reader(*this);
     std::optional<Helper::Row> row;
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindChatNameFile);
+    auto helper = helperFor(*reader, Helper::kFindChatNameFile);
     if (!helper->prepare()) {
         return std::nullopt;
     }
@@ -440,8 +581,9 @@ std::optional<std::string> SQLiteDatabase::getChatName(
 }
 
 bool SQLiteDatabase::deleteChatInfo(const ChatId chatId) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DELETE_CHAT);
     const std::lock_guard lock(db_mutex_);
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kDeleteChatFile);
+    auto helper = helperFor(writer_, Helper::kDeleteChatFile);
     if (!helper->prepare()) {
         return false;
     }
@@ -450,11 +592,11 @@ bool SQLiteDatabase::deleteChatInfo(const ChatId chatId) const {
 }
 
 std::vector<SQLiteDatabase::ChatInfo> SQLiteDatabase::getAllChatInfos() const {
-    const std::lock_guard lock(db_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_ALL_CHATS);
+    const ReaderLease reader(*this);
     std::vector<ChatInfo> result;
     std::optional<Helper::Row> row;
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindAllChatMapFile);
+    auto helper = helperFor(*reader, Helper::kFindAllChatMapFile);
     if (!helper->prepare()) {
         return result;
     }
@@ -467,8 +609,190 @@ std::vector<SQLiteDatabase::ChatInfo> SQLiteDatabase::getAllChatInfos() const {
     return result;
 }
 
+void SQLiteDatabase::loadScripts() {
+    // createDatabase.sql only runs once in load(), outside this table.
+    static constexpr std::array kQueryScripts = {
+        Helper::kInsertUserFile,       Helper::kRemoveUserFile,
+        Helper::kFindUserFile,         Helper::kFindMediaInfoFile,
+        Helper::kFindMediaNameFile,    Helper::kInsertMediaNameFile,
+        Helper::kInsertMediaIdFile,    Helper::kFindMediaIdFile,
+        Helper::kInsertMediaMapFile,   Helper::kFindOwnerFile,
+        Helper::kDumpDatabaseFile,     Helper::kInsertChatFile,
+        Helper::kFindChatNameFile,     Helper::kFindChatIdFile,
+        Helper::kFindAllMediaMapFile,  Helper::kFindAllChatMapFile,
+        Helper::kDeleteMediaNameFile,  Helper::kDeleteChatFile,
+        Helper::kDeleteMediaFile,      Helper::kFindMediaIdsByAliasFile,
+        Helper::kFindAllUsersFile,
+    };
+    static constexpr std::array kSearchScripts = {
+        Helper::kSearchMediaNamesFile,
+        Helper::kFindMediaByNamePrefixFile,
+    };
+
+    scripts_.clear();
+    std::vector<std::string_view> filenames(kQueryScripts.begin(),
+                                            kQueryScripts.end());
+    if (searchIndex_) {
+        filenames.insert(filenames.end(), kSearchScripts.begin(),
+                         kSearchScripts.end());
+    }
+    for (const auto filename : filenames) {
+        std::ifstream sqlFile(_sqlScriptsPath / filename);
+        if (!sqlFile.is_open()) {
+            // Leave it to helperFor(), which reports the missing file on use.
+            LOG(WARNING) << "Could not open SQL script file: "
+                         << (_sqlScriptsPath / filename).string();
+            continue;
+        }
+        scripts_.emplace(filename,
+                         std::string((std::istreambuf_iterator<char>(sqlFile)),
+                                     std::istreambuf_iterator<char>()));
+    }
+}
+
+void SQLiteDatabase::prepareStatementCache(Connection& connection) const {
+    for (const auto& [filename, script] : scripts_) {
+        CachedStatement entry;
+        entry.script = &script;
+
+        const char* tail = nullptr;
+        if (sqlite3_prepare_v2(connection.db, script.c_str(), -1, &entry.stmt,
+                               &tail) != SQLITE_OK) {
+            LOG(ERROR) << "Failed to prepare " << filename << ": "
+                       << sqlite3_errmsg(connection.db);
+            entry.stmt = nullptr;
+        } else if (tail != nullptr) {
+            // Anything but comments and whitespace left means this is a
+            // multi-statement script, which Helper walks one statement at a
+            // time through getNextStatement().
+            sqlite3_stmt* next = nullptr;
+            const int ret =
+                sqlite3_prepare_v2(connection.db, tail, -1, &next, nullptr);
+            if (ret != SQLITE_OK || next != nullptr) {
+                sqlite3_finalize(next);
+                sqlite3_finalize(entry.stmt);
+                entry.stmt = nullptr;
+            }
+        }
+        connection.statements.insert_or_assign(filename, entry);
+    }
+}
+
+void SQLiteDatabase::clearStatementCache(Connection& connection) {
+    for (auto& [filename, entry] : connection.statements) {
+        if (entry.inUse) {
+            LOG(WARNING) << "Finalizing " << filename << " while in use";
+        }
+        sqlite3_finalize(entry.stmt);
+    }
+    connection.statements.clear();
+}
+
+std::shared_ptr<SQLiteDatabase::Helper> SQLiteDatabase::helperFor(
+    Connection& connection, const std::string_view filename) const {
+    const auto it = connection.statements.find(filename);
+    if (it == connection.statements.end()) {
+        return Helper::create(connection.db, _sqlScriptsPath, filename);
+    }
+    return Helper::create(connection.db, it->second);
+}
+
+SQLiteDatabase::ReaderLease::ReaderLease(const SQLiteDatabase& database)
+    : database_(database) {
+    std::unique_lock lock(database_.readersMutex_);
+    const auto start = DatabaseMetrics::Clock::now();
+    database_.readersAvailable_.wait(lock, [this] {
+        return !database_.idleReaders_.empty() || database_.readers_.empty();
+    });
+    DatabaseMetrics::Scope::addLockWait(DatabaseMetrics::Clock::now() - start);
+    if (!database_.idleReaders_.empty()) {
+        connection_ = database_.idleReaders_.back();
+        database_.idleReaders_.pop_back();
+        return;
+    }
+    lock.unlock();
+    writerLock_ = std::unique_lock(database_.db_mutex_);
+    connection_ = &database_.writer_;
+}
+
+SQLiteDatabase::ReaderLease::~ReaderLease() {
+    if (writerLock_.owns_lock()) {
+        return;
+    }
+    {
+        const std::lock_guard lock(database_.readersMutex_);
+        database_.idleReaders_.emplace_back(connection_);
+    }
+    database_.readersAvailable_.notify_one();
+}
+
+void SQLiteDatabase::openReaders(const std::filesystem::path& filepath) {
+    if (filepath == kInMemoryDatabase) {
+        // Every connection to :memory: is a database of its own.
+        return;
+    }
+
+    sqlite3_stmt* statement = nullptr;
+    std::string journalMode;
+    if (sqlite3_prepare_v2(writer_.db, "PRAGMA journal_mode = WAL", -1,
+                           &statement, nullptr) == SQLITE_OK &&
+        sqlite3_step(statement) == SQLITE_ROW) {
+        journalMode = detail::get<std::string>(0, statement);
+    }
+    sqlite3_finalize(statement);
+    if (journalMode != "wal") {
+        LOG(WARNING) << "Could not enable WAL (journal_mode=" << journalMode
+                     << "), serving reads from the writer connection";
+        return;
+    }
+    sqlite3_busy_timeout(writer_.db, kBusyTimeoutMs);
+
+    const auto count = std::clamp(std::thread::hardware_concurrency(),
+                                  kMinReaderConnections, kMaxReaderConnections);
+    const auto pathString = filepath.string();
+    const std::lock_guard lock(readersMutex_);
+    for (unsigned int i = 0; i < count; ++i) {
+        auto reader = std::make_unique<Connection>();
+        const int ret = sqlite3_open_v2(
+            pathString.c_str(), &reader->db,
+            SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+        if (ret != SQLITE_OK) {
+            LOG(WARNING) << "Could not open reader connection: "
+                         << (reader->db != nullptr
+                                 ? sqlite3_errmsg(reader->db)
+                                 : sqlite3_errstr(ret));
+            sqlite3_close(reader->db);
+            break;
+        }
+        sqlite3_busy_timeout(reader->db, kBusyTimeoutMs);
+        prepareStatementCache(*reader);
+        idleReaders_.emplace_back(reader.get());
+        readers_.emplace_back(std::move(reader));
+    }
+    DLOG(INFO) << "Opened " << readers_.size() << " SQLite reader connections";
+}
+
+void SQLiteDatabase::closeReaders() {
+    std::unique_lock lock(readersMutex_);
+    readersAvailable_.wait(
+        lock, [this] { return idleReaders_.size() == readers_.size(); });
+    for (auto& reader : readers_) {
+        clearStatementCache(*reader);
+        if (sqlite3_close(reader->db) != SQLITE_OK) {
+            LOG(ERROR) << "Could not close reader connection: "
+                       << sqlite3_errmsg(reader->db);
+        }
+    }
+    idleReaders_.clear();
+    readers_.clear();
+    lock.unlock();
+    // Wake leases that were waiting for a reader; they now use the writer.
+    readersAvailable_.notify_all();
+}
+
 bool SQLiteDatabase::load(std::filesystem::path filepath) {
     const std::lock_guard lock(db_mutex_);
+    auto& db = writer_.db;
     std::error_code ec;
     if (db != nullptr) {
         LOG(WARNING) << "Attempting to load database while it is already open.";
@@ -494,7 +818,7 @@ bool SQLiteDatabase::load(std::filesystem::path filepath) {
         db = nullptr;
         return false;
     }
-    const auto failLoad = [this](const std::string& message) {
+    const auto failLoad = [&db](const std::string& message) {
         LOG(ERROR) << message;
         sqlite3_close(db);
         db = nullptr;
@@ -510,7 +834,7 @@ bool SQLiteDatabase::load(std::filesystem::path filepath) {
         }
     }
 
-    constexpr int kCurrentSchemaVersion = 2;
+    constexpr int kCurrentSchemaVersion = 3;
     sqlite3_stmt* statement = nullptr;
     if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &statement,
                            nullptr) != SQLITE_OK ||
@@ -573,17 +897,18 @@ bool SQLiteDatabase::load(std::filesystem::path filepath) {
     retainedOwner = sqlite3_column_int64(statement, 1);
     sqlite3_finalize(statement);
 
-    constexpr const char* kOwnerMigration =
+    const auto ownerMigration = fmt::format(
         "BEGIN IMMEDIATE;"
         "UPDATE usermap SET info = 2 WHERE info = 0 AND rowid NOT IN "
         "(SELECT rowid FROM usermap WHERE info = 0 ORDER BY rowid LIMIT 1);"
         "CREATE UNIQUE INDEX IF NOT EXISTS owner_singleton "
         "ON usermap(info) WHERE info = 0;"
-        "PRAGMA user_version = 2;"
-        "COMMIT;";
+        "PRAGMA user_version = {};"
+        "COMMIT;",
+        std::max(schemaVersion, 2));
     char* migrationError = nullptr;
-    if (sqlite3_exec(db, kOwnerMigration, nullptr, nullptr, &migrationError) !=
-        SQLITE_OK) {
+    if (sqlite3_exec(db, ownerMigration.c_str(), nullptr, nullptr,
+                     &migrationError) != SQLITE_OK) {
         const std::string detail =
             migrationError != nullptr ? migrationError : "unknown error";
         sqlite3_free(migrationError);
@@ -599,6 +924,31 @@ bool SQLiteDatabase::load(std::filesystem::path filepath) {
                      nullptr) != SQLITE_OK) {
         return failLoad("Failed to enable SQLite foreign keys");
     }
+    // Without FTS5 the database stays at version 2 and is searched by
+    // scanning, so a missing module is not a load failure.
+    if (schemaVersion < 3) {
+        migrationError = nullptr;
+        if (sqlite3_exec(db, kSearchMigration, nullptr, nullptr,
+                         &migrationError) != SQLITE_OK) {
+            LOG(WARNING) << "Media alias search index unavailable: "
+                         << (migrationError != nullptr ? migrationError
+                                                       : "unknown error");
+            sqlite3_free(migrationError);
+            (void)sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        }
+    }
+    statement = nullptr;
+    searchIndex_ =
+        sqlite3_prepare_v2(db,
+                           "SELECT 1 FROM sqlite_master WHERE type='table' "
+                           "AND name='medianame_fts'",
+                           -1, &statement, nullptr) == SQLITE_OK &&
+        sqlite3_step(statement) == SQLITE_ROW;
+    sqlite3_finalize(statement);
+    loadScripts();
+    prepareStatementCache(writer_);
+    openReaders(filepath);
+    refreshAcl();
 
     if (filepath != kInMemoryDatabase) {
         LOG(INFO) << "Loaded SQLite database: " << filepath;
@@ -610,7 +960,11 @@ bool SQLiteDatabase::load(std::filesystem::path filepath) {
 
 bool SQLiteDatabase::unload() {
     const std::lock_guard lock(db_mutex_);
+    auto& db = writer_.db;
     if (db != nullptr) {
+        acl_.clear();
+        closeReaders();
+        clearStatementCache(writer_);
         if (sqlite3_close(db) == SQLITE_OK) {
             db = nullptr;
             return true;
@@ -624,11 +978,11 @@ bool SQLiteDatabase::unload() {
 
 std::optional<SQLiteDatabase::MediaInfo> SQLiteDatabase::queryMediaInfo(
     std::string str) const {
-    const std::lock_guard lock(db_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::QUERY_MEDIA);
+    const ReaderLease reader(*this);
     MediaInfo info{};
 
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindMediaInfoFile);
+    auto helper = helperFor(*reader, Helper::kFindMediaInfoFile);
     if (!helper->prepare()) {
         return std::nullopt;
     }
@@ -648,7 +1002,43 @@ std::optional<SQLiteDatabase::MediaInfo> SQLiteDatabase::queryMediaInfo(
 
 SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
     const MediaInfo& info) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_MEDIA);
+    const std::lock_guard lock(db_mutex_);
+    SQLiteTransaction transaction(writer_.db);
+    if (!transaction.active()) {
+        return AddResult::BACKEND_ERROR;
+    }
+    const auto result = insertMediaInfo(info);
+    if (result != AddResult::OK) {
+        return result;
+    }
+    return transaction.commit() ? AddResult::OK : AddResult::BACKEND_ERROR;
+}
+
+std::vector<SQLiteDatabase::AddResult> SQLiteDatabase::addMediaInfos(
+    std::span<const MediaInfo> infos) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_MEDIAS);
     const std::lock_guard lock(db_mutex_);
+    std::vector<AddResult> results(infos.size(), AddResult::BACKEND_ERROR);
+    SQLiteTransaction transaction(writer_.db);
+    if (!transaction.active()) {
+        return results;
+    }
+    for (size_t i = 0; i < infos.size(); ++i) {
+        results[i] = insertMediaInfo(infos[i]);
+        if (results[i] == AddResult::BACKEND_ERROR) {
+            std::ranges::fill(results, AddResult::BACKEND_ERROR);
+            return results;
+        }
+    }
+    if (!transaction.commit()) {
+        std::ranges::fill(results, AddResult::BACKEND_ERROR);
+    }
+    return results;
+}
+
+SQLiteDatabase::AddResult SQLiteDatabase::insertMediaInfo(
+    const MediaInfo& info) const {
     struct UpdateInfo {
         enum class Op {
             INSERT,  // This name does not exist in namemap: I should insert it
@@ -668,14 +1058,8 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
         return AddResult::BACKEND_ERROR;
     }
 
-    SQLiteTransaction transaction(db);
-    if (!transaction.active()) {
-        return AddResult::BACKEND_ERROR;
-    }
-
     // Insert the media info into the database
-    auto insertMediaHelper =
-        Helper::create(db, _sqlScriptsPath, Helper::kInsertMediaIdFile);
+    auto insertMediaHelper = helperFor(writer_, Helper::kInsertMediaIdFile);
 
     if (!insertMediaHelper->prepare()) {
         return AddResult::BACKEND_ERROR;
@@ -691,8 +1075,7 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
 
     // Determine stuff to insert, and the ones that already exist
     for (const auto& name : info.names) {
-        auto helper =
-            Helper::create(db, _sqlScriptsPath, Helper::kFindMediaNameFile);
+        auto helper = helperFor(writer_, Helper::kFindMediaNameFile);
         if (!helper->prepare()) {
             return AddResult::BACKEND_ERROR;
         }
@@ -717,8 +1100,8 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
                 const auto name = std::get<std::string>(info.data);
 
                 // Insert into database
-                auto insertHelper = Helper::create(
-                    db, _sqlScriptsPath, Helper::kInsertMediaNameFile);
+                auto insertHelper =
+                    helperFor(writer_, Helper::kInsertMediaNameFile);
                 if (!insertHelper->prepare()) {
                     return AddResult::BACKEND_ERROR;
                 }
@@ -733,8 +1116,8 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
                 }
 
                 // Get the index again
-                auto findHelper = Helper::create(db, _sqlScriptsPath,
-                                                 Helper::kFindMediaNameFile);
+                auto findHelper =
+                    helperFor(writer_, Helper::kFindMediaNameFile);
                 if (!findHelper->prepare()) {
                     return AddResult::BACKEND_ERROR;
                 }
@@ -758,8 +1141,7 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
     }
 
     // Get the inserted media index
-    auto findMediaIdHelper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindMediaIdFile);
+    auto findMediaIdHelper = helperFor(writer_, Helper::kFindMediaIdFile);
     if (!findMediaIdHelper->prepare()) {
         return AddResult::BACKEND_ERROR;
     }
@@ -778,7 +1160,7 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
         int data = std::get<int>(info.data);
 
         auto insertMediaMapHelper =
-            Helper::create(db, _sqlScriptsPath, Helper::kInsertMediaMapFile);
+            helperFor(writer_, Helper::kInsertMediaMapFile);
         if (!insertMediaMapHelper->prepare()) {
             return AddResult::BACKEND_ERROR;
         }
@@ -793,55 +1175,153 @@ SQLiteDatabase::AddResult SQLiteDatabase::addMediaInfo(
             return AddResult::BACKEND_ERROR;
         }
     }
-    return transaction.commit() ? AddResult::OK : AddResult::BACKEND_ERROR;
+    return AddResult::OK;
 }
 
 std::vector<SQLiteDatabase::MediaInfo> SQLiteDatabase::getAllMediaInfos()
     const {
-    const std::lock_guard lock(db_mutex_);
-    using MergeMap =
-        std::unordered_map<std::pair<std::string, std::string>,
-                           std::pair<std::vector<std::string>, MediaType>,
-                           PairHash>;
-    MergeMap map;
-
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindAllMediaMapFile);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_ALL_MEDIA);
+    std::vector<MediaInfo> result;
+    forEachMediaInfo([&result](const MediaInfo& info) {
+        result.emplace_back(info);
+        return true;
+    });
+    return result;
+}
+
+void SQLiteDatabase::forEachMediaInfo(
+    const std::function<bool(const MediaInfo&)>& visitor) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::FOR_EACH_MEDIA);
+    const ReaderLease reader(*this);
+    (void)forEachMediaInfo(*reader, visitor);
+}
+
+bool SQLiteDatabase::forEachMediaInfo(
+    Connection& connection,
+    const std::function<bool(const MediaInfo&)>& visitor) const {
+    auto helper = helperFor(connection, Helper::kFindAllMediaMapFile);
     if (!helper->prepare()) {
-        return {};
+        return false;
     }
 
-    // Directly build the map from database rows
-    while (auto rows = helper->execAndGetRow()) {
-        auto mediaId = rows->get<std::string>(0);
-        auto mediaUniqueId = rows->get<std::string>(1);
-        auto name = rows->get<std::string>(2);
-        auto mediaType = static_cast<MediaType>(rows->get<int>(3));
+    // Rows come ordered by media, one per name, so a media is complete once
+    // the next row belongs to another one.
+    std::optional<MediaInfo> current;
+    while (auto row = helper->execAndGetRow()) {
+        auto mediaUniqueId = row->get<std::string>(1);
+        if (current && current->mediaUniqueId != mediaUniqueId) {
+            if (!visitor(*current)) {
+                return false;
+            }
+            current.reset();
+        }
+        if (!current) {
+            current.emplace();
+            current->mediaId = row->get<std::string>(0);
+            current->mediaUniqueId = std::move(mediaUniqueId);
+            current->mediaType = static_cast<MediaType>(row->get<int>(3));
+        }
+        current->names.emplace_back(row->get<std::string>(2));
+    }
+    return !current || visitor(*current);
+}
 
-        auto key = std::make_pair(std::move(mediaUniqueId), std::move(mediaId));
-        auto& entry = map[key];
-        entry.first.emplace_back(std::move(name));
-        entry.second = mediaType;
+bool SQLiteDatabase::exportRows(
+    const std::function<bool(std::span<const DumpRow>)>& sink,
+    const std::size_t batchSize) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::EXPORT);
+    const auto limit = std::max<std::size_t>(batchSize, 1);
+    std::vector<DumpRow> rows;
+    if (!readRowsForExport(sink, limit, &rows)) {
+        return false;
     }
+    // What is left, or everything if it had to be copied first.
+    for (std::size_t begin = 0; begin < rows.size(); begin += limit) {
+        const auto count = std::min(limit, rows.size() - begin);
+        if (!sink(std::span<const DumpRow>(rows).subspan(begin, count))) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Convert map to result vector
-    std::vector<MediaInfo> result;
-    result.reserve(map.size());
-    for (auto& pair : map) {
-        MediaInfo info;
-        info.mediaId = pair.first.second;
-        info.mediaUniqueId = pair.first.first;
-        info.names = std::move(pair.second.first);
-        info.mediaType = pair.second.second;
-        result.emplace_back(std::move(info));
+bool SQLiteDatabase::readRowsForExport(
+    const std::function<bool(std::span<const DumpRow>)>& sink,
+    const std::size_t limit, std::vector<DumpRow>* rows) const {
+    const ReaderLease reader(*this);
+    auto& connection = *reader;
+    // Every table is read from the same snapshot. On a pooled reader this
+    // does not hold db_mutex_, so writers carry on while the sink works.
+    // Without a pool (in-memory databases) the sink must not run under the
+    // lock, so the rows, which are in memory already, are copied instead.
+    const bool copyAll = !reader.pooled();
+    SQLiteTransaction snapshot(connection.db, "BEGIN");
+    if (!snapshot.active()) {
+        return false;
     }
-    return result;
+
+    if (!copyAll) {
+        rows->reserve(limit);
+    }
+    const auto push = [rows, &sink, limit, copyAll](DumpRow row) {
+        rows->emplace_back(std::move(row));
+        if (copyAll || rows->size() < limit) {
+            return true;
+        }
+        const bool more = sink(*rows);
+        rows->clear();
+        return more;
+    };
+
+    auto users = helperFor(connection, Helper::kFindAllUsersFile);
+    if (!users->prepare()) {
+        return false;
+    }
+    while (const auto row = users->execAndGetRow()) {
+        UserInfo user{row->get<UserId>(0), std::nullopt};
+        switch (static_cast<InfoType>(row->get<int>(1))) {
+            case InfoType::OWNER:
+                break;
+            case InfoType::WHITELIST:
+                user.list = ListType::WHITELIST;
+                break;
+            case InfoType::BLACKLIST:
+                user.list = ListType::BLACKLIST;
+                break;
+            default:
+                LOG(WARNING) << "Skipping usermap row with invalid info for "
+                             << user.userId;
+                continue;
+        }
+        if (!push(user)) {
+            return false;
+        }
+    }
+
+    const auto pushMedia = [&push](const MediaInfo& info) {
+        return push(info);
+    };
+    if (!forEachMediaInfo(connection, pushMedia)) {
+        return false;
+    }
+
+    auto chats = helperFor(connection, Helper::kFindAllChatMapFile);
+    if (!chats->prepare()) {
+        return false;
+    }
+    while (const auto row = chats->execAndGetRow()) {
+        if (!push(ChatInfo{row->get<ChatId>(0), row->get<std::string>(1)})) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool SQLiteDatabase::deleteMediaInfo(
     const decltype(MediaInfo::mediaId) mediaId) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DELETE_MEDIA);
     const std::lock_guard lock(db_mutex_);
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kDeleteMediaFile);
+    auto helper = helperFor(writer_, Helper::kDeleteMediaFile);
     if (!helper->prepare()) {
         return false;
     }
@@ -849,16 +1329,16 @@ bool SQLiteDatabase::deleteMediaInfo(
     if (!helper->execute()) {
         return false;
     }
-    return sqlite3_changes(db) > 0;
+    return sqlite3_changes(writer_.db) > 0;
 }
 
 std::optional<std::vector<decltype(SQLiteDatabase::MediaInfo::mediaId)>>
 SQLiteDatabase::getMediaIds(const std::string_view alias) const {
-    const std::lock_guard lock(db_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_MEDIA_IDS);
+    const ReaderLease reader(*this);
     std::vector<decltype(MediaInfo::mediaId)> result;
     std::optional<Helper::Row> row;
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kFindMediaIdsByAliasFile);
+    auto helper = helperFor(*reader, Helper::kFindMediaIdsByAliasFile);
     if (!helper->prepare()) {
         return std::nullopt;
     }
@@ -872,9 +1352,59 @@ SQLiteDatabase::getMediaIds(const std::string_view alias) const {
     return result;
 }
 
+std::vector<SQLiteDatabase::MediaMatch> SQLiteDatabase::searchMedia(
+    const std::string_view query, const std::size_t limit) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::SEARCH_MEDIA);
+    if (!searchIndex_) {
+        return DatabaseBase::searchMedia(query, limit);
+    }
+    const media_search::Query parsed(query);
+    if (parsed.text.empty() || limit == 0) {
+        return {};
+    }
+    const ReaderLease reader(*this);
+    // Trigram matching needs three characters; shorter queries can only
+    // be prefixes, which a LIKE scan of the aliases answers.
+    const bool byPrefix = parsed.text.size() < 3;
+    auto helper = helperFor(*reader, byPrefix
+                                         ? Helper::kFindMediaByNamePrefixFile
+                                         : Helper::kSearchMediaNamesFile);
+    if (!helper->prepare()) {
+        return {};
+    }
+    helper
+        ->addArgument(byPrefix ? toPrefixPattern(parsed.text)
+                               : toMatchExpression(parsed.text))
+        .addArgument(static_cast<int64_t>(limit * kSearchCandidatesPerMatch))
+        .bindArguments();
+    std::vector<MediaMatch> matches;
+    std::optional<Helper::Row> row;
+    while ((row = helper->execAndGetRow())) {
+        auto alias = row->get<std::string>(0);
+        const auto score = media_search::score(parsed, alias);
+        if (!score) {
+            continue;
+        }
+        matches.push_back({std::move(alias), row->get<std::string>(1),
+                           row->get<std::string>(2),
+                           static_cast<MediaType>(row->get<int32_t>(3)),
+                           *score});
+    }
+    return media_search::rank(std::move(matches), limit);
+}
+
 std::optional<UserId> SQLiteDatabase::getOwnerUserId() const {
-    const std::lock_guard lock(db_mutex_);
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kFindOwnerFile);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_OWNER);
+    if (acl_.available()) {
+        return acl_.owner();
+    }
+    const ReaderLease reader(*this);
+    return getOwnerUserId(*reader);
+}
+
+std::optional<UserId> SQLiteDatabase::getOwnerUserId(
+    Connection& connection) const {
+    auto helper = helperFor(connection, Helper::kFindOwnerFile);
     if (!helper->prepare()) {
         return std::nullopt;
     }
@@ -885,6 +1415,37 @@ std::optional<UserId> SQLiteDatabase::getOwnerUserId() const {
     return row->get<UserId>(0);
 }
 
+void SQLiteDatabase::refreshAcl() const {
+    std::vector<AclSnapshot::Entry> entries;
+    std::optional<UserId> owner;
+    auto helper = helperFor(writer_, Helper::kFindAllUsersFile);
+    if (!helper->prepare()) {
+        // Without a snapshot, list checks query the database directly.
+        acl_.clear();
+        return;
+    }
+    while (const auto row = helper->execAndGetRow()) {
+        const auto user = row->get<UserId>(0);
+        switch (static_cast<InfoType>(row->get<int>(1))) {
+            case InfoType::OWNER:
+                owner = user;
+                entries.push_back({user, AclSnapshot::Membership::OWNER});
+                break;
+            case InfoType::WHITELIST:
+                entries.push_back({user, AclSnapshot::Membership::WHITELIST});
+                break;
+            case InfoType::BLACKLIST:
+                entries.push_back({user, AclSnapshot::Membership::BLACKLIST});
+                break;
+            default:
+                LOG(WARNING) << "Ignoring usermap row with invalid info for "
+                             << user;
+                break;
+        }
+    }
+    acl_.publish(std::move(entries), owner);
+}
+
 SQLiteDatabase::InfoType SQLiteDatabase::toInfoType(ListType type) {
     switch (type) {
         case ListType::BLACKLIST:
@@ -896,23 +1457,43 @@ SQLiteDatabase::InfoType SQLiteDatabase::toInfoType(ListType type) {
 }
 
 std::ostream& SQLiteDatabase::dump(std::ostream& ofs) const {
-    const std::lock_guard lock(db_mutex_);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::DUMP);
     std::stringstream ss;
+    dumpSnapshot(ss, ofs);
+    ofs << ss.str();
+    return ofs;
+}
 
-    if (db == nullptr) {
-        ofs << "Database not loaded!";
-        return ofs;
+void SQLiteDatabase::dumpSnapshot(std::stringstream& ss,
+                                  std::ostream& ofs) const {
+    const ReaderLease reader(*this);
+
+    if ((*reader).db == nullptr) {
+        ss << "Database not loaded!";
+        return;
     }
+    // All sections come from one snapshot, read without blocking writers.
+    SQLiteTransaction snapshot((*reader).db, "BEGIN");
 
     ss << "====================== Dump of database ======================"
        << '\n';
 
     // Because of the race condition with logging, use stringstream and output
-    // later.
-    ss << fmt::format("Owner Id: {}\n", getOwnerUserId().value_or(0));
+    // it in chunks of rows, so large databases are not held in memory. A
+    // lease without a pool holds db_mutex_, which must not be held while
+    // writing to the stream; those databases are in memory anyway.
+    const bool flush = reader.pooled();
+    std::size_t rows = 0;
+    const auto flushChunk = [&ss, &ofs, &rows, flush] {
+        if (flush && ++rows % kDumpBatchRows == 0) {
+            ofs << ss.str();
+            ss.str({});
+        }
+    };
+    ss << fmt::format("Owner Id: {}\n",
+                      getOwnerUserId(*reader).value_or(0));
 
-    auto helper =
-        Helper::create(db, _sqlScriptsPath, Helper::kDumpDatabaseFile);
+    auto helper = helperFor(*reader, Helper::kDumpDatabaseFile);
     if (helper->prepare()) {
         std::optional<Helper::Row> row;
         while ((row = helper->execAndGetRow())) {
@@ -940,6 +1521,7 @@ std::ostream& SQLiteDatabase::dump(std::ostream& ofs) const {
                     break;
             };
             ss << '\n';
+            flushChunk();
         }
     } else {
         ss << "!!! Failed to dump usermap database" << '\n';
@@ -958,6 +1540,7 @@ std::ostream& SQLiteDatabase::dump(std::ostream& ofs) const {
                << '\n';
             ss << '\n';
             any = true;
+            flushChunk();
         }
         if (!any) {
             ss << "!!! No media entries in the database" << '\n';
@@ -976,6 +1559,7 @@ std::ostream& SQLiteDatabase::dump(std::ostream& ofs) const {
             ss << "ChatName: " << row->get<std::string>(1) << '\n';
             ss << '\n';
             any = true;
+            flushChunk();
         }
         if (!any) {
             ss << "!!! No chatid entries in the database" << '\n';
@@ -986,8 +1570,6 @@ std::ostream& SQLiteDatabase::dump(std::ostream& ofs) const {
 
     ss << "========================= End of dump ========================"
        << '\n';
-    ofs << ss.str();
-    return ofs;
 }
 
 void SQLiteDatabase::setOwnerUserId(UserId userId) const {
@@ -996,8 +1578,9 @@ void SQLiteDatabase::setOwnerUserId(UserId userId) const {
 
 DatabaseBase::OwnerClaimResult SQLiteDatabase::claimOwnerUserId(
     const UserId userId) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::CLAIM_OWNER);
     const std::lock_guard lock(db_mutex_);
-    if (getOwnerUserId()) {
+    if (getOwnerUserId(writer_)) {
         return OwnerClaimResult::ALREADY_SET;
     }
 
@@ -1007,7 +1590,7 @@ DatabaseBase::OwnerClaimResult SQLiteDatabase::claimOwnerUserId(
             return OwnerClaimResult::OK;
         case DatabaseBase::ListResult::ALREADY_IN_OTHER_LIST:
         case DatabaseBase::ListResult::BACKEND_ERROR:
-            if (getOwnerUserId()) {
+            if (getOwnerUserId(writer_)) {
                 return OwnerClaimResult::ALREADY_SET;
             }
             LOG(ERROR) << "Failed to set owner to " << userId;
@@ -1024,12 +1607,39 @@ DatabaseBase::OwnerClaimResult SQLiteDatabase::claimOwnerUserId(
 
 SQLiteDatabase::AddResult SQLiteDatabase::addChatInfo(
     const ChatId chatid, const std::string_view name) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_CHAT);
     const std::lock_guard lock(db_mutex_);
-    if (getChatId(name)) {
+    return insertChatInfo(chatid, name);
+}
+
+std::vector<SQLiteDatabase::AddResult> SQLiteDatabase::addChatInfos(
+    std::span<const ChatInfo> chats) const {
+    const DatabaseMetrics::Scope scope(metrics_, Operation::ADD_CHATS);
+    const std::lock_guard lock(db_mutex_);
+    std::vector<AddResult> results(chats.size(), AddResult::BACKEND_ERROR);
+    SQLiteTransaction transaction(writer_.db);
+    if (!transaction.active()) {
+        return results;
+    }
+    for (size_t i = 0; i < chats.size(); ++i) {
+        results[i] = insertChatInfo(chats[i].chatId, chats[i].name);
+        if (results[i] == AddResult::BACKEND_ERROR) {
+            std::ranges::fill(results, AddResult::BACKEND_ERROR);
+            return results;
+        }
+    }
+    if (!transaction.commit()) {
+        std::ranges::fill(results, AddResult::BACKEND_ERROR);
+    }
+    return results;
+}
+
+SQLiteDatabase::AddResult SQLiteDatabase::insertChatInfo(
+    const ChatId chatid, const std::string_view name) const {
+    if (getChatId(writer_, name)) {
         return AddResult::ALREADY_EXISTS;
     }
-    auto insertHelper =
-        Helper::create(db, _sqlScriptsPath, Helper::kInsertChatFile);
+    auto insertHelper = helperFor(writer_, Helper::kInsertChatFile);
     if (!insertHelper->prepare()) {
         return AddResult::BACKEND_ERROR;
     }
@@ -1038,15 +1648,24 @@ SQLiteDatabase::AddResult SQLiteDatabase::addChatInfo(
         .bindArguments();
     if (insertHelper->execute()) {
         return AddResult::OK;
-    } else {
-        return AddResult::BACKEND_ERROR;
     }
+    // chatmap.chatid is unique as well as the name checked above.
+    if (sqlite3_extended_errcode(writer_.db) == SQLITE_CONSTRAINT_UNIQUE) {
+        return AddResult::ALREADY_EXISTS;
+    }
+    return AddResult::BACKEND_ERROR;
 }
 
 std::optional<ChatId> SQLiteDatabase::getChatId(
     const std::string_view name) const {
-    const std::lock_guard lock(db_mutex_);
-    auto helper = Helper::create(db, _sqlScriptsPath, Helper::kFindChatIdFile);
+    const DatabaseMetrics::Scope scope(metrics_, Operation::GET_CHAT_ID);
+    const ReaderLease reader(*this);
+    return getChatId(*reader, name);
+}
+
+std::optional<ChatId> SQLiteDatabase::getChatId(
+    Connection& connection, const std::string_view name) const {
+    auto helper = helperFor(connection, Helper::kFindChatIdFile);
     if (!helper->prepare()) {
         return std::nullopt;
     }
@@ -3,18 +3,27 @@
 #include <DBImplExports.h>
 #include <sqlite3.h>
 
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <source_location>
+#include <span>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <variant>
+#include <vector>
 
+#include "AclSnapshot.hpp"
 #include "DatabaseBase.hpp"
+#include "DatabaseMetrics.hpp"
 
 namespace detail {
 
@@ -59,6 +68,8 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
                                                 UserId user) const override;
     [[nodiscard]] ListResult checkUserInList(ListType type,
                                              UserId user) const override;
+    [[nodiscard]] std::vector<UserId> getUsersInList(
+        ListType type) const override;
     bool load(std::filesystem::path filepath) override;
     bool unload() override;
     [[nodiscard]] std::optional<UserId> getOwnerUserId() const override;
@@ -82,6 +93,37 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
         const ChatId chatId) const override;
     [[nodiscard]] bool deleteChatInfo(const ChatId chatId) const override;
     [[nodiscard]] std::vector<ChatInfo> getAllChatInfos() const override;
+    [[nodiscard]] std::vector<AddResult> addMediaInfos(
+        std::span<const MediaInfo> infos) const override;
+    [[nodiscard]] std::vector<AddResult> addChatInfos(
+        std::span<const ChatInfo> chats) const override;
+    [[nodiscard]] std::vector<ListResult> addUsersToList(
+        ListType type, std::span<const UserId> users) const override;
+    void forEachMediaInfo(
+        const std::function<bool(const MediaInfo&)>& visitor) const override;
+    [[nodiscard]] bool exportRows(
+        const std::function<bool(std::span<const DumpRow>)>& sink,
+        std::size_t batchSize) const override;
+    [[nodiscard]] std::vector<MediaMatch> searchMedia(
+        std::string_view query, std::size_t limit) const override;
+    [[nodiscard]] DatabaseMetrics* metrics() const override {
+        return &metrics_;
+    }
+
+    /**
+     * A script from the SQL script directory, read once at load(). Scripts
+     * holding a single statement are also kept prepared for the lifetime of
+     * the connection, and are reset instead of finalized after each use.
+     */
+    struct CachedStatement {
+        // Points into SQLiteDatabase's script table, shared by connections.
+        const std::string* script = nullptr;
+        // nullptr for multi-statement scripts, which are prepared per use.
+        sqlite3_stmt* stmt = nullptr;
+        // Set while a Helper borrows stmt. Nested users of the same script
+        // fall back to preparing a private copy from the cached text.
+        bool inUse = false;
+    };
 
     /**
      * SQLiteDatabase::Helper is a helper class for executing SQL statements
@@ -111,6 +153,8 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
         static constexpr std::string_view kInsertMediaMapFile =
             "insertMediaMap.sql";
         static constexpr std::string_view kFindOwnerFile = "findOwner.sql";
+        static constexpr std::string_view kFindAllUsersFile =
+            "findAllUsers.sql";
         static constexpr std::string_view kDumpDatabaseFile =
             "dumpDatabase.sql";
         static constexpr std::string_view kInsertChatFile = "insertChat.sql";
@@ -127,6 +171,10 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
         static constexpr std::string_view kDeleteMediaFile = "deleteMedia.sql";
         static constexpr std::string_view kFindMediaIdsByAliasFile =
             "findMediaIdsByName.sql";
+        static constexpr std::string_view kSearchMediaNamesFile =
+            "searchMediaNames.sql";
+        static constexpr std::string_view kFindMediaByNamePrefixFile =
+            "findMediaByNamePrefix.sql";
 
         struct Row {
             template <typename T>
@@ -230,6 +278,11 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
                 Helper(db, scriptDirectory, filename));
         }
 
+        static std::shared_ptr<Helper> create(sqlite3* db,
+                                              CachedStatement& cached) {
+            return std::make_shared<Helper>(Helper(db, cached));
+        }
+
        private:
         /**
          * Constructor for SQLiteDatabase::Helper.
@@ -246,6 +299,14 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
         // Used for methods that have multiple statements
         explicit Helper(sqlite3* db, std::string content);
 
+        // Borrows the prepared statement of a cached script, if available.
+        explicit Helper(sqlite3* db, CachedStatement& cached);
+
+        // The SQL text this helper prepares or executes.
+        [[nodiscard]] const std::string& source() const {
+            return cached != nullptr ? *cached->script : scriptContent;
+        }
+
         /**
          * Structure to hold an argument for the SQL statement.
          */
@@ -312,16 +373,113 @@ struct DBIMPL_EXPORT SQLiteDatabase : DatabaseBase {
         // Pointer to the SQLite database.
         sqlite3* db;
         sqlite3_stmt* stmt = nullptr;
+        CachedStatement* cached = nullptr;
     };
 
    private:
+    /**
+     * One SQLite connection and the statements prepared on it. The writer
+     * connection is guarded by db_mutex_; reader connections are handed to
+     * one thread at a time through ReaderLease.
+     */
+    struct Connection {
+        sqlite3* db = nullptr;
+        // Keyed by the Helper::k*File constants. Node-based, so the entries
+        // Helpers point to stay put for as long as the connection is open.
+        std::unordered_map<std::string_view, CachedStatement> statements;
+    };
+
+    /**
+     * Checks out an idle read-only connection for one query. Without a
+     * reader pool (in-memory databases, or WAL unavailable) it locks
+     * db_mutex_ and hands out the writer connection instead.
+     */
+    class ReaderLease {
+       public:
+        explicit ReaderLease(const SQLiteDatabase& database);
+        ~ReaderLease();
+        NO_COPY_CTOR(ReaderLease);
+
+        Connection& operator*() const { return *connection_; }
+        // False if this lease borrowed the writer connection, and so holds
+        // db_mutex_: nothing slow may run until it is released.
+        [[nodiscard]] bool pooled() const { return !writerLock_.owns_lock(); }
+
+       private:
+        const SQLiteDatabase& database_;
+        Connection* connection_ = nullptr;
+        std::unique_lock<MeteredMutex<std::recursive_mutex>> writerLock_;
+    };
+
     [[nodiscard]] ListResult addUserToList(InfoType type, UserId user) const;
-    [[nodiscard]] ListResult checkUserInList(InfoType type, UserId user) const;
+    // The statements behind the add operations, without their own
+    // transaction or ACL refresh, so batches can run many of them in one.
+    // Caller holds db_mutex_.
+    [[nodiscard]] ListResult insertUser(InfoType type, UserId user) const;
+    [[nodiscard]] AddResult insertMediaInfo(const MediaInfo& info) const;
+    [[nodiscard]] AddResult insertChatInfo(ChatId chatid,
+                                           std::string_view name) const;
+    [[nodiscard]] ListResult checkUserInList(Connection& connection,
+                                             InfoType type, UserId user) const;
+    [[nodiscard]] std::optional<UserId> getOwnerUserId(
+        Connection& connection) const;
+    [[nodiscard]] std::optional<ChatId> getChatId(
+        Connection& connection, std::string_view name) const;
+    // Returns false if the query failed or the visitor stopped it.
+    [[nodiscard]] bool forEachMediaInfo(
+        Connection& connection,
+        const std::function<bool(const MediaInfo&)>& visitor) const;
+    // Reads the rows for exportRows(), handing them to the sink in batches
+    // of `limit` where that is safe. Rows not handed over yet are left in
+    // `rows`. Returns false if a query failed or the sink stopped it.
+    [[nodiscard]] bool readRowsForExport(
+        const std::function<bool(std::span<const DumpRow>)>& sink,
+        std::size_t limit, std::vector<DumpRow>* rows) const;
+    // The body of dump(). Completed chunks go to `ofs` when that is safe,
+    // the rest is left in `ss`.
+    void dumpSnapshot(std::stringstream& ss, std::ostream& ofs) const;
     static InfoType toInfoType(ListType type);
-    sqlite3* db = nullptr;
+
+    // Republishes acl_ from the writer connection. Caller holds db_mutex_.
+    void refreshAcl() const;
+
+    // Reads every query script into scripts_. Called once per load().
+    void loadScripts();
+    // Prepares the single-statement scripts on the given connection.
+    void prepareStatementCache(Connection& connection) const;
+    // Finalizes the cached statements. Must run before sqlite3_close().
+    static void clearStatementCache(Connection& connection);
+    // Returns a Helper for the script, served from the cache when possible.
+    [[nodiscard]] std::shared_ptr<Helper> helperFor(
+        Connection& connection, std::string_view filename) const;
+
+    /**
+     * Switches the writer to WAL and opens the read-only connection pool,
+     * so reads no longer queue behind db_mutex_. Leaves the pool empty when
+     * WAL cannot be enabled.
+     */
+    void openReaders(const std::filesystem::path& filepath);
+    // Waits for outstanding leases, then closes every reader connection.
+    void closeReaders();
+
+    // The only connection that writes. Also serves reads made inside a write
+    // operation so they observe its uncommitted changes.
+    mutable Connection writer_;
     std::filesystem::path _sqlScriptsPath;
+    std::unordered_map<std::string_view, std::string> scripts_;
+    // Whether medianame_fts exists. SQLite builds without FTS5 leave it out
+    // and searchMedia() falls back to scanning every alias.
+    bool searchIndex_ = false;
     // Transactions belong to the connection, not to a calling thread. Keep a
     // complete logical operation under one recursive lock because several
     // public operations call shared private helpers.
-    mutable std::recursive_mutex db_mutex_;
+    mutable MeteredMutex<std::recursive_mutex> db_mutex_;
+    // Served to checkUserInList() and getOwnerUserId() without a connection.
+    mutable AclSnapshot acl_;
+
+    std::vector<std::unique_ptr<Connection>> readers_;
+    mutable std::vector<Connection*> idleReaders_;
+    mutable std::mutex readersMutex_;
+    mutable std::condition_variable readersAvailable_;
+    mutable DatabaseMetrics metrics_{"SQLite"};
 };
@@ -2,10 +2,13 @@
 #include <absl/strings/str_split.h>
 
 #include <ConfigManager.hpp>
+#include <TryParseStr.hpp>
+#include <chrono>
 #include <database/bot/TgBotDatabaseImpl.hpp>
 
 #include "CommandLine.hpp"
 #include "DatabaseBase.hpp"
+#include "DatabaseMetrics.hpp"
 
 bool TgBotDatabaseImpl_load(ConfigManager* configmgr, TgBotDatabaseImpl* dbimpl,
                             CommandLine* cmdline) {
@@ -43,5 +46,15 @@ bool TgBotDatabaseImpl_load(ConfigManager* configmgr, TgBotDatabaseImpl* dbimpl,
     } else {
         DLOG(INFO) << "Database loaded";
     }
+
+    const auto slowQueryMs =
+        configmgr->get(ConfigManager::Configs::DATABASE_SLOW_QUERY_MS);
+    int threshold = 0;
+    if (slowQueryMs && !try_parse(*slowQueryMs, &threshold)) {
+        LOG(WARNING) << "Invalid slow query threshold: " << *slowQueryMs;
+    } else if (auto* metrics = dbimpl->metrics();
+               threshold > 0 && metrics != nullptr) {
+        metrics->setSlowThreshold(std::chrono::milliseconds(threshold));
+    }
     return loaded;
 }
@@ -4,6 +4,7 @@
 #include <api/typedefs.h>
 #include <fmt/format.h>
 
+#include <database/AsyncDatabase.hpp>
 #include <database/DatabaseBase.hpp>
 #include <filesystem>
 #include <memory>
@@ -58,17 +59,23 @@ bool TgBotDatabaseImpl::load(std::filesystem::path filepath) {
         LOG(ERROR) << "Failed to load database: " << ex.what();
         return false;
     }
+    if (loaded) {
+        _async = std::make_unique<AsyncDatabase>(_databaseImpl.get());
+    }
     return loaded;
 }
 
 bool TgBotDatabaseImpl::unload() {
     if (loaded) {
+        // Let queued writes land before the backend goes away.
+        _async.reset();
         if (_databaseImpl->unload()) {
             loaded = false;
             return true;
         }
         LOG(ERROR) << "Database backend failed to unload; keeping it marked "
                       "loaded so persistence can be retried";
+        _async = std::make_unique<AsyncDatabase>(_databaseImpl.get());
         return false;
     } else {
         LOG(WARNING) << "No database to unload.";
@@ -80,18 +87,17 @@ bool TgBotDatabaseImpl::isLoaded() const {
     return loaded;
 }
 
+AsyncDatabase* TgBotDatabaseImpl::async() const {
+    return _async.get();
+}
+
 DatabaseBase::ListResult TgBotDatabaseImpl::addUserToList(
     DatabaseBase::ListType type, UserId user) const {
     if (!isLoaded()) {
         LOG(ERROR) << __func__ << ": No-op due to missing database";
         return DatabaseBase::ListResult::BACKEND_ERROR;
     }
-    try {
-        return _databaseImpl->addUserToList(type, user);
-    } catch (const exception& ex) {
-        LOG(ERROR) << "Failed to add user to list: " << ex.what();
-        return DatabaseBase::ListResult::BACKEND_ERROR;
-    }
+    return _async->addUserToList(type, user).get();
 }
 
 DatabaseBase::ListResult TgBotDatabaseImpl::removeUserFromList(
@@ -122,6 +128,20 @@ DatabaseBase::ListResult TgBotDatabaseImpl::checkUserInList(
     }
 }
 
+std::vector<UserId> TgBotDatabaseImpl::getUsersInList(
+    DatabaseBase::ListType type) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return {};
+    }
+    try {
+        return _databaseImpl->getUsersInList(type);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to get users in list: " << ex.what();
+        return {};
+    }
+}
+
 std::optional<UserId> TgBotDatabaseImpl::getOwnerUserId() const {
     if (!isLoaded()) {
         LOG(ERROR) << __func__ << ": No-op due to missing database";
@@ -155,12 +175,7 @@ TgBotDatabaseImpl::AddResult TgBotDatabaseImpl::addMediaInfo(
         LOG(ERROR) << __func__ << ": No-op due to missing database";
         return AddResult::BACKEND_ERROR;
     }
-    try {
-        return _databaseImpl->addMediaInfo(info);
-    } catch (const exception& ex) {
-        LOG(ERROR) << "Failed to add media info: " << ex.what();
-        return AddResult::BACKEND_ERROR;
-    }
+    return _async->addMediaInfo(info).get();
 }
 
 std::vector<TgBotDatabaseImpl::MediaInfo> TgBotDatabaseImpl::getAllMediaInfos()
@@ -214,12 +229,7 @@ TgBotDatabaseImpl::AddResult TgBotDatabaseImpl::addChatInfo(
         LOG(ERROR) << __func__ << ": No-op due to missing database";
         return AddResult::BACKEND_ERROR;
     }
-    try {
-        return _databaseImpl->addChatInfo(chatid, name);
-    } catch (const exception& ex) {
-        LOG(ERROR) << "Failed to add chat info: " << ex.what();
-        return AddResult::BACKEND_ERROR;
-    }
+    return _async->addChatInfo(chatid, std::string(name)).get();
 }
 
 std::optional<ChatId> TgBotDatabaseImpl::getChatId(
@@ -305,6 +315,94 @@ std::vector<TgBotDatabaseImpl::ChatInfo> TgBotDatabaseImpl::getAllChatInfos()
     }
 }
 
+std::vector<TgBotDatabaseImpl::AddResult> TgBotDatabaseImpl::addMediaInfos(
+    std::span<const MediaInfo> infos) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return std::vector(infos.size(), AddResult::BACKEND_ERROR);
+    }
+    try {
+        return _databaseImpl->addMediaInfos(infos);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to add media infos: " << ex.what();
+        return std::vector(infos.size(), AddResult::BACKEND_ERROR);
+    }
+}
+
+std::vector<TgBotDatabaseImpl::AddResult> TgBotDatabaseImpl::addChatInfos(
+    std::span<const ChatInfo> chats) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return std::vector(chats.size(), AddResult::BACKEND_ERROR);
+    }
+    try {
+        return _databaseImpl->addChatInfos(chats);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to add chat infos: " << ex.what();
+        return std::vector(chats.size(), AddResult::BACKEND_ERROR);
+    }
+}
+
+std::vector<TgBotDatabaseImpl::ListResult> TgBotDatabaseImpl::addUsersToList(
+    ListType type, std::span<const UserId> users) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return std::vector(users.size(), ListResult::BACKEND_ERROR);
+    }
+    try {
+        return _databaseImpl->addUsersToList(type, users);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to add users to list: " << ex.what();
+        return std::vector(users.size(), ListResult::BACKEND_ERROR);
+    }
+}
+
+void TgBotDatabaseImpl::forEachMediaInfo(
+    const std::function<bool(const MediaInfo&)>& visitor) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return;
+    }
+    try {
+        _databaseImpl->forEachMediaInfo(visitor);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to iterate media infos: " << ex.what();
+    }
+}
+
+bool TgBotDatabaseImpl::exportRows(
+    const std::function<bool(std::span<const DumpRow>)>& sink,
+    const std::size_t batchSize) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return false;
+    }
+    try {
+        return _databaseImpl->exportRows(sink, batchSize);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to export database: " << ex.what();
+        return false;
+    }
+}
+
+std::vector<TgBotDatabaseImpl::MediaMatch> TgBotDatabaseImpl::searchMedia(
+    const std::string_view query, const std::size_t limit) const {
+    if (!isLoaded()) {
+        LOG(ERROR) << __func__ << ": No-op due to missing database";
+        return {};
+    }
+    try {
+        return _databaseImpl->searchMedia(query, limit);
+    } catch (const exception& ex) {
+        LOG(ERROR) << "Failed to search media: " << ex.what();
+        return {};
+    }
+}
+
+DatabaseMetrics* TgBotDatabaseImpl::metrics() const {
+    return _databaseImpl ? _databaseImpl->metrics() : nullptr;
+}
+
 TgBotDatabaseImpl::Providers::Providers(CommandLine* cmdline) {
 #ifdef DATABASE_HAVE_SQLITE
     registerProvider("sqlite",
@@ -5,10 +5,12 @@
 #include <trivial_helpers/_class_helper_macros.h>
 
 #include <ConfigManager.hpp>
+#include <database/AsyncDatabase.hpp>
 #include <database/DatabaseBase.hpp>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string_view>
 #include <unordered_map>
 
@@ -67,12 +69,20 @@ struct DBIMPL_EXPORT TgBotDatabaseImpl : DatabaseBase {
 
     // Wrappers
     [[nodiscard]] bool isLoaded() const;
+
+    // Queue in front of the loaded backend, or nullptr when not loaded.
+    // addUserToList(), addMediaInfo() and addChatInfo() go through it and
+    // wait, so concurrent callers share a group commit; callers that do not
+    // need the result can use it directly and not wait at all.
+    [[nodiscard]] AsyncDatabase* async() const override;
     [[nodiscard]] DatabaseBase::ListResult addUserToList(
         DatabaseBase::ListType type, UserId user) const override;
     [[nodiscard]] DatabaseBase::ListResult removeUserFromList(
         DatabaseBase::ListType type, UserId user) const override;
     [[nodiscard]] DatabaseBase::ListResult checkUserInList(
         DatabaseBase::ListType type, UserId user) const override;
+    [[nodiscard]] std::vector<UserId> getUsersInList(
+        DatabaseBase::ListType type) const override;
     [[nodiscard]] std::optional<UserId> getOwnerUserId() const override;
     [[nodiscard]] std::optional<DatabaseBase::MediaInfo> queryMediaInfo(
         std::string str) const override;
@@ -96,6 +106,21 @@ struct DBIMPL_EXPORT TgBotDatabaseImpl : DatabaseBase {
         const ChatId chatId) const override;
     std::optional<std::vector<decltype(MediaInfo::mediaId)>> getMediaIds(
         const std::string_view alias) const override;
+    [[nodiscard]] std::vector<AddResult> addMediaInfos(
+        std::span<const MediaInfo> infos) const override;
+    [[nodiscard]] std::vector<AddResult> addChatInfos(
+        std::span<const ChatInfo> chats) const override;
+    [[nodiscard]] std::vector<ListResult> addUsersToList(
+        ListType type, std::span<const UserId> users) const override;
+    void forEachMediaInfo(
+        const std::function<bool(const MediaInfo&)>& visitor) const override;
+    [[nodiscard]] bool exportRows(
+        const std::function<bool(std::span<const DumpRow>)>& sink,
+        std::size_t batchSize) const override;
+    [[nodiscard]] std::vector<MediaMatch> searchMedia(
+        std::string_view query, std::size_t limit) const override;
+    // The metrics of the backend in use, nullptr if there is none.
+    [[nodiscard]] DatabaseMetrics* metrics() const override;
 
     // Load database from file
     bool load(std::filesystem::path filepath) override;
@@ -107,6 +132,8 @@ struct DBIMPL_EXPORT TgBotDatabaseImpl : DatabaseBase {
     bool setImpl(std::unique_ptr<DatabaseBase> impl);
 
     std::unique_ptr<DatabaseBase> _databaseImpl;
+    // Declared after the backend so it is stopped first.
+    std::unique_ptr<AsyncDatabase> _async;
     bool loaded = false;
 };
 
@@ -0,0 +1,235 @@
+#include <absl/log/log.h>
+#include <fmt/format.h>
+#include <sqlite3.h>
+
+#include <TryParseStr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <database/AsyncDatabase.hpp>
+#include <database/SQLiteDatabase.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CommandLine.hpp"
+
+// Measures per-query latency of the SQLiteDatabase list lookup that
+// AuthContext runs for every command, against the pre-cache baseline of
+// reading and preparing the .sql script for each query, then the aggregate
+// read throughput of the same lookup from several threads at once, and
+// finally the latency of chat writes racing list lookups when each write
+// commits on its own versus when it goes through AsyncDatabase.
+//
+// Usage: DatabaseBench [iterations]
+
+namespace {
+
+constexpr UserId kUserCount = 1000;
+constexpr int kDefaultIterations = 100000;
+constexpr unsigned int kMixedWriters = 4;
+constexpr unsigned int kMixedReaders = 2;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Fn>
+void measure(const std::string_view name, const int iterations, Fn&& fn) {
+    const auto start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        fn(static_cast<UserId>(i % kUserCount) + 1);
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        Clock::now() - start;
+    fmt::print("{:<28} {:>10.0f} ns/query ({} queries)\n", name,
+               elapsed.count() / iterations, iterations);
+}
+
+// What each lookup used to cost: open and read the script, prepare, bind,
+// step and finalize.
+bool uncachedLookup(sqlite3* raw, const std::filesystem::path& script,
+                    const UserId user) {
+    std::ifstream sqlFile(script);
+    const std::string sql((std::istreambuf_iterator<char>(sqlFile)),
+                          std::istreambuf_iterator<char>());
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(raw, sql.c_str(), -1, &stmt, nullptr) !=
+        SQLITE_OK) {
+        return false;
+    }
+    sqlite3_bind_int64(stmt, 1, user);
+    const bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+void measureThroughput(const SQLiteDatabase& database, const int iterations,
+                       const unsigned int threadCount) {
+    const int perThread =
+        std::max(1, iterations / static_cast<int>(threadCount));
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount);
+    const auto start = Clock::now();
+    for (unsigned int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&database, perThread, t] {
+            for (int i = 0; i < perThread; ++i) {
+                const auto user =
+                    static_cast<UserId>((i + t * perThread) % kUserCount) + 1;
+                (void)database.checkUserInList(
+                    DatabaseBase::ListType::WHITELIST, user);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    fmt::print("{:>2} reader threads {:>20.0f} queries/s\n", threadCount,
+               perThread * threadCount / elapsed.count());
+}
+
+double percentile(std::vector<double>& samples, const double fraction) {
+    if (samples.empty()) {
+        return 0;
+    }
+    const auto index = static_cast<std::size_t>(
+        fraction * static_cast<double>(samples.size() - 1));
+    std::ranges::nth_element(samples, samples.begin() + index);
+    return samples[index];
+}
+
+// Runs kMixedWriters threads adding chats through addChat while
+// kMixedReaders threads check list membership, and reports the latency of
+// both in microseconds.
+template <typename AddChat>
+void measureMixed(const std::string_view name, const SQLiteDatabase& database,
+                  const ChatId firstChat, const int writesPerThread,
+                  AddChat&& addChat) {
+    std::vector<std::vector<double>> writes(kMixedWriters);
+    std::vector<std::vector<double>> reads(kMixedReaders);
+    std::atomic_bool writing = true;
+    std::vector<std::thread> readers;
+    for (unsigned int t = 0; t < kMixedReaders; ++t) {
+        readers.emplace_back([&database, &writing, &samples = reads[t]] {
+            for (UserId user = 1; writing; user = user % kUserCount + 1) {
+                const auto start = Clock::now();
+                (void)database.checkUserInList(
+                    DatabaseBase::ListType::WHITELIST, user);
+                samples.emplace_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() -
+                                                              start)
+                        .count());
+            }
+        });
+    }
+    std::vector<std::thread> writers;
+    for (unsigned int t = 0; t < kMixedWriters; ++t) {
+        writers.emplace_back([&, t, &samples = writes[t]] {
+            for (int i = 0; i < writesPerThread; ++i) {
+                const ChatId chat = firstChat + t * writesPerThread + i;
+                const auto start = Clock::now();
+                (void)addChat(chat, fmt::format("bench-{}", chat));
+                samples.emplace_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() -
+                                                              start)
+                        .count());
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    writing = false;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    const auto merge = [](std::vector<std::vector<double>>& perThread) {
+        std::vector<double> all;
+        for (auto& samples : perThread) {
+            all.insert(all.end(), samples.begin(), samples.end());
+        }
+        return all;
+    };
+    auto allWrites = merge(writes);
+    auto allReads = merge(reads);
+    fmt::print(
+        "{:<20} write p50 {:>8.1f} us p99 {:>8.1f} us | read p50 {:>6.1f} "
+        "us p99 {:>8.1f} us\n",
+        name, percentile(allWrites, 0.5), percentile(allWrites, 0.99),
+        percentile(allReads, 0.5), percentile(allReads, 0.99));
+}
+
+}  // namespace
+
+int app_main(int argc, char** argv) {
+    CommandLine line{argc, argv};
+    int iterations = kDefaultIterations;
+    if (argc > 1 && (!try_parse(argv[1], &iterations) || iterations <= 0)) {
+        LOG(ERROR) << "Usage: " << argv[0] << " [iterations]";
+        return EXIT_FAILURE;
+    }
+
+    const auto sqlPath = line.getPath(FS::PathType::RESOURCES_SQL);
+    const auto dbPath =
+        std::filesystem::temp_directory_path() / "glider-database-bench.db";
+    std::filesystem::remove(dbPath);
+
+    SQLiteDatabase database(sqlPath);
+    if (!database.load(dbPath)) {
+        LOG(ERROR) << "Failed to load benchmark database";
+        return EXIT_FAILURE;
+    }
+    for (UserId user = 1; user <= kUserCount; ++user) {
+        (void)database.addUserToList(user % 2 == 0
+                                         ? DatabaseBase::ListType::WHITELIST
+                                         : DatabaseBase::ListType::BLACKLIST,
+                                     user);
+    }
+
+    sqlite3* raw = nullptr;
+    if (sqlite3_open(dbPath.string().c_str(), &raw) != SQLITE_OK) {
+        LOG(ERROR) << "Failed to open baseline connection";
+        sqlite3_close(raw);
+        return EXIT_FAILURE;
+    }
+    const auto findUser =
+        sqlPath / SQLiteDatabase::Helper::kFindUserFile.data();
+    measure("read+prepare per query", iterations, [&](const UserId user) {
+        (void)uncachedLookup(raw, findUser, user);
+    });
+    sqlite3_close(raw);
+
+    measure("cached checkUserInList", iterations, [&](const UserId user) {
+        (void)database.checkUserInList(DatabaseBase::ListType::WHITELIST,
+                                       user);
+    });
+
+    for (const unsigned int threads : {1U, 2U, 4U, 8U}) {
+        measureThroughput(database, iterations, threads);
+    }
+
+    const int writesPerThread = std::max(1, iterations / 1000);
+    measureMixed("direct addChatInfo", database, 1, writesPerThread,
+                 [&database](const ChatId chat, const std::string& name) {
+                     return database.addChatInfo(chat, name);
+                 });
+    {
+        AsyncDatabase async(&database);
+        measureMixed("AsyncDatabase", database,
+                     1 + kMixedWriters * writesPerThread, writesPerThread,
+                     [&async](const ChatId chat, std::string name) {
+                         return async.addChatInfo(chat, std::move(name)).get();
+                     });
+        const auto stats = async.stats();
+        fmt::print("{:<20} {} writes in {} commits\n", "", stats.writes,
+                   stats.commits);
+    }
+
+    (void)database.unload();
+    std::filesystem::remove(dbPath);
+    return EXIT_SUCCESS;
+}
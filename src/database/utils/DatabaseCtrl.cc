@@ -1,8 +1,11 @@
 #include <absl/log/log.h>
 
 #include <TryParseStr.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <cstdlib>
 #include <database/bot/TgBotDatabaseImpl.hpp>
+#include <filesystem>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -20,6 +23,8 @@ enum class Commands : uint8_t {
     WhiteBlackList,
     DeleteMedia,
     DeleteChat,
+    CopyTo,
+    Export,
 };
 
 // Structure to hold command data for easier manipulation and handling
@@ -28,6 +33,8 @@ struct CommandData {
     std::vector<std::string_view> args;
     // Instance of TgBotDatabaseImpl
     std::unique_ptr<TgBotDatabaseImpl> impl;
+    // Command line, to construct other database providers
+    CommandLine* line = nullptr;
 };
 
 namespace {
@@ -88,6 +95,12 @@ void executeCommand<Commands::Help>(const CommandData& data) {
     std::cout << "- set_white_black_list: Add/remove the white/black list user "
                  "for the database"
               << '\n';
+    std::cout << "- copy_to: Copy media, chats, the owner and the user lists "
+                 "into another database backend"
+              << '\n';
+    std::cout << "- export: Write the database to stdout as csv or "
+                 "length-delimited protobuf"
+              << '\n';
 }
 
 template <>
@@ -95,6 +108,21 @@ void executeCommand<Commands::Dump>(const CommandData& data) {
     data.impl->dump(std::cout);
 }
 
+template <>
+void executeCommand<Commands::Export>(const CommandData& data) {
+    if (data.args.size() != 1 ||
+        (data.args[0] != "csv" && data.args[0] != "protobuf")) {
+        LOG(ERROR) << "Need <csv|protobuf> as argument";
+        return;
+    }
+    const auto format = data.args[0] == "csv"
+                            ? DatabaseBase::DumpFormat::CSV
+                            : DatabaseBase::DumpFormat::PROTOBUF;
+    if (!data.impl->exportTo(std::cout, format)) {
+        LOG(ERROR) << "Failed to export the database";
+    }
+}
+
 template <>
 void executeCommand<Commands::AddChat>(const CommandData& data) {
     if (data.args.size() != 2) {
@@ -183,6 +211,97 @@ void executeCommand<Commands::WhiteBlackList>(const CommandData& data) {
         }
     }
 }
+template <>
+void executeCommand<Commands::CopyTo>(const CommandData& data) {
+    if (data.args.size() != 2) {
+        LOG(ERROR) << "Need <sqlite|protobuf> <path> as arguments";
+        return;
+    }
+    TgBotDatabaseImpl::Providers providers(data.line);
+    if (!providers.chooseProvider(data.args[0])) {
+        return;
+    }
+    TgBotDatabaseImpl target;
+    if (!target.setImpl(std::move(providers)) ||
+        !target.load(std::filesystem::path(data.args[1]))) {
+        LOG(ERROR) << "Failed to load target database";
+        return;
+    }
+
+    // Stream the media out and commit it in chunks, so neither side holds
+    // the whole table and each chunk is one transaction.
+    constexpr std::size_t kChunkSize = 1000;
+    std::vector<DatabaseBase::MediaInfo> chunk;
+    chunk.reserve(kChunkSize);
+    std::size_t copied = 0;
+    std::size_t skipped = 0;
+    bool failed = false;
+    const auto flush = [&] {
+        for (const auto result : target.addMediaInfos(chunk)) {
+            switch (result) {
+                case DatabaseBase::AddResult::OK:
+                    ++copied;
+                    break;
+                case DatabaseBase::AddResult::ALREADY_EXISTS:
+                    ++skipped;
+                    break;
+                case DatabaseBase::AddResult::BACKEND_ERROR:
+                    failed = true;
+                    break;
+            }
+        }
+        chunk.clear();
+        return !failed;
+    };
+    data.impl->forEachMediaInfo([&](const DatabaseBase::MediaInfo& info) {
+        chunk.emplace_back(info);
+        return chunk.size() < kChunkSize || flush();
+    });
+    if (!failed && !chunk.empty()) {
+        flush();
+    }
+    if (failed) {
+        LOG(ERROR) << "Failed to copy media after " << copied << " entries";
+        return;
+    }
+    LOG(INFO) << "Copied " << copied << " media, skipped " << skipped
+              << " already present";
+
+    const auto chats = data.impl->getAllChatInfos();
+    const auto chatResults = target.addChatInfos(chats);
+    const auto chatsCopied =
+        std::ranges::count(chatResults, DatabaseBase::AddResult::OK);
+    if (std::ranges::count(chatResults,
+                           DatabaseBase::AddResult::BACKEND_ERROR) != 0) {
+        LOG(ERROR) << "Failed to copy chat infos";
+        return;
+    }
+    LOG(INFO) << "Copied " << chatsCopied << " of " << chats.size()
+              << " chat infos";
+
+    if (const auto owner = data.impl->getOwnerUserId()) {
+        if (target.claimOwnerUserId(*owner) ==
+            DatabaseBase::OwnerClaimResult::OK) {
+            LOG(INFO) << "Copied owner ID " << *owner;
+        }
+    }
+
+    for (const auto type : {DatabaseBase::ListType::WHITELIST,
+                            DatabaseBase::ListType::BLACKLIST}) {
+        const auto users = data.impl->getUsersInList(type);
+        const auto results = target.addUsersToList(type, users);
+        if (std::ranges::count(results,
+                               DatabaseBase::ListResult::BACKEND_ERROR) != 0) {
+            LOG(ERROR) << "Failed to copy the "
+                       << DatabaseBase::getSimpleName(type);
+            return;
+        }
+        const auto usersCopied =
+            std::ranges::count(results, DatabaseBase::ListResult::OK);
+        LOG(INFO) << "Copied " << usersCopied << " of " << users.size()
+                  << " users in the " << DatabaseBase::getSimpleName(type);
+    }
+}
 }  // namespace
 
 int app_main(int argc, char** argv) {
@@ -209,7 +328,7 @@ int app_main(int argc, char** argv) {
     const std::string_view command = args[1];
     // Erase exe, command name
     args.erase(args.begin(), args.begin() + 2);
-    data = {.args = args, .impl = std::move(dbImpl)};
+    data = {.args = args, .impl = std::move(dbImpl), .line = &line};
 
     DLOG(INFO) << "Executing command: " << command;
     if (command == "dump") {
@@ -224,6 +343,10 @@ int app_main(int argc, char** argv) {
         executeCommand<Commands::SetOwnerId>(data);
     } else if (command == "set_white_black_list") {
         executeCommand<Commands::WhiteBlackList>(data);
+    } else if (command == "copy_to") {
+        executeCommand<Commands::CopyTo>(data);
+    } else if (command == "export") {
+        executeCommand<Commands::Export>(data);
     } else {
         LOG(ERROR) << "Unknown command: " << command;
     }
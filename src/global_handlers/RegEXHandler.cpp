@@ -35,59 +35,72 @@ using std::regex_constants::match_not_null;
 }
 
 void RegexHandler::registerCommand(std::unique_ptr<RegexCommand> handler) {
-    std::lock_guard<std::mutex> lock(_mutex);
     LOG(INFO) << "Registering handler: " << std::quoted(handler->description());
+    const auto leader = static_cast<unsigned char>(handler->shape().leader);
+    _dispatch[leader].emplace_back(handler.get());
     // Transfer ownership to the vector
     _handlers.emplace_back(std::move(handler));
 }
 
+const RegexCommand* RegexHandler::route(const std::string& regexCommand) const {
+    if (regexCommand.empty()) {
+        return nullptr;
+    }
+    const auto& candidates =
+        _dispatch[static_cast<unsigned char>(regexCommand.front())];
+    for (const auto* handler : candidates) {
+        const char suffix = handler->shape().suffix;
+        if (suffix == '\0' || regexCommand.back() == suffix) {
+            return handler;
+        }
+    }
+    return nullptr;
+}
+
 void RegexHandler::execute(const std::shared_ptr<Interface>& callback,
                            const std::string& source,
-                           const std::string& regexCommand) {
-    std::lock_guard<std::mutex> lock(_mutex);
-
-    if (_handlers.empty()) {
-        // No registered regex commands, just return.
+                           const std::string& regexCommand) const {
+    const RegexCommand* handler = route(regexCommand);
+    if (handler == nullptr) {
+        // No regex command has this shape, just return.
         return;
     }
-    for (const auto& handler : _handlers) {
-        RegexCommand::Result ret = handler->process(source, regexCommand);
-        if (ret.has_value()) {
-            callback->onSuccess(*ret);
-        } else {
-            switch (ret.error()) {
-                case RegexCommand::Error::InvalidRegexOption:
-                    callback->onError(tinystatus::TinyStatus(
-                        tinystatus::Status::kInvalidArgument,
-                        "Invalid regex option in command: " + regexCommand));
-                    return;
-                case RegexCommand::Error::GlobalFlagAndMatchIndexInvalid:
-                    callback->onError(tinystatus::TinyStatus(
-                        tinystatus::Status::kInvalidArgument,
-                        "Global flag and match index are not compatible: " +
-                            regexCommand));
-                    return;
-                case RegexCommand::Error::InvalidRegexMatchIndex:
-                    callback->onError(tinystatus::TinyStatus(
-                        tinystatus::Status::kInvalidArgument,
-                        "Invalid regex match index: " + regexCommand));
-                    return;
-                case RegexCommand::Error::InvalidRegex:
-                    callback->onError(tinystatus::TinyStatus(
-                        tinystatus::Status::kInvalidArgument,
-                        "Invalid regex: " + regexCommand));
-                    return;
-                case RegexCommand::Error::None:
-                    // No error, just continue to the next handler
-                    break;
-                default:
-                    callback->onError(tinystatus::TinyStatus(
-                        tinystatus::Status::kInternalError,
-                        "An unexpected error occurred while processing "
-                        "regex command: " +
-                            regexCommand));
-                    return;
-            }
+    RegexCommand::Result ret = handler->process(source, regexCommand);
+    if (ret.has_value()) {
+        callback->onSuccess(*ret);
+    } else {
+        switch (ret.error()) {
+            case RegexCommand::Error::InvalidRegexOption:
+                callback->onError(tinystatus::TinyStatus(
+                    tinystatus::Status::kInvalidArgument,
+                    "Invalid regex option in command: " + regexCommand));
+                return;
+            case RegexCommand::Error::GlobalFlagAndMatchIndexInvalid:
+                callback->onError(tinystatus::TinyStatus(
+                    tinystatus::Status::kInvalidArgument,
+                    "Global flag and match index are not compatible: " +
+                        regexCommand));
+                return;
+            case RegexCommand::Error::InvalidRegexMatchIndex:
+                callback->onError(tinystatus::TinyStatus(
+                    tinystatus::Status::kInvalidArgument,
+                    "Invalid regex match index: " + regexCommand));
+                return;
+            case RegexCommand::Error::InvalidRegex:
+                callback->onError(tinystatus::TinyStatus(
+                    tinystatus::Status::kInvalidArgument,
+                    "Invalid regex: " + regexCommand));
+                return;
+            case RegexCommand::Error::None:
+                // Shape fit, but the full grammar didn't; ignore.
+                break;
+            default:
+                callback->onError(tinystatus::TinyStatus(
+                    tinystatus::Status::kInternalError,
+                    "An unexpected error occurred while processing "
+                    "regex command: " +
+                        regexCommand));
+                return;
         }
     }
 }
@@ -141,7 +154,9 @@ void RegexHandler::execute(const std::shared_ptr<Interface>& callback,
 // clang-format on
 
 struct ReplaceCommand : public RegexCommand {
-    [[nodiscard]] std::regex command_regex() const override {
+    [[nodiscard]] Shape shape() const override { return {'s'}; }
+
+    [[nodiscard]] const std::regex& command_regex() const override {
         static std::regex regex(
             R"(^s\/((?:[^\/\\]|\\.)+)\/((?:[^\/\\]|\\.)*)(\/)?(.*)?$)");
         return regex;
@@ -235,7 +250,9 @@ struct ReplaceCommand : public RegexCommand {
 };
 
 struct DeleteCommand : public RegexCommand {
-    [[nodiscard]] std::regex command_regex() const override {
+    [[nodiscard]] Shape shape() const override { return {'/', 'd'}; }
+
+    [[nodiscard]] const std::regex& command_regex() const override {
         // Match for the delete command pattern like /pattern/d
         static std::regex regex(R"(^\/((?:[^\/\\]|\\.)+)\/d$)");
         return regex;
@@ -265,7 +282,9 @@ struct DeleteCommand : public RegexCommand {
 };
 
 struct PrintCommand : public RegexCommand {
-    [[nodiscard]] std::regex command_regex() const override {
+    [[nodiscard]] Shape shape() const override { return {'/', 'p'}; }
+
+    [[nodiscard]] const std::regex& command_regex() const override {
         // Matches /pattern/p
         static std::regex regex(R"(^\/((?:[^\/\\]|\\.)+)\/p$)");
         return regex;
@@ -295,7 +314,9 @@ struct PrintCommand : public RegexCommand {
 };
 
 struct CountCommand : public RegexCommand {
-    [[nodiscard]] std::regex command_regex() const override {
+    [[nodiscard]] Shape shape() const override { return {'/', 'c'}; }
+
+    [[nodiscard]] const std::regex& command_regex() const override {
         // Matches /pattern/c
         static std::regex regex(R"(^\/((?:[^\/\\]|\\.)+)\/c$)");
         return regex;
@@ -322,7 +343,9 @@ struct CountCommand : public RegexCommand {
     }
 };
 struct ToUpperCommand : public RegexCommand {
-    [[nodiscard]] std::regex command_regex() const override {
+    [[nodiscard]] Shape shape() const override { return {'u', '/'}; }
+
+    [[nodiscard]] const std::regex& command_regex() const override {
         // Matches u/pattern/
         static std::regex regex(R"(^u\/((?:[^\/\\]|\\.)+)\/$)");
         return regex;
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <absl/base/log_severity.h>
+#include <absl/log/log.h>
+#include <absl/log/log_entry.h>
+#include <absl/log/log_sink.h>
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <StructF.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * A log sink that writes on a background thread. Send() copies the
+ * formatted entry into a bounded lock-free ring and returns. The writer
+ * thread takes everything queued at once and writes it with a single call,
+ * so logging threads neither wait on the file nor on each other.
+ *
+ * Entries go into fixed size slots, a long one into several consecutive
+ * ones. When the ring is full, Policy decides whether Send() waits for
+ * room or drops the entry. Dropped entries are counted and reported in the
+ * file. If the file couldn't be opened, every entry is dropped.
+ */
+class AsyncLogSink : public absl::LogSink {
+   public:
+    enum class Policy {
+        // Wait for the writer to make room. Nothing is lost.
+        Block,
+        // Drop the entry. Logging never waits.
+        Drop,
+    };
+
+    struct Options {
+        // Rounded up to a power of two.
+        std::size_t slots = 4096;
+        Policy policy = Policy::Block;
+        // The longest an entry stays queued. Errors and a ring half full
+        // wake the writer earlier.
+        std::chrono::milliseconds flushInterval{50};
+    };
+
+    AsyncLogSink(F file, const Options& options)
+        : file_(std::move(file)),
+          writable_(file_.native_handle() != nullptr),
+          slots_(std::bit_ceil(std::max<std::size_t>(options.slots, 2))),
+          policy_(options.policy),
+          flushInterval_(options.flushInterval) {
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        // Without a file there is nothing to write. Writing anyway would
+        // log an error, which comes back here from the writer, forever.
+        if (writable_) {
+            writer_ = std::jthread(
+                [this](const std::stop_token& stop) { run(stop); });
+        }
+    }
+    AsyncLogSink(const std::filesystem::path& filename, const Options& options)
+        : AsyncLogSink(open(filename), options) {}
+    explicit AsyncLogSink(const std::filesystem::path& filename)
+        : AsyncLogSink(filename, Options{}) {}
+
+    ~AsyncLogSink() override {
+        if (writer_.joinable()) {
+            writer_.request_stop();
+            wake();
+            writer_.join();
+        }
+    }
+    NO_COPY_CTOR(AsyncLogSink);
+
+    void Send(const absl::LogEntry& entry) override {
+        if (!writable_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::string_view text = entry.text_message_with_prefix_and_newline();
+        // An entry takes at most half the ring, so one always fits.
+        text = text.substr(0, slots_.size() / 2 * kSlotBytes);
+        const auto count = std::max<std::uint64_t>(
+            (text.size() + kSlotBytes - 1) / kSlotBytes, 1);
+
+        const auto position = claim(count);
+        if (!position) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        for (std::uint64_t i = 0; i < count; ++i) {
+            auto& slot = slotAt(*position + i);
+            const auto chunk = text.substr(i * kSlotBytes, kSlotBytes);
+            std::memcpy(slot.text.data(), chunk.data(), chunk.size());
+            slot.size = static_cast<std::uint32_t>(chunk.size());
+            // Sequentially consistent, to pair with the writer's check
+            // before it sleeps, see wake().
+            slot.sequence.store(*position + i + 1, std::memory_order_seq_cst);
+        }
+
+        const auto queued =
+            *position + count - written_.load(std::memory_order_relaxed);
+        if (entry.log_severity() >= absl::LogSeverity::kFatal) {
+            // The process is about to abort.
+            Flush();
+        } else if (entry.log_severity() >= absl::LogSeverity::kError ||
+                   queued >= slots_.size() / 2) {
+            wake();
+        }
+    }
+
+    // Waits until everything sent before is in the file.
+    void Flush() override {
+        const auto target = claimed_.load(std::memory_order_acquire);
+        wake();
+        auto done = written_.load(std::memory_order_acquire);
+        while (done < target) {
+            written_.wait(done, std::memory_order_acquire);
+            done = written_.load(std::memory_order_acquire);
+        }
+    }
+
+    // Entries dropped because the ring was full or there is no file.
+    [[nodiscard]] std::uint64_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    // Slots are a cache line apart, so producers filling neighbouring
+    // slots do not contend.
+    static constexpr std::size_t kSlotSize = 256;
+    static constexpr std::size_t kSlotBytes =
+        kSlotSize - sizeof(std::atomic<std::uint64_t>) - sizeof(std::uint32_t);
+
+    struct alignas(64) Slot {
+        // The position this slot is free for, or that plus one once the
+        // entry at that position is in it.
+        std::atomic<std::uint64_t> sequence;
+        std::uint32_t size;
+        std::array<char, kSlotBytes> text;
+    };
+
+    static F open(const std::filesystem::path& filename) {
+        F file;
+        const auto& res = file.open(filename.string(), F::Mode::Write);
+        if (!res) {
+            LOG(ERROR) << "Couldn't open file " << filename << ": "
+                       << res.reason;
+            return {};
+        }
+        LOG(INFO) << "File " << filename << " added as async logsink";
+        return file;
+    }
+
+    Slot& slotAt(const std::uint64_t position) {
+        return slots_[position & (slots_.size() - 1)];
+    }
+
+    // Reserves `count` consecutive slots, or none if the ring is full and
+    // the policy is to drop.
+    std::optional<std::uint64_t> claim(const std::uint64_t count) {
+        auto position = claimed_.load(std::memory_order_relaxed);
+        while (true) {
+            // The writer frees slots in order, so the last one being free
+            // means the ones before it are.
+            const auto last = position + count - 1;
+            const auto sequence =
+                slotAt(last).sequence.load(std::memory_order_acquire);
+            if (sequence == last) {
+                if (claimed_.compare_exchange_weak(position, position + count,
+                                                   std::memory_order_relaxed)) {
+                    return position;
+                }
+            } else if (sequence < last) {
+                // Still holds an entry from the previous lap: full.
+                if (policy_ == Policy::Drop) {
+                    return std::nullopt;
+                }
+                wake();
+                std::this_thread::yield();
+                position = claimed_.load(std::memory_order_relaxed);
+            } else {
+                // Another thread claimed it first.
+                position = claimed_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Wakes the writer if it waits, at the cost of a lock only then.
+    void wake() {
+        // The writer announces its sleep, then checks for a new entry. So
+        // either it sees the entries published before this, or this sees it
+        // sleeping.
+        if (!sleeping_.load(std::memory_order_seq_cst)) {
+            return;
+        }
+        {
+            const std::lock_guard<std::mutex> lock(wakeMutex_);
+            wakeRequested_ = true;
+        }
+        wakeup_.notify_one();
+    }
+
+    void run(const std::stop_token& stop) {
+        std::string batch;
+        std::uint64_t position = 0;
+        std::uint64_t reportedDrops = 0;
+        while (true) {
+            // Take every filled slot in order. A long entry still being
+            // copied is finished in the next batch, which nothing else can
+            // come before.
+            batch.clear();
+            while (true) {
+                auto& slot = slotAt(position);
+                if (slot.sequence.load(std::memory_order_acquire) !=
+                    position + 1) {
+                    break;
+                }
+                batch.append(slot.text.data(), slot.size);
+                slot.sequence.store(position + slots_.size(),
+                                    std::memory_order_release);
+                ++position;
+            }
+            const auto drops = dropped();
+            if (drops != reportedDrops) {
+                batch += "AsyncLogSink: dropped " +
+                         std::to_string(drops - reportedDrops) +
+                         " log entries, the queue was full\n";
+                reportedDrops = drops;
+            }
+
+            if (!batch.empty()) {
+                (void)file_.write(batch.data(), 1, batch.size());
+                std::fflush(file_.native_handle());
+                written_.store(position, std::memory_order_release);
+                written_.notify_all();
+                continue;
+            }
+            if (stop.stop_requested() &&
+                position == claimed_.load(std::memory_order_acquire)) {
+                return;
+            }
+            sleeping_.store(true, std::memory_order_seq_cst);
+            if (slotAt(position).sequence.load(std::memory_order_seq_cst) ==
+                position + 1) {
+                sleeping_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wakeup_.wait_for(lock, flushInterval_, [this, &stop] {
+                return wakeRequested_ || stop.stop_requested();
+            });
+            wakeRequested_ = false;
+            sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    F file_;
+    // Whether file_ is open. Nothing is queued if not.
+    const bool writable_;
+    std::vector<Slot> slots_;
+    Policy policy_;
+    std::chrono::milliseconds flushInterval_;
+
+    // Positions handed out to Send() so far.
+    alignas(64) std::atomic<std::uint64_t> claimed_ = 0;
+    // Positions the writer has written, waited on by Flush().
+    alignas(64) std::atomic<std::uint64_t> written_ = 0;
+    std::atomic<std::uint64_t> dropped_ = 0;
+
+    // Set while the writer waits for entries or wake().
+    std::atomic<bool> sleeping_ = false;
+    std::mutex wakeMutex_;
+    std::condition_variable wakeup_;
+    bool wakeRequested_ = false;
+
+    // Last, so it stops before the rest goes away.
+    std::jthread writer_;
+};
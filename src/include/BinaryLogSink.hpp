@@ -0,0 +1,474 @@
+#pragma once
+
+#include <absl/base/log_severity.h>
+#include <absl/log/log.h>
+#include <absl/log/log_entry.h>
+#include <absl/log/log_sink.h>
+#include <absl/time/time.h>
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+#endif
+
+/**
+ * A compact binary log file format, for log files that are read with
+ * `logcat decode` rather than by hand.
+ *
+ * The file starts with kMagic, the segment size (4 bytes) and the time of
+ * the first entry in microseconds since the epoch (8 bytes), little endian.
+ * Records follow, each a type byte and varints:
+ *
+ *  Location: id, line, file name size, file name
+ *  Entry:    time since the previous entry in microseconds (zigzag),
+ *            severity, thread id, location id, message size, message
+ *
+ * Every source location is written once and entries refer to it by id.
+ * Records never cross a segment boundary. A Skip record means the rest of
+ * the segment is unused, a zero type byte that nothing follows.
+ */
+namespace binlog {
+
+inline constexpr std::string_view kMagic = "TGBLOG\x01\n";
+inline constexpr std::size_t kHeaderSize = kMagic.size() + 4 + 8;
+
+enum class RecordType : std::uint8_t {
+    End = 0,
+    Location = 1,
+    Entry = 2,
+    Skip = 3,
+};
+
+// The most bytes a varint of 64 bits takes.
+inline constexpr std::size_t kMaxVarintSize = 10;
+
+inline std::uint8_t* putVarint(std::uint8_t* out, std::uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<std::uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<std::uint8_t>(value);
+    return out;
+}
+
+inline std::uint64_t zigzag(const std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^
+           static_cast<std::uint64_t>(value >> 63);
+}
+
+inline std::int64_t unzigzag(const std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^
+           -static_cast<std::int64_t>(value & 1);
+}
+
+struct Record {
+    absl::Time time;
+    absl::LogSeverity severity;
+    std::uint64_t tid;
+    std::string_view file;
+    int line;
+    std::string_view message;
+};
+
+/**
+ * Decodes a binary log file, which may still be written to or cut short by
+ * a crash: reading stops at the first record not completely written.
+ */
+class Reader {
+   public:
+    explicit Reader(std::string data) : data_(std::move(data)) {
+        if (data_.size() < kHeaderSize ||
+            std::string_view(data_).substr(0, kMagic.size()) != kMagic) {
+            return;
+        }
+        const auto* header =
+            reinterpret_cast<const std::uint8_t*>(data_.data()) +
+            kMagic.size();
+        std::uint64_t firstMicros = 0;
+        for (int i = 0; i < 4; ++i) {
+            segmentSize_ |= std::size_t{header[i]} << (8 * i);
+        }
+        for (int i = 0; i < 8; ++i) {
+            firstMicros |= std::uint64_t{header[4 + i]} << (8 * i);
+        }
+        lastMicros_ = static_cast<std::int64_t>(firstMicros);
+        valid_ = segmentSize_ > kHeaderSize;
+        position_ = kHeaderSize;
+    }
+
+    // The reader of `filename`, or nullopt if it can't be read.
+    static std::optional<Reader> open(const std::filesystem::path& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            return std::nullopt;
+        }
+        return Reader(std::string(std::istreambuf_iterator<char>(file), {}));
+    }
+
+    // Whether the data starts like a binary log file.
+    [[nodiscard]] bool valid() const { return valid_; }
+
+    // Reads the next entry into `record`, whose views stay valid as long
+    // as *this. False at the end of the data.
+    bool next(Record* record) {
+        while (valid_ && position_ < data_.size()) {
+            const std::size_t start = position_;
+            const auto type = static_cast<RecordType>(byte());
+            switch (type) {
+                case RecordType::Skip:
+                    position_ = (start / segmentSize_ + 1) * segmentSize_;
+                    continue;
+                case RecordType::Location:
+                    if (!readLocation()) {
+                        return stop();
+                    }
+                    continue;
+                case RecordType::Entry:
+                    if (!readEntry(record)) {
+                        return stop();
+                    }
+                    return true;
+                default:
+                    return stop();
+            }
+        }
+        return false;
+    }
+
+   private:
+    struct Location {
+        std::string_view file;
+        int line = 0;
+    };
+
+    bool stop() {
+        position_ = data_.size();
+        return false;
+    }
+
+    std::uint8_t byte() {
+        return static_cast<std::uint8_t>(data_[position_++]);
+    }
+
+    std::optional<std::uint64_t> varint() {
+        std::uint64_t value = 0;
+        for (int shift = 0; shift < 64 && position_ < data_.size();
+             shift += 7) {
+            const auto next = byte();
+            value |= std::uint64_t{next & 0x7FU} << shift;
+            if ((next & 0x80) == 0) {
+                return value;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<std::string_view> bytes() {
+        const auto size = varint();
+        if (!size || *size > data_.size() - position_) {
+            return std::nullopt;
+        }
+        const auto view = std::string_view(data_).substr(position_, *size);
+        position_ += *size;
+        return view;
+    }
+
+    bool readLocation() {
+        const auto id = varint();
+        const auto line = varint();
+        if (!id || !line || *id != locations_.size()) {
+            return false;
+        }
+        const auto file = bytes();
+        if (!file) {
+            return false;
+        }
+        locations_.push_back({*file, static_cast<int>(*line)});
+        return true;
+    }
+
+    bool readEntry(Record* record) {
+        const auto delta = varint();
+        if (!delta || position_ >= data_.size()) {
+            return false;
+        }
+        const auto severity = byte();
+        const auto tid = varint();
+        const auto location = varint();
+        if (!tid || !location || *location >= locations_.size()) {
+            return false;
+        }
+        const auto message = bytes();
+        if (!message) {
+            return false;
+        }
+        lastMicros_ += unzigzag(*delta);
+        record->time = absl::FromUnixMicros(lastMicros_);
+        record->severity = static_cast<absl::LogSeverity>(severity);
+        record->tid = *tid;
+        record->file = locations_[*location].file;
+        record->line = locations_[*location].line;
+        record->message = *message;
+        return true;
+    }
+
+    std::string data_;
+    std::size_t position_ = 0;
+    std::size_t segmentSize_ = 0;
+    std::int64_t lastMicros_ = 0;
+    std::vector<Location> locations_;
+    bool valid_ = false;
+};
+
+}  // namespace binlog
+
+#ifndef _WIN32
+
+/**
+ * A log sink writing the binlog format through memory mapped segments of
+ * the file. An entry is a few varints and the raw message copied into the
+ * mapping, with no formatting and no write call. The file grows one
+ * segment at a time and is cut to what was used when the sink goes away.
+ *
+ * What is in the mapping is in the page cache, so a crash of the process
+ * loses nothing written before it.
+ */
+class BinaryLogSink : public absl::LogSink {
+   public:
+    struct Options {
+        // Rounded up to a multiple of 64KiB.
+        std::size_t segmentSize = 1 << 20;
+    };
+
+    BinaryLogSink(const std::filesystem::path& filename,
+                  const Options& options)
+        : segmentSize_(
+              std::max<std::size_t>(
+                  (options.segmentSize + kGranularity - 1) / kGranularity, 1) *
+              kGranularity) {
+        fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     0644);
+        if (fd_ < 0 || !map(0)) {
+            LOG(ERROR) << "Couldn't open file " << filename << ": "
+                       << std::system_category().message(errno);
+            return;
+        }
+        LOG(INFO) << "File " << filename << " added as binary logsink";
+    }
+    explicit BinaryLogSink(const std::filesystem::path& filename)
+        : BinaryLogSink(filename, Options{}) {}
+
+    ~BinaryLogSink() override {
+        if (failed_) {
+            LOG(ERROR) << "Binary log stopped early: "
+                       << std::system_category().message(failed_);
+        }
+        if (fd_ < 0) {
+            return;
+        }
+        const auto used = segmentOffset_ + used_;
+        unmap();
+        (void)::ftruncate(fd_, static_cast<off_t>(used));
+        ::close(fd_);
+    }
+    NO_COPY_CTOR(BinaryLogSink);
+
+    void Send(const absl::LogEntry& entry) override {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (data_ == nullptr) {
+            return;
+        }
+        const auto micros = absl::ToUnixMicros(entry.timestamp());
+        if (segmentOffset_ == 0 && used_ == 0) {
+            writeHeader(micros);
+        }
+        const auto location =
+            intern(entry.source_basename(), entry.source_line());
+        if (!location) {
+            return;
+        }
+
+        // Leave room for the header fields, so a message never needs a
+        // segment of its own.
+        auto message = entry.text_message();
+        message = message.substr(0, segmentSize_ / 2);
+        auto* out = reserve(1 + 5 * binlog::kMaxVarintSize + message.size());
+        if (out == nullptr) {
+            return;
+        }
+        auto* const type = out++;
+        out = binlog::putVarint(out, binlog::zigzag(micros - lastMicros_));
+        *out++ = static_cast<std::uint8_t>(entry.log_severity());
+        out = binlog::putVarint(out, static_cast<std::uint64_t>(entry.tid()));
+        out = binlog::putVarint(out, *location);
+        out = binlog::putVarint(out, message.size());
+        std::memcpy(out, message.data(), message.size());
+        commit(type, binlog::RecordType::Entry, out + message.size());
+        lastMicros_ = micros;
+    }
+
+    // Asks the kernel to start writing the mapped pages out.
+    void Flush() override {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (data_ != nullptr) {
+            (void)::msync(data_, used_, MS_ASYNC);
+        }
+    }
+
+   private:
+    // Mappings start at a multiple of the page size. 64KiB covers every
+    // page size in use.
+    static constexpr std::size_t kGranularity = 64 * 1024;
+
+    // Keyed on the file name, not where it is: once a command module is
+    // unloaded, its __FILE__ strings may be reused by another one. Looked
+    // up by LocationView, so a known location allocates nothing.
+    struct LocationKey {
+        std::string file;
+        int line;
+    };
+    struct LocationView {
+        std::string_view file;
+        int line;
+    };
+    struct LocationHash {
+        using is_transparent = void;
+        std::size_t operator()(const LocationView& key) const {
+            return std::hash<std::string_view>()(key.file) * 31 +
+                   static_cast<std::size_t>(key.line);
+        }
+        std::size_t operator()(const LocationKey& key) const {
+            return (*this)(LocationView{key.file, key.line});
+        }
+    };
+    struct LocationEqual {
+        using is_transparent = void;
+        template <typename L, typename R>
+        bool operator()(const L& lhs, const R& rhs) const {
+            return lhs.line == rhs.line &&
+                   std::string_view(lhs.file) == std::string_view(rhs.file);
+        }
+    };
+
+    bool map(const std::size_t offset) {
+        if (::ftruncate(fd_, static_cast<off_t>(offset + segmentSize_)) != 0) {
+            return false;
+        }
+        void* data = ::mmap(nullptr, segmentSize_, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd_, static_cast<off_t>(offset));
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        data_ = static_cast<std::uint8_t*>(data);
+        segmentOffset_ = offset;
+        used_ = 0;
+        return true;
+    }
+
+    void unmap() {
+        if (data_ != nullptr) {
+            ::munmap(data_, segmentSize_);
+            data_ = nullptr;
+        }
+    }
+
+    // Room for `size` bytes in the current segment, moving on to the next
+    // one if needed. Null if the file can't grow.
+    std::uint8_t* reserve(const std::size_t size) {
+        if (used_ + size <= segmentSize_) {
+            return data_ + used_;
+        }
+        if (used_ < segmentSize_) {
+            data_[used_] = static_cast<std::uint8_t>(binlog::RecordType::Skip);
+        }
+        const auto next = segmentOffset_ + segmentSize_;
+        unmap();
+        if (!map(next)) {
+            failed_ = errno;
+            return nullptr;
+        }
+        return data_;
+    }
+
+    // Completes the record starting at `type` and ending before `end`. The
+    // type goes in last, so a reader never sees a record half written.
+    void commit(std::uint8_t* type, const binlog::RecordType value,
+                const std::uint8_t* end) {
+        std::atomic_ref<std::uint8_t>(*type).store(
+            static_cast<std::uint8_t>(value), std::memory_order_release);
+        used_ = static_cast<std::size_t>(end - data_);
+    }
+
+    void writeHeader(const std::int64_t micros) {
+        std::memcpy(data_, binlog::kMagic.data(), binlog::kMagic.size());
+        auto* out = data_ + binlog::kMagic.size();
+        for (int i = 0; i < 4; ++i) {
+            *out++ = static_cast<std::uint8_t>(segmentSize_ >> (8 * i));
+        }
+        for (int i = 0; i < 8; ++i) {
+            *out++ = static_cast<std::uint8_t>(
+                static_cast<std::uint64_t>(micros) >> (8 * i));
+        }
+        used_ = binlog::kHeaderSize;
+        lastMicros_ = micros;
+    }
+
+    // The id of a source location, written to the file the first time.
+    std::optional<std::uint64_t> intern(const std::string_view file,
+                                        const int line) {
+        if (const auto it = locations_.find(LocationView{file, line});
+            it != locations_.end()) {
+            return it->second;
+        }
+        const std::uint64_t id = locations_.size();
+        auto* out = reserve(1 + 3 * binlog::kMaxVarintSize + file.size());
+        if (out == nullptr) {
+            return std::nullopt;
+        }
+        auto* const type = out++;
+        out = binlog::putVarint(out, id);
+        out = binlog::putVarint(out, static_cast<std::uint64_t>(line));
+        out = binlog::putVarint(out, file.size());
+        std::memcpy(out, file.data(), file.size());
+        commit(type, binlog::RecordType::Location, out + file.size());
+        locations_.emplace(LocationKey{std::string(file), line}, id);
+        return id;
+    }
+
+    std::size_t segmentSize_;
+    int fd_ = -1;
+    // The mapped segment, where it is in the file and how much is used.
+    std::uint8_t* data_ = nullptr;
+    std::size_t segmentOffset_ = 0;
+    std::size_t used_ = 0;
+    int failed_ = 0;
+
+    std::mutex mutex_;
+    std::int64_t lastMicros_ = 0;
+    std::unordered_map<LocationKey, std::uint64_t, LocationHash,
+                       LocationEqual>
+        locations_;
+};
+
+#endif  // _WIN32
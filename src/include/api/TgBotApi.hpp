@@ -21,6 +21,7 @@
 #include <trivial_helpers/fruit_inject.hpp>
 #include <utility>
 #include <variant>
+#include <vector>
 
 #include "ReplyParametersExt.hpp"
 #include "Utils.hpp"
@@ -978,12 +979,79 @@ class TgBotApi {
         (void)command;
     }
 
+    // Who answers a callback query, i.e. stops the client's spinner.
+    enum class CallbackAck {
+        // The framework answers with no text as soon as the query arrives,
+        // before the handler runs. Answers from the handler are dropped.
+        Immediate,
+        // The handler answers, e.g. to show alert text. If it hasn't within
+        // a short grace period, or returns without answering or holding the
+        // answer, the framework answers with no text and the handler's late
+        // answer is dropped.
+        Deferred,
+    };
+
+    /**
+     * @brief Registers a callback-query handler for queries whose data starts
+     * with dataPrefix. Queries are routed by prefix lookup, so handlers with
+     * a prefix never see presses on other keyboards.
+     *
+     * @param command Owner of the handler.
+     * @param dataPrefix Callback data prefix, empty to receive every query.
+     * @param listener The handler.
+     * @param ack How the query gets answered.
+     */
     virtual void onCallbackQuery(
-        std::string message,
-        TgBot::EventBroadcaster::CallbackQueryListener listener) {
+        std::string command, std::string dataPrefix,
+        TgBot::EventBroadcaster::CallbackQueryListener listener,
+        CallbackAck ack) {
         // Dummy implementation
     }
 
+    void onCallbackQuery(
+        std::string command, std::string dataPrefix,
+        TgBot::EventBroadcaster::CallbackQueryListener listener) {
+        onCallbackQuery(std::move(command), std::move(dataPrefix),
+                        std::move(listener), CallbackAck::Deferred);
+    }
+
+    void onCallbackQuery(
+        std::string command,
+        TgBot::EventBroadcaster::CallbackQueryListener listener) {
+        onCallbackQuery(std::move(command), {}, std::move(listener),
+                        CallbackAck::Deferred);
+    }
+
+    /**
+     * @brief Keeps the framework from answering a Deferred callback query
+     * when the handler returns, for handlers that answer from work they
+     * queue. The grace period still applies.
+     *
+     * @param callbackQueryId The query being handled.
+     * @return The hold, released when the last copy is destroyed; null if
+     * the query is no longer waiting for an answer.
+     */
+    [[nodiscard]] virtual std::shared_ptr<void> holdCallbackAnswer(
+        const std::string_view callbackQueryId) {
+        (void)callbackQueryId;
+        return nullptr;
+    }
+
+    // Latency of one callback-query handler since it was registered.
+    struct CallbackQueryStats {
+        std::string command;
+        std::string dataPrefix;
+        std::uint64_t calls;
+        std::chrono::microseconds average;
+        std::chrono::microseconds max;
+    };
+
+    // Latency of each registered callback-query handler.
+    [[nodiscard]] virtual std::vector<CallbackQueryStats> callbackQueryStats()
+        const {
+        return {};
+    }
+
     virtual void onEditedMessage(
         TgBot::EventBroadcaster::MessageListener listener) {
         // Dummy implementation
@@ -198,7 +198,8 @@ class TgBotApiImpl : public TgBotApi {
      * @param showAlert Optional. If true, an alert is shown to the user.
      *
      * @return True if the callback query was answered successfully, otherwise
-     * false.
+     * false. Also false if the framework already acknowledged the query, in
+     * which case the text is dropped.
      */
     bool answerCallbackQuery_impl(const std::string_view callbackQueryId,
                                   const std::string_view text = {},
@@ -505,9 +506,15 @@ class TgBotApiImpl : public TgBotApi {
                                 const AnyMessageCallback& callback) override;
     void removeAnyMessageCallbacksForCommand(std::string_view command) override;
 
+    using TgBotApi::onCallbackQuery;
     void onCallbackQuery(
-        std::string command,
-        TgBot::EventBroadcaster::CallbackQueryListener listener) override;
+        std::string command, std::string dataPrefix,
+        TgBot::EventBroadcaster::CallbackQueryListener listener,
+        CallbackAck ack) override;
+    [[nodiscard]] std::shared_ptr<void> holdCallbackAnswer(
+        std::string_view callbackQueryId) override;
+    [[nodiscard]] std::vector<CallbackQueryStats> callbackQueryStats()
+        const override;
 
     void onEditedMessage(
         TgBot::EventBroadcaster::MessageListener listener) override;
@@ -2,23 +2,154 @@
 
 #include "../TgBotApiImpl.hpp"
 #include "Async.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 class TgBotApiImpl::OnCallbackQueryImpl : TgBotApiImpl::CommandListener {
+   public:
+    // Cumulative latency of one registered handler, updated by the workers.
+    struct HandlerStats {
+        std::atomic<std::uint64_t> calls = 0;
+        std::atomic<std::uint64_t> totalMicros = 0;
+        std::atomic<std::uint64_t> maxMicros = 0;
+
+        void record(std::chrono::microseconds elapsed);
+    };
+
+   private:
+    struct Listener {
+        std::string command;
+        std::string dataPrefix;
+        TgBot::EventBroadcaster::CallbackQueryListener callback;
+        TgBotApi::CallbackAck ack;
+        std::shared_ptr<HandlerStats> stats;
+    };
+
+    // Immutable once published. Updates copy, modify and swap the pointer,
+    // so a dispatch in progress keeps using the table it started with.
+    struct Routes {
+        std::unordered_map<std::string, std::vector<Listener>> byPrefix;
+        // Distinct lengths of the keys in byPrefix, ascending.
+        std::vector<std::size_t> prefixLengths;
+        // Listeners registered without a prefix see every query.
+        std::vector<Listener> catchAll;
+
+        void addLengthOf(const std::string& prefix);
+    };
+
+    // A query in flight: whether someone answered it, and how many
+    // handlers still hold it.
+    struct PendingAck {
+        bool answered = false;
+        // Handlers and answer holds not released yet.
+        std::size_t running = 0;
+    };
+    // Released when a handler task or an answer hold is destroyed.
+    struct HandlerTicket;
+
+    // Handlers slower than this are logged as they finish.
+    static constexpr std::chrono::milliseconds kSlowHandlerThreshold{500};
+    // Deferred handlers get this long to answer before the framework does.
+    static constexpr std::chrono::milliseconds kAckGrace{1000};
+
+    // The routes, for use without the lock. Taking and releasing one is
+    // serialized with onUnload(), which waits for those taken before it
+    // swapped the routes: they may hold the unloaded module's listeners,
+    // which must be destroyed before its DSO is closed.
+    class RoutesSnapshot {
+       public:
+        explicit RoutesSnapshot(OnCallbackQueryImpl* owner);
+        ~RoutesSnapshot();
+        NO_COPY_CTOR(RoutesSnapshot);
+
+        const Routes* operator->() const { return routes_.get(); }
+
+       private:
+        OnCallbackQueryImpl* owner_;
+        std::shared_ptr<const Routes> routes_;
+        std::uint64_t id_;
+    };
+
+    // Guards the routes pointer and the snapshots of it in use; dispatch
+    // runs unlocked on a snapshot.
     std::mutex mutex;
-    std::multimap<std::string, TgBot::EventBroadcaster::CallbackQueryListener>
-        listeners;
+    std::shared_ptr<const Routes> routes = std::make_shared<Routes>();
+    std::condition_variable snapshotReleased;
+    // Ids of the snapshots in use, which are handed out in order.
+    std::set<std::uint64_t> snapshotsInUse;
+    std::uint64_t nextSnapshot = 0;
     TgBotApiImpl::Ptr _api;
+
+    // Acknowledgements run on their own thread so they never queue behind
+    // handlers or other outbound work.
+    std::mutex ackMutex;
+    std::condition_variable ackCondition;
+    std::unordered_map<std::string, PendingAck> pendingAcks;
+    std::multimap<std::chrono::steady_clock::time_point, std::string> ackQueue;
+    bool stopAcks = false;
+    std::thread ackThread;
+
+    // Declared last: destroying it releases queued handler tickets, which
+    // still touch the acknowledgement state above.
     TgBotApiImpl::Async queryAsync;
 
     void onCallbackQueryFunction(TgBot::CallbackQuery::Ptr query);
+    // `lease` keeps the listener's module loaded until the handler ran.
+    void dispatch(const Listener& listener,
+                  const TgBot::CallbackQuery::Ptr& query,
+                  std::shared_ptr<RefLock::SharedLease> lease);
+    void scheduleAckLocked(std::string queryId,
+                           std::chrono::steady_clock::duration delay);
+    void finishHandler(const std::string& queryId);
+    void ackThreadFunction();
 
     void onUnload(const std::string_view command) override;
     void onReload(const std::string_view command) override;
    public:
+    /**
+     * @brief Registers a callback-query handler.
+     *
+     * @param command Owner of the handler, used for module leases.
+     * @param dataPrefix Only queries whose data starts with this are routed
+     * to the handler. Empty means every query.
+     * @param listener The handler.
+     * @param ack How the query gets answered.
+     */
     void onCallbackQuery(
-        std::string command,
-        TgBot::EventBroadcaster::CallbackQueryListener listener);
+        std::string command, std::string dataPrefix,
+        TgBot::EventBroadcaster::CallbackQueryListener listener,
+        TgBotApi::CallbackAck ack);
+
+    /**
+     * @brief Claims the single answer Telegram accepts for a query.
+     *
+     * @return Whether the caller may answer it. If not, it was already
+     * answered, by the framework or by another handler.
+     */
+    [[nodiscard]] bool claimAnswer(std::string_view queryId);
+
+    /**
+     * @brief Counts as one more handler of the query until released, so its
+     * handlers returning doesn't answer it.
+     *
+     * @return The hold, or null if the query was answered or isn't pending.
+     */
+    [[nodiscard]] std::shared_ptr<void> holdAnswer(std::string_view queryId);
+
+    // Latency of each registered handler so far.
+    [[nodiscard]] std::vector<TgBotApi::CallbackQueryStats> stats();
 
     explicit OnCallbackQueryImpl(TgBotApiImpl::Ptr api);
-};
\ No newline at end of file
+    ~OnCallbackQueryImpl() override;
+};
@@ -1,17 +1,57 @@
 #include <api/TgBotApiImpl.hpp>
-#include <mutex>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <api/AuthContext.hpp>
 
 class TgBotApiImpl::OnInlineQueryImpl : TgBotApiImpl::CommandListener {
+    struct Entry {
+        InlineQuery registration;
+        // Empty for static entries.
+        InlineCallback callback;
+        // Prebuilt results, answered without invoking any callback.
+        std::vector<TgBot::InlineQueryResult::Ptr> staticResults;
+    };
+    using ResultList = std::vector<TgBot::InlineQueryResult::Ptr>;
+
+    // A node per prefix of the registered names, holding the entries
+    // registered under exactly that prefix. A query collects the entries of
+    // every name that prefixes it on one walk down, one node per character.
+    struct Node {
+        std::map<char, std::unique_ptr<Node>> children;
+        // One per owning command, in registration order.
+        std::vector<Entry> entries;
+    };
+
     // Protect callbacks
     std::mutex mutex;
-    std::map<InlineQuery, InlineCallback> queryResults;
+    Node root;
+    std::size_t entryCount = 0;
+    // "Query: <name>" articles shown when nothing matched, rebuilt on every
+    // registry change rather than per query.
+    std::shared_ptr<const ResultList> advertisedAll;
+    std::shared_ptr<const ResultList> advertisedPublic;
     AuthContext* _auth;
     TgBotApiImpl::Ptr _api;
 
+    // Telegram's default. Telegram can't be told to drop a cached answer,
+    // so a longer time would keep serving stale results after a module
+    // reload.
+    static constexpr std::int32_t kCacheTime = 300;
+
     void onInlineQueryFunction(TgBot::InlineQuery::Ptr query);
+    void rebuildAdvertisedLocked();
+    // Adds `entry` under its name. A command registering a name again
+    // replaces its entry; other commands' entries under the name stay.
+    void addLocked(Entry entry);
+    // Removes the entries `remove` returns true for, and the nodes left
+    // without entries. Returns how many were removed.
+    std::size_t eraseIfLocked(const std::function<bool(const Entry&)>& remove);
 
     void onUnload(const std::string_view command) override;
     void onReload(const std::string_view command) override;
@@ -21,22 +61,25 @@ class TgBotApiImpl::OnInlineQueryImpl : TgBotApiImpl::CommandListener {
 
     void add(InlineQuery query, TgBot::InlineQueryResult::Ptr result) {
         const std::lock_guard _(mutex);
-        queryResults[std::move(query)] =
-            [result = std::move(result)](const std::string_view /*unused*/) {
-                return std::vector{result};
-            };
+        addLocked(Entry{.registration = std::move(query),
+                        .callback = {},
+                        .staticResults = {std::move(result)}});
+        rebuildAdvertisedLocked();
     }
     void add(InlineQuery query, InlineCallback result) {
         const std::lock_guard _(mutex);
-        queryResults[std::move(query)] = std::move(result);
+        addLocked(Entry{.registration = std::move(query),
+                        .callback = std::move(result),
+                        .staticResults = {}});
+        rebuildAdvertisedLocked();
     }
     void remove(const std::string_view key) {
         const std::lock_guard _(mutex);
-        for (auto it = queryResults.begin(); it != queryResults.end(); ++it) {
-            if (it->first.name == static_cast<std::string>(key)) {
-                queryResults.erase(it);
-                break;
-            }
+        const auto named = [key](const Entry& entry) {
+            return entry.registration.name == key;
+        };
+        if (eraseIfLocked(named) != 0) {
+            rebuildAdvertisedLocked();
         }
     }
 };
@@ -1,14 +1,69 @@
 #pragma once
 
 #include <api/TgBotApiImpl.hpp>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <regex>
+#include <string>
+#include <vector>
 
 class TgBotApiImpl::ReactionsProvider {
    public:
-    explicit ReactionsProvider(TgBotApi* apiImpl);
+    /**
+     * @brief Loads reaction rules and subscribes to incoming messages.
+     *
+     * @param apiImpl The API to react through.
+     * @param rulesFile JSON file with the reaction rules. If it doesn't exist
+     * or fails to parse, the built-in defaults are used.
+     */
+    ReactionsProvider(TgBotApi* apiImpl,
+                      const std::filesystem::path& rulesFile);
     ~ReactionsProvider();
 
+    struct Rule {
+        enum class Type { Text, Filename, User };
+        Type type;
+        std::string emoji;
+        // Type::Text
+        std::regex pattern;
+        // Type::Filename
+        std::string filename;
+        // Type::User
+        UserId userId{};
+    };
+
+    // Immutable after construction, compiled once.
+    struct Rules {
+        // In the order their reactions are added.
+        std::vector<Rule> rules;
+        // Alternation of every text rule's pattern. A miss proves no text
+        // rule matches, so most messages pay one regex search in total.
+        std::optional<std::regex> textPrefilter;
+
+        /**
+         * Rules file format:
+         * [
+         *   {"type": "text", "pattern": "^[a-z]lex$", "emoji": "🥰"},
+         *   {"type": "filename", "match": "last_kmsg", "emoji": "😱"},
+         *   {"type": "user", "id": 5037893234, "emoji": "👑"}
+         * ]
+         *
+         * @return The rules, or std::nullopt if the input is invalid.
+         */
+        static std::optional<Rules> parse(std::istream& input);
+        static std::optional<Rules> load(const std::filesystem::path& file);
+        // Used when no rules file is installed.
+        static Rules defaults();
+
+        // The emojis to react to `message` with, in rule order.
+        [[nodiscard]] std::vector<std::string> match(
+            const Message& message) const;
+    };
+
    private:
     TgBotApi* _apiImpl;
+    Rules _rules;
     TgBotApi::CallbackSubscription::Ptr anyMessageSubscription_;
 
     TgBotApi::AnyMessageResult onAnyMessageFunction(Message::Ptr message);
@@ -2,11 +2,12 @@
 
 #include <absl/status/status.h>
 
+#include <array>
 #include <expected_cpp20>
 #include <memory>
-#include <mutex>
 #include <regex>
 #include <string>
+#include <vector>
 
 #include "TinyStatus.hpp"
 
@@ -40,13 +41,32 @@ class RegexCommand {
      */
     [[nodiscard]] virtual std::string_view description() const = 0;
 
+    /**
+     * @brief Describes the fixed characters framing a command.
+     *
+     * Used by RegexHandler to route a command to at most one handler without
+     * running every handler's command_regex().
+     * A suffix of '\0' means any trailing character is accepted.
+     */
+    struct Shape {
+        char leader;
+        char suffix = '\0';
+    };
+
+    /**
+     * @brief Returns the shape of the command.
+     *
+     * @return The leading character, and optionally the trailing character.
+     */
+    [[nodiscard]] virtual Shape shape() const = 0;
+
    protected:
     /**
      * @brief Returns the regex pattern for the command.
      *
      * @return The regex pattern for the command.
      */
-    [[nodiscard]] virtual std::regex command_regex() const = 0;
+    [[nodiscard]] virtual const std::regex& command_regex() const = 0;
 
     /**
      * @brief Processes the command using the given source and command strings.
@@ -75,33 +95,45 @@ struct RegexHandler {
         virtual void onSuccess(const std::string& result) = 0;
     };
 
+    /**
+     * @brief Executes the matching regex command and notifies the callback.
+     *
+     * This function routes the command by its shape to the single handler
+     * that can accept it, processes the command, and notifies the provided
+     * callback interface with the result or error status.
+     * The registry is immutable after construction, so this is safe to call
+     * concurrently without locking.
+     *
+     * @param callback A shared pointer to an Interface object that will receive
+     *                 the result or error status.
+     * @param source The source string on which the commands will be applied.
+     * @param regexCommand The command string to be processed.
+     */
+    void execute(const std::shared_ptr<Interface>& callback,
+                 const std::string& source,
+                 const std::string& regexCommand) const;
+
+   private:
     /**
      * @brief Registers a regex command handler with the RegexHandler.
      *
-     * This function adds a unique pointer to a RegexCommand object to the
-     * internal handlers vector. The ownership of the RegexCommand object is
-     * transferred to the RegexHandler.
+     * Only called from the constructor; the dispatch table is never modified
+     * afterwards. The ownership of the RegexCommand object is transferred to
+     * the RegexHandler.
      *
      * @param handler A unique pointer to a RegexCommand object.
      */
     void registerCommand(std::unique_ptr<RegexCommand> handler);
 
     /**
-     * @brief Executes the registered regex commands and notifies the callback.
-     *
-     * This function iterates through all the registered regex command handlers,
-     * processes the commands, and notifies the provided callback interface with
-     * the result or error status.
+     * @brief Finds the handler whose shape fits the command.
      *
-     * @param callback A shared pointer to an Interface object that will receive
-     *                 the result or error status.
-     * @param source The source string on which the commands will be applied.
-     * @param regexCommand The command string to be processed.
+     * @return The handler, or nullptr if no handler can accept the command.
      */
-    void execute(const std::shared_ptr<Interface>& callback,
-                 const std::string& source, const std::string& regexCommand);
+    [[nodiscard]] const RegexCommand* route(
+        const std::string& regexCommand) const;
 
-   private:
     std::vector<std::unique_ptr<RegexCommand>> _handlers;
-    std::mutex _mutex;
+    // Indexed by the command's leading character, a handful of handlers each.
+    std::array<std::vector<const RegexCommand*>, 256> _dispatch{};
 };
@@ -0,0 +1,115 @@
+#include <absl/log/log.h>
+#include <fmt/format.h>
+
+#include <AsyncLogSink.hpp>
+#include <LogSinks.hpp>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Measures how fast threads can log through a file sink: the synchronous
+// LogFileSink, and AsyncLogSink dropping or blocking when its queue is full.
+// Entries go only to the sink measured, through LOG().ToSinkOnly(), to
+// logbench_<sink>.log files in a directory, which are left behind.
+//
+// "callers" is the rate the logging threads see. "written" also counts the
+// time to get the queued entries into the file.
+//
+// Usage: LogBench <dir> [max_threads] [entries_per_thread]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned int kDefaultMaxThreads = 8;
+constexpr unsigned int kDefaultEntries = 200000;
+
+bool parse(const char* text, unsigned int* value) {
+    const std::string_view view(text);
+    const auto [end, ec] =
+        std::from_chars(view.data(), view.data() + view.size(), *value);
+    return ec == std::errc() && end == view.data() + view.size() &&
+           *value > 0;
+}
+
+double rate(const std::uint64_t entries, const Clock::duration elapsed) {
+    return static_cast<double>(entries) /
+           std::chrono::duration<double>(elapsed).count();
+}
+
+// Logs `entries` lines on each of `threads` threads into `sink` and prints
+// the rates.
+template <typename Sink>
+void measure(const std::string_view name, Sink& sink,
+             const unsigned int threads, const unsigned int entries) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    const auto start = Clock::now();
+    for (unsigned int n = 0; n < threads; ++n) {
+        workers.emplace_back([&sink, entries, n] {
+            for (unsigned int i = 0; i < entries; ++i) {
+                LOG(INFO).ToSinkOnly(&sink)
+                    << "Worker " << n << " queued item " << i
+                    << ", queue depth " << i % 64;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const auto logged = Clock::now() - start;
+    sink.Flush();
+    const auto written = Clock::now() - start;
+
+    const std::uint64_t total = std::uint64_t{threads} * entries;
+    std::uint64_t dropped = 0;
+    if constexpr (std::is_same_v<Sink, AsyncLogSink>) {
+        dropped = sink.dropped();
+    }
+    fmt::print(
+        "{:<12} {:>2} threads {:>10.0f} entries/s callers {:>10.0f} "
+        "written ({} dropped)\n",
+        name, threads, rate(total, logged), rate(total - dropped, written),
+        dropped);
+}
+
+}  // namespace
+
+int app_main(int argc, char** argv) {
+    unsigned int maxThreads = kDefaultMaxThreads;
+    unsigned int entries = kDefaultEntries;
+    if (argc < 2 || (argc > 2 && !parse(argv[2], &maxThreads)) ||
+        (argc > 3 && !parse(argv[3], &entries))) {
+        LOG(ERROR) << "Usage: " << argv[0]
+                   << " <dir> [max_threads] [entries_per_thread]";
+        return EXIT_FAILURE;
+    }
+    const std::filesystem::path dir = argv[1];
+
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+        {
+            LogFileSink sink(dir / "logbench_sync.log");
+            measure("sync", sink, threads, entries);
+        }
+        {
+            AsyncLogSink sink(dir / "logbench_block.log",
+                              {.policy = AsyncLogSink::Policy::Block});
+            measure("async-block", sink, threads, entries);
+        }
+        {
+            AsyncLogSink sink(dir / "logbench_drop.log",
+                              {.policy = AsyncLogSink::Policy::Drop});
+            measure("async-drop", sink, threads, entries);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <absl/base/log_severity.h>
+#include <absl/log/log_entry.h>
+#include <absl/log/log_sink.h>
+#include <absl/time/time.h>
+#include <trivial_helpers/_class_helper_macros.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * The most recent log entries, for any number of readers to follow at their
+ * own pace. Send() only copies the entry into the ring, so logging never
+ * waits on a reader. A reader too slow to keep up misses the entries
+ * overwritten before it got to them, and is told how many.
+ */
+class LogRing : public absl::LogSink {
+   public:
+    static constexpr std::size_t kDefaultCapacity = 2048;
+    // Entries a reader copies per hold of the lock.
+    static constexpr std::size_t kReadChunk = 64;
+
+    struct Entry {
+        absl::LogSeverity severity{};
+        absl::Time time;
+        std::string file;
+        int line = 0;
+        std::string message;
+    };
+
+    explicit LogRing(const std::size_t capacity = kDefaultCapacity)
+        : entries_(std::max<std::size_t>(capacity, 1)) {}
+    ~LogRing() override = default;
+    NO_COPY_CTOR(LogRing);
+
+    void Send(const absl::LogEntry& entry) override {
+        {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            // Assigning keeps the slot's buffers, so this rarely allocates.
+            auto& slot = entries_[next_ % entries_.size()];
+            slot.severity = entry.log_severity();
+            slot.time = entry.timestamp();
+            slot.file.assign(entry.source_basename());
+            slot.line = entry.source_line();
+            slot.message.assign(entry.text_message());
+            ++next_;
+        }
+        added_.notify_all();
+    }
+
+    // Follows the ring from `replay` entries before the newest one.
+    class Reader {
+       public:
+        Reader(LogRing& ring, const std::size_t replay) : ring_(ring) {
+            const std::lock_guard<std::mutex> lock(ring_.mutex_);
+            next_ = ring_.next_ -
+                    std::min<std::uint64_t>(
+                        {replay, ring_.next_, ring_.entries_.size()});
+        }
+
+        // Waits up to `timeout` for entries not read yet and copies them
+        // into `entries`, up to the ring's capacity. Returns how many were
+        // overwritten since the last read, before this reader could get
+        // them. Copies kReadChunk entries at a time under the ring's lock,
+        // so catching up holds off Send() for no longer than one chunk.
+        std::uint64_t read(std::vector<Entry>* entries,
+                           const std::chrono::milliseconds timeout) {
+            std::unique_lock<std::mutex> lock(ring_.mutex_);
+            ring_.added_.wait_for(lock, timeout,
+                                  [this] { return ring_.next_ != next_; });
+            const auto size = ring_.entries_.size();
+            std::uint64_t missed = 0;
+            std::size_t filled = 0;
+            while (true) {
+                if (ring_.next_ - next_ > size) {
+                    const auto skipped = ring_.next_ - size - next_;
+                    next_ += skipped;
+                    missed += skipped;
+                    dropped_ += skipped;
+                }
+                const auto count = std::min<std::uint64_t>(
+                    {ring_.next_ - next_, kReadChunk, size - filled});
+                // Assigning keeps the buffers of the last read.
+                if (entries->size() < filled + count) {
+                    entries->resize(filled + count);
+                }
+                for (std::uint64_t i = 0; i < count; ++i) {
+                    (*entries)[filled++] = ring_.entries_[next_++ % size];
+                }
+                if (ring_.next_ == next_ || filled == size) {
+                    break;
+                }
+                // Lets Send() in between chunks.
+                lock.unlock();
+                lock.lock();
+            }
+            entries->resize(filled);
+            return missed;
+        }
+
+        // Entries this reader missed in total.
+        [[nodiscard]] std::uint64_t dropped() const { return dropped_; }
+
+       private:
+        LogRing& ring_;
+        std::uint64_t next_ = 0;
+        std::uint64_t dropped_ = 0;
+    };
+
+   private:
+    std::mutex mutex_;
+    std::condition_variable added_;
+    std::vector<Entry> entries_;
+    // The position of the next entry, which also counts every entry sent.
+    std::uint64_t next_ = 0;
+};
@@ -1,11 +1,18 @@
 #include <Log_service.grpc.pb.h>
 #include <absl/log/log.h>
 #include <absl/strings/ascii.h>
+#include <absl/time/time.h>
 #include <grpcpp/create_channel.h>
 
+#include <BinaryLogSink.hpp>
+#include <charconv>
 #include <cstdlib>
 #include <iostream>
 #include <libos/libsighandler.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
 
 #include "LogcatData.hpp"
 
@@ -34,9 +41,105 @@ std::ostream& operator<<(std::ostream& os,
     return os;
 }
 
+namespace {
+
+std::optional<absl::LogSeverity> parseSeverity(std::string_view text) {
+    const auto name = absl::AsciiStrToUpper(text);
+    for (const auto severity :
+         {absl::LogSeverity::kInfo, absl::LogSeverity::kWarning,
+          absl::LogSeverity::kError, absl::LogSeverity::kFatal}) {
+        const std::string_view full = absl::LogSeverityName(severity);
+        if (name == full || name == full.substr(0, 1)) {
+            return severity;
+        }
+    }
+    return std::nullopt;
+}
+
+// Prints the entries of a binary log file written by BinaryLogSink in the
+// usual text format, keeping those matching every filter given.
+int decode(int argc, char** argv) {
+    auto minSeverity = absl::LogSeverity::kInfo;
+    std::string_view source;
+    std::string_view text;
+    bool usage = argc < 3;
+    for (int i = 3; i < argc && !usage; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--min-severity=")) {
+            const auto severity = parseSeverity(arg.substr(15));
+            usage = !severity;
+            minSeverity = severity.value_or(minSeverity);
+        } else if (arg.starts_with("--source=")) {
+            source = arg.substr(9);
+        } else if (arg.starts_with("--grep=")) {
+            text = arg.substr(7);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cerr << "Usage: " << argv[0]
+                  << " decode <file> [--min-severity=<I|W|E|F>] "
+                     "[--source=<file>] [--grep=<text>]\n";
+        return EXIT_FAILURE;
+    }
+
+    auto reader = binlog::Reader::open(argv[2]);
+    if (!reader || !reader->valid()) {
+        LOG(ERROR) << "Not a binary log file: " << argv[2];
+        return EXIT_FAILURE;
+    }
+    binlog::Record record{};
+    while (reader->next(&record)) {
+        if (record.severity < minSeverity ||
+            record.file.find(source) == std::string_view::npos ||
+            record.message.find(text) == std::string_view::npos) {
+            continue;
+        }
+        std::cout << absl::LogSeverityName(record.severity)[0]
+                  << absl::FormatTime("%m%d %H:%M:%E6S", record.time,
+                                      absl::LocalTimeZone())
+                  << ' ' << record.tid << ' ' << record.file << ':'
+                  << record.line << "] " << record.message << '\n';
+    }
+    return EXIT_SUCCESS;
+}
+
+}  // namespace
+
 int app_main(int argc, char** argv) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <server_address> <auth_token>\n";
+    if (argc > 1 && std::string_view(argv[1]) == "decode") {
+        return decode(argc, argv);
+    }
+    tgbot::proto::logging::LogRequest request;
+    bool usage = argc < 3;
+    for (int i = 3; i < argc && !usage; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--min-severity=")) {
+            const auto severity = parseSeverity(arg.substr(15));
+            usage = !severity;
+            request.set_min_severity(
+                static_cast<tgbot::proto::logging::LogSeverity>(
+                    severity.value_or(absl::LogSeverity::kInfo)));
+        } else if (arg.starts_with("--module=")) {
+            request.add_modules(std::string(arg.substr(9)));
+        } else if (arg.starts_with("--replay=")) {
+            unsigned int replay = 0;
+            const auto value = arg.substr(9);
+            const auto [end, ec] = std::from_chars(
+                value.data(), value.data() + value.size(), replay);
+            usage = ec != std::errc() || end != value.data() + value.size();
+            request.set_replay(replay);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <server_address> <auth_token> "
+                     "[--min-severity=<I|W|E|F>] [--module=<file>]... "
+                     "[--replay=<entries>]\n"
+                  << "       " << argv[0] << " decode <file> [filters...]\n";
         return EXIT_FAILURE;
     }
 
@@ -47,7 +150,6 @@ int app_main(int argc, char** argv) {
     auto stub = LoggingService::NewStub(channel);
 
     grpc::ClientContext context;
-    google::protobuf::Empty request;
     auto reader = stub->getLogs(&context, request);
 
     LOG(INFO)
@@ -84,8 +186,13 @@ int app_main(int argc, char** argv) {
             }
         }
 
+        if (entry.dropped() != 0) {
+            LOG(WARNING) << entry.dropped()
+                         << " entries dropped, reading too slowly";
+        }
         LOG(INFO) << std::chrono::system_clock::from_time_t(entry.timestamp())
-                  << " " << entry.severity() << " " << entry.message();
+                  << " " << entry.severity() << " " << entry.file() << ":"
+                  << entry.line() << " " << entry.message();
     }
     grpc::Status status = reader->Finish();
     if (!status.ok()) {
@@ -12,49 +12,43 @@
 #include <algorithm>
 #include <atomic>
 #include <barrier>
+#include <chrono>
+#include <cstdint>
 #include <mutex>
 #include <stop_token>
+#include <string>
+#include <vector>
 
+#include "LogRing.hpp"
 #include "LogSinks.hpp"
 #include "Log_service.grpc.pb.h"
 #include "Log_service.pb.h"
 
-class LogSinkImpl : public absl::LogSink {
-    void Send(const absl::LogEntry& entry) override;
-    grpc::ServerWriter<tgbot::proto::logging::LogData>* _impl;
-    bool _stopped = false;
-    std::mutex mu_;
+namespace {
 
-   public:
-    // Requires an accepted socket.
-    explicit LogSinkImpl(
-        grpc::ServerWriter<tgbot::proto::logging::LogData>* impl)
-        : _impl(impl) {};
-
-    ~LogSinkImpl() override = default;
-
-    void stop() {
-        std::lock_guard<std::mutex> lock(mu_);
-        _stopped = true;
-    }
-};
+// How often a waiting stream checks whether it should end.
+constexpr std::chrono::milliseconds kPollInterval{100};
 
-void LogSinkImpl::Send(const absl::LogEntry& entry) {
-    std::lock_guard<std::mutex> lock(mu_);
-    tgbot::proto::logging::LogData le{};
-    le.set_severity(
-        static_cast<tgbot::proto::logging::LogSeverity>(entry.log_severity()));
-    le.set_timestamp(absl::ToUnixSeconds(entry.timestamp()));
-    le.set_message(entry.text_message());
-    bool rc = _impl->Write(le);
-    if (!rc) {
-        _stopped = true;
+bool wanted(const tgbot::proto::logging::LogRequest& request,
+            const LogRing::Entry& entry) {
+    if (static_cast<int>(entry.severity) < request.min_severity()) {
+        return false;
     }
+    const auto& modules = request.modules();
+    return modules.empty() ||
+           std::any_of(modules.begin(), modules.end(),
+                       [&entry](const std::string& name) {
+                           return entry.file.find(name) != std::string::npos;
+                       });
 }
 
+}  // namespace
+
 struct NetworkLogSink::Impl {
     std::unique_ptr<grpc::Server> server;
     std::stop_token token;
+    // Every stream reads from here, so none holds up the logging threads.
+    LogRing ring;
 };
 
 class LoggingServiceImpl
@@ -62,16 +56,40 @@ class LoggingServiceImpl
     NetworkLogSink::Impl* impl;
     grpc::Status getLogs(
         grpc::ServerContext* context,
-        const google::protobuf::Empty* /*request*/,
+        const tgbot::proto::logging::LogRequest* request,
         grpc::ServerWriter<tgbot::proto::logging::LogData>* writer) override {
         LOG(INFO) << "Client connected for log streaming";
-        RAIILogSink<LogSinkImpl> sinkGuard(writer);
-        // Wait until the client disconnects
-        while (!context->IsCancelled() && !impl->token.stop_requested()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        LogRing::Reader reader(impl->ring, request->replay());
+        std::vector<LogRing::Entry> entries;
+        // Missed since the last entry written, reported with the next.
+        std::uint64_t dropped = 0;
+        bool connected = true;
+        while (connected && !context->IsCancelled() &&
+               !impl->token.stop_requested()) {
+            dropped += reader.read(&entries, kPollInterval);
+            for (const auto& entry : entries) {
+                if (!wanted(*request, entry)) {
+                    continue;
+                }
+                tgbot::proto::logging::LogData data;
+                data.set_severity(
+                    static_cast<tgbot::proto::logging::LogSeverity>(
+                        entry.severity));
+                data.set_timestamp(absl::ToUnixSeconds(entry.time));
+                data.set_file(entry.file);
+                data.set_line(entry.line);
+                data.set_message(entry.message);
+                data.set_dropped(dropped);
+                if (!writer->Write(data)) {
+                    connected = false;
+                    break;
+                }
+                dropped = 0;
+            }
         }
-        if (context->IsCancelled()) {
-            LOG(INFO) << "Client disconnected from log streaming";
+        if (!connected || context->IsCancelled()) {
+            LOG(INFO) << "Client disconnected from log streaming, "
+                      << reader.dropped() << " entries dropped";
         } else {
             LOG(INFO) << "Log streaming stopped by server";
         }
@@ -107,7 +125,10 @@ void NetworkLogSink::onPreStop() {
 
 NetworkLogSink::NetworkLogSink(std::string url)
     : url(std::move(url)), impl(std::make_unique<Impl>()) {
+    // From the start, so clients can have what was logged before they
+    // connected replayed.
+    absl::AddLogSink(&impl->ring);
     run();
 }
 
-NetworkLogSink::~NetworkLogSink() = default;
\ No newline at end of file
+NetworkLogSink::~NetworkLogSink() { absl::RemoveLogSink(&impl->ring); }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <absl/log/log.h>
 #include <absl/log/log_sink_registry.h>
-#include <absl/strings/match.h>
 #include <absl/strings/str_split.h>
 #include <fmt/chrono.h>
 #include <fmt/format.h>
@@ -8,6 +7,8 @@
 #include <fruit/fruit_forward_decls.h>
 #include <fruit/injector.h>
 
+#include <AsyncLogSink.hpp>
+#include <BinaryLogSink.hpp>
 #include <CommandLine.hpp>
 #include <ConfigManager.hpp>
 #include <DurationPoint.hpp>
@@ -331,33 +332,30 @@ std::vector<TgBot::InlineQueryResult::Ptr> mediaQueryKeyboardFunction(
     if (word.empty()) {
         return {};  // Nothing to search.
     }
-    // Perform search in media database.
+    // Ranked by how well an alias matches, so typos and partial words
+    // still find something while the user is typing.
     std::vector<TgBot::InlineQueryResult::Ptr> results;
-    const auto medias = database->getAllMediaInfos();
-    for (const auto& media : medias) {
-        for (const auto& name : media.names) {
-            if (absl::StartsWith(name, word.data()) || word.empty()) {
-                switch (media.mediaType) {
-                    case DatabaseBase::MediaType::STICKER: {
-                        auto sticker = std::make_shared<
-                            TgBot::InlineQueryResultCachedSticker>();
-                        sticker->stickerFileId = media.mediaId;
-                        sticker->id = media.mediaUniqueId;
-                        results.emplace_back(sticker);
-                        break;
-                    }
-                    case DatabaseBase::MediaType::GIF: {
-                        auto gif = std::make_shared<
-                            TgBot::InlineQueryResultCachedGif>();
-                        gif->gifFileId = media.mediaId;
-                        gif->id = media.mediaUniqueId;
-                        results.emplace_back(gif);
-                        break;
-                    }
-                    default:
-                        break;
-                }
+    for (const auto& match :
+         database->searchMedia(word, DatabaseBase::kMediaSearchLimit)) {
+        switch (match.mediaType) {
+            case DatabaseBase::MediaType::STICKER: {
+                auto sticker =
+                    std::make_shared<TgBot::InlineQueryResultCachedSticker>();
+                sticker->stickerFileId = match.mediaId;
+                sticker->id = match.mediaUniqueId;
+                results.emplace_back(sticker);
+                break;
+            }
+            case DatabaseBase::MediaType::GIF: {
+                auto gif =
+                    std::make_shared<TgBot::InlineQueryResultCachedGif>();
+                gif->gifFileId = match.mediaId;
+                gif->id = match.mediaUniqueId;
+                results.emplace_back(gif);
+                break;
             }
+            default:
+                break;
         }
     }
     if (results.empty()) {
@@ -513,14 +511,37 @@ int app_main(int argc, char** argv) {
         std::filesystem::remove(defLogFile, ec);
     }
 
-    RAIILogSink<LogFileSink> defFileSink(defLogFile);
+    // Log files are written on a background thread, so logging on hot paths
+    // does not wait on the disk.
+    RAIILogSink<AsyncLogSink> defFileSink(defLogFile);
 
     // Initialize conditional logging
-    RAIILogSink<LogFileSink> logFileSink;
+    RAIILogSink<AsyncLogSink> logFileSink;
+#ifndef _WIN32
+    RAIILogSink<BinaryLogSink> binaryLogFileSink;
+#endif
 
     if (const auto it = configMgr->get(ConfigManager::Configs::LOG_FILE); it) {
-        auto sink = std::make_unique<LogFileSink>(*it);
-        logFileSink = std::move(sink);
+        const auto format = configMgr->get(ConfigManager::Configs::LOG_FORMAT);
+        if (format && format != "text" && format != "binary") {
+            LOG(WARNING) << "Unknown log format " << *format << ", using text";
+        }
+        bool binary = false;
+#ifndef _WIN32
+        if (format == "binary") {
+            binaryLogFileSink = std::make_unique<BinaryLogSink>(*it);
+            binary = true;
+        }
+#else
+        if (format == "binary") {
+            LOG(WARNING) << "Binary log files are not supported on Windows, "
+                            "using text";
+        }
+#endif
+        if (!binary) {
+            auto sink = std::make_unique<AsyncLogSink>(*it);
+            logFileSink = std::move(sink);
+        }
     }
 
     // Print help and return if help option is set
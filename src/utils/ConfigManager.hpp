@@ -28,8 +28,10 @@ class UTILS_EXPORT ConfigManager {
     enum class Configs {
         TOKEN,
         LOG_FILE,
+        LOG_FORMAT,
         DATABASE_FILEPATH,
         DATABASE_TYPE,
+        DATABASE_SLOW_QUERY_MS,
         HELP,
         SOCKET_URL_PRIMARY,
         SOCKET_URL_SECONDARY,
@@ -121,6 +123,14 @@ class UTILS_EXPORT ConfigManager {
             .type = Entry::ArgType::STRING,
             .belongsTo = &sectionMain,
         },
+        {
+            .config = Configs::LOG_FORMAT,
+            .name = "LogFormat",
+            .description = "Log file format (text or binary)",
+            .alias = Entry::ALIAS_NONE,
+            .type = Entry::ArgType::STRING,
+            .belongsTo = &sectionMain,
+        },
         {
             .config = Configs::DATABASE_FILEPATH,
             .name = "FilePath",
@@ -137,6 +147,14 @@ class UTILS_EXPORT ConfigManager {
             .type = Entry::ArgType::STRING,
             .belongsTo = &sectionDatabase,
         },
+        {
+            .config = Configs::DATABASE_SLOW_QUERY_MS,
+            .name = "SlowQueryMs",
+            .description = "Log database calls taking at least this many ms",
+            .alias = Entry::ALIAS_NONE,
+            .type = Entry::ArgType::STRING,
+            .belongsTo = &sectionDatabase,
+        },
         {
             .config = Configs::HELP,
             .name = "Help",
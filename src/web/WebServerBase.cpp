@@ -16,6 +16,7 @@
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <utility>
+#include <vector>
 
 #include "Socket_service.pb.h"
 #include "SystemMonitor_service.grpc.pb.h"
@@ -370,6 +371,31 @@ void TgBotWebServerBase::Callbacks::handleStats(const httplib::Request& req,
     responseJson["uptime"]["hours"] = grpcResponse.uptime().hours();
     responseJson["uptime"]["minutes"] = grpcResponse.uptime().minutes();
     responseJson["uptime"]["seconds"] = grpcResponse.uptime().seconds();
+    responseJson["database"] = nlohmann::json::array();
+    for (const auto& op : grpcResponse.database_operations()) {
+        nlohmann::json entry;
+        entry["operation"] = op.operation();
+        entry["calls"] = op.calls();
+        entry["slow_calls"] = op.slow_calls();
+        entry["total_latency_us"] = op.total_latency_us();
+        entry["total_lock_wait_us"] = op.total_lock_wait_us();
+        entry["rows_scanned"] = op.rows_scanned();
+        entry["latency_buckets"] = std::vector<std::uint64_t>(
+            op.latency_buckets().begin(), op.latency_buckets().end());
+        entry["lock_wait_buckets"] = std::vector<std::uint64_t>(
+            op.lock_wait_buckets().begin(), op.lock_wait_buckets().end());
+        responseJson["database"].push_back(std::move(entry));
+    }
+    responseJson["callback_handlers"] = nlohmann::json::array();
+    for (const auto& handler : grpcResponse.callback_handlers()) {
+        nlohmann::json entry;
+        entry["command"] = handler.command();
+        entry["data_prefix"] = handler.data_prefix();
+        entry["calls"] = handler.calls();
+        entry["average_latency_us"] = handler.average_latency_us();
+        entry["max_latency_us"] = handler.max_latency_us();
+        responseJson["callback_handlers"].push_back(std::move(entry));
+    }
     res.set_content(responseJson.dump(), "application/json");
 }
 
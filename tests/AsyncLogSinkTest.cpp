@@ -0,0 +1,138 @@
+#include <absl/log/log.h>
+#include <gtest/gtest.h>
+
+#include <AsyncLogSink.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LogFileTest.hpp"
+
+using std::chrono_literals::operator""h;
+
+namespace {
+
+class AsyncLogSinkTest : public LogFileTest {
+   protected:
+    // The messages in the file, without the log prefix.
+    [[nodiscard]] std::vector<std::string> messages() const {
+        std::ifstream input(path_);
+        std::vector<std::string> result;
+        for (std::string line; std::getline(input, line);) {
+            const auto prefixEnd = line.find("] ");
+            result.emplace_back(prefixEnd == std::string::npos
+                                    ? line
+                                    : line.substr(prefixEnd + 2));
+        }
+        return result;
+    }
+};
+
+}  // namespace
+
+TEST_F(AsyncLogSinkTest, FlushWritesEverythingSentBefore) {
+    // The writer would otherwise wait an hour.
+    AsyncLogSink sink(path_, {.flushInterval = 1h});
+    LOG(INFO).ToSinkOnly(&sink) << "first";
+    LOG(INFO).ToSinkOnly(&sink) << "second";
+    sink.Flush();
+    EXPECT_EQ(messages(), (std::vector<std::string>{"first", "second"}));
+}
+
+TEST_F(AsyncLogSinkTest, BlockKeepsEveryEntryInOrder) {
+    constexpr int kThreads = 4;
+    constexpr int kEntries = 5000;
+    const std::string longText(1000, 'x');
+    {
+        // A small ring, so threads have to wait for room.
+        AsyncLogSink sink(path_, {.slots = 32});
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&sink, &longText, t] {
+                for (int i = 0; i < kEntries; ++i) {
+                    LOG(INFO).ToSinkOnly(&sink) << t << " " << i;
+                    if (i % 1000 == 0) {
+                        // Spans several slots.
+                        LOG(INFO).ToSinkOnly(&sink)
+                            << t << " long " << longText;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_EQ(sink.dropped(), 0U);
+    }
+
+    std::map<int, int> next;
+    int longEntries = 0;
+    for (const auto& message : messages()) {
+        std::istringstream fields(message);
+        int thread = 0;
+        std::string index;
+        fields >> thread >> index;
+        if (index == "long") {
+            std::string text;
+            fields >> text;
+            EXPECT_EQ(text, longText);
+            ++longEntries;
+            continue;
+        }
+        EXPECT_EQ(std::stoi(index), next[thread]++);
+    }
+    EXPECT_EQ(longEntries, kThreads * kEntries / 1000);
+    for (int t = 0; t < kThreads; ++t) {
+        EXPECT_EQ(next[t], kEntries);
+    }
+}
+
+TEST_F(AsyncLogSinkTest, DropCountsWhatIsLost) {
+    constexpr int kThreads = 4;
+    constexpr int kEntries = 5000;
+    std::uint64_t dropped = 0;
+    {
+        AsyncLogSink sink(path_,
+                          {.slots = 16, .policy = AsyncLogSink::Policy::Drop});
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&sink] {
+                for (int i = 0; i < kEntries; ++i) {
+                    LOG(INFO).ToSinkOnly(&sink) << i;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        sink.Flush();
+        dropped = sink.dropped();
+    }
+
+    std::uint64_t written = 0;
+    std::uint64_t reported = 0;
+    for (const auto& message : messages()) {
+        if (message.starts_with("AsyncLogSink: dropped ")) {
+            reported += std::stoull(message.substr(22));
+        } else {
+            ++written;
+        }
+    }
+    EXPECT_EQ(written + dropped, kThreads * kEntries);
+    EXPECT_EQ(reported, dropped);
+}
+
+TEST_F(AsyncLogSinkTest, UnopenedFileDropsEverything) {
+    AsyncLogSink sink(path_ / "missing" / "sink.log");
+    for (int i = 0; i < 3; ++i) {
+        LOG(ERROR).ToSinkOnly(&sink) << i;
+    }
+    sink.Flush();
+    EXPECT_EQ(sink.dropped(), 3U);
+}
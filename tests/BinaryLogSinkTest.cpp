@@ -0,0 +1,111 @@
+#include <absl/log/log.h>
+#include <gtest/gtest.h>
+
+#include <BinaryLogSink.hpp>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "LogFileTest.hpp"
+
+namespace {
+
+class BinaryLogSinkTest : public LogFileTest {
+   protected:
+    // Every record in the file.
+    [[nodiscard]] std::vector<binlog::Record> records() {
+        auto reader = binlog::Reader::open(path_);
+        EXPECT_TRUE(reader && reader->valid());
+        std::vector<binlog::Record> result;
+        if (reader) {
+            reader_ = std::move(reader);
+            for (binlog::Record record{}; reader_->next(&record);) {
+                result.emplace_back(record);
+            }
+        }
+        return result;
+    }
+
+    // Owns what the records point to.
+    std::optional<binlog::Reader> reader_;
+};
+
+}  // namespace
+
+TEST_F(BinaryLogSinkTest, EntriesReadBackAsLogged) {
+    int line = 0;
+    {
+        BinaryLogSink sink(path_);
+        for (int i = 0; i < 3; ++i) {
+            // Same location every time, written to the file once.
+            line = __LINE__ + 1;
+            LOG(INFO).ToSinkOnly(&sink) << "entry " << i;
+        }
+        LOG(ERROR).ToSinkOnly(&sink) << "failed";
+    }
+
+    const auto result = records();
+    ASSERT_EQ(result.size(), 4U);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(result[i].message, "entry " + std::to_string(i));
+        EXPECT_EQ(result[i].severity, absl::LogSeverity::kInfo);
+        EXPECT_EQ(result[i].file, "BinaryLogSinkTest.cpp");
+        EXPECT_EQ(result[i].line, line);
+    }
+    EXPECT_EQ(result[3].message, "failed");
+    EXPECT_EQ(result[3].severity, absl::LogSeverity::kError);
+    EXPECT_EQ(result[3].line, line + 2);
+    for (std::size_t i = 1; i < result.size(); ++i) {
+        EXPECT_GE(result[i].time, result[i - 1].time);
+    }
+}
+
+TEST_F(BinaryLogSinkTest, EntriesSpanSegments) {
+    constexpr int kEntries = 5000;
+    {
+        BinaryLogSink sink(path_, {.segmentSize = 64 * 1024});
+        for (int i = 0; i < kEntries; ++i) {
+            LOG(INFO).ToSinkOnly(&sink) << i << " " << std::string(i % 97, 'x');
+        }
+    }
+    EXPECT_GT(std::filesystem::file_size(path_), 2 * 64 * 1024U);
+
+    const auto result = records();
+    ASSERT_EQ(result.size(), static_cast<std::size_t>(kEntries));
+    for (int i = 0; i < kEntries; ++i) {
+        EXPECT_EQ(result[i].message,
+                  std::to_string(i) + " " + std::string(i % 97, 'x'));
+    }
+}
+
+TEST_F(BinaryLogSinkTest, ReadsWhileStillWritten) {
+    BinaryLogSink sink(path_);
+    LOG(INFO).ToSinkOnly(&sink) << "first";
+    LOG(WARNING).ToSinkOnly(&sink) << "second";
+
+    // The rest of the segment is still zeros, where reading stops.
+    EXPECT_EQ(std::filesystem::file_size(path_), 1U << 20);
+    const auto result = records();
+    ASSERT_EQ(result.size(), 2U);
+    EXPECT_EQ(result[0].message, "first");
+    EXPECT_EQ(result[1].message, "second");
+    EXPECT_EQ(result[1].severity, absl::LogSeverity::kWarning);
+}
+
+TEST_F(BinaryLogSinkTest, LocationsKeyOnTheFileName) {
+    // As if a module was unloaded and another loaded in its place, with its
+    // file name where the first one's was.
+    std::string file = "first.cpp";
+    {
+        BinaryLogSink sink(path_);
+        LOG(INFO).AtLocation(file, 1).ToSinkOnly(&sink) << "a";
+        file.replace(0, 5, "other");
+        LOG(INFO).AtLocation(file, 1).ToSinkOnly(&sink) << "b";
+    }
+
+    const auto result = records();
+    ASSERT_EQ(result.size(), 2U);
+    EXPECT_EQ(result[0].file, "first.cpp");
+    EXPECT_EQ(result[1].file, "other.cpp");
+}
@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 
+#include "AsyncDatabase.hpp"
 #include "CommandLine.hpp"
 #include "DatabaseBase.hpp"
+#include "DatabaseMetrics.hpp"
 #include "GetCommandLine.hpp"
 
 #ifdef DATABASE_HAVE_PROTOBUF
@@ -11,9 +13,18 @@
 #include <database/SQLiteDatabase.hpp>
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <future>
 #include <memory>
+#include <span>
+#include <sstream>
 #include <string>
+#include <variant>
+#include <vector>
 
 struct DBParam {
     std::shared_ptr<DatabaseBase> db;
@@ -64,6 +75,22 @@ TEST_P(DatabaseBaseTest, UserListOperations) {
 }
 
 // Test load and unloadDatabase methods
+TEST_P(DatabaseBaseTest, UsersInListsCanBeEnumerated) {
+    EXPECT_TRUE(db->getUsersInList(DatabaseBase::ListType::WHITELIST).empty());
+    for (const UserId user : {7001, 7002}) {
+        ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::WHITELIST, user),
+                  DatabaseBase::ListResult::OK);
+    }
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::BLACKLIST, 7003),
+              DatabaseBase::ListResult::OK);
+
+    auto whitelist = db->getUsersInList(DatabaseBase::ListType::WHITELIST);
+    std::ranges::sort(whitelist);
+    EXPECT_EQ(whitelist, (std::vector<UserId>{7001, 7002}));
+    EXPECT_EQ(db->getUsersInList(DatabaseBase::ListType::BLACKLIST),
+              std::vector<UserId>{7003});
+}
+
 TEST_P(DatabaseBaseTest, LoadAndUnloadDatabase) {
     std::filesystem::path testFilePath = "test_database_file.db";
 
@@ -76,8 +103,9 @@ TEST_P(DatabaseBaseTest, LoadAndUnloadDatabase) {
     // Unload the database again
     EXPECT_TRUE(db->unload());
 
-    // Remove file
+    // Remove file, and the journal the protobuf backend keeps next to it
     EXPECT_TRUE(std::filesystem::remove(testFilePath));
+    std::filesystem::remove(testFilePath.string() + ".journal");
 }
 
 // Test setting and getting owner user ID
@@ -139,6 +167,34 @@ TEST_P(DatabaseBaseTest, BlacklistedUserCannotBecomeOwner) {
     EXPECT_FALSE(db->getOwnerUserId());
 }
 
+TEST_P(DatabaseBaseTest, ListChecksFollowMutationsAndUnload) {
+    constexpr UserId owner = 2301;
+    constexpr UserId user = 2302;
+
+    ASSERT_EQ(db->claimOwnerUserId(owner), DatabaseBase::OwnerClaimResult::OK);
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::BLACKLIST, user),
+              DatabaseBase::ListResult::OK);
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::WHITELIST, user),
+              DatabaseBase::ListResult::ALREADY_IN_OTHER_LIST);
+    ASSERT_EQ(db->removeUserFromList(DatabaseBase::ListType::BLACKLIST, user),
+              DatabaseBase::ListResult::OK);
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::WHITELIST, user),
+              DatabaseBase::ListResult::OK);
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::WHITELIST, user),
+              DatabaseBase::ListResult::OK);
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::BLACKLIST, user),
+              DatabaseBase::ListResult::ALREADY_IN_OTHER_LIST);
+
+    // Nothing may be answered from a stale snapshot once unloaded.
+    ASSERT_TRUE(db->unload());
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::WHITELIST, user),
+              DatabaseBase::ListResult::BACKEND_ERROR);
+    EXPECT_FALSE(db->getOwnerUserId());
+    ASSERT_TRUE(db->load(db_path));
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::WHITELIST, user),
+              DatabaseBase::ListResult::NOT_IN_LIST);
+}
+
 // Test media info operations
 TEST_P(DatabaseBaseTest, MediaInfoOperations) {
     DatabaseBase::MediaInfo mediaInfo1 = {"media1",
@@ -166,6 +222,278 @@ TEST_P(DatabaseBaseTest, MediaInfoOperations) {
     EXPECT_FALSE(db->queryMediaInfo("name1").has_value());
 }
 
+TEST_P(DatabaseBaseTest, AliasAndChatLookupsFollowDeletions) {
+    ASSERT_EQ(db->addMediaInfo({"media-a",
+                                "unique-a",
+                                {"shared", "only-a"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addMediaInfo({"media-b",
+                                "unique-b",
+                                {"shared"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db->addMediaInfo({"media-c",
+                                "unique-a",
+                                {"other"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::ALREADY_EXISTS);
+
+    auto ids = db->getMediaIds("shared");
+    ASSERT_TRUE(ids.has_value());
+    EXPECT_EQ(*ids, (std::vector<std::string>{"media-a", "media-b"}));
+    EXPECT_FALSE(db->getMediaIds("other").has_value());
+
+    ASSERT_TRUE(db->deleteMediaInfo("media-a"));
+    ids = db->getMediaIds("shared");
+    ASSERT_TRUE(ids.has_value());
+    EXPECT_EQ(*ids, std::vector<std::string>{"media-b"});
+    EXPECT_FALSE(db->queryMediaInfo("only-a").has_value());
+    const auto remaining = db->queryMediaInfo("shared");
+    ASSERT_TRUE(remaining.has_value());
+    EXPECT_EQ(remaining->mediaUniqueId, "unique-b");
+
+    ASSERT_EQ(db->addChatInfo(5001, "first"), DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addChatInfo(5002, "second"), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db->getChatId("first"), 5001);
+    ASSERT_TRUE(db->deleteChatInfo(5001));
+    EXPECT_FALSE(db->getChatId("first").has_value());
+    EXPECT_EQ(db->getChatId("second"), 5002);
+    EXPECT_EQ(db->getChatName(5002), "second");
+}
+
+TEST_P(DatabaseBaseTest, BatchAddsReportResultsPerEntry) {
+    using AddResult = DatabaseBase::AddResult;
+    using ListResult = DatabaseBase::ListResult;
+    ASSERT_EQ(db->addMediaInfo({"media-1",
+                                "unique-1",
+                                {"one"},
+                                DatabaseBase::MediaType::PHOTO}),
+              AddResult::OK);
+    const std::vector<DatabaseBase::MediaInfo> medias = {
+        {"media-1", "unique-1", {"again"}, DatabaseBase::MediaType::PHOTO},
+        {"media-2", "unique-2", {"two"}, DatabaseBase::MediaType::GIF},
+        {"media-3", "unique-3", {"three", "drei"},
+         DatabaseBase::MediaType::VIDEO},
+        {"media-2", "unique-2", {"two"}, DatabaseBase::MediaType::GIF},
+    };
+    EXPECT_EQ(db->addMediaInfos(medias),
+              (std::vector{AddResult::ALREADY_EXISTS, AddResult::OK,
+                           AddResult::OK, AddResult::ALREADY_EXISTS}));
+    EXPECT_EQ(db->getAllMediaInfos().size(), 3);
+    const auto three = db->queryMediaInfo("drei");
+    ASSERT_TRUE(three.has_value());
+    EXPECT_EQ(three->mediaId, "media-3");
+
+    std::vector<std::string> visited;
+    db->forEachMediaInfo([&visited](const DatabaseBase::MediaInfo& info) {
+        visited.emplace_back(info.mediaUniqueId);
+        return visited.size() < 2;
+    });
+    EXPECT_EQ(visited.size(), 2);
+
+    const std::vector<DatabaseBase::ChatInfo> chats = {
+        {6001, "batch-one"}, {6002, "batch-two"}, {6001, "batch-one"}};
+    EXPECT_EQ(db->addChatInfos(chats),
+              (std::vector{AddResult::OK, AddResult::OK,
+                           AddResult::ALREADY_EXISTS}));
+    EXPECT_EQ(db->getChatId("batch-two"), 6002);
+
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::BLACKLIST, 7001),
+              ListResult::OK);
+    const std::vector<UserId> users = {7001, 7002, 7003, 7002};
+    EXPECT_EQ(db->addUsersToList(DatabaseBase::ListType::WHITELIST, users),
+              (std::vector{ListResult::ALREADY_IN_OTHER_LIST, ListResult::OK,
+                           ListResult::OK, ListResult::ALREADY_IN_LIST}));
+    EXPECT_EQ(db->checkUserInList(DatabaseBase::ListType::WHITELIST, 7003),
+              ListResult::OK);
+}
+
+TEST_P(DatabaseBaseTest, ExportStreamsEveryRowInBatches) {
+    ASSERT_EQ(db->claimOwnerUserId(8001), DatabaseBase::OwnerClaimResult::OK);
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::WHITELIST, 8002),
+              DatabaseBase::ListResult::OK);
+    ASSERT_EQ(db->addUserToList(DatabaseBase::ListType::BLACKLIST, 8003),
+              DatabaseBase::ListResult::OK);
+    ASSERT_EQ(db->addMediaInfo({"media-x",
+                                "unique-x",
+                                {"plain", "with, comma"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addChatInfo(8004, "exported"), DatabaseBase::AddResult::OK);
+
+    std::vector<std::size_t> batches;
+    std::size_t medias = 0;
+    ASSERT_TRUE(db->exportRows(
+        [&](const std::span<const DatabaseBase::DumpRow> rows) {
+            batches.push_back(rows.size());
+            for (const auto& row : rows) {
+                medias += std::holds_alternative<DatabaseBase::MediaInfo>(row);
+            }
+            return true;
+        },
+        2));
+    // Owner, two list members, one media and one chat.
+    EXPECT_EQ(batches, (std::vector<std::size_t>{2, 2, 1}));
+    EXPECT_EQ(medias, 1);
+    EXPECT_FALSE(db->exportRows([](auto /*rows*/) { return false; }, 2));
+    // Every backend treats a batch size of 0 as 1.
+    batches.clear();
+    ASSERT_TRUE(db->exportRows(
+        [&](const std::span<const DatabaseBase::DumpRow> rows) {
+            batches.push_back(rows.size());
+            return true;
+        },
+        0));
+    EXPECT_EQ(batches, (std::vector<std::size_t>(5, 1)));
+
+    std::ostringstream csv;
+    ASSERT_TRUE(db->exportTo(csv, DatabaseBase::DumpFormat::CSV));
+    const auto text = csv.str();
+    EXPECT_TRUE(text.starts_with("kind,id,unique_id,name,type\n"));
+    EXPECT_NE(text.find("owner,8001,,,\n"), std::string::npos);
+    EXPECT_NE(text.find("blacklist,8003,,,\n"), std::string::npos);
+    EXPECT_NE(text.find("media,media-x,unique-x,\"with, comma\",STICKER\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("chat,8004,,exported,\n"), std::string::npos);
+}
+
+TEST_P(DatabaseBaseTest, AsyncDatabaseGroupsQueuedWrites) {
+    AsyncDatabase async(db.get());
+    // Hold the database thread so the writes below queue up behind it.
+    std::promise<void> release;
+    auto gate = async.submit(
+        [held = release.get_future()](const DatabaseBase& /*backend*/) {
+            held.wait();
+        });
+
+    std::vector<std::future<DatabaseBase::AddResult>> chats;
+    for (ChatId chat = 9000; chat < 9010; ++chat) {
+        chats.push_back(
+            async.addChatInfo(chat, "async-" + std::to_string(chat)));
+    }
+    chats.push_back(async.addChatInfo(9000, "async-duplicate"));
+    auto user = async.addUserToList(DatabaseBase::ListType::WHITELIST, 9100);
+    auto viaCallback = DatabaseBase::AddResult::BACKEND_ERROR;
+    async.addChatInfo(9200, "async-callback",
+                      [&viaCallback](const DatabaseBase::AddResult result) {
+                          viaCallback = result;
+                      });
+    auto name = async.submit([](const DatabaseBase& backend) {
+        return backend.getChatName(9005);
+    });
+
+    release.set_value();
+    gate.get();
+    for (std::size_t i = 0; i + 1 < chats.size(); ++i) {
+        EXPECT_EQ(chats[i].get(), DatabaseBase::AddResult::OK);
+    }
+    EXPECT_EQ(chats.back().get(), DatabaseBase::AddResult::ALREADY_EXISTS);
+    EXPECT_EQ(user.get(), DatabaseBase::ListResult::OK);
+    EXPECT_EQ(name.get(), "async-9005");
+    async.drain();
+    EXPECT_EQ(viaCallback, DatabaseBase::AddResult::OK);
+
+    // The eleven queued chats went in as one batch, then the user, then the
+    // chat added with a callback.
+    const auto stats = async.stats();
+    EXPECT_EQ(stats.writes, 13);
+    EXPECT_EQ(stats.commits, 3);
+}
+
+TEST_P(DatabaseBaseTest, SearchMediaRanksPrefixesAndTypos) {
+    ASSERT_EQ(db->addMediaInfo({"media-hello",
+                                "unique-hello",
+                                {"Hello", "greetings"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addMediaInfo({"media-help",
+                                "unique-help",
+                                {"help"},
+                                DatabaseBase::MediaType::GIF}),
+              DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addMediaInfo({"media-yellow",
+                                "unique-yellow",
+                                {"yellow"},
+                                DatabaseBase::MediaType::STICKER}),
+              DatabaseBase::AddResult::OK);
+
+    const auto ids = [this](const std::string_view query) {
+        std::vector<std::string> result;
+        for (const auto& match : db->searchMedia(query, 10)) {
+            result.emplace_back(match.mediaId);
+        }
+        return result;
+    };
+
+    const auto exact = db->searchMedia("hello", 10);
+    ASSERT_FALSE(exact.empty());
+    EXPECT_EQ(exact.front().mediaId, "media-hello");
+    EXPECT_EQ(exact.front().alias, "Hello");
+    EXPECT_EQ(exact.front().mediaType, DatabaseBase::MediaType::STICKER);
+    EXPECT_FLOAT_EQ(exact.front().score, 1.0F);
+
+    // Prefixes covering more of the alias rank higher.
+    EXPECT_EQ(ids("hel"), (std::vector<std::string>{"media-help",
+                                                    "media-hello"}));
+    EXPECT_EQ(ids("HE"), (std::vector<std::string>{"media-help",
+                                                   "media-hello"}));
+    EXPECT_EQ(ids("ellow"), std::vector<std::string>{"media-yellow"});
+    // A dropped letter still finds the alias, ahead of weaker neighbours.
+    EXPECT_EQ(ids("helo").front(), "media-hello");
+    EXPECT_EQ(ids("greetigns"), std::vector<std::string>{"media-hello"});
+    EXPECT_TRUE(ids("zzz").empty());
+    EXPECT_EQ(db->searchMedia("hel", 1).size(), 1);
+
+    ASSERT_TRUE(db->deleteMediaInfo("media-hello"));
+    EXPECT_EQ(ids("hello"), std::vector<std::string>{"media-help"});
+}
+
+TEST_P(DatabaseBaseTest, MetricsCountCallsAndLogSlowOnes) {
+    auto* const metrics = db->metrics();
+    ASSERT_NE(metrics, nullptr);
+    using Operation = DatabaseMetrics::Operation;
+    const auto statsOf = [metrics](const Operation operation) {
+        for (const auto& stats : metrics->snapshot()) {
+            if (stats.operation == operation) {
+                return stats;
+            }
+        }
+        return DatabaseMetrics::OperationStats{.operation = operation};
+    };
+
+    ASSERT_EQ(db->addChatInfo(1, "one"), DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addChatInfo(2, "two"), DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db->addChatInfo(3, "three"), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db->getChatId("two"), 2);
+    EXPECT_EQ(statsOf(Operation::ADD_CHAT).calls, 3);
+    EXPECT_EQ(statsOf(Operation::GET_CHAT_ID).calls, 1);
+    EXPECT_EQ(statsOf(Operation::GET_CHAT_ID).slowCalls, 0);
+
+    const auto addStats = statsOf(Operation::ADD_CHAT);
+    std::uint64_t bucketed = 0;
+    for (const auto count : addStats.latencyBuckets) {
+        bucketed += count;
+    }
+    EXPECT_EQ(bucketed, addStats.calls);
+
+    // getAllMediaInfos() is built on forEachMediaInfo() in both backends,
+    // but only the outer call is counted.
+    (void)db->getAllMediaInfos();
+    EXPECT_EQ(statsOf(Operation::GET_ALL_MEDIA).calls, 1);
+    EXPECT_EQ(statsOf(Operation::FOR_EACH_MEDIA).calls, 0);
+
+    EXPECT_EQ(db->getAllChatInfos().size(), 3);
+    EXPECT_GT(statsOf(Operation::GET_ALL_CHATS).rowsScanned, 0);
+
+    metrics->setSlowThreshold(std::chrono::microseconds(1));
+    EXPECT_EQ(metrics->slowThreshold(), std::chrono::microseconds(1));
+    std::ostringstream out;
+    ASSERT_TRUE(db->exportTo(out, DatabaseBase::DumpFormat::CSV));
+    EXPECT_EQ(statsOf(Operation::EXPORT).slowCalls, 1);
+    metrics->setSlowThreshold(std::chrono::microseconds::zero());
+}
+
 #ifdef DATABASE_HAVE_SQLITE
 TEST(SQLiteDatabaseTest, FailedOpenDoesNotPoisonNextLoad) {
     SQLiteDatabase db(getCmdLine().getPath(FS::PathType::RESOURCES_SQL));
@@ -220,6 +548,118 @@ TEST(SQLiteDatabaseTest, MigratesLegacyDuplicateOwnersDeterministically) {
     EXPECT_TRUE(db.unload());
     std::filesystem::remove(path);
 }
+
+TEST(SQLiteDatabaseTest, CachedStatementsAreReusableAndReleasedOnUnload) {
+    SQLiteDatabase db(getCmdLine().getPath(FS::PathType::RESOURCES_SQL));
+    ASSERT_TRUE(db.load(DatabaseBase::kInMemoryDatabase));
+    for (UserId user = 1; user <= 64; ++user) {
+        ASSERT_EQ(db.addUserToList(DatabaseBase::ListType::WHITELIST, user),
+                  DatabaseBase::ListResult::OK);
+    }
+    // Every lookup reuses one statement; stale bindings or an unreset cursor
+    // would surface as a wrong answer here.
+    for (int round = 0; round < 3; ++round) {
+        for (UserId user = 1; user <= 64; ++user) {
+            EXPECT_EQ(
+                db.checkUserInList(DatabaseBase::ListType::WHITELIST, user),
+                DatabaseBase::ListResult::OK);
+            EXPECT_EQ(
+                db.checkUserInList(DatabaseBase::ListType::WHITELIST, -user),
+                DatabaseBase::ListResult::NOT_IN_LIST);
+        }
+    }
+    DatabaseBase::MediaInfo info = {
+        "media", "unique", {"a", "b", "c"}, DatabaseBase::MediaType::PHOTO};
+    EXPECT_EQ(db.addMediaInfo(info), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db.getMediaIds("b")->size(), 1);
+
+    // sqlite3_close() refuses connections with unfinalized statements.
+    EXPECT_TRUE(db.unload());
+    ASSERT_TRUE(db.load(DatabaseBase::kInMemoryDatabase));
+    EXPECT_EQ(db.checkUserInList(DatabaseBase::ListType::WHITELIST, 1),
+              DatabaseBase::ListResult::NOT_IN_LIST);
+    EXPECT_TRUE(db.unload());
+}
+
+TEST(SQLiteDatabaseTest, PooledReadersSeeCommittedWritesConcurrently) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "glider-sqlite-reader-pool-test.db";
+    std::filesystem::remove(path);
+    SQLiteDatabase db(getCmdLine().getPath(FS::PathType::RESOURCES_SQL));
+    ASSERT_TRUE(db.load(path));
+
+    sqlite3* raw = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    ASSERT_EQ(sqlite3_open(path.string().c_str(), &raw), SQLITE_OK);
+    ASSERT_EQ(sqlite3_prepare_v2(raw, "PRAGMA journal_mode", -1, &stmt,
+                                 nullptr),
+              SQLITE_OK);
+    ASSERT_EQ(sqlite3_step(stmt), SQLITE_ROW);
+    EXPECT_EQ(detail::get<std::string>(0, stmt), "wal");
+    sqlite3_finalize(stmt);
+    sqlite3_close(raw);
+
+    constexpr UserId kUsers = 32;
+    std::vector<std::future<bool>> readers;
+    for (UserId user = 1; user <= kUsers; ++user) {
+        ASSERT_EQ(db.addUserToList(DatabaseBase::ListType::WHITELIST, user),
+                  DatabaseBase::ListResult::OK);
+        // Each write is committed before returning, so a reader started now
+        // must observe it regardless of which connection it is handed.
+        readers.emplace_back(std::async(std::launch::async, [&db, user] {
+            return db.checkUserInList(DatabaseBase::ListType::WHITELIST,
+                                      user) == DatabaseBase::ListResult::OK;
+        }));
+    }
+    for (auto& reader : readers) {
+        EXPECT_TRUE(reader.get());
+    }
+    EXPECT_TRUE(db.unload());
+    std::filesystem::remove(path);
+}
+
+// Fails any batch holding kPoison, as a backend does when one row of the
+// transaction is rejected.
+class PoisonedBatchDatabase : public SQLiteDatabase {
+   public:
+    constexpr static ChatId kPoison = 666;
+    using SQLiteDatabase::SQLiteDatabase;
+
+    [[nodiscard]] std::vector<AddResult> addChatInfos(
+        std::span<const ChatInfo> chats) const override {
+        for (const auto& chat : chats) {
+            if (chat.chatId == kPoison) {
+                return std::vector<AddResult>(chats.size(),
+                                              AddResult::BACKEND_ERROR);
+            }
+        }
+        return SQLiteDatabase::addChatInfos(chats);
+    }
+};
+
+TEST(SQLiteDatabaseTest, AsyncDatabaseRetriesFailedGroupsOneByOne) {
+    PoisonedBatchDatabase db(getCmdLine().getPath(FS::PathType::RESOURCES_SQL));
+    ASSERT_TRUE(db.load(DatabaseBase::kInMemoryDatabase));
+    AsyncDatabase async(&db);
+    std::promise<void> release;
+    auto gate = async.submit(
+        [held = release.get_future()](const DatabaseBase& /*backend*/) {
+            held.wait();
+        });
+    auto before = async.addChatInfo(665, "before");
+    auto poisoned = async.addChatInfo(PoisonedBatchDatabase::kPoison, "bad");
+    auto after = async.addChatInfo(667, "after");
+    release.set_value();
+    gate.get();
+
+    EXPECT_EQ(before.get(), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(poisoned.get(), DatabaseBase::AddResult::BACKEND_ERROR);
+    EXPECT_EQ(after.get(), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db.getChatName(667), "after");
+    // The failed group, then each of its three writes alone.
+    EXPECT_EQ(async.stats().commits, 4);
+    EXPECT_TRUE(db.unload());
+}
 #endif
 
 #ifdef DATABASE_HAVE_PROTOBUF
@@ -249,6 +689,92 @@ TEST(ProtoDatabaseTest, MutationIsDurableBeforeUnload) {
     EXPECT_TRUE(reader.unload());
     EXPECT_TRUE(writer.unload());
     std::filesystem::remove(path);
+    std::filesystem::remove(ProtoDatabase::journalPathFor(path));
+}
+
+TEST(ProtoDatabaseTest, DeletionsShiftLaterEntriesInTheIndices) {
+    ProtoDatabase db;
+    ASSERT_TRUE(db.load(DatabaseBase::kInMemoryDatabase));
+    for (int i = 0; i < 4; ++i) {
+        const auto n = std::to_string(i);
+        // Entries 1 and 2 share a media ID.
+        ASSERT_EQ(db.addMediaInfo({i == 2 ? "media-1" : "media-" + n,
+                                   "unique-" + n,
+                                   {"alias-" + n, "common"},
+                                   DatabaseBase::MediaType::STICKER}),
+                  DatabaseBase::AddResult::OK);
+    }
+    ASSERT_TRUE(db.deleteMediaInfo("media-1"));
+    EXPECT_FALSE(db.queryMediaInfo("alias-1").has_value());
+    for (const int i : {0, 2, 3}) {
+        const auto n = std::to_string(i);
+        const auto media = db.queryMediaInfo("alias-" + n);
+        ASSERT_TRUE(media.has_value()) << n;
+        EXPECT_EQ(media->mediaUniqueId, "unique-" + n);
+    }
+    EXPECT_EQ(db.getMediaIds("common"),
+              (std::vector<std::string>{"media-0", "media-1", "media-3"}));
+    // The entry that shared the ID is found by it now.
+    ASSERT_TRUE(db.deleteMediaInfo("media-1"));
+    EXPECT_FALSE(db.queryMediaInfo("alias-2").has_value());
+    EXPECT_EQ(db.getMediaIds("common"),
+              (std::vector<std::string>{"media-0", "media-3"}));
+
+    ASSERT_EQ(db.addChatInfo(6001, "Same"), DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db.addChatInfo(6002, "same"), DatabaseBase::AddResult::OK);
+    ASSERT_EQ(db.addChatInfo(6003, "third"), DatabaseBase::AddResult::OK);
+    EXPECT_EQ(db.getChatId("same"), 6001);
+    ASSERT_TRUE(db.deleteChatInfo(6001));
+    EXPECT_EQ(db.getChatId("same"), 6002);
+    EXPECT_EQ(db.getChatName(6003), "third");
+    EXPECT_TRUE(db.unload());
+}
+
+TEST(ProtoDatabaseTest, JournalIsReplayedAfterCrashAndTornTailDropped) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "glider-protobuf-journal-replay-test.db";
+    const auto journal = ProtoDatabase::journalPathFor(path);
+    std::filesystem::remove(path);
+    std::filesystem::remove(journal);
+
+    {
+        // Destroyed without unload(), like a crash after the mutations.
+        ProtoDatabase writer;
+        ASSERT_TRUE(writer.load(path));
+        ASSERT_EQ(writer.claimOwnerUserId(3301),
+                  DatabaseBase::OwnerClaimResult::OK);
+        ASSERT_EQ(
+            writer.addUserToList(DatabaseBase::ListType::BLACKLIST, 3302),
+            DatabaseBase::ListResult::OK);
+        ASSERT_EQ(writer.addChatInfo(3303, "journaled"),
+                  DatabaseBase::AddResult::OK);
+    }
+    const auto acknowledged = std::filesystem::file_size(journal);
+    ASSERT_GT(acknowledged, 0);
+    {
+        // A length prefix promising more bytes than were written.
+        std::ofstream torn(journal, std::ios::binary | std::ios::app);
+        torn.put('\x7f').put('\x01');
+    }
+
+    ProtoDatabase reader;
+    ASSERT_TRUE(reader.load(path));
+    EXPECT_EQ(std::filesystem::file_size(journal), acknowledged);
+    EXPECT_EQ(reader.getOwnerUserId(), 3301);
+    EXPECT_EQ(reader.checkUserInList(DatabaseBase::ListType::BLACKLIST, 3302),
+              DatabaseBase::ListResult::OK);
+    EXPECT_EQ(reader.getChatId("journaled"), 3303);
+    ASSERT_TRUE(reader.deleteChatInfo(3303));
+
+    // Unloading folds the journal into the snapshot.
+    ASSERT_TRUE(reader.unload());
+    EXPECT_EQ(std::filesystem::file_size(journal), 0);
+    ASSERT_TRUE(reader.load(path));
+    EXPECT_EQ(reader.getOwnerUserId(), 3301);
+    EXPECT_FALSE(reader.getChatId("journaled"));
+    EXPECT_TRUE(reader.unload());
+    std::filesystem::remove(path);
+    std::filesystem::remove(journal);
 }
 
 TEST(ProtoDatabaseTest, ParsedRepeatedFieldsRemainReadableAndMutable) {
@@ -296,6 +822,7 @@ TEST(ProtoDatabaseTest, ParsedRepeatedFieldsRemainReadableAndMutable) {
               DatabaseBase::ListResult::OK);
     EXPECT_TRUE(verifier.unload());
     std::filesystem::remove(path);
+    std::filesystem::remove(ProtoDatabase::journalPathFor(path));
 }
 
 TEST(ProtoDatabaseTest, RepeatedListLookupsDoNotCopyProtobufContainers) {
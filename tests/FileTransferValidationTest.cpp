@@ -1,7 +1,12 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "Blake3.hpp"
 #include "FileTransferValidation.hpp"
 
 using namespace tgbot::socket::transfer;
@@ -34,6 +39,43 @@ TEST(FileTransferValidation, CoverageMergesOverlapAndDuplicates) {
     EXPECT_EQ(coverage.coveredBytes(), 8U);
 }
 
+TEST(FileTransferValidation, CoverageReportsMissingRanges) {
+    using Range = std::pair<std::uintmax_t, std::uintmax_t>;
+    UploadCoverage coverage(10);
+    EXPECT_EQ(coverage.missing(), (std::vector<Range>{{0, 10}}));
+    coverage.add(2, 3);
+    coverage.add(7, 1);
+    EXPECT_EQ(coverage.missing(),
+              (std::vector<Range>{{0, 2}, {5, 7}, {8, 10}}));
+    coverage.add(0, 2);
+    coverage.add(5, 5);
+    EXPECT_TRUE(coverage.missing().empty());
+    EXPECT_EQ(coverage.ranges().size(), 1U);
+}
+
+TEST(FileTransferValidation, CoverageCoversRanges) {
+    UploadCoverage coverage(10);
+    coverage.add(2, 3);
+    coverage.add(5, 2);
+    EXPECT_TRUE(coverage.covers(2, 7));
+    EXPECT_TRUE(coverage.covers(4, 5));
+    EXPECT_TRUE(coverage.covers(9, 9));
+    EXPECT_FALSE(coverage.covers(1, 3));
+    EXPECT_FALSE(coverage.covers(6, 8));
+    EXPECT_FALSE(coverage.covers(0, 10));
+}
+
+TEST(FileTransferValidation, CoverageOverlapsRanges) {
+    UploadCoverage coverage(10);
+    coverage.add(2, 3);
+    coverage.add(7, 1);
+    EXPECT_TRUE(coverage.overlaps(0, 3));
+    EXPECT_TRUE(coverage.overlaps(4, 8));
+    EXPECT_FALSE(coverage.overlaps(0, 2));
+    EXPECT_FALSE(coverage.overlaps(5, 7));
+    EXPECT_FALSE(coverage.overlaps(3, 3));
+}
+
 TEST(FileTransferValidation, ChunkCount) {
     EXPECT_EQ(chunkCount(0), 0);
     EXPECT_EQ(chunkCount(1), 1);
@@ -70,3 +112,139 @@ TEST(FileTransferValidation, ChunkOffset) {
     EXPECT_EQ(chunkOffset(1), kChunkSize);
     EXPECT_EQ(chunkOffset(10), kChunkSize * 10);
 }
+
+TEST(FileTransferValidation, StreamStartValid) {
+    EXPECT_TRUE(streamStartValid(0, 0));
+    EXPECT_TRUE(streamStartValid(0, 100));
+    EXPECT_TRUE(streamStartValid(kChunkSize, kChunkSize * 2 + 1));
+    EXPECT_TRUE(streamStartValid(100, 100));  // Nothing left to send.
+    EXPECT_FALSE(streamStartValid(1, kChunkSize * 2));
+    EXPECT_FALSE(streamStartValid(kChunkSize * 3, kChunkSize * 2));
+}
+
+TEST(FileTransferValidation, StreamChunkLimit) {
+    EXPECT_EQ(streamChunkLimit(0), kMaxStreamChunkSize);
+    EXPECT_EQ(streamChunkLimit(1), kChunkSize);             // raised to min
+    EXPECT_EQ(streamChunkLimit(kChunkSize * 3 + 1), kChunkSize * 3);
+    EXPECT_EQ(streamChunkLimit(kMaxStreamChunkSize * 4), kMaxStreamChunkSize);
+}
+
+TEST(FileTransferValidation, AdaptiveChunkSizeFollowsWriteTimes) {
+    using std::chrono::milliseconds;
+    AdaptiveChunkSize chunkSize(kChunkSize * 4);
+    EXPECT_EQ(chunkSize.size(), kChunkSize);
+    chunkSize.record(milliseconds(1));
+    EXPECT_EQ(chunkSize.size(), kChunkSize * 2);
+    chunkSize.record(milliseconds(1));
+    chunkSize.record(milliseconds(1));
+    EXPECT_EQ(chunkSize.size(), kChunkSize * 4);  // capped at the limit
+    chunkSize.record(milliseconds(50));
+    EXPECT_EQ(chunkSize.size(), kChunkSize * 4);  // neither fast nor slow
+    chunkSize.record(milliseconds(500));
+    EXPECT_EQ(chunkSize.size(), kChunkSize * 2);
+    chunkSize.record(milliseconds(500));
+    chunkSize.record(milliseconds(500));
+    EXPECT_EQ(chunkSize.size(), kChunkSize);  // never below kChunkSize
+}
+
+TEST(FileTransferValidation, AdaptiveChunkSizeHalvesToChunkMultiples) {
+    using std::chrono::milliseconds;
+    AdaptiveChunkSize chunkSize(kChunkSize * 3);
+    chunkSize.record(milliseconds(1));
+    chunkSize.record(milliseconds(1));
+    EXPECT_EQ(chunkSize.size(), kChunkSize * 3);
+    chunkSize.record(milliseconds(500));
+    EXPECT_EQ(chunkSize.size(), kChunkSize);
+    EXPECT_EQ(chunkSize.size() % kChunkSize, 0);
+}
+
+namespace {
+
+// The input of the official BLAKE3 test vectors.
+std::vector<std::uint8_t> blake3Input(std::size_t size) {
+    std::vector<std::uint8_t> input(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        input[i] = static_cast<std::uint8_t>(i % 251);
+    }
+    return input;
+}
+
+std::string toHex(const Blake3::Digest& digest) {
+    std::string hex;
+    for (const auto byte : digest) {
+        char buffer[3];
+        std::snprintf(buffer, sizeof(buffer), "%02x", byte);
+        hex += buffer;
+    }
+    return hex;
+}
+
+}  // namespace
+
+TEST(Blake3, MatchesTestVectors) {
+    const std::vector<std::pair<std::size_t, std::string>> vectors = {
+        {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+        {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+        {1024,
+         "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+        {1025,
+         "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+        {102400,
+         "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+    };
+    for (const auto& [size, expected] : vectors) {
+        const auto input = blake3Input(size);
+        Blake3 hasher;
+        // Odd pieces, so updates straddle blocks and chunks.
+        for (std::size_t offset = 0; offset < size; offset += 100) {
+            hasher.update(input.data() + offset,
+                          std::min<std::size_t>(100, size - offset));
+        }
+        EXPECT_EQ(toHex(hasher.digest()), expected) << size << " bytes";
+    }
+}
+
+TEST(Blake3, TreeTakesBlocksInAnyOrder) {
+    for (const std::size_t size : {std::size_t{0}, kChunkSize, kChunkSize + 1,
+                                   5 * kChunkSize + 777}) {
+        const auto input = blake3Input(size);
+        Blake3 hasher;
+        hasher.update(input.data(), input.size());
+
+        Blake3Tree tree(size, kChunkSize);
+        for (auto index = tree.blockCount(); index-- > 0;) {
+            EXPECT_FALSE(tree.hasBlock(index));
+            const auto offset = index * kChunkSize;
+            tree.addBlock(index, input.data() + offset,
+                          std::min<std::size_t>(kChunkSize, size - offset));
+            EXPECT_TRUE(tree.hasBlock(index));
+        }
+        EXPECT_EQ(tree.digest(), hasher.digest()) << size << " bytes";
+    }
+}
+
+TEST(Blake3, TreeTakesBlocksHashedAgain) {
+    for (const std::size_t size : {kChunkSize, 3 * kChunkSize + 5}) {
+        auto input = blake3Input(size);
+        Blake3Tree tree(size, kChunkSize);
+        for (std::uint64_t index = 0; index < tree.blockCount(); ++index) {
+            const auto offset = index * kChunkSize;
+            tree.addBlock(index, input.data() + offset,
+                          std::min<std::size_t>(kChunkSize, size - offset));
+        }
+        // The last block changes after it was added.
+        const auto last = tree.blockCount() - 1;
+        const auto offset = last * kChunkSize;
+        input[offset] ^= 0xff;
+        tree.removeBlock(last);
+        EXPECT_FALSE(tree.hasBlock(last));
+        const auto hash =
+            tree.hashBlock(last, input.data() + offset, size - offset);
+        EXPECT_FALSE(tree.hasBlock(last));
+        tree.setBlock(hash);
+
+        Blake3 hasher;
+        hasher.update(input.data(), input.size());
+        EXPECT_EQ(tree.digest(), hasher.digest()) << size << " bytes";
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+// A fixture giving each test a log file path of its own in the temporary
+// directory, removed after the test.
+class LogFileTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        const auto* info =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+        path_ = std::filesystem::temp_directory_path() /
+                (std::string(info->test_suite_name()) + "_" + info->name() +
+                 ".log");
+    }
+    void TearDown() override { std::filesystem::remove(path_); }
+
+    std::filesystem::path path_;
+};
@@ -0,0 +1,96 @@
+#include <absl/log/log.h>
+#include <gtest/gtest.h>
+
+#include <LogRing.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using std::chrono_literals::operator""ms;
+
+namespace {
+
+std::vector<std::string> messages(const std::vector<LogRing::Entry>& entries) {
+    std::vector<std::string> result;
+    for (const auto& entry : entries) {
+        result.emplace_back(entry.message);
+    }
+    return result;
+}
+
+}  // namespace
+
+TEST(LogRingTest, ReplayStartsWithTheLastEntries) {
+    LogRing ring(8);
+    for (int i = 0; i < 5; ++i) {
+        LOG(INFO).ToSinkOnly(&ring) << i;
+    }
+    std::vector<LogRing::Entry> entries;
+
+    LogRing::Reader none(ring, 0);
+    EXPECT_EQ(none.read(&entries, 0ms), 0U);
+    EXPECT_TRUE(entries.empty());
+
+    LogRing::Reader some(ring, 2);
+    EXPECT_EQ(some.read(&entries, 0ms), 0U);
+    EXPECT_EQ(messages(entries), (std::vector<std::string>{"3", "4"}));
+
+    // No more than the ring holds.
+    LogRing::Reader all(ring, 100);
+    EXPECT_EQ(all.read(&entries, 0ms), 0U);
+    EXPECT_EQ(entries.size(), 5U);
+    EXPECT_EQ(entries[0].file, "LogRingTest.cpp");
+}
+
+TEST(LogRingTest, ReadersFollowIndependently) {
+    LogRing ring(8);
+    LogRing::Reader first(ring, 0);
+    LogRing::Reader second(ring, 0);
+    std::vector<LogRing::Entry> entries;
+
+    LOG(WARNING).ToSinkOnly(&ring) << "a";
+    EXPECT_EQ(first.read(&entries, 0ms), 0U);
+    EXPECT_EQ(messages(entries), (std::vector<std::string>{"a"}));
+    EXPECT_EQ(entries[0].severity, absl::LogSeverity::kWarning);
+
+    LOG(INFO).ToSinkOnly(&ring) << "b";
+    EXPECT_EQ(first.read(&entries, 0ms), 0U);
+    EXPECT_EQ(messages(entries), (std::vector<std::string>{"b"}));
+    EXPECT_EQ(second.read(&entries, 0ms), 0U);
+    EXPECT_EQ(messages(entries), (std::vector<std::string>{"a", "b"}));
+}
+
+TEST(LogRingTest, SlowReaderCountsWhatItMissed) {
+    LogRing ring(4);
+    LogRing::Reader slow(ring, 0);
+    LogRing::Reader fast(ring, 0);
+    std::vector<LogRing::Entry> entries;
+    for (int i = 0; i < 10; ++i) {
+        LOG(INFO).ToSinkOnly(&ring) << i;
+        EXPECT_EQ(fast.read(&entries, 0ms), 0U);
+    }
+
+    EXPECT_EQ(slow.read(&entries, 0ms), 6U);
+    EXPECT_EQ(messages(entries),
+              (std::vector<std::string>{"6", "7", "8", "9"}));
+    EXPECT_EQ(slow.dropped(), 6U);
+    EXPECT_EQ(fast.dropped(), 0U);
+}
+
+TEST(LogRingTest, ReadsMoreThanAChunkInOrder) {
+    constexpr std::size_t kEntries = LogRing::kReadChunk * 3 + 5;
+    LogRing ring(kEntries);
+    for (std::size_t i = 0; i < kEntries; ++i) {
+        LOG(INFO).ToSinkOnly(&ring) << i;
+    }
+    LogRing::Reader reader(ring, kEntries);
+    std::vector<LogRing::Entry> entries;
+
+    EXPECT_EQ(reader.read(&entries, 0ms), 0U);
+    ASSERT_EQ(entries.size(), kEntries);
+    for (std::size_t i = 0; i < kEntries; ++i) {
+        EXPECT_EQ(entries[i].message, std::to_string(i));
+    }
+    EXPECT_EQ(reader.read(&entries, 0ms), 0U);
+    EXPECT_TRUE(entries.empty());
+}
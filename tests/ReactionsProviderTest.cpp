@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <api/components/ReactionsProvider.hpp>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using Rules = TgBotApiImpl::ReactionsProvider::Rules;
+
+namespace {
+
+std::optional<Rules> parse(const std::string& json) {
+    std::istringstream input(json);
+    return Rules::parse(input);
+}
+
+Message textMessage(const std::string& text) {
+    Message message;
+    message.text = text;
+    return message;
+}
+
+}  // namespace
+
+TEST(ReactionsProviderTest, DefaultsReactInTheOriginalOrder) {
+    const auto rules = Rules::defaults();
+    Message message = textMessage("alex");
+    message.from = std::make_shared<TgBot::User>();
+    (*message.from)->id = 5037893234;
+    auto document = std::make_shared<TgBot::Document>();
+    document->fileName = "last_kmsg";
+    message.document = document;
+
+    // Filename, text, user, as the rules were applied before they could
+    // be configured.
+    EXPECT_EQ(rules.match(message),
+              (std::vector<std::string>{"😱", "🥰", "👑"}));
+    EXPECT_EQ(rules.match(textMessage("hey")),
+              (std::vector<std::string>{"🍌"}));
+}
+
+TEST(ReactionsProviderTest, ParsedRulesKeepFileOrder) {
+    const auto rules = parse(R"([
+        {"type": "user", "id": 42, "emoji": "1"},
+        {"type": "text", "pattern": "b", "emoji": "2"},
+        {"type": "unknown", "emoji": "skipped"},
+        {"type": "text", "pattern": "a", "emoji": "3"}
+    ])");
+    ASSERT_TRUE(rules);
+    ASSERT_EQ(rules->rules.size(), 3U);
+    Message message = textMessage("ab");
+    message.from = std::make_shared<TgBot::User>();
+    (*message.from)->id = 42;
+    EXPECT_EQ(rules->match(message), (std::vector<std::string>{"1", "2", "3"}));
+}
+
+TEST(ReactionsProviderTest, PrefilterSkipsTextThatMatchesNoRule) {
+    const auto rules = parse(R"([
+        {"type": "text", "pattern": "^foo", "emoji": "1"},
+        {"type": "text", "pattern": "bar$", "emoji": "2"}
+    ])");
+    ASSERT_TRUE(rules);
+    ASSERT_TRUE(rules->textPrefilter);
+    EXPECT_TRUE(rules->match(textMessage("baz")).empty());
+    EXPECT_EQ(rules->match(textMessage("foobar")),
+              (std::vector<std::string>{"1", "2"}));
+    EXPECT_EQ(rules->match(textMessage("a bar")),
+              (std::vector<std::string>{"2"}));
+    EXPECT_TRUE(rules->match(Message{}).empty());
+}
+
+TEST(ReactionsProviderTest, BackreferencesStillMatchWithoutPrefilter) {
+    const auto rules = parse(R"([
+        {"type": "text", "pattern": "(a)\\1", "emoji": "1"},
+        {"type": "text", "pattern": "b", "emoji": "2"}
+    ])");
+    ASSERT_TRUE(rules);
+    EXPECT_FALSE(rules->textPrefilter);
+    EXPECT_EQ(rules->match(textMessage("aa")),
+              (std::vector<std::string>{"1"}));
+    EXPECT_TRUE(rules->match(textMessage("a")).empty());
+}
+
+TEST(ReactionsProviderTest, InvalidRulesAreRejected) {
+    EXPECT_FALSE(parse("not json"));
+    EXPECT_FALSE(parse(R"([{"type": "text", "emoji": "1"}])"));
+    EXPECT_FALSE(parse(R"([{"type": "text", "pattern": "(", "emoji": "1"}])"));
+    EXPECT_FALSE(Rules::load("/nonexistent/reactions.json"));
+}
@@ -165,4 +165,15 @@ INSTANTIATE_TEST_SUITE_P(ExpectedFailure_Expanded, RegexHandlerTestFail,
                              Params{"text", "/Unbalanced(/d", "Exception"},
                              Params{"text", "/[range/p", "Exception"},
                              Params{"text", "/a{5,1}/c", "Exception"},
-                             Params{"text", "u/*start/", "Exception"}));
\ No newline at end of file
+                             Params{"text", "u/*start/", "Exception"}));
+
+TEST_F(RegexHandlerTest, IgnoresTextWithoutCommandShape) {
+    EXPECT_CALL(*mock, onSuccess(_)).Times(0);
+    EXPECT_CALL(*mock, onError(_)).Times(0);
+
+    handler.execute(mock, "text", "");
+    handler.execute(mock, "text", "hello there");
+    handler.execute(mock, "text", "/pattern/x");
+    handler.execute(mock, "text", "u/pattern");
+    clearVerification();
+}
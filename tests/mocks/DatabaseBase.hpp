@@ -18,6 +18,9 @@ class MockDatabase : public DatabaseBase {
     MOCK_METHOD(DatabaseBase::ListResult, checkUserInList,
                 (DatabaseBase::ListType type, UserId user), (const, override));
 
+    MOCK_METHOD(std::vector<UserId>, getUsersInList,
+                (DatabaseBase::ListType type), (const, override));
+
     MOCK_METHOD(std::optional<UserId>, getOwnerUserId, (), (const, override));
 
     MOCK_METHOD(std::optional<DatabaseBase::MediaInfo>, queryMediaInfo,